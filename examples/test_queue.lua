@@ -0,0 +1,102 @@
+-- test_queue.lua
+--
+-- Очередь отложенных загрузок: put и загрузка в фоне, вторая запись
+-- того же ключа заменяет незагруженную первую, вторая очередь на тот же
+-- спейс не открывается, записи, оставшиеся после close(), догружает
+-- новая очередь (как после рестарта).
+
+package.cpath = '../build/?.dylib;../build/?.so;' .. package.cpath
+
+local fiber = require('fiber')
+local fio = require('fio')
+local json = require('json')
+local s3 = require('s3')
+
+local WORK = '/tmp/s3_queue_work'
+local SPACE = 's3_queue_test'
+local PREFIX = ('queue-test-%d/'):format(os.time())
+
+fio.rmtree(WORK)
+fio.mktree(WORK)
+box.cfg{ work_dir = WORK, log_level = 4 }
+
+local client, err = s3.new{
+    endpoint        = 'http://minio:9000',
+    region          = 'us-east-1',
+    access_key      = 'user',
+    secret_key      = '12345678',
+    backend         = 'multi',
+    default_bucket  = 'firstbucket',
+    require_sigv4   = true,
+}
+assert(client, ('s3.new failed: %s'):format(err and err.message))
+
+local function read_object(key)
+    local r, rerr = client:open_read(nil, key)
+    assert(r, 'open_read ' .. key .. ': ' .. json.encode(rerr))
+    local parts = {}
+    while true do
+        local data, derr = r:read()
+        assert(derr == nil, 'read ' .. key .. ': ' .. json.encode(derr))
+        if data == nil then
+            break
+        end
+        parts[#parts + 1] = data
+    end
+    r:close()
+    return table.concat(parts)
+end
+
+local function wait_drained(q)
+    local deadline = fiber.clock() + 30
+    while q:stats().pending > 0 do
+        assert(fiber.clock() < deadline, 'queue did not drain: ' ..
+               json.encode(q:stats()))
+        fiber.sleep(0.1)
+    end
+end
+
+print("--------------------- test_queue [START] --------------------------")
+
+-- 1. put: запись уходит в bucket в фоне.
+local q, qerr = client:queue{ space = SPACE, concurrency = 4 }
+assert(q, 'queue: ' .. json.encode(qerr))
+
+local again, aerr = client:queue{ space = SPACE }
+assert(again == nil and aerr ~= nil,
+       'second queue on the same space must be rejected')
+
+assert(q:put(nil, PREFIX .. 'a', 'first object'))
+wait_drained(q)
+assert(read_object(PREFIX .. 'a') == 'first object')
+assert(q:stats().uploaded == 1, json.encode(q:stats()))
+
+-- 2. Два put подряд без уступки управления: файбер очереди ещё не
+-- проснулся, вторая запись заменяет первую, и грузится только она.
+assert(q:put(nil, PREFIX .. 'b', 'old value'))
+assert(q:put(nil, PREFIX .. 'b', 'new value'))
+assert(q:stats().pending == 1, 'superseded write must be replaced')
+wait_drained(q)
+assert(read_object(PREFIX .. 'b') == 'new value')
+assert(q:stats().uploaded == 2, json.encode(q:stats()))
+
+-- 3. close() сразу после put: запись остаётся в спейсе и её догружает
+-- следующая очередь на тот же спейс.
+assert(q:put(nil, PREFIX .. 'c', 'after restart'))
+q:close()
+assert(box.space[SPACE]:len() == 1, 'pending write must survive close()')
+
+q, qerr = client:queue{ space = SPACE }
+assert(q, 'reopen queue: ' .. json.encode(qerr))
+wait_drained(q)
+assert(read_object(PREFIX .. 'c') == 'after restart')
+
+-- 4. client:close() останавливает свои очереди.
+client:close()
+local ok = pcall(q.stats, q)
+assert(not ok, 'queue must be closed together with its client')
+
+box.space[SPACE]:drop()
+
+print("--------------------- test_queue [FINISHED] --------------------------")
+os.exit(0)
@@ -84,11 +84,52 @@ s3_free(const s3_allocator_t *a, void *ptr)
  * Инициализация аллокатора, работающего поверх Tarantool small_alloc.
  *
  * small_ctx — это (struct small_alloc *).
+ *
+ * small_alloc не потокобезопасен, а client->alloc зовётся и из
+ * coio-воркеров, и из потока multi backend'а, и из фоновых потоков.
+ * Такой аллокатор годится, только если вызовы снаружи сериализованы;
+ * иначе — s3_allocator_init_small_mt.
  */
 void
 s3_allocator_init_small(s3_allocator_t *a, void *small_ctx);
 
 
+/*
+ * Потокобезопасный аллокатор поверх small.
+ *
+ * У каждого потока, который выделяет память, свой slab_cache и
+ * small_alloc над общей slab_arena (она потокобезопасна), поэтому
+ * malloc/free в своём потоке идут без блокировок. Блок, освобождённый
+ * чужим потоком, кладётся в lock-free список потока-владельца, и тот
+ * возвращает его в свой small_alloc при следующем вызове.
+ *
+ * Кэш завершившегося потока не разрушается (в нём могут жить блоки),
+ * а достаётся следующему новому потоку.
+ *
+ *      struct slab_arena arena;  // slab_arena_create(&arena, &quota, ...)
+ *      s3_mt_allocator_t *mt = s3_mt_allocator_new(&arena);
+ *      s3_allocator_t a;
+ *      s3_allocator_init_small_mt(&a, mt);
+ *      ... клиенты с opts.allocator = &a ...
+ *      s3_mt_allocator_delete(mt);  // после удаления всех клиентов
+ */
+typedef struct s3_mt_allocator s3_mt_allocator_t;
+
+/*
+ * arena_ctx — это (struct slab_arena *), должна пережить аллокатор.
+ * NULL — нет памяти.
+ */
+s3_mt_allocator_t *
+s3_mt_allocator_new(void *arena_ctx);
+
+/* Освобождает всю память, выделенную через аллокатор. */
+void
+s3_mt_allocator_delete(s3_mt_allocator_t *mt);
+
+void
+s3_allocator_init_small_mt(s3_allocator_t *a, s3_mt_allocator_t *mt);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -14,11 +14,14 @@ extern "C" {
 
 /*
  * Тип HTTP backend'а.
- * Реализуется через libcurl (easy/multi).
+ * Реализуется через libcurl (easy/multi) или собственным HTTP/1.1
+ * клиентом (native: только http://, один endpoint; PUT/GET в fd идут
+ * через sendfile/splice, остальное — через curl easy).
  */
 typedef enum s3_http_backend {
     S3_HTTP_BACKEND_CURL_EASY  = 0,
     S3_HTTP_BACKEND_CURL_MULTI = 1,
+    S3_HTTP_BACKEND_NATIVE     = 2,
 } s3_http_backend_t;
 
 /*
@@ -97,8 +100,28 @@ enum {
     /*
      * Использовать path-style адреса (https://host/bucket/key)
      * вместо virtual-hosted-style (https://bucket.host/key).
+     * Обязателен для S3_HTTP_BACKEND_NATIVE: другого он не умеет.
      */
     S3_CLIENT_F_FORCE_PATH_STYLE       = 1u << 3,
+
+    /*
+     * Склеивать одновременные одинаковые GET (singleflight):
+     * первый вызов качает объект, остальные ждут его и получают копию.
+     */
+    S3_CLIENT_F_COALESCE_GETS          = 1u << 4,
+
+    /*
+     * Резолвить endpoint'ы заранее и обновлять адреса в фоне
+     * (dns_refresh_ms); соединения распределяются по всем A/AAAA записям.
+     */
+    S3_CLIENT_F_PIN_DNS                = 1u << 5,
+
+    /*
+     * Договариваться о HTTP/2 (ALPN, только https) и мультиплексировать
+     * запросы multi backend'а по max_concurrent_streams на соединение.
+     * Если сервер не умеет h2 — остаётся HTTP/1.1.
+     */
+    S3_CLIENT_F_HTTP2                  = 1u << 6,
 };
 
 /*
@@ -106,6 +129,41 @@ enum {
  */
 typedef struct s3_client_opts {
     const char *endpoint;     /* Например: "https://s3.example.com" */
+
+    /*
+     * Опционально: несколько endpoint'ов одного кластера (узлы MinIO и т.п.).
+     * Запросы распределяются между ними по латентности, упавшие узлы
+     * временно исключаются, идемпотентные запросы повторяются на другом
+     * узле. endpoint тогда можно не задавать.
+     */
+    const char *const *endpoints;
+    size_t endpoints_count;
+    uint32_t endpoint_eject_errors;      /* 3 -> ошибок подряд до исключения */
+    uint32_t endpoint_probe_interval_ms; /* 2s -> период проверки исключённых */
+    uint32_t endpoint_max_attempts;      /* 3 -> попыток на запрос (<= числа endpoint'ов) */
+
+    uint32_t dns_refresh_ms;             /* 30s -> период обновления адресов (S3_CLIENT_F_PIN_DNS) */
+
+    /*
+     * Опционально: держать открытыми prewarm_connections keep-alive
+     * соединений на каждый endpoint. Открываются в фоне сразу после
+     * создания клиента (HEAD prewarm_bucket, по умолчанию default_bucket)
+     * и обновляются раз в keep_warm_interval_ms, чтобы сервер не закрыл
+     * их по простою. Пул соединений есть только у multi backend'а; у easy
+     * прогреваются DNS и TLS-сессии.
+     */
+    uint32_t prewarm_connections;
+    uint32_t keep_warm_interval_ms;      /* 15s -> значение по умолчанию */
+    const char *prewarm_bucket;
+
+    /*
+     * Опционально: кэш блоков для s3_client_pread с etag. Объекты
+     * читаются блоками block_cache_block_size байт, до block_cache_bytes
+     * байт держится в памяти (LRU). 0 — кэш выключен.
+     */
+    size_t block_cache_bytes;
+    uint32_t block_cache_block_size;     /* 1 MiB -> значение по умолчанию */
+
     const char *region;       /* Например: "us-east-1" */
 
     const char *access_key;   /* AWS Access Key ID */
@@ -128,6 +186,7 @@ typedef struct s3_client_opts {
     uint32_t max_total_connections;      /* 64 -> значение по умолчанию */
     uint32_t max_connections_per_host;   /* 16 -> значение по умолчанию */
     uint32_t multi_idle_timeout_ms;      /* 50ms -> значение по умолчанию */
+    uint32_t max_concurrent_streams;     /* 100 -> потоков на h2 соединение (S3_CLIENT_F_HTTP2) */
 
     const char *ca_file;
     const char *ca_path;
@@ -185,6 +244,8 @@ typedef struct s3_put_opts {
 
     const char *content_type;  /* Опционально: "application/octet-stream" и т.п. */
     uint64_t content_length;   /* Если 0 — берём из size аргумента put_fd */
+    const char *checksum_sha256; /* Опционально: SHA-256 тела в base64,
+                                    S3 отвергнет PUT с другим телом */
 
     uint32_t flags;    /* На будущее: например, disable_expect_100_continue и т.п. */
 } s3_put_opts_t;
@@ -209,6 +270,357 @@ s3_client_put_fd(s3_client_t *client,
                  s3_error_t *error);
 
 
+/*
+ * Опции s3_client_put_stream.
+ */
+typedef struct s3_put_stream_opts {
+    size_t part_size;      /* 0 -> 8 MiB; не меньше 5 MiB (ограничение S3) */
+    uint32_t concurrency;  /* 0 -> 4; сколько частей грузится одновременно */
+} s3_put_stream_opts_t;
+
+/*
+ * PUT из pipe/сокета/stdin: fd читается read()'ом до EOF, размер заранее
+ * неизвестен.
+ *
+ * Поток режется на части по part_size и грузится multipart upload'ом,
+ * пачками по concurrency частей; пока пачка грузится, следующая читается
+ * из fd во второй набор буферов. Памяти — 2 * part_size * concurrency,
+ * сколько бы ни было в потоке. Если поток закончился раньше первой
+ * части — обычный PUT одним запросом.
+ *
+ * Частей не больше 10000, то есть объект до part_size * 10000 байт.
+ * При ошибке загрузка отменяется (AbortMultipartUpload), прочитанные
+ * из fd данные теряются. opts->content_length игнорируется.
+ *
+ * bytes_read (если не NULL) — сколько байт прочитано из fd.
+ */
+s3_error_code_t
+s3_client_put_stream(s3_client_t *client,
+                     const s3_put_opts_t *opts,
+                     const s3_put_stream_opts_t *stream_opts,
+                     int fd,
+                     uint64_t *bytes_read,
+                     s3_error_t *error);
+
+/*
+ * Кусок файла для s3_client_put_iov.
+ */
+typedef struct s3_put_seg {
+    int fd;
+    off_t offset;  /* читается pread'ом, позиция fd не меняется */
+    size_t len;
+} s3_put_seg_t;
+
+/*
+ * PUT одного объекта, склеенного из кусков файлов (заголовок + данные +
+ * футер, диапазон xlog'ов и т.п.) без временного файла: тело — это
+ * segs[0], segs[1], ... подряд.
+ *
+ * Если объект не больше part_size (opts части как у put_stream:
+ * part_size, concurrency; mp_opts может быть NULL) — один PUT, read
+ * callback идёт по сегментам. Иначе — multipart upload: объект режется
+ * на части по part_size (часть может захватывать несколько сегментов),
+ * concurrency частей грузятся одновременно.
+ *
+ * segs должны жить на время вызова. opts->content_length игнорируется.
+ */
+s3_error_code_t
+s3_client_put_iov(s3_client_t *client,
+                  const s3_put_opts_t *opts,
+                  const s3_put_stream_opts_t *mp_opts,
+                  const s3_put_seg_t *segs, size_t count,
+                  s3_error_t *error);
+
+/* Сравнивать с уже загруженным объектом ещё и ETag (читает файл целиком). */
+#define S3_BACKUP_F_VERIFY_ETAG 0x1
+
+/*
+ * Опции s3_client_backup.
+ */
+typedef struct s3_backup_opts {
+    const char *bucket;       /* NULL — default_bucket */
+    const char *prefix;       /* префикс ключей, например "backup/0042/" */
+    const char *manifest_key; /* NULL — prefix + "manifest.json" */
+    size_t part_size;         /* 0 -> 16 MiB; не меньше 5 MiB */
+    uint32_t concurrency;     /* 0 -> 8; запросов одновременно */
+    uint32_t flags;           /* S3_BACKUP_F_* */
+} s3_backup_opts_t;
+
+typedef struct s3_backup_result {
+    size_t files;             /* всего файлов */
+    size_t uploaded;          /* загружено */
+    size_t skipped;           /* уже были в bucket'е */
+    uint64_t bytes;           /* размер всех файлов */
+    uint64_t bytes_uploaded;  /* отправлено байт */
+    double elapsed;           /* секунд на весь backup */
+} s3_backup_result_t;
+
+/*
+ * Загрузить файлы backup'а (список от box.backup.start(): .snap, .xlog,
+ * файлы vinyl) в bucket.
+ *
+ * Ключ файла — prefix + путь без общего для всех файлов каталога.
+ * Файл пропускается, если объект с таким ключом уже есть и у него тот
+ * же размер (и ETag при S3_BACKUP_F_VERIFY_ETAG): имена файлов
+ * Tarantool содержат LSN, и закрытые файлы не меняются.
+ *
+ * Маленькие файлы грузятся пачками по concurrency PUT'ов, большие —
+ * multipart upload'ом с concurrency частями одновременно. Последним
+ * пишется manifest (JSON: путь, ключ, размер, part_size и ETag каждого
+ * файла) — backup без manifest'а считается незавершённым.
+ *
+ * result (если не NULL) заполняется и при ошибке.
+ */
+s3_error_code_t
+s3_client_backup(s3_client_t *client,
+                 const s3_backup_opts_t *opts,
+                 const char *const *files, size_t count,
+                 s3_backup_result_t *result,
+                 s3_error_t *error);
+
+/* Не сверять md5 скачанных файлов с ETag из manifest'а. */
+#define S3_RESTORE_F_NO_VERIFY 0x1
+
+/*
+ * Опции s3_client_restore.
+ */
+typedef struct s3_restore_opts {
+    const char *bucket;       /* NULL — default_bucket */
+    const char *manifest_key; /* manifest, записанный s3_client_backup */
+    const char *dir;          /* куда класть файлы (name из manifest'а) */
+    uint32_t concurrency;     /* 0 -> 8; Range GET'ов одновременно */
+    uint32_t flags;           /* S3_RESTORE_F_* */
+} s3_restore_opts_t;
+
+typedef struct s3_restore_result {
+    size_t files;
+    uint64_t bytes;
+    double elapsed;           /* секунд на весь restore */
+} s3_restore_result_t;
+
+/*
+ * Восстановить backup по manifest'у.
+ *
+ * Все файлы качаются одновременно: каждый режется на полосы по своему
+ * part_size из manifest'а (файл, загруженный одним PUT — одна полоса),
+ * полосы всех файлов идут Range GET'ами с If-Match по concurrency штук
+ * в заранее выделенные (posix_fallocate) временные файлы "<name>.s3tmp".
+ *
+ * md5 каждой полосы считается сразу после её загрузки и в конце
+ * сводится в ETag файла (для multipart — md5 от md5 частей, поэтому
+ * полосы совпадают с частями backup'а). У multipart-файла с неизвестным
+ * part_size (0 или нет в manifest'е) ETag не сверяется, его полосы —
+ * по 16 MiB. Размер проверяется всегда.
+ *
+ * Запись на диск запускается после каждой пачки (sync_file_range), в
+ * конце — fsync файлов, rename на место и fsync каталогов. При ошибке
+ * временные файлы удаляются, уже лежавшие в dir файлы не трогаются.
+ */
+s3_error_code_t
+s3_client_restore(s3_client_t *client,
+                  const s3_restore_opts_t *opts,
+                  s3_restore_result_t *result,
+                  s3_error_t *error);
+
+typedef enum s3_sync_direction {
+    S3_SYNC_UPLOAD = 0,   /* local_dir -> bucket/prefix */
+    S3_SYNC_DOWNLOAD = 1, /* bucket/prefix -> local_dir */
+} s3_sync_direction_t;
+
+/* Удалять в приёмнике то, чего нет в источнике. */
+#define S3_SYNC_F_DELETE   0x1
+/* При равном размере сравнивать md5 файла с ETag вместо mtime. */
+#define S3_SYNC_F_CHECKSUM 0x2
+
+/*
+ * Опции s3_client_sync.
+ */
+typedef struct s3_sync_opts {
+    const char *local_dir;
+    const char *bucket;       /* NULL — default_bucket */
+    const char *prefix;       /* ключ = prefix + путь от local_dir */
+    s3_sync_direction_t direction;
+    size_t part_size;         /* 0 -> 16 MiB; больше — multipart upload */
+    uint32_t concurrency;     /* 0 -> 8; передач одновременно */
+    uint32_t flags;           /* S3_SYNC_F_* */
+} s3_sync_opts_t;
+
+typedef struct s3_sync_result {
+    size_t scanned;           /* имён в local_dir и под prefix (без повторов) */
+    size_t transferred;
+    size_t deleted;
+    uint64_t bytes;           /* передано */
+    double elapsed;           /* секунд на весь sync */
+} s3_sync_result_t;
+
+/*
+ * Инкрементальная синхронизация каталога и prefix'а в bucket'е.
+ *
+ * Обход local_dir (каталоги читаются по одному, имена сортируются в
+ * порядке ключей S3) сливается с постраничным ListObjectsV2 без
+ * загрузки полного списка в память. Файл передаётся, если его нет в
+ * приёмнике, отличается размер или (без S3_SYNC_F_CHECKSUM) mtime:
+ * при upload — файл новее объекта, при download — mtime файла не равен
+ * LastModified (после download он выставляется равным).
+ *
+ * Передачи копятся в пачку по concurrency и выполняются, пока слияние
+ * стоит; файлы больше part_size грузятся multipart'ом, их части идут
+ * в тех же пачках, что и мелкие файлы. Download пишет
+ * во временный "<name>.s3tmp" и переименовывает после fsync. Удаления
+ * объектов идут DeleteObjects по 1000 ключей.
+ *
+ * Пустые каталоги и ключи, оканчивающиеся на '/', пропускаются.
+ */
+s3_error_code_t
+s3_client_sync(s3_client_t *client,
+               const s3_sync_opts_t *opts,
+               s3_sync_result_t *result,
+               s3_error_t *error);
+
+/*
+ * Опции chunk store (s3_client_chunk_put / s3_client_chunk_get).
+ */
+typedef struct s3_chunk_opts {
+    const char *bucket;       /* NULL — default_bucket */
+    const char *chunk_prefix; /* NULL -> "chunks/"; ключ = prefix + sha256 */
+    size_t avg_chunk;         /* 0 -> 1 MiB, степень двойки от 64 KiB до
+                                 8 MiB; min = avg / 4, max = avg * 4 */
+    uint32_t concurrency;     /* 0 -> 8; запросов одновременно */
+} s3_chunk_opts_t;
+
+typedef struct s3_chunk_result {
+    size_t chunks;            /* кусков в файле */
+    size_t transferred;       /* загружено (put) или скачано (get) */
+    uint64_t bytes;           /* размер файла */
+    uint64_t bytes_transferred;
+    double elapsed;           /* секунд на весь вызов */
+} s3_chunk_result_t;
+
+/*
+ * Сохранить файл fd (с начала до конца) в chunk store с дедупликацией.
+ *
+ * Файл режется FastCDC (gear hash, границы зависят от содержимого,
+ * поэтому вставка в середину сдвигает только соседние куски). Каждый
+ * кусок — объект chunk_prefix + sha256 содержимого; куски, которые уже
+ * есть в bucket'е (HEAD пачками по concurrency, сверяются размер и
+ * x-amz-checksum-sha256) или повторяются в файле, не загружаются.
+ * Куски грузятся с x-amz-checksum-sha256: если файл поменялся после
+ * хеширования, S3 отвергнет PUT. В конце пишется manifest_key — список
+ * sha256 и размеров кусков по порядку.
+ *
+ * avg_chunk должен быть одинаковым у всех версий файла, иначе границы
+ * не совпадут и дедупликации не будет.
+ */
+s3_error_code_t
+s3_client_chunk_put(s3_client_t *client,
+                    const s3_chunk_opts_t *opts,
+                    const char *manifest_key,
+                    int fd,
+                    s3_chunk_result_t *result,
+                    s3_error_t *error);
+
+/*
+ * Собрать файл по manifest'у s3_client_chunk_put в fd: размер
+ * выставляется заранее, куски качаются по concurrency одновременно
+ * прямо на свои смещения, sha256 каждого сверяется с его именем.
+ */
+s3_error_code_t
+s3_client_chunk_get(s3_client_t *client,
+                    const s3_chunk_opts_t *opts,
+                    const char *manifest_key,
+                    int fd,
+                    s3_chunk_result_t *result,
+                    s3_error_t *error);
+
+/*
+ * Одно место назначения s3_client_put_fanout.
+ */
+typedef struct s3_fanout_dest {
+    /*
+     * Клиент, через который грузить (свой endpoint, креды, backend).
+     * NULL — клиент вызова.
+     */
+    s3_client_t *client;
+    const char *bucket;   /* если NULL — default_bucket клиента */
+    const char *key;      /* обязателен */
+
+    /* Результат загрузки в это место. */
+    s3_error_code_t code;
+    s3_error_t err;
+} s3_fanout_dest_t;
+
+typedef struct s3_put_fanout_opts {
+    const char *content_type;
+    size_t part_size;      /* 0 -> 8 MiB; не меньше 5 MiB */
+    uint32_t concurrency;  /* 0 -> 2; сколько частей источника в памяти */
+    /*
+     * Сколько мест назначения должны получить объект, чтобы вызов
+     * считался успешным. 0 — все.
+     */
+    uint32_t quorum;
+} s3_put_fanout_opts_t;
+
+/*
+ * PUT одного источника (fd, offset, size — как в s3_client_put_fd)
+ * в несколько мест сразу, например в бакеты разных регионов.
+ *
+ * Каждая часть источника читается один раз и отправляется во все места
+ * одновременно из одного буфера; в памяти — part_size * concurrency
+ * байт на весь вызов, а не на каждое место. Объекты больше part_size
+ * грузятся multipart upload'ом.
+ *
+ * Место, в которое не удалось загрузить часть (после повторов),
+ * выбывает: его загрузка отменяется, остальные продолжают. Вызов
+ * завершается ошибкой, как только живых мест меньше quorum.
+ *
+ * Результат каждого места — в dests[i].code/err. Возвращает S3_E_OK,
+ * если объект получили не меньше quorum мест, иначе ошибку первого
+ * выбывшего.
+ */
+s3_error_code_t
+s3_client_put_fanout(s3_client_t *client,
+                     const s3_put_fanout_opts_t *opts,
+                     int fd, off_t offset, size_t size,
+                     s3_fanout_dest_t *dests, size_t count,
+                     s3_error_t *error);
+
+/*
+ * Опции s3_client_transfer.
+ */
+typedef struct s3_transfer_opts {
+    const char *src_bucket;   /* если NULL — default_bucket источника */
+    const char *src_key;      /* обязателен */
+    const char *dst_bucket;   /* если NULL — default_bucket приёмника */
+    const char *dst_key;      /* если NULL — src_key */
+
+    const char *content_type; /* Content-Type нового объекта */
+    size_t part_size;         /* 0 -> 8 MiB; не меньше 5 MiB */
+    uint32_t concurrency;     /* 0 -> 4; частей в полёте в каждую сторону */
+} s3_transfer_opts_t;
+
+/*
+ * Скопировать объект из src в dst (другой endpoint, кластер, креды)
+ * без промежуточного файла: тело идёт через память.
+ *
+ * Объект до part_size — GET в память и PUT. Больше — Range GET'ы частей
+ * источника и multipart upload в приёмник; части следующей волны
+ * скачиваются одновременно с загрузкой предыдущей. Памяти —
+ * 2 * part_size * concurrency, сколько бы ни весил объект.
+ *
+ * Все GET идут с If-Match на ETag источника: если объект поменяли во
+ * время копирования, вызов завершится ошибкой (412), а загрузка в
+ * приёмник отменится. dst == NULL — копия внутри src.
+ *
+ * bytes (если не NULL) — сколько байт загружено в приёмник.
+ * Ошибка сохраняется как последняя ошибка src.
+ */
+s3_error_code_t
+s3_client_transfer(s3_client_t *src,
+                   s3_client_t *dst,
+                   const s3_transfer_opts_t *opts,
+                   uint64_t *bytes,
+                   s3_error_t *error);
+
 /*
  * Опции для GET.
  */
@@ -222,9 +634,26 @@ typedef struct s3_get_opts {
      */
     const char *range;
 
+    /*
+     * Опционально: ETag для заголовка If-Match (с кавычками или без).
+     * Если объект изменился — сервер вернёт 412.
+     */
+    const char *if_match;
+
     uint32_t flags;
 } s3_get_opts_t;
 
+/*
+ * Флаги GET (s3_get_opts_t.flags).
+ */
+enum {
+    /*
+     * Не склеивать этот GET с одновременными одинаковыми запросами,
+     * даже если у клиента включён S3_CLIENT_F_COALESCE_GETS.
+     */
+    S3_GET_F_NO_COALESCE = 1u << 0,
+};
+
 /*
  * GET: приём тела в fd.
  *
@@ -232,6 +661,13 @@ typedef struct s3_get_opts {
  * offset    — стартовая позиция (используется pwrite).
  * max_size  — максимум байт для записи. Если 0 — без ограничения, пока не конец ответа.
  *
+ * Если у клиента включён S3_CLIENT_F_COALESCE_GETS, одновременные GET
+ * с одинаковыми (bucket, key, range, if_match, max_size) выполняются одним
+ * запросом: остальные файберы ждут его и копируют результат в свой fd
+ * (copy_file_range, на reflink-ФС — без копирования данных). Копируют
+ * из fd первого вызова, поэтому GET в fd, открытый O_WRONLY, не
+ * склеивается и выполняется отдельным запросом.
+ *
  * При успехе:
  *   - code == S3_E_OK
  *   - если bytes_written != NULL, туда сохраняется количество записанных байт.
@@ -244,6 +680,229 @@ s3_client_get_fd(s3_client_t *client,
                  s3_error_t *error);
 
 
+/*
+ * PUT из памяти.
+ *
+ * data/size — тело объекта (size == 0 — пустой объект).
+ * Память должна жить до возврата из вызова.
+ */
+s3_error_code_t
+s3_client_put_buf(s3_client_t *client,
+                  const s3_put_opts_t *opts,
+                  const void *data, size_t size,
+                  s3_error_t *error);
+
+/*
+ * Один объект s3_client_put_many: тело — файл path либо data/size
+ * (path == NULL). bucket == NULL — default_bucket.
+ */
+typedef struct s3_put_item {
+    const char *bucket;
+    const char *key;
+    const char *path;
+    const void *data;
+    size_t size;
+    const char *content_type;
+
+    s3_error_code_t code;
+    s3_error_t err;
+} s3_put_item_t;
+
+/*
+ * PUT пачки независимых объектов: по concurrency (0 -> 8) запросов
+ * одновременно через perform_many, упавшие повторяются по одному.
+ * Файл открывается на время своего запроса и загружается одним PUT.
+ *
+ * Результат каждого объекта — в items[i].code/err. Возвращает S3_E_OK,
+ * если загружены все, иначе ошибку первого упавшего.
+ */
+s3_error_code_t
+s3_client_put_many(s3_client_t *client,
+                   s3_put_item_t *items, size_t count,
+                   uint32_t concurrency,
+                   s3_error_t *error);
+
+/*
+ * GET в память вызывающего.
+ *
+ * buf/cap — буфер и его ёмкость. Если тело ответа больше cap,
+ * вызов завершится ошибкой (S3_E_IO), поэтому для больших объектов
+ * используйте opts->range.
+ *
+ * При успехе, если bytes_read != NULL, туда сохраняется размер тела.
+ */
+s3_error_code_t
+s3_client_get_buf(s3_client_t *client,
+                  const s3_get_opts_t *opts,
+                  void *buf, size_t cap,
+                  size_t *bytes_read,
+                  s3_error_t *error);
+
+/* ETag S3 — md5 в hex с кавычками и суффиксом "-N" у multipart. */
+#define S3_ETAG_MAX 80
+
+/*
+ * Метаданные объекта (HEAD).
+ */
+typedef struct s3_head_info {
+    uint64_t size;
+    char etag[S3_ETAG_MAX]; /* с кавычками, как в ответе */
+} s3_head_info_t;
+
+/*
+ * HEAD объекта: размер и ETag без чтения тела.
+ * bucket == NULL — default_bucket. Нет объекта — S3_E_NOT_FOUND.
+ */
+s3_error_code_t
+s3_client_head(s3_client_t *client,
+               const char *bucket, const char *key,
+               s3_head_info_t *info,
+               s3_error_t *error);
+
+typedef struct s3_append_result {
+    uint64_t size;            /* размер объекта после вызова */
+    uint64_t uploaded;        /* байт реально отправлено */
+    bool copied;              /* старое тело взято UploadPartCopy */
+    char etag[S3_ETAG_MAX];   /* ETag объекта после вызова */
+} s3_append_result_t;
+
+/*
+ * Дописать в объект opts->key хвост растущего файла fd (xlog): объект
+ * должен совпадать с началом файла, это не проверяется.
+ *
+ * Новая версия собирается multipart upload'ом: первые части —
+ * UploadPartCopy старого объекта (с x-amz-copy-source-if-match его
+ * ETag'а, по 5 GiB на часть), дальше — байты файла после конца объекта
+ * частями по part_size (mp_opts как у put_stream, может быть NULL),
+ * concurrency одновременно. Трафик — только новый хвост.
+ *
+ * Объекта нет или он меньше 5 MiB (минимальная часть multipart'а) —
+ * файл загружается целиком. Файл не вырос — ничего не делается.
+ * Метаданные старого объекта не переносятся, нужные задаются в opts.
+ */
+s3_error_code_t
+s3_client_append(s3_client_t *client,
+                 const s3_put_opts_t *opts,
+                 const s3_put_stream_opts_t *mp_opts,
+                 int fd,
+                 s3_append_result_t *result,
+                 s3_error_t *error);
+
+/*
+ * GET с потоковой записью тела в сокет или pipe.
+ *
+ * В отличие от s3_client_get_fd пишет последовательно через write() с
+ * дозаписью, поэтому подходит для fd без позиции (pwrite на них
+ * даёт ESPIPE): можно отдать объект прямо в HTTP-соединение клиента без
+ * временного файла. Если fd неблокирующий и заполнен, чтение из S3
+ * приостанавливается до готовности fd — память постоянная.
+ *
+ * Таймаут — только на простой: request_timeout_ms без данных из S3 или
+ * без чтения получателем. Ответ с ошибкой в fd не пишется. После того
+ * как в fd ушёл хотя бы один байт, запрос не повторяется.
+ *
+ * bytes_written (если не NULL) — сколько байт записано в fd.
+ */
+s3_error_code_t
+s3_client_get_stream(s3_client_t *client,
+                     const s3_get_opts_t *opts,
+                     int fd,
+                     size_t *bytes_written,
+                     s3_error_t *error);
+
+/*
+ * Один диапазон для s3_client_get_ranges.
+ */
+typedef struct s3_range {
+    uint64_t offset;    /* смещение в объекте */
+    size_t   length;    /* сколько байт, > 0 */
+
+    /*
+     * Куда положить байты: buf != NULL — в память (ёмкость >= length),
+     * иначе pwrite в fd начиная с fd_offset.
+     */
+    void    *buf;
+    int      fd;
+    off_t    fd_offset;
+
+    /* Результат: сколько байт записано (меньше length — объект кончился). */
+    size_t   bytes;
+    s3_error_code_t code;
+} s3_range_t;
+
+/* Склеивать диапазоны с дыркой до 64 KiB: дешевле докачать, чем ещё один GET. */
+#define S3_GET_RANGES_DEFAULT_GAP (64 * 1024)
+
+typedef struct s3_get_ranges_opts {
+    const char *bucket;   /* если NULL — default_bucket */
+    const char *key;      /* обязателен */
+    const char *if_match; /* опционально, как в s3_get_opts_t */
+
+    /*
+     * Соседние диапазоны, между которыми не больше max_gap байт,
+     * читаются одним GET (0 — склеивать только смежные/перекрывающиеся).
+     */
+    uint64_t max_gap;
+    /* Максимальный размер одного склеенного GET, 0 — без ограничения. */
+    uint64_t max_span;
+    /* Сколько GET выполнять одновременно, 0 — 8, не больше 64. */
+    uint32_t concurrency;
+
+    uint32_t flags;
+} s3_get_ranges_opts_t;
+
+/*
+ * Прочитать набор диапазонов одного объекта.
+ *
+ * Диапазоны сортируются и склеиваются (max_gap/max_span) в меньшее число
+ * Range GET, которые выполняются параллельно (до concurrency штук,
+ * следующий начинается, как только закончился любой из идущих);
+ * байты раскладываются по buf/fd каждого диапазона, лишние байты
+ * в дырках отбрасываются. Диапазоны могут перекрываться.
+ *
+ * Результат каждого диапазона — в ranges[i].code/bytes. Возвращает
+ * S3_E_OK, если все прочитаны, иначе код (и error) первой ошибки.
+ */
+s3_error_code_t
+s3_client_get_ranges(s3_client_t *client,
+                     const s3_get_ranges_opts_t *opts,
+                     s3_range_t *ranges, size_t count,
+                     s3_error_t *error);
+
+
+/*
+ * Объект для s3_client_pread.
+ */
+typedef struct s3_pread_opts {
+    const char *bucket;   /* если NULL — default_bucket */
+    const char *key;      /* обязателен */
+    /*
+     * Опционально: ETag версии объекта. Входит в ключ кэша и уходит в
+     * If-Match, поэтому после перезаписи объекта старые блоки не читаются.
+     * NULL — версию не проверить, и кэш блоков не используется.
+     */
+    const char *etag;
+} s3_pread_opts_t;
+
+/*
+ * pread по объекту: len байт с offset в buf.
+ *
+ * С block_cache_bytes и opts->etag чтение идёт через общий кэш блоков
+ * клиента: недостающие блоки качаются одним s3_client_get_ranges
+ * (смежные — одним Range GET), блоки, которые уже качает другой файбер,
+ * не запрашиваются повторно. Без кэша или без etag — один Range GET.
+ *
+ * bytes_read — сколько прочитано; меньше len — объект кончился
+ * (offset за концом объекта — 0, не ошибка).
+ */
+s3_error_code_t
+s3_client_pread(s3_client_t *client,
+                const s3_pread_opts_t *opts,
+                void *buf, size_t len, uint64_t offset,
+                size_t *bytes_read,
+                s3_error_t *error);
+
+
 /*
  * Опции для CREATE bucket.
  */
@@ -337,6 +996,48 @@ s3_client_delete_objects(s3_client_t *client,
                          s3_error_t *error);
 
 
+/*
+ * Состояние endpoint'а (s3_client_opts_t.endpoints).
+ */
+typedef struct s3_endpoint_info {
+    const char *url;          /* живёт, пока жив клиент */
+    double ewma_latency_ms;   /* 0 — ещё не было успешных запросов */
+    uint32_t inflight;
+    uint64_t requests;
+    uint64_t errors;          /* сетевые ошибки, таймауты, 5xx */
+    bool ejected;
+} s3_endpoint_info_t;
+
+/*
+ * Снимок состояния endpoint'ов: заполняет до cap элементов out,
+ * возвращает их общее число. Для клиента с одним endpoint — 0.
+ */
+size_t
+s3_client_endpoints(const s3_client_t *client,
+                    s3_endpoint_info_t *out, size_t cap);
+
+
+/*
+ * Счётчики HTTP-уровня клиента с момента создания.
+ */
+typedef struct s3_client_stats {
+    uint64_t requests;        /* завершённых HTTP запросов */
+    uint64_t connections;     /* открытых для них новых соединений */
+    uint64_t http2_requests;  /* запросов, ушедших по HTTP/2 */
+    /*
+     * requests / connections: сколько запросов в среднем прошло по одному
+     * соединению (keep-alive + h2 потоки).
+     */
+    double requests_per_connection;
+
+    /* Кэш блоков s3_client_pread, в блоках. */
+    uint64_t block_cache_hits;
+    uint64_t block_cache_misses;
+} s3_client_stats_t;
+
+void
+s3_client_stats(const s3_client_t *client, s3_client_stats_t *out);
+
 /*
  * Возвращает последний error клиента (thread/fiber-local внутри клиента).
  *
@@ -6,6 +6,7 @@ extern "C" {
 #endif
 
 #include <stddef.h>
+#include <stdint.h>
 #include <sys/types.h>
 #include <s3/curl_compat.h>
 
@@ -15,6 +16,11 @@ typedef enum {
     S3_IO_NONE = 0,
     S3_IO_FD,
     S3_IO_MEM,
+    S3_IO_BUF,
+    S3_IO_SCATTER,
+    S3_IO_STREAM,
+    S3_IO_CHAIN,
+    S3_IO_IOV,
 } s3_easy_io_kind_t;
 
 typedef struct s3_mem_buf {
@@ -23,6 +29,44 @@ typedef struct s3_mem_buf {
     size_t  capacity;
 } s3_mem_buf_t;
 
+/*
+ * Цепочка сегментов фиксированного размера (S3_IO_CHAIN).
+ *
+ * Тело ответа дописывается в хвостовой сегмент; когда он заполнен,
+ * добавляется новый, уже принятые байты при росте не копируются.
+ * Непрерывная копия строится только если она нужна потребителю
+ * (s3_buf_chain_flatten), для scatter/gather — s3_buf_chain_iov.
+ */
+typedef struct s3_buf_seg {
+    struct s3_buf_seg *next;
+    size_t size;
+    size_t cap;
+    char   data[];
+} s3_buf_seg_t;
+
+typedef struct s3_buf_chain {
+    s3_buf_seg_t *head;
+    s3_buf_seg_t *tail;
+    size_t size;   /* байт во всех сегментах */
+    size_t nsegs;
+} s3_buf_chain_t;
+
+/*
+ * Кусок тела ответа, который нужно положить в отдельное место
+ * (S3_IO_SCATTER, s3_client_get_ranges).
+ */
+typedef struct s3_easy_scatter_seg {
+    uint64_t offset;  /* абсолютное смещение в объекте */
+    size_t   len;
+
+    /* Куда писать: ptr != NULL — в память, иначе pwrite в fd. */
+    char    *ptr;
+    int      fd;
+    off_t    fd_offset;
+
+    size_t   written; /* сколько байт уже положили */
+} s3_easy_scatter_seg_t;
+
 /*
  * Описание I/O для easy-хендла.
  *
@@ -35,6 +79,11 @@ typedef struct s3_easy_io {
      * kind:
      *   - S3_IO_FD  — работа с файловым дескриптором (pread/pwrite)
      *   - S3_IO_MEM — запись/чтение в память (s3_mem_buf_t)
+     *   - S3_IO_BUF — запись в буфер вызывающего фиксированного размера
+     *   - S3_IO_SCATTER — раскладка ответа на Range GET по сегментам
+     *   - S3_IO_STREAM — последовательная запись в сокет/pipe (write)
+     *   - S3_IO_CHAIN — запись в цепочку сегментов (s3_buf_chain_t)
+     *   - S3_IO_IOV — чтение тела PUT из кусков файлов (s3_put_seg_t) подряд
      *   - S3_IO_NONE — не использовать
     */
     s3_easy_io_kind_t kind;
@@ -56,6 +105,45 @@ typedef struct s3_easy_io {
         struct {
             s3_mem_buf_t *buf; /* не владеем, буфер живёт снаружи */
         } mem;
+
+        struct {
+            char *ptr; /* не владеем, ёмкость — size_limit */
+        } buf;
+
+        struct {
+            /* Отсортированы по offset, не владеем. */
+            s3_easy_scatter_seg_t *segs;
+            size_t count;
+            size_t cursor; /* первый сегмент, который ещё может получить байты */
+            uint64_t start; /* начало Range, для перемотки */
+            /*
+             * Смещение первого байта тела в объекте. Если сервер
+             * проигнорировал Range и ответил 200, сбрасывается в 0.
+             */
+            uint64_t base;
+        } scatter;
+
+        struct {
+            int fd;
+            /*
+             * Сколько байт текущего куска уже записано, когда fd
+             * заполнился и мы вернули CURL_WRITEFUNC_PAUSE: curl отдаст
+             * этот кусок ещё раз с начала.
+             */
+            size_t skip;
+            bool paused;
+        } stream;
+
+        struct {
+            s3_buf_chain_t *chain; /* не владеем */
+        } chain;
+
+        struct {
+            const s3_put_seg_t *segs; /* не владеем */
+            size_t count;
+            size_t cursor;       /* сегмент, из которого читаем */
+            size_t cursor_start; /* смещение его начала в теле */
+        } iov;
     } u;
 } s3_easy_io_t;
 
@@ -85,18 +173,72 @@ s3_easy_io_init_mem(s3_easy_io_t *io, s3_mem_buf_t *buf, size_t size_limit)
     io->size_limit = size_limit;
 }
 
+static inline void
+s3_easy_io_init_buf(s3_easy_io_t *io, void *ptr, size_t cap)
+{
+    io->kind = S3_IO_BUF;
+    io->u.buf.ptr = (char *)ptr;
+    io->size_limit = cap;
+}
+
+static inline void
+s3_easy_io_init_scatter(s3_easy_io_t *io, s3_easy_scatter_seg_t *segs,
+                        size_t count, uint64_t base)
+{
+    io->kind = S3_IO_SCATTER;
+    io->u.scatter.segs = segs;
+    io->u.scatter.count = count;
+    io->u.scatter.cursor = 0;
+    io->u.scatter.base = base;
+    io->u.scatter.start = base;
+    io->size_limit = 0;
+}
+
+static inline void
+s3_easy_io_init_stream(s3_easy_io_t *io, int fd)
+{
+    io->kind = S3_IO_STREAM;
+    io->u.stream.fd = fd;
+    io->u.stream.skip = 0;
+    io->u.stream.paused = false;
+    io->size_limit = 0;
+}
+
+static inline void
+s3_easy_io_init_chain(s3_easy_io_t *io, s3_buf_chain_t *chain)
+{
+    io->kind = S3_IO_CHAIN;
+    io->u.chain.chain = chain;
+    io->size_limit = 0;
+}
+
+static inline void
+s3_easy_io_init_iov(s3_easy_io_t *io, const s3_put_seg_t *segs,
+                    size_t count, size_t size)
+{
+    io->kind = S3_IO_IOV;
+    io->u.iov.segs = segs;
+    io->u.iov.count = count;
+    io->u.iov.cursor = 0;
+    io->u.iov.cursor_start = 0;
+    io->size_limit = size;
+}
+
 /*
  * Внутренняя обёртка над CURL *easy.
  * Пользователь её не видит, с ней работают только backend’ы.
  */
 typedef struct s3_easy_handle s3_easy_handle_t;
 
+struct s3_endpoint;
+
 struct s3_easy_handle {
     CURL *easy;
     struct curl_slist *headers;
 
     s3_client_t *client;
 	char *url;
+    size_t url_cap;  /* ёмкость url, буфер переживает возврат в пул */
 
     /* Контекст для read/write callbacks. */
     s3_easy_io_t read_io;   /* для PUT/POST (исходящее тело), может быть "пустым" */
@@ -108,8 +250,31 @@ struct s3_easy_handle {
 
     /* Тело запроса, если мы его сами строим (DELETE, POST, и т.п.) */
     s3_mem_buf_t owned_body;
+    /* Обёртка над чужой памятью для PUT из буфера (data не владеем). */
+    s3_mem_buf_t borrowed_body;
     /* Тело ответа, если хотим его собрать целиком (LIST, DELETE, и т.п.) */
+    s3_buf_chain_t resp_chain;
+    /* Непрерывная копия resp_chain, если сегментов больше одного. */
     s3_mem_buf_t owned_resp;
+
+    /* Запрос можно безопасно повторить (в т.ч. на другом endpoint'е). */
+    bool idempotent;
+    /* Endpoint текущей попытки (s3_endpoint_begin/end). */
+    struct s3_endpoint *ep;
+    uint64_t ep_start_us;
+
+    /* CURLOPT_CONNECT_TO с закреплённым адресом (resolve.c). */
+    struct curl_slist *connect_to;
+
+    /* ETag из заголовков ответа (с кавычками), если хендл его ловит. */
+    char etag[S3_ETAG_MAX];
+    /* x-amz-checksum-sha256 из ответа (base64), если объект его хранит. */
+    char checksum_sha256[48];
+    /* Полный размер объекта из Content-Range ответа на Range GET, 0 — нет. */
+    uint64_t object_size;
+
+    /* Следующий свободный хендл в пуле клиента. */
+    struct s3_easy_handle *pool_next;
 };
 
 /*
@@ -149,6 +314,54 @@ s3_easy_factory_new_get_fd(s3_client_t *client,
                         s3_easy_handle_t **out_handle,
                         s3_error_t *error);
 
+/*
+ * PUT из памяти: data/size должны жить до уничтожения хендла.
+ * size == 0 — пустой объект. ETag нового объекта (у всех PUT) — в h->etag.
+ */
+s3_error_code_t
+s3_easy_factory_new_put_buf(s3_client_t *client,
+                            const s3_put_opts_t *opts,
+                            const void *data, size_t size,
+                            s3_easy_handle_t **out_handle,
+                            s3_error_t *error);
+
+/*
+ * PUT из кусков файлов (S3_IO_IOV): тело — segs[0..count) подряд.
+ * segs должны жить до уничтожения хендла.
+ */
+s3_error_code_t
+s3_easy_factory_new_put_iov(s3_client_t *client,
+                            const s3_put_opts_t *opts,
+                            const s3_put_seg_t *segs, size_t count,
+                            s3_easy_handle_t **out_handle,
+                            s3_error_t *error);
+
+/*
+ * GET в буфер вызывающего ёмкостью cap байт.
+ * Если тело ответа больше cap — запрос завершится ошибкой записи.
+ */
+s3_error_code_t
+s3_easy_factory_new_get_buf(s3_client_t *client,
+                            const s3_get_opts_t *opts,
+                            void *buf, size_t cap,
+                            s3_easy_handle_t **out_handle,
+                            s3_error_t *error);
+
+/*
+ * Range GET, тело которого раскладывается по segs (S3_IO_SCATTER).
+ *
+ * segs отсортированы по offset и лежат внутри [start, end) — этот
+ * диапазон уходит в заголовок Range. Сегменты могут перекрываться,
+ * байты между ними отбрасываются. segs должны жить до уничтожения хендла.
+ */
+s3_error_code_t
+s3_easy_factory_new_get_scatter(s3_client_t *client,
+                                const s3_get_opts_t *opts,
+                                uint64_t start, uint64_t end,
+                                s3_easy_scatter_seg_t *segs, size_t count,
+                                s3_easy_handle_t **out_handle,
+                                s3_error_t *error);
+
 s3_error_code_t
 s3_easy_factory_new_create_bucket(s3_client_t *client,
                                   const s3_create_bucket_opts_t *opts,
@@ -167,17 +380,162 @@ s3_easy_factory_new_delete_objects(s3_client_t *client,
                                    s3_easy_handle_t **out_handle,
                                    s3_error_t *error);
 
+/*
+ * GET с последовательной записью тела в fd (S3_IO_STREAM): сокет, pipe.
+ * Если fd неблокирующий и заполнен, передача ставится на паузу
+ * (CURL_WRITEFUNC_PAUSE) — выполнять такой хендл нужно через
+ * s3_http_stream_perform. Общего таймаута на запрос нет, только
+ * на простой (request_timeout_ms).
+ */
+s3_error_code_t
+s3_easy_factory_new_get_stream(s3_client_t *client,
+                               const s3_get_opts_t *opts,
+                               int fd,
+                               s3_easy_handle_t **out_handle,
+                               s3_error_t *error);
+
+/*
+ * Multipart upload.
+ *
+ * mpu_create    — POST ?uploads; ответ (XML с UploadId) — в resp_chain,
+ *                 читать через s3_easy_handle_resp.
+ * mpu_part      — PUT ?partNumber=N&uploadId=...; тело из памяти
+ *                 (data/size живут до уничтожения хендла), ETag части
+ *                 после выполнения — в h->etag.
+ * mpu_complete  — POST ?uploadId=...; body — готовый XML
+ *                 CompleteMultipartUpload, хендл забирает его себе.
+ *                 Ответ — в resp_chain (s3_easy_handle_resp): S3
+ *                 может вернуть 200 с <Error>.
+ * mpu_abort     — DELETE ?uploadId=...
+ *
+ * upload_id передаётся как есть, кодируется внутри.
+ */
+s3_error_code_t
+s3_easy_factory_new_mpu_create(s3_client_t *client,
+                               const s3_put_opts_t *opts,
+                               s3_easy_handle_t **out_handle,
+                               s3_error_t *error);
+
+s3_error_code_t
+s3_easy_factory_new_mpu_part(s3_client_t *client,
+                             const s3_put_opts_t *opts,
+                             const char *upload_id,
+                             uint32_t part_number,
+                             const void *data, size_t size,
+                             s3_easy_handle_t **out_handle,
+                             s3_error_t *error);
+
+/* UploadPart из size байт файла fd с offset (S3_IO_FD, pread). */
+s3_error_code_t
+s3_easy_factory_new_mpu_part_fd(s3_client_t *client,
+                                const s3_put_opts_t *opts,
+                                const char *upload_id,
+                                uint32_t part_number,
+                                int fd, off_t offset, size_t size,
+                                s3_easy_handle_t **out_handle,
+                                s3_error_t *error);
+
+/* UploadPart из кусков файлов (S3_IO_IOV), segs живут до уничтожения хендла. */
+s3_error_code_t
+s3_easy_factory_new_mpu_part_iov(s3_client_t *client,
+                                 const s3_put_opts_t *opts,
+                                 const char *upload_id,
+                                 uint32_t part_number,
+                                 const s3_put_seg_t *segs, size_t count,
+                                 s3_easy_handle_t **out_handle,
+                                 s3_error_t *error);
+
+/*
+ * UploadPartCopy: часть — диапазон range ("bytes=a-b", NULL — весь объект)
+ * объекта src_bucket/src_key (src_bucket NULL — bucket из opts). Если
+ * if_match не NULL, источник должен иметь этот ETag. Тела запроса нет;
+ * ETag части — в XML ответа (CopyPartResult), а не в заголовке.
+ */
+s3_error_code_t
+s3_easy_factory_new_mpu_part_copy(s3_client_t *client,
+                                  const s3_put_opts_t *opts,
+                                  const char *upload_id,
+                                  uint32_t part_number,
+                                  const char *src_bucket,
+                                  const char *src_key,
+                                  const char *range,
+                                  const char *if_match,
+                                  s3_easy_handle_t **out_handle,
+                                  s3_error_t *error);
+
+s3_error_code_t
+s3_easy_factory_new_mpu_complete(s3_client_t *client,
+                                 const s3_put_opts_t *opts,
+                                 const char *upload_id,
+                                 s3_mem_buf_t *body,
+                                 s3_easy_handle_t **out_handle,
+                                 s3_error_t *error);
+
+s3_error_code_t
+s3_easy_factory_new_mpu_abort(s3_client_t *client,
+                              const s3_put_opts_t *opts,
+                              const char *upload_id,
+                              s3_easy_handle_t **out_handle,
+                              s3_error_t *error);
+
+/*
+ * HEAD bucket (bucket == NULL — default_bucket). Тело ответа не читается;
+ * используется для прогрева соединений (prewarm.c).
+ */
+s3_error_code_t
+s3_easy_factory_new_head_bucket(s3_client_t *client,
+                                const char *bucket,
+                                s3_easy_handle_t **out_handle,
+                                s3_error_t *error);
+
+/*
+ * HEAD объекта: после выполнения ETag — в h->etag, размер —
+ * CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, SHA-256, переданный при загрузке
+ * (x-amz-checksum-sha256), — в h->checksum_sha256.
+ */
+s3_error_code_t
+s3_easy_factory_new_head_object(s3_client_t *client,
+                                const char *bucket,
+                                const char *key,
+                                s3_easy_handle_t **out_handle,
+                                s3_error_t *error);
+
+/*
+ * Подготовить хендл к повторному выполнению: сбросить счётчики
+ * и принятое тело ответа. Возвращает -1, если источник/приёмник
+ * нельзя перемотать.
+ */
+int
+s3_easy_handle_rewind(s3_easy_handle_t *h);
+
+/*
+ * Тело ответа (resp_chain) одной строкой с '\0' в *out.
+ * Из одного сегмента — без копирования, иначе собирается один раз
+ * в owned_resp. Пустой ответ — "". Указатель живёт до destroy/rewind.
+ */
+s3_error_code_t
+s3_easy_handle_resp(s3_easy_handle_t *h, const char **out, s3_error_t *err);
+
 /*
  * Освобождает s3_easy_handle:
  *   - curl_slist_free_all(headers);
- *   - curl_easy_cleanup(easy);
- *   - освобождает саму структуру через аллокатор клиента.
+ *   - пока пул клиента не полон, кладёт хендл туда вместе с CURL
+ *     (curl_easy_reset сохраняет его соединения, DNS и TLS-сессии)
+ *     и буфером URL; иначе curl_easy_cleanup(easy) и освобождает
+ *     структуру через аллокатор клиента.
  *
  * Безопасно звать с NULL.
  */
 void
 s3_easy_handle_destroy(s3_easy_handle_t *h);
 
+/*
+ * Освободить хендлы из пула клиента. Зовётся при удалении клиента,
+ * когда запросов в полёте уже нет.
+ */
+void
+s3_easy_handle_pool_drain(s3_client_t *client);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -0,0 +1,162 @@
+#ifndef TARANTOOL_S3_PACK_H_INCLUDED
+#define TARANTOOL_S3_PACK_H_INCLUDED 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "s3/client.h"
+
+/*
+ * Pack — контейнер для множества маленьких объектов в одном S3-объекте.
+ *
+ * Формат (все числа little-endian):
+ *
+ *   [ данные member 0 ][ данные member 1 ] ... [ index ][ footer ]
+ *
+ *   index  — записи, отсортированные по имени (memcmp, затем длина):
+ *              u64 offset, u64 size, u16 name_len, name bytes
+ *   footer — 32 байта:
+ *              "S3PACK01", u64 index_offset, u64 index_size,
+ *              u32 count, u32 reserved (0)
+ *
+ * Запись: один PUT на весь pack.
+ * Чтение: reader при открытии забирает хвост объекта (index + footer)
+ * одним-двумя Range GET, дальше каждый member читается одним Range GET.
+ * Хвост можно сохранить (s3_pack_reader_index) и открыть reader без
+ * обращения к S3 (s3_pack_reader_open_index).
+ *
+ * Все функции вызываются из файбера на tx-треде.
+ */
+
+#define S3_PACK_MAGIC        "S3PACK01"
+#define S3_PACK_FOOTER_SIZE  32
+#define S3_PACK_NAME_MAX     65535
+
+typedef struct s3_pack_writer s3_pack_writer_t;
+typedef struct s3_pack_reader s3_pack_reader_t;
+
+/* ----------------- writer ----------------- */
+
+/*
+ * Создать writer. Данные копятся в памяти (через allocator клиента)
+ * до s3_pack_writer_finish.
+ */
+s3_error_code_t
+s3_pack_writer_new(s3_client_t *client,
+                   s3_pack_writer_t **out_writer,
+                   s3_error_t *error);
+
+/*
+ * Добавить member. name — непустая строка до S3_PACK_NAME_MAX байт,
+ * данные копируются. Дубликаты имён обнаруживаются в finish.
+ */
+s3_error_code_t
+s3_pack_writer_add(s3_pack_writer_t *w,
+                   const char *name,
+                   const void *data, size_t size,
+                   s3_error_t *error);
+
+/* Сколько member'ов уже добавлено. */
+size_t
+s3_pack_writer_count(const s3_pack_writer_t *w);
+
+/*
+ * Дописать index + footer и загрузить pack одним PUT.
+ * opts->bucket/key/content_type — как у s3_client_put_buf.
+ * После успешного вызова writer можно только удалить; после ошибки
+ * (в том числе PUT'а) finish можно повторить.
+ */
+s3_error_code_t
+s3_pack_writer_finish(s3_pack_writer_t *w,
+                      const s3_put_opts_t *opts,
+                      s3_error_t *error);
+
+/* Безопасно вызывать с NULL. */
+void
+s3_pack_writer_delete(s3_pack_writer_t *w);
+
+/* ----------------- reader ----------------- */
+
+/*
+ * Открыть pack: прочитать index из хвоста объекта.
+ * bucket == NULL — default_bucket клиента.
+ */
+s3_error_code_t
+s3_pack_reader_open(s3_client_t *client,
+                    const char *bucket, const char *key,
+                    s3_pack_reader_t **out_reader,
+                    s3_error_t *error);
+
+/*
+ * Открыть pack по ранее сохранённому хвосту (index + footer),
+ * без запросов в S3. Данные копируются.
+ */
+s3_error_code_t
+s3_pack_reader_open_index(s3_client_t *client,
+                          const char *bucket, const char *key,
+                          const void *tail, size_t tail_size,
+                          s3_pack_reader_t **out_reader,
+                          s3_error_t *error);
+
+/*
+ * Хвост (index + footer) для кэширования. Указатель живёт,
+ * пока жив reader.
+ */
+void
+s3_pack_reader_index(const s3_pack_reader_t *r,
+                     const void **tail, size_t *tail_size);
+
+/* Количество member'ов. */
+size_t
+s3_pack_reader_count(const s3_pack_reader_t *r);
+
+/*
+ * i-й member в порядке index (по имени). name не 0-терминирован.
+ * Возвращает S3_E_INVALID_ARG, если i >= count.
+ */
+s3_error_code_t
+s3_pack_reader_member(const s3_pack_reader_t *r, size_t i,
+                      const char **name, size_t *name_len,
+                      uint64_t *size);
+
+/*
+ * Размер member'а по имени (бинарный поиск по index).
+ * S3_E_NOT_FOUND, если такого нет.
+ */
+s3_error_code_t
+s3_pack_reader_stat(const s3_pack_reader_t *r, const char *name,
+                    uint64_t *size);
+
+/*
+ * Прочитать member в буфер (один Range GET).
+ * cap должен быть не меньше размера member'а.
+ */
+s3_error_code_t
+s3_pack_reader_get_buf(s3_pack_reader_t *r, const char *name,
+                       void *buf, size_t cap,
+                       size_t *bytes_read,
+                       s3_error_t *error);
+
+/*
+ * Прочитать member в fd с позиции offset (один Range GET).
+ */
+s3_error_code_t
+s3_pack_reader_get_fd(s3_pack_reader_t *r, const char *name,
+                      int fd, off_t offset,
+                      size_t *bytes_written,
+                      s3_error_t *error);
+
+/* Безопасно вызывать с NULL. */
+void
+s3_pack_reader_delete(s3_pack_reader_t *r);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* TARANTOOL_S3_PACK_H_INCLUDED */
@@ -19,6 +19,17 @@ s3_parse_list_response(s3_client_t *client,
                        s3_list_objects_result_t *result,
                        s3_error_t *error);
 
+/*
+ * Текст первого элемента <tag>...</tag> в xml (UploadId, ETag и т.п.).
+ * Возвращает строку из client->alloc или NULL, если элемента нет
+ * (err тогда не трогается) либо не хватило памяти (err заполнен).
+ */
+char *
+s3_parse_xml_value(s3_client_t *client,
+                   const char *xml,
+                   const char *tag,
+                   s3_error_t *error);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,101 @@
+#ifndef TARANTOOL_S3_READER_H_INCLUDED
+#define TARANTOOL_S3_READER_H_INCLUDED 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "s3/client.h"
+
+/*
+ * Последовательное чтение большого объекта кусками, без скачивания
+ * целиком.
+ *
+ * Reader держит окно — несколько соседних блоков объекта в памяти.
+ * Когда позиция выходит за окно, запрашиваются следующие 1 + prefetch
+ * блоков: первый — в вызывающем файбере, остальные — фоновыми файберами.
+ * Чтение возвращается, как только пришёл первый блок; следующие
+ * догружаются, пока он разбирается, и ждать приходится только тот, до
+ * которого дошла позиция, а он ещё не пришёл.
+ * Пока чтение последовательное, размер блока удваивается от min_window
+ * до max_window; после seek в сторону — снова min_window.
+ *
+ * Памяти — не больше (1 + prefetch) * max_window. Все Range GET идут с
+ * If-Match на ETag, полученный при открытии: если объект перезаписали,
+ * чтение завершится ошибкой, а не смешает две версии.
+ *
+ * Все функции вызываются из файбера на tx-треде. Клиент должен жить,
+ * пока reader не освобождён окончательно (см. on_free).
+ */
+
+typedef struct s3_reader s3_reader_t;
+
+typedef struct s3_reader_opts {
+    const char *bucket;   /* если NULL — default_bucket */
+    const char *key;      /* обязателен */
+
+    size_t min_window;    /* 0 -> 256 KiB */
+    size_t max_window;    /* 0 -> 8 MiB */
+    uint32_t prefetch;    /* 0 -> 2; сколько блоков читать наперёд */
+
+    /*
+     * Если не NULL — вызывается, когда память reader'а освобождена:
+     * в s3_reader_delete или позже, когда закончится последняя фоновая
+     * загрузка. После этого клиент можно удалять.
+     */
+    void (*on_free)(void *arg);
+    void *on_free_arg;
+} s3_reader_opts_t;
+
+/* Открыть объект (HEAD: размер и ETag). */
+s3_error_code_t
+s3_reader_open(s3_client_t *client,
+               const s3_reader_opts_t *opts,
+               s3_reader_t **out_reader,
+               s3_error_t *error);
+
+uint64_t
+s3_reader_size(const s3_reader_t *r);
+
+uint64_t
+s3_reader_tell(const s3_reader_t *r);
+
+/* Перейти на позицию pos (не дальше размера объекта). */
+s3_error_code_t
+s3_reader_seek(s3_reader_t *r, uint64_t pos, s3_error_t *error);
+
+/*
+ * Непрерывный кусок данных с текущей позиции, без копирования и без
+ * сдвига позиции. *len == 0 — конец объекта. Указатель живёт до
+ * следующего вызова reader'а.
+ */
+s3_error_code_t
+s3_reader_peek(s3_reader_t *r, const void **data, size_t *len,
+               s3_error_t *error);
+
+/* Сдвинуть позицию на n байт, полученных через s3_reader_peek. */
+void
+s3_reader_consume(s3_reader_t *r, size_t n);
+
+/*
+ * Прочитать до n байт в buf. *got < n — только в конце объекта.
+ */
+s3_error_code_t
+s3_reader_read(s3_reader_t *r, void *buf, size_t n, size_t *got,
+               s3_error_t *error);
+
+/*
+ * Не уступает (можно звать из __gc). Если блоки ещё грузятся в фоне,
+ * память освободит последний фоновый файбер. Безопасно вызывать с NULL.
+ */
+void
+s3_reader_delete(s3_reader_t *r);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* TARANTOOL_S3_READER_H_INCLUDED */
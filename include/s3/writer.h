@@ -0,0 +1,83 @@
+#ifndef TARANTOOL_S3_WRITER_H_INCLUDED
+#define TARANTOOL_S3_WRITER_H_INCLUDED 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "s3/client.h"
+
+/*
+ * Запись большого объекта кусками, без временного файла.
+ *
+ * Данные копятся в буферах по part_size. Заполненный буфер уходит
+ * фоновому потоку writer'а, который грузит части multipart upload'ом
+ * пачками до concurrency штук, пока вызывающий пишет дальше. Если все
+ * буферы в полёте, s3_writer_write ждёт (coio_call) — памяти не больше
+ * (concurrency + 1) * part_size.
+ *
+ * Объект меньше part_size загружается при close одним PUT.
+ *
+ * Функции, кроме s3_writer_delete, вызываются из файбера на tx-треде
+ * и блокируют только текущий файбер.
+ */
+
+typedef struct s3_writer s3_writer_t;
+
+typedef struct s3_writer_opts {
+    const char *bucket;       /* если NULL — default_bucket */
+    const char *key;          /* обязателен */
+    const char *content_type;
+
+    size_t part_size;         /* 0 -> 8 MiB; не меньше 5 MiB */
+    uint32_t concurrency;     /* 0 -> 4; частей в полёте */
+} s3_writer_opts_t;
+
+/* Создать writer; запросов в S3 пока нет, строки opts копируются. */
+s3_error_code_t
+s3_writer_open(s3_client_t *client,
+               const s3_writer_opts_t *opts,
+               s3_writer_t **out_writer,
+               s3_error_t *error);
+
+/*
+ * Дописать данные. Ошибка фоновой загрузки всплывает в следующем
+ * write/close; после неё writer можно только отменить или удалить.
+ */
+s3_error_code_t
+s3_writer_write(s3_writer_t *w, const void *data, size_t size,
+                s3_error_t *error);
+
+/* Сколько байт записано. */
+uint64_t
+s3_writer_bytes(const s3_writer_t *w);
+
+/*
+ * Дождаться всех частей и завершить загрузку. etag (если не NULL,
+ * S3_ETAG_MAX байт) — ETag нового объекта с кавычками. При ошибке
+ * multipart upload отменяется.
+ */
+s3_error_code_t
+s3_writer_close(s3_writer_t *w, char *etag, s3_error_t *error);
+
+/* Отменить загрузку: части в полёте дожидаются, upload удаляется. */
+void
+s3_writer_abort(s3_writer_t *w);
+
+/*
+ * Освободить writer. Не блокирует: если writer не закрыт и не отменён,
+ * фоновый поток сам дождётся частей в полёте, отменит upload и
+ * освободит память — клиент должен жить до этого, поэтому закрывайте
+ * (или отменяйте) writer явно. Безопасно вызывать с NULL.
+ */
+void
+s3_writer_delete(s3_writer_t *w);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* TARANTOOL_S3_WRITER_H_INCLUDED */
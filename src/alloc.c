@@ -1,8 +1,13 @@
 #include "s3/alloc.h"
 
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <small/slab_arena.h>
+#include <small/slab_cache.h>
 #include <small/small.h>
 
 /* ----------------- default allocator (malloc/free/realloc) ----------------- */
@@ -120,6 +125,10 @@ s3_small_realloc(void *ctx, void *ptr, size_t size)
     else
         old_user_size = 0;
 
+    /* Уменьшение — оставляем блок как есть, без копии. */
+    if (size <= old_user_size)
+        return ptr;
+
     /* Новый блок. */
     void *new_ptr = s3_small_malloc(ctx, size);
     if (new_ptr == NULL)
@@ -147,3 +156,234 @@ s3_allocator_init_small(s3_allocator_t *a, void *small_ctx)
     a->realloc = s3_small_realloc;
     a->free    = s3_small_free;
 }
+
+/* ----------------- thread-safe small allocator ----------------- */
+
+/*
+ * Каждому потоку — свой small_alloc (struct s3_mt_cache), найденный
+ * через pthread_getspecific. Заголовок блока помнит кэш-владелец:
+ *
+ *   [ s3_mt_hdr ][ user bytes ... ]
+ *
+ * Освобождение в своём потоке — smfree. В чужом — блок уходит в стек
+ * remote владельца (Трайбер: push — CAS, владелец забирает весь стек
+ * одним exchange, поэтому ABA не возникает), а владелец делает smfree
+ * при следующем вызове.
+ */
+
+struct s3_mt_cache;
+
+struct s3_mt_hdr {
+    union {
+        struct s3_mt_cache *cache; /* пока блок выдан */
+        struct s3_mt_hdr *next;    /* пока блок в стеке remote */
+    };
+    size_t size;                   /* вместе с заголовком, для smfree */
+};
+
+struct s3_mt_cache {
+    struct s3_mt_allocator *mt;
+    struct slab_cache slabs;
+    struct small_alloc small;
+
+    /* Блоки, освобождённые чужими потоками. */
+    struct s3_mt_hdr *remote;
+
+    /* Под mt->mutex. */
+    struct s3_mt_cache *next;
+    bool orphan;                   /* поток завершился */
+};
+
+struct s3_mt_allocator {
+    struct slab_arena *arena;
+    pthread_key_t key;
+
+    pthread_mutex_t mutex;
+    struct s3_mt_cache *caches;
+};
+
+static void
+s3_mt_cache_drain(struct s3_mt_cache *c)
+{
+    if (__atomic_load_n(&c->remote, __ATOMIC_RELAXED) == NULL)
+        return;
+
+    struct s3_mt_hdr *hdr =
+        __atomic_exchange_n(&c->remote, NULL, __ATOMIC_ACQUIRE);
+    while (hdr != NULL) {
+        struct s3_mt_hdr *next = hdr->next;
+        smfree(&c->small, hdr, hdr->size);
+        hdr = next;
+    }
+}
+
+/* Деструктор pthread key: поток завершился, кэш ждёт нового хозяина. */
+static void
+s3_mt_cache_orphan(void *arg)
+{
+    struct s3_mt_cache *c = (struct s3_mt_cache *)arg;
+    struct s3_mt_allocator *mt = c->mt;
+
+    pthread_mutex_lock(&mt->mutex);
+    c->orphan = true;
+    pthread_mutex_unlock(&mt->mutex);
+}
+
+static struct s3_mt_cache *
+s3_mt_cache_get(struct s3_mt_allocator *mt)
+{
+    struct s3_mt_cache *c =
+        (struct s3_mt_cache *)pthread_getspecific(mt->key);
+    if (c != NULL)
+        return c;
+
+    pthread_mutex_lock(&mt->mutex);
+    for (c = mt->caches; c != NULL; c = c->next) {
+        if (c->orphan)
+            break;
+    }
+    if (c != NULL) {
+        c->orphan = false;
+        slab_cache_set_thread(&c->slabs);
+    } else {
+        c = (struct s3_mt_cache *)malloc(sizeof(*c));
+        if (c == NULL) {
+            pthread_mutex_unlock(&mt->mutex);
+            return NULL;
+        }
+        memset(c, 0, sizeof(*c));
+        c->mt = mt;
+
+        float actual_factor;
+        slab_cache_create(&c->slabs, mt->arena);
+        small_alloc_create(&c->small, &c->slabs,
+                           sizeof(struct s3_mt_hdr), sizeof(intptr_t),
+                           1.05f, &actual_factor);
+
+        c->next = mt->caches;
+        mt->caches = c;
+    }
+    pthread_mutex_unlock(&mt->mutex);
+
+    pthread_setspecific(mt->key, c);
+    return c;
+}
+
+static void *
+s3_mt_malloc(void *ctx, size_t size)
+{
+    struct s3_mt_allocator *mt = (struct s3_mt_allocator *)ctx;
+    struct s3_mt_cache *c = s3_mt_cache_get(mt);
+    if (c == NULL)
+        return NULL;
+
+    s3_mt_cache_drain(c);
+
+    size_t total = sizeof(struct s3_mt_hdr) + size;
+    struct s3_mt_hdr *hdr = (struct s3_mt_hdr *)smalloc(&c->small, total);
+    if (hdr == NULL)
+        return NULL;
+
+    hdr->cache = c;
+    hdr->size = total;
+    return (void *)(hdr + 1);
+}
+
+static void
+s3_mt_free(void *ctx, void *ptr)
+{
+    if (ptr == NULL)
+        return;
+
+    struct s3_mt_allocator *mt = (struct s3_mt_allocator *)ctx;
+    struct s3_mt_hdr *hdr = ((struct s3_mt_hdr *)ptr) - 1;
+    struct s3_mt_cache *owner = hdr->cache;
+
+    if (owner == pthread_getspecific(mt->key)) {
+        smfree(&owner->small, hdr, hdr->size);
+        s3_mt_cache_drain(owner);
+        return;
+    }
+
+    struct s3_mt_hdr *head = __atomic_load_n(&owner->remote, __ATOMIC_RELAXED);
+    do {
+        hdr->next = head;
+    } while (!__atomic_compare_exchange_n(&owner->remote, &head, hdr, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static void *
+s3_mt_realloc(void *ctx, void *ptr, size_t size)
+{
+    if (ptr == NULL)
+        return s3_mt_malloc(ctx, size);
+
+    if (size == 0) {
+        s3_mt_free(ctx, ptr);
+        return NULL;
+    }
+
+    struct s3_mt_hdr *old_hdr = ((struct s3_mt_hdr *)ptr) - 1;
+    size_t old_user_size = old_hdr->size - sizeof(struct s3_mt_hdr);
+    if (size <= old_user_size)
+        return ptr;
+
+    void *new_ptr = s3_mt_malloc(ctx, size);
+    if (new_ptr == NULL)
+        return NULL;
+
+    memcpy(new_ptr, ptr, old_user_size < size ? old_user_size : size);
+    s3_mt_free(ctx, ptr);
+    return new_ptr;
+}
+
+s3_mt_allocator_t *
+s3_mt_allocator_new(void *arena_ctx)
+{
+    struct s3_mt_allocator *mt =
+        (struct s3_mt_allocator *)malloc(sizeof(*mt));
+    if (mt == NULL)
+        return NULL;
+    memset(mt, 0, sizeof(*mt));
+    mt->arena = (struct slab_arena *)arena_ctx;
+
+    if (pthread_key_create(&mt->key, s3_mt_cache_orphan) != 0) {
+        free(mt);
+        return NULL;
+    }
+    pthread_mutex_init(&mt->mutex, NULL);
+    return mt;
+}
+
+void
+s3_mt_allocator_delete(s3_mt_allocator_t *mt)
+{
+    if (mt == NULL)
+        return;
+
+    /* После этого деструктор key у живых потоков уже не вызовется. */
+    pthread_key_delete(mt->key);
+
+    struct s3_mt_cache *c = mt->caches;
+    while (c != NULL) {
+        struct s3_mt_cache *next = c->next;
+        /* small_alloc_destroy отдаёт арене все слабы, в т.ч. remote. */
+        slab_cache_set_thread(&c->slabs);
+        small_alloc_destroy(&c->small);
+        slab_cache_destroy(&c->slabs);
+        free(c);
+        c = next;
+    }
+
+    pthread_mutex_destroy(&mt->mutex);
+    free(mt);
+}
+
+void
+s3_allocator_init_small_mt(s3_allocator_t *a, s3_mt_allocator_t *mt)
+{
+    a->ctx     = mt;
+    a->malloc  = s3_mt_malloc;
+    a->realloc = s3_mt_realloc;
+    a->free    = s3_mt_free;
+}
@@ -0,0 +1,297 @@
+#include "s3_internal.h"
+#include "multipart.h"
+#include "s3/curl_easy_factory.h"
+#include "error.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <tarantool/module.h>
+
+#define S3_APPEND_DEFAULT_PART_SIZE   (8u * 1024 * 1024)
+#define S3_APPEND_DEFAULT_CONCURRENCY 4
+#define S3_APPEND_MAX_CONCURRENCY     64
+/* Предел одного UploadPartCopy. */
+#define S3_APPEND_MAX_COPY_PART       (5ULL * 1024 * 1024 * 1024)
+
+struct s3_append_task {
+    s3_client_t *client;
+    s3_put_opts_t opts;
+    size_t part_size;
+    uint32_t concurrency;
+    int fd;
+
+    uint64_t file_size;
+    uint64_t obj_size;
+    char obj_etag[S3_ETAG_MAX];
+    uint64_t copy_size;     /* байт берётся UploadPartCopy: 0 или obj_size */
+
+    s3_append_result_t result;
+    s3_error_t err;
+    s3_error_code_t code;
+};
+
+/* Размер и ETag текущего объекта; нет объекта — размер 0. */
+static s3_error_code_t
+s3_append_head(struct s3_append_task *t)
+{
+    struct s3_http_backend_impl *b = t->client->backend;
+
+    s3_easy_handle_t *h = NULL;
+    if (s3_easy_factory_new_head_object(t->client, t->opts.bucket,
+                                        t->opts.key, &h,
+                                        &t->err) != S3_E_OK)
+        return t->err.code;
+
+    s3_error_code_t code = b->vtbl->perform(b, h, &t->err);
+    if (code == S3_E_OK) {
+        curl_off_t len = -1;
+        curl_easy_getinfo(h->easy, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &len);
+        if (len < 0) {
+            s3_error_set(&t->err, S3_E_HTTP,
+                         "no Content-Length in HEAD response", 0, 0, 0);
+            code = t->err.code;
+        } else {
+            t->obj_size = (uint64_t)len;
+            memcpy(t->obj_etag, h->etag, sizeof(t->obj_etag));
+        }
+    } else if (code == S3_E_NOT_FOUND) {
+        s3_error_clear(&t->err);
+        code = S3_E_OK;
+    }
+    s3_easy_handle_destroy(h);
+    return code;
+}
+
+/* Весь файл одним PUT из fd. */
+static s3_error_code_t
+s3_append_put(struct s3_append_task *t)
+{
+    struct s3_http_backend_impl *b = t->client->backend;
+
+    s3_easy_handle_t *h = NULL;
+    if (s3_easy_factory_new_put_fd(t->client, &t->opts, t->fd, 0,
+                                   (size_t)t->file_size, &h,
+                                   &t->err) != S3_E_OK)
+        return t->err.code;
+
+    s3_error_code_t code = b->vtbl->perform(b, h, &t->err);
+    if (code == S3_E_OK) {
+        memcpy(t->result.etag, h->etag, sizeof(t->result.etag));
+        t->result.uploaded = t->file_size;
+    }
+    s3_easy_handle_destroy(h);
+    return code;
+}
+
+/* Старое тело — части 1..ncopy, поровну, каждая не больше 5 GiB. */
+static s3_error_code_t
+s3_append_copy(struct s3_append_task *t, struct s3_mpu *mpu,
+               uint32_t *next_part)
+{
+    uint64_t n = t->copy_size;
+    if (n == 0)
+        return S3_E_OK;
+    uint64_t ncopy = (n + S3_APPEND_MAX_COPY_PART - 1) /
+                     S3_APPEND_MAX_COPY_PART;
+    uint64_t piece = (n + ncopy - 1) / ncopy;
+
+    for (uint64_t off = 0; off < n; off += piece) {
+        uint64_t end = off + piece < n ? off + piece : n;
+        char range[64];
+        snprintf(range, sizeof(range), "bytes=%" PRIu64 "-%" PRIu64,
+                 off, end - 1);
+
+        s3_error_code_t code = s3_mpu_part_copy(mpu, (*next_part)++, NULL,
+                                                t->opts.key, range,
+                                                t->obj_etag[0] != '\0' ?
+                                                t->obj_etag : NULL,
+                                                &t->err);
+        if (code != S3_E_OK)
+            return code;
+    }
+    return S3_E_OK;
+}
+
+/* Файл после copy_size — части по part_size из fd, concurrency за раз. */
+static s3_error_code_t
+s3_append_tail(struct s3_append_task *t, struct s3_mpu *mpu,
+               uint32_t first)
+{
+    s3_client_t *client = t->client;
+    uint64_t off = t->copy_size;
+
+    s3_easy_handle_t **handles =
+        s3_alloc(&client->alloc, t->concurrency * sizeof(*handles));
+    s3_error_code_t code = S3_E_OK;
+
+    if (handles == NULL) {
+        s3_error_set(&t->err, S3_E_NOMEM,
+                     "Out of memory in append", ENOMEM, 0, 0);
+        return t->err.code;
+    }
+
+    while (off < t->file_size && code == S3_E_OK) {
+        size_t n = 0;
+        for (; n < t->concurrency && off < t->file_size; n++) {
+            uint64_t left = t->file_size - off;
+            size_t len = left < t->part_size ? (size_t)left : t->part_size;
+
+            code = s3_mpu_part_handle_fd(mpu, first + (uint32_t)n, t->fd,
+                                         (off_t)off, len, &handles[n],
+                                         &t->err);
+            if (code != S3_E_OK)
+                break;
+            off += len;
+        }
+        if (code != S3_E_OK) {
+            for (size_t i = 0; i < n; i++)
+                s3_easy_handle_destroy(handles[i]);
+            break;
+        }
+
+        code = s3_mpu_upload_handles(mpu, first, handles, n, &t->err);
+        first += (uint32_t)n;
+    }
+
+    s3_free(&client->alloc, handles);
+    return code;
+}
+
+static s3_error_code_t
+s3_append_multipart(struct s3_append_task *t, struct s3_mpu *mpu)
+{
+    uint64_t tail = t->file_size - t->copy_size;
+    uint64_t nparts = (t->copy_size + S3_APPEND_MAX_COPY_PART - 1) /
+                      S3_APPEND_MAX_COPY_PART +
+                      (tail + t->part_size - 1) / t->part_size;
+    if (nparts > S3_MPU_MAX_PARTS) {
+        s3_error_set(&t->err, S3_E_INVALID_ARG,
+                     "append exceeds 10000 parts, increase part_size",
+                     0, 0, 0);
+        return t->err.code;
+    }
+
+    uint32_t next = 1;
+    s3_error_code_t code;
+    if ((code = s3_mpu_begin(mpu, t->client, &t->opts, &t->err)) != S3_E_OK ||
+        (code = s3_append_copy(t, mpu, &next)) != S3_E_OK ||
+        (code = s3_append_tail(t, mpu, next)) != S3_E_OK ||
+        (code = s3_mpu_complete(mpu, &t->err)) != S3_E_OK)
+        return code;
+
+    memcpy(t->result.etag, mpu->etag, sizeof(t->result.etag));
+    t->result.copied = t->copy_size > 0;
+    t->result.uploaded = tail;
+    return S3_E_OK;
+}
+
+static ssize_t
+s3_client_append_worker(va_list ap)
+{
+    struct s3_append_task *t = va_arg(ap, struct s3_append_task *);
+
+    struct stat st;
+    if (fstat(t->fd, &st) != 0) {
+        s3_error_set(&t->err, S3_E_IO, "fstat failed in append",
+                     errno, 0, 0);
+        t->code = t->err.code;
+        return 0;
+    }
+    t->file_size = (uint64_t)st.st_size;
+
+    if ((t->code = s3_append_head(t)) != S3_E_OK)
+        return 0;
+
+    if (t->file_size < t->obj_size) {
+        s3_error_set(&t->err, S3_E_INVALID_ARG,
+                     "file is shorter than the object in append", 0, 0, 0);
+        t->code = t->err.code;
+        return 0;
+    }
+
+    t->result.size = t->file_size;
+    if (t->file_size == t->obj_size && t->obj_etag[0] != '\0') {
+        memcpy(t->result.etag, t->obj_etag, sizeof(t->result.etag));
+        return 0;
+    }
+
+    /*
+     * Старое тело не годится в часть multipart'а — загрузить всё:
+     * до part_size одним PUT, больше — multipart без копирования.
+     */
+    if (t->obj_size >= S3_MPU_MIN_PART_SIZE) {
+        t->copy_size = t->obj_size;
+    } else if (t->file_size <= t->part_size) {
+        t->code = s3_append_put(t);
+        return 0;
+    }
+
+    struct s3_mpu mpu;
+    memset(&mpu, 0, sizeof(mpu));
+    t->code = s3_append_multipart(t, &mpu);
+    if (t->code != S3_E_OK)
+        s3_mpu_abort(&mpu);
+    s3_mpu_destroy(&mpu);
+    return 0;
+}
+
+s3_error_code_t
+s3_client_append(s3_client_t *client,
+                 const s3_put_opts_t *opts,
+                 const s3_put_stream_opts_t *mp_opts,
+                 int fd,
+                 s3_append_result_t *result,
+                 s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (client == NULL || opts == NULL || opts->key == NULL || fd < 0) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts, key or fd is invalid in append",
+                     0, 0, 0);
+        if (client != NULL)
+            s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    struct s3_append_task task;
+    memset(&task, 0, sizeof(task));
+    task.client = client;
+    task.opts = *opts;
+    task.opts.content_length = 0;
+    task.fd = fd;
+    task.part_size = S3_APPEND_DEFAULT_PART_SIZE;
+    task.concurrency = S3_APPEND_DEFAULT_CONCURRENCY;
+    if (mp_opts != NULL && mp_opts->part_size > 0)
+        task.part_size = mp_opts->part_size;
+    if (mp_opts != NULL && mp_opts->concurrency > 0)
+        task.concurrency = mp_opts->concurrency;
+
+    if (task.part_size < S3_MPU_MIN_PART_SIZE ||
+        task.concurrency > S3_APPEND_MAX_CONCURRENCY)
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "part_size must be >= 5 MiB and concurrency <= 64 "
+                     "in append", 0, 0, 0);
+        s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    s3_error_clear(&task.err);
+    task.code = S3_E_OK;
+
+    coio_call(s3_client_append_worker, &task);
+
+    if (result != NULL)
+        *result = task.result;
+
+    *err = task.err;
+    s3_client_set_error(client, &task.err);
+    return task.code;
+}
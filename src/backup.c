@@ -0,0 +1,577 @@
+#include "s3_internal.h"
+#include "multipart.h"
+#include "s3/curl_easy_factory.h"
+#include "http/http_util.h"
+#include "error.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+
+#include <tarantool/module.h>
+
+#define S3_BACKUP_DEFAULT_PART_SIZE   (16u * 1024 * 1024)
+#define S3_BACKUP_DEFAULT_CONCURRENCY 8
+#define S3_BACKUP_MAX_CONCURRENCY     64
+#define S3_BACKUP_RETRIES             2
+#define S3_BACKUP_READ_BUF            (1024 * 1024)
+
+struct s3_backup_file {
+    const char *path;
+    const char *name;   /* path без общего каталога */
+    char *key;          /* prefix + name */
+    int fd;
+    uint64_t size;
+    bool skip;          /* объект уже есть в bucket'е */
+    size_t part_size;   /* 0 — одиночный PUT или неизвестен */
+    char etag[S3_ETAG_MAX];
+};
+
+struct s3_backup_task {
+    s3_client_t *client;
+    s3_backup_opts_t opts;
+    const char *const *paths;
+    size_t count;
+
+    struct s3_backup_file *files;
+    s3_backup_result_t result;
+
+    s3_error_t err;
+    s3_error_code_t code;
+};
+
+/* Длина общего для всех путей каталога, вместе с завершающим '/'. */
+static size_t
+s3_backup_common_dir(const char *const *paths, size_t count)
+{
+    size_t len = strlen(paths[0]);
+    for (size_t i = 1; i < count; i++) {
+        size_t j = 0;
+        while (j < len && paths[i][j] == paths[0][j])
+            j++;
+        len = j;
+    }
+    while (len > 0 && paths[0][len - 1] != '/')
+        len--;
+    return len;
+}
+
+static s3_error_code_t
+s3_backup_open(struct s3_backup_task *t)
+{
+    s3_client_t *c = t->client;
+    const char *prefix = t->opts.prefix != NULL ? t->opts.prefix : "";
+    size_t dir_len = s3_backup_common_dir(t->paths, t->count);
+
+    for (size_t i = 0; i < t->count; i++) {
+        struct s3_backup_file *f = &t->files[i];
+        f->path = t->paths[i];
+        f->name = f->path + dir_len;
+
+        size_t klen = strlen(prefix) + strlen(f->name) + 1;
+        f->key = s3_alloc(&c->alloc, klen);
+        if (f->key == NULL) {
+            s3_error_set(&t->err, S3_E_NOMEM,
+                         "Out of memory in backup", ENOMEM, 0, 0);
+            return t->err.code;
+        }
+        snprintf(f->key, klen, "%s%s", prefix, f->name);
+
+        f->fd = open(f->path, O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (f->fd < 0 || fstat(f->fd, &st) != 0) {
+            char msg[256];
+            snprintf(msg, sizeof(msg), "cannot open backup file %s",
+                     f->path);
+            s3_error_set(&t->err, S3_E_IO, msg, errno, 0, 0);
+            return t->err.code;
+        }
+        f->size = (uint64_t)st.st_size;
+
+        t->result.bytes += f->size;
+    }
+    return S3_E_OK;
+}
+
+int
+s3_local_etag(int fd, uint64_t size, size_t part_size, bool multipart,
+              char *out, size_t cap)
+{
+    char *buf = malloc(S3_BACKUP_READ_BUF);
+    EVP_MD_CTX *part = EVP_MD_CTX_new();
+    EVP_MD_CTX *all = EVP_MD_CTX_new();
+    unsigned char md[EVP_MAX_MD_SIZE];
+    unsigned int md_len = 0;
+    uint64_t nparts = 0;
+    int rc = -1;
+
+    if (buf == NULL || part == NULL || all == NULL)
+        goto out;
+    EVP_DigestInit_ex(all, EVP_md5(), NULL);
+
+    uint64_t pos = 0;
+    do {
+        uint64_t end = multipart && size - pos > part_size ?
+            pos + part_size : size;
+        EVP_DigestInit_ex(part, EVP_md5(), NULL);
+        while (pos < end) {
+            size_t want = end - pos < S3_BACKUP_READ_BUF ?
+                (size_t)(end - pos) : S3_BACKUP_READ_BUF;
+            ssize_t n = pread(fd, buf, want, (off_t)pos);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                goto out;
+            EVP_DigestUpdate(part, buf, (size_t)n);
+            pos += (uint64_t)n;
+        }
+        EVP_DigestFinal_ex(part, md, &md_len);
+        EVP_DigestUpdate(all, md, md_len);
+        nparts++;
+    } while (pos < size);
+
+    if (multipart)
+        EVP_DigestFinal_ex(all, md, &md_len);
+
+    size_t o = 0;
+    out[o++] = '"';
+    for (unsigned int i = 0; i < md_len && o + 3 < cap; i++)
+        o += (size_t)snprintf(out + o, cap - o, "%02x", md[i]);
+    if (multipart)
+        o += (size_t)snprintf(out + o, cap - o, "-%" PRIu64, nparts);
+    snprintf(out + o, cap - o, "\"");
+    rc = 0;
+
+out:
+    EVP_MD_CTX_free(all);
+    EVP_MD_CTX_free(part);
+    free(buf);
+    return rc;
+}
+
+/* Объект уже загружен: тот же размер (и ETag, если просили). */
+static bool
+s3_backup_same(struct s3_backup_task *t, struct s3_backup_file *f,
+               s3_easy_handle_t *h)
+{
+    curl_off_t len = -1;
+    curl_easy_getinfo(h->easy, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &len);
+    if (len < 0 || (uint64_t)len != f->size)
+        return false;
+
+    /*
+     * Размер частей прошлой загрузки известен, только если ETag сошёлся
+     * с посчитанным по нашему part_size; иначе 0 — restore не сверяет
+     * multipart ETag такого файла.
+     */
+    f->part_size = 0;
+    if (t->opts.flags & S3_BACKUP_F_VERIFY_ETAG) {
+        char local[S3_ETAG_MAX];
+        bool multipart = strchr(h->etag, '-') != NULL;
+        if (s3_local_etag(f->fd, f->size, t->opts.part_size,
+                          multipart, local, sizeof(local)) != 0 ||
+            strcmp(local, h->etag) != 0)
+            return false;
+        if (multipart)
+            f->part_size = t->opts.part_size;
+    }
+
+    memcpy(f->etag, h->etag, sizeof(f->etag));
+    return true;
+}
+
+/*
+ * Выполнить n хендлов одновременно; упавшие повторить по одной.
+ * codes[i] — итог i-го, возвращает код первой ошибки.
+ */
+static s3_error_code_t
+s3_backup_perform(struct s3_backup_task *t, s3_easy_handle_t **handles,
+                  size_t n, s3_error_code_t *codes, s3_error_t *errs,
+                  bool retry)
+{
+    struct s3_http_backend_impl *b = t->client->backend;
+
+    s3_error_t batch_err = S3_ERROR_INIT;
+    s3_error_code_t rc = b->vtbl->perform_many(b, handles, n, codes, errs,
+                                               &batch_err);
+    s3_error_code_t code = S3_E_OK;
+
+    for (size_t i = 0; i < n; i++) {
+        if (rc != S3_E_OK && codes[i] == S3_E_INTERNAL) {
+            codes[i] = rc;
+            errs[i] = batch_err;
+        }
+        for (int a = 0; retry && a < S3_BACKUP_RETRIES &&
+             codes[i] != S3_E_OK && codes[i] != S3_E_ACCESS_DENIED &&
+             codes[i] != S3_E_AUTH && codes[i] != S3_E_INVALID_ARG; a++)
+        {
+            if (s3_easy_handle_rewind(handles[i]) != 0)
+                break;
+            handles[i]->etag[0] = '\0';
+            codes[i] = b->vtbl->perform(b, handles[i], &errs[i]);
+        }
+        if (codes[i] != S3_E_OK && code == S3_E_OK) {
+            code = codes[i];
+            t->err = errs[i];
+        }
+    }
+    return code;
+}
+
+/* HEAD всех ключей пачками: что уже загружено прошлым backup'ом. */
+static s3_error_code_t
+s3_backup_check_existing(struct s3_backup_task *t, s3_easy_handle_t **handles,
+                         s3_error_code_t *codes, s3_error_t *errs)
+{
+    uint32_t conc = t->opts.concurrency;
+
+    for (size_t i = 0; i < t->count; i += conc) {
+        size_t n = 0;
+        s3_error_code_t code = S3_E_OK;
+        for (; n < conc && i + n < t->count && code == S3_E_OK; n++) {
+            code = s3_easy_factory_new_head_object(t->client, t->opts.bucket,
+                                                   t->files[i + n].key,
+                                                   &handles[n], &t->err);
+        }
+        if (code != S3_E_OK) {
+            for (size_t k = 0; k + 1 < n; k++)
+                s3_easy_handle_destroy(handles[k]);
+            return code;
+        }
+
+        /* Ошибки HEAD не фатальны: такой файл просто загрузим. */
+        s3_backup_perform(t, handles, n, codes, errs, false);
+        s3_error_clear(&t->err);
+        for (size_t k = 0; k < n; k++) {
+            struct s3_backup_file *f = &t->files[i + k];
+            f->skip = codes[k] == S3_E_OK && s3_backup_same(t, f, handles[k]);
+            s3_easy_handle_destroy(handles[k]);
+        }
+    }
+    return S3_E_OK;
+}
+
+/* Файлы не больше part_size — одиночными PUT'ами по concurrency за раз. */
+static s3_error_code_t
+s3_backup_upload_small(struct s3_backup_task *t, s3_easy_handle_t **handles,
+                       s3_error_code_t *codes, s3_error_t *errs)
+{
+    uint32_t conc = t->opts.concurrency;
+    struct s3_backup_file **batch =
+        s3_alloc(&t->client->alloc, conc * sizeof(*batch));
+    if (batch == NULL) {
+        s3_error_set(&t->err, S3_E_NOMEM,
+                     "Out of memory in backup", ENOMEM, 0, 0);
+        return t->err.code;
+    }
+
+    s3_error_code_t code = S3_E_OK;
+    size_t i = 0;
+    while (code == S3_E_OK && i < t->count) {
+        size_t n = 0;
+        for (; n < conc && i < t->count && code == S3_E_OK; i++) {
+            struct s3_backup_file *f = &t->files[i];
+            if (f->skip || f->size > t->opts.part_size)
+                continue;
+
+            s3_put_opts_t popts;
+            memset(&popts, 0, sizeof(popts));
+            popts.bucket = t->opts.bucket;
+            popts.key = f->key;
+
+            /* put_fd не умеет пустое тело. */
+            if (f->size == 0)
+                code = s3_easy_factory_new_put_buf(t->client, &popts,
+                                                   NULL, 0, &handles[n],
+                                                   &t->err);
+            else
+                code = s3_easy_factory_new_put_fd(t->client, &popts, f->fd,
+                                                  0, (size_t)f->size,
+                                                  &handles[n], &t->err);
+            if (code == S3_E_OK)
+                batch[n++] = f;
+        }
+
+        if (code == S3_E_OK && n > 0) {
+            code = s3_backup_perform(t, handles, n, codes, errs, true);
+            for (size_t k = 0; k < n; k++) {
+                if (codes[k] != S3_E_OK)
+                    continue;
+                memcpy(batch[k]->etag, handles[k]->etag,
+                       sizeof(batch[k]->etag));
+                t->result.uploaded++;
+                t->result.bytes_uploaded += batch[k]->size;
+            }
+        }
+
+        for (size_t k = 0; k < n; k++)
+            s3_easy_handle_destroy(handles[k]);
+    }
+
+    s3_free(&t->client->alloc, batch);
+    return code;
+}
+
+/* Большие файлы по одному, части — concurrency за раз. */
+static s3_error_code_t
+s3_backup_upload_large(struct s3_backup_task *t)
+{
+    for (size_t i = 0; i < t->count; i++) {
+        struct s3_backup_file *f = &t->files[i];
+        if (f->skip || f->size <= t->opts.part_size)
+            continue;
+
+        s3_put_opts_t popts;
+        memset(&popts, 0, sizeof(popts));
+        popts.bucket = t->opts.bucket;
+        popts.key = f->key;
+
+        s3_put_seg_t seg = { f->fd, 0, (size_t)f->size };
+        if (s3_put_iov_run(t->client, &popts, t->opts.part_size,
+                           t->opts.concurrency, &seg, 1, f->etag,
+                           &t->err) != S3_E_OK)
+            return t->err.code;
+
+        f->part_size = t->opts.part_size;
+        t->result.uploaded++;
+        t->result.bytes_uploaded += f->size;
+    }
+    return S3_E_OK;
+}
+
+/* Строка JSON в кавычках. */
+static s3_error_code_t
+s3_backup_json_str(s3_client_t *c, s3_mem_buf_t *b, const char *s,
+                   s3_error_t *err)
+{
+    if (s3_mem_buf_append(c, b, "\"", 1, err) != S3_E_OK)
+        return err->code;
+    for (; *s != '\0'; s++) {
+        char esc[8];
+        const char *p = s;
+        size_t len = 1;
+        if (*s == '"' || *s == '\\') {
+            esc[0] = '\\';
+            esc[1] = *s;
+            p = esc;
+            len = 2;
+        } else if ((unsigned char)*s < 0x20) {
+            len = (size_t)snprintf(esc, sizeof(esc), "\\u%04x",
+                                   (unsigned char)*s);
+            p = esc;
+        }
+        if (s3_mem_buf_append(c, b, p, len, err) != S3_E_OK)
+            return err->code;
+    }
+    return s3_mem_buf_append(c, b, "\"", 1, err);
+}
+
+/*
+ * {"version":1,"created":..,"files":[
+ * {"name":..,"path":..,"key":..,"size":..,"part_size":..,"etag":..},
+ * ...
+ * ]}
+ * part_size — размер частей multipart-объекта, 0 — одиночный PUT или
+ * неизвестен (пропущенный файл без сверки ETag'а).
+ * Одна запись на строку — restore разбирает её построчно.
+ */
+static s3_error_code_t
+s3_backup_write_manifest(struct s3_backup_task *t)
+{
+    s3_client_t *c = t->client;
+    s3_error_t *err = &t->err;
+    s3_mem_buf_t b = { NULL, 0, 0 };
+    char num[96];
+
+    snprintf(num, sizeof(num), "{\"version\":1,\"created\":%lld,\"files\":[\n",
+             (long long)time(NULL));
+    s3_error_code_t code = s3_mem_buf_append(c, &b, num, strlen(num), err);
+
+    for (size_t i = 0; i < t->count && code == S3_E_OK; i++) {
+        struct s3_backup_file *f = &t->files[i];
+        if ((code = s3_mem_buf_append(c, &b, "{\"name\":", 8, err)) != S3_E_OK ||
+            (code = s3_backup_json_str(c, &b, f->name, err)) != S3_E_OK ||
+            (code = s3_mem_buf_append(c, &b, ",\"path\":", 8, err)) != S3_E_OK ||
+            (code = s3_backup_json_str(c, &b, f->path, err)) != S3_E_OK ||
+            (code = s3_mem_buf_append(c, &b, ",\"key\":", 7, err)) != S3_E_OK ||
+            (code = s3_backup_json_str(c, &b, f->key, err)) != S3_E_OK)
+            break;
+        snprintf(num, sizeof(num),
+                 ",\"size\":%" PRIu64 ",\"part_size\":%zu,\"etag\":",
+                 f->size, f->part_size);
+        if ((code = s3_mem_buf_append(c, &b, num, strlen(num), err)) != S3_E_OK ||
+            (code = s3_backup_json_str(c, &b, f->etag, err)) != S3_E_OK)
+            break;
+        const char *tail = i + 1 < t->count ? "},\n" : "}\n";
+        code = s3_mem_buf_append(c, &b, tail, strlen(tail), err);
+    }
+    if (code == S3_E_OK)
+        code = s3_mem_buf_append(c, &b, "]}\n", 3, err);
+
+    char *key = NULL;
+    if (code == S3_E_OK && t->opts.manifest_key == NULL) {
+        const char *prefix = t->opts.prefix != NULL ? t->opts.prefix : "";
+        size_t klen = strlen(prefix) + sizeof("manifest.json");
+        key = s3_alloc(&c->alloc, klen);
+        if (key == NULL) {
+            s3_error_set(err, S3_E_NOMEM,
+                         "Out of memory in backup", ENOMEM, 0, 0);
+            code = err->code;
+        } else {
+            snprintf(key, klen, "%smanifest.json", prefix);
+        }
+    }
+
+    if (code == S3_E_OK) {
+        s3_put_opts_t popts;
+        memset(&popts, 0, sizeof(popts));
+        popts.bucket = t->opts.bucket;
+        popts.key = key != NULL ? key : t->opts.manifest_key;
+        popts.content_type = "application/json";
+
+        s3_easy_handle_t *h = NULL;
+        code = s3_easy_factory_new_put_buf(c, &popts, b.data, b.size,
+                                           &h, err);
+        if (code == S3_E_OK) {
+            struct s3_http_backend_impl *be = c->backend;
+            code = be->vtbl->perform(be, h, err);
+            s3_easy_handle_destroy(h);
+        }
+    }
+
+    if (key != NULL)
+        s3_free(&c->alloc, key);
+    if (b.data != NULL)
+        s3_free(&c->alloc, b.data);
+    return code;
+}
+
+static double
+s3_backup_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static ssize_t
+s3_client_backup_worker(va_list ap)
+{
+    struct s3_backup_task *t = va_arg(ap, struct s3_backup_task *);
+    s3_client_t *c = t->client;
+    double start = s3_backup_now();
+    uint32_t conc = t->opts.concurrency;
+
+    s3_easy_handle_t **handles = s3_alloc(&c->alloc, conc * sizeof(*handles));
+    s3_error_code_t *codes = s3_alloc(&c->alloc, conc * sizeof(*codes));
+    s3_error_t *errs = s3_alloc(&c->alloc, conc * sizeof(*errs));
+    t->files = s3_alloc(&c->alloc, t->count * sizeof(*t->files));
+
+    if (handles == NULL || codes == NULL || errs == NULL || t->files == NULL) {
+        s3_error_set(&t->err, S3_E_NOMEM,
+                     "Out of memory in backup", ENOMEM, 0, 0);
+        t->code = t->err.code;
+        goto out;
+    }
+    memset(t->files, 0, t->count * sizeof(*t->files));
+    for (size_t i = 0; i < t->count; i++)
+        t->files[i].fd = -1;
+    t->result.files = t->count;
+
+    if ((t->code = s3_backup_open(t)) != S3_E_OK ||
+        (t->code = s3_backup_check_existing(t, handles, codes,
+                                            errs)) != S3_E_OK)
+        goto out;
+
+    for (size_t i = 0; i < t->count; i++)
+        t->result.skipped += t->files[i].skip;
+
+    if ((t->code = s3_backup_upload_small(t, handles, codes,
+                                          errs)) != S3_E_OK ||
+        (t->code = s3_backup_upload_large(t)) != S3_E_OK)
+        goto out;
+
+    /* Manifest — только когда все файлы на месте. */
+    t->code = s3_backup_write_manifest(t);
+
+out:
+    if (t->files != NULL) {
+        for (size_t i = 0; i < t->count; i++) {
+            if (t->files[i].fd >= 0)
+                close(t->files[i].fd);
+            if (t->files[i].key != NULL)
+                s3_free(&c->alloc, t->files[i].key);
+        }
+        s3_free(&c->alloc, t->files);
+    }
+    if (errs != NULL)
+        s3_free(&c->alloc, errs);
+    if (codes != NULL)
+        s3_free(&c->alloc, codes);
+    if (handles != NULL)
+        s3_free(&c->alloc, handles);
+
+    t->result.elapsed = s3_backup_now() - start;
+    return 0;
+}
+
+s3_error_code_t
+s3_client_backup(s3_client_t *client,
+                 const s3_backup_opts_t *opts,
+                 const char *const *files, size_t count,
+                 s3_backup_result_t *result,
+                 s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (client == NULL || opts == NULL || files == NULL || count == 0) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts or files is invalid in backup", 0, 0, 0);
+        if (client != NULL)
+            s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    struct s3_backup_task task;
+    memset(&task, 0, sizeof(task));
+    task.client = client;
+    task.opts = *opts;
+    task.paths = files;
+    task.count = count;
+    if (task.opts.part_size == 0)
+        task.opts.part_size = S3_BACKUP_DEFAULT_PART_SIZE;
+    if (task.opts.concurrency == 0)
+        task.opts.concurrency = S3_BACKUP_DEFAULT_CONCURRENCY;
+
+    if (task.opts.part_size < S3_MPU_MIN_PART_SIZE ||
+        task.opts.concurrency > S3_BACKUP_MAX_CONCURRENCY)
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "part_size must be >= 5 MiB and concurrency <= 64 "
+                     "in backup", 0, 0, 0);
+        s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    s3_error_clear(&task.err);
+    task.code = S3_E_OK;
+
+    coio_call(s3_client_backup_worker, &task);
+
+    if (result != NULL)
+        *result = task.result;
+
+    *err = task.err;
+    s3_client_set_error(client, &task.err);
+    return task.code;
+}
@@ -0,0 +1,502 @@
+#include "block_cache.h"
+#include "error.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <tarantool/module.h>
+
+#define S3_BLOCK_CACHE_DEFAULT_BLOCK (1024 * 1024)
+#define S3_BLOCK_CACHE_MIN_BUCKETS   64
+
+enum s3_block_state {
+    S3_BLOCK_LOADING,
+    S3_BLOCK_READY,
+    S3_BLOCK_FAILED,
+};
+
+struct s3_block {
+    struct rlist hash_link;  /* в цепочке buckets, пока блок в кэше */
+    struct rlist lru_link;   /* в lru, пока refs == 0 */
+    bool in_hash;
+
+    /* Ключ: "bucket\0key\0etag" и номер блока. */
+    char *id;
+    size_t id_len;
+    uint64_t hash;
+    uint64_t index;
+
+    enum s3_block_state state;
+    int refs;                /* сколько вызовов держат блок */
+
+    char *data;              /* block_size байт */
+    size_t len;              /* < block_size — конец объекта */
+    s3_error_t err;          /* для S3_BLOCK_FAILED */
+};
+
+struct s3_block_cache {
+    s3_client_t *client;
+
+    size_t capacity;
+    size_t block_size;
+    size_t used;             /* block_size * число живых блоков */
+
+    struct rlist *buckets;
+    size_t nbuckets;         /* степень двойки */
+
+    /* Незакреплённые готовые блоки, в голове — давно не читанные. */
+    struct rlist lru;
+
+    /* Будит всех, кто ждёт загрузки каких-либо блоков. */
+    struct fiber_cond *cond;
+
+    uint64_t hits;
+    uint64_t misses;
+};
+
+s3_error_code_t
+s3_block_cache_new(struct s3_client *client,
+                   const s3_client_opts_t *opts,
+                   struct s3_block_cache **out,
+                   s3_error_t *err)
+{
+    struct s3_block_cache *cache =
+        (struct s3_block_cache *)s3_alloc(&client->alloc, sizeof(*cache));
+    if (cache == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate block cache", ENOMEM, 0, 0);
+        return err->code;
+    }
+    memset(cache, 0, sizeof(*cache));
+    cache->client = client;
+    cache->capacity = opts->block_cache_bytes;
+    cache->block_size = opts->block_cache_block_size > 0 ?
+        opts->block_cache_block_size : S3_BLOCK_CACHE_DEFAULT_BLOCK;
+    rlist_create(&cache->lru);
+
+    size_t want = 2 * (cache->capacity / cache->block_size + 1);
+    cache->nbuckets = S3_BLOCK_CACHE_MIN_BUCKETS;
+    while (cache->nbuckets < want)
+        cache->nbuckets *= 2;
+
+    cache->buckets = (struct rlist *)s3_alloc(&client->alloc,
+        cache->nbuckets * sizeof(*cache->buckets));
+    cache->cond = fiber_cond_new();
+    if (cache->buckets == NULL || cache->cond == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate block cache", ENOMEM, 0, 0);
+        s3_block_cache_delete(cache);
+        return err->code;
+    }
+    for (size_t i = 0; i < cache->nbuckets; i++)
+        rlist_create(&cache->buckets[i]);
+
+    *out = cache;
+    return S3_E_OK;
+}
+
+static void
+s3_block_free(struct s3_block_cache *cache, struct s3_block *b)
+{
+    s3_client_t *c = cache->client;
+    if (b->data != NULL) {
+        s3_free(&c->alloc, b->data);
+        cache->used -= cache->block_size;
+    }
+    s3_free(&c->alloc, b->id);
+    s3_free(&c->alloc, b);
+}
+
+void
+s3_block_cache_delete(struct s3_block_cache *cache)
+{
+    if (cache == NULL)
+        return;
+
+    s3_client_t *c = cache->client;
+
+    /* При удалении клиента вызовов в полёте нет — все блоки в lru. */
+    if (cache->buckets != NULL) {
+        for (size_t i = 0; i < cache->nbuckets; i++) {
+            struct s3_block *b, *tmp;
+            rlist_foreach_entry_safe(b, &cache->buckets[i], hash_link, tmp)
+                s3_block_free(cache, b);
+        }
+        s3_free(&c->alloc, cache->buckets);
+    }
+    if (cache->cond != NULL)
+        fiber_cond_delete(cache->cond);
+    s3_free(&c->alloc, cache);
+}
+
+void
+s3_block_cache_stats(const struct s3_block_cache *cache,
+                     uint64_t *hits, uint64_t *misses)
+{
+    *hits = cache->hits;
+    *misses = cache->misses;
+}
+
+/* FNV-1a по id и номеру блока. */
+static uint64_t
+s3_block_hash(const char *id, size_t id_len, uint64_t index)
+{
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < id_len; i++) {
+        h ^= (unsigned char)id[i];
+        h *= 1099511628211ULL;
+    }
+    for (int i = 0; i < 8; i++) {
+        h ^= (index >> (i * 8)) & 0xff;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static struct s3_block *
+s3_block_find(struct s3_block_cache *cache, const char *id, size_t id_len,
+              uint64_t hash, uint64_t index)
+{
+    struct rlist *chain = &cache->buckets[hash & (cache->nbuckets - 1)];
+    struct s3_block *b;
+    rlist_foreach_entry(b, chain, hash_link) {
+        if (b->hash == hash && b->index == index && b->id_len == id_len &&
+            memcmp(b->id, id, id_len) == 0)
+            return b;
+    }
+    return NULL;
+}
+
+static void
+s3_block_unhash(struct s3_block *b)
+{
+    if (b->in_hash) {
+        rlist_del(&b->hash_link);
+        b->in_hash = false;
+    }
+}
+
+/* Освобождать место, пока новый блок не влезет (или вытеснять нечего). */
+static void
+s3_block_cache_evict(struct s3_block_cache *cache)
+{
+    while (cache->used + cache->block_size > cache->capacity &&
+           !rlist_empty(&cache->lru))
+    {
+        struct s3_block *b =
+            rlist_first_entry(&cache->lru, struct s3_block, lru_link);
+        rlist_del(&b->lru_link);
+        s3_block_unhash(b);
+        s3_block_free(cache, b);
+    }
+}
+
+static void
+s3_block_pin(struct s3_block *b)
+{
+    if (b->refs++ == 0 && b->state == S3_BLOCK_READY)
+        rlist_del(&b->lru_link);
+}
+
+static void
+s3_block_unpin(struct s3_block_cache *cache, struct s3_block *b)
+{
+    if (--b->refs > 0)
+        return;
+    if (!b->in_hash) {
+        s3_block_free(cache, b);
+        return;
+    }
+    rlist_add_tail(&cache->lru, &b->lru_link);
+}
+
+static struct s3_block *
+s3_block_new(struct s3_block_cache *cache, const char *id, size_t id_len,
+             uint64_t hash, uint64_t index, s3_error_t *err)
+{
+    s3_client_t *c = cache->client;
+
+    s3_block_cache_evict(cache);
+
+    struct s3_block *b = (struct s3_block *)s3_alloc(&c->alloc, sizeof(*b));
+    if (b == NULL)
+        goto nomem;
+    memset(b, 0, sizeof(*b));
+
+    b->id = (char *)s3_alloc(&c->alloc, id_len);
+    b->data = (char *)s3_alloc(&c->alloc, cache->block_size);
+    if (b->id == NULL || b->data == NULL) {
+        if (b->id != NULL)
+            s3_free(&c->alloc, b->id);
+        if (b->data != NULL)
+            s3_free(&c->alloc, b->data);
+        s3_free(&c->alloc, b);
+        goto nomem;
+    }
+    cache->used += cache->block_size;
+
+    memcpy(b->id, id, id_len);
+    b->id_len = id_len;
+    b->hash = hash;
+    b->index = index;
+    b->state = S3_BLOCK_LOADING;
+    b->refs = 1;
+    rlist_add_tail(&cache->buckets[hash & (cache->nbuckets - 1)],
+                   &b->hash_link);
+    b->in_hash = true;
+    return b;
+
+nomem:
+    s3_error_set(err, S3_E_NOMEM,
+                 "Out of memory in block cache", ENOMEM, 0, 0);
+    return NULL;
+}
+
+/*
+ * Загрузить блоки misses (все LOADING, наши) одним s3_client_get_ranges:
+ * смежные склеятся в один Range GET.
+ */
+static void
+s3_block_cache_fetch(struct s3_block_cache *cache,
+                     const s3_pread_opts_t *opts,
+                     struct s3_block **misses, size_t n)
+{
+    s3_client_t *c = cache->client;
+    s3_error_t err = S3_ERROR_INIT;
+
+    s3_range_t *ranges = (s3_range_t *)s3_alloc(&c->alloc,
+                                                n * sizeof(*ranges));
+    if (ranges == NULL) {
+        s3_error_set(&err, S3_E_NOMEM,
+                     "Out of memory in block cache", ENOMEM, 0, 0);
+        for (size_t i = 0; i < n; i++) {
+            misses[i]->state = S3_BLOCK_FAILED;
+            misses[i]->err = err;
+        }
+        goto out;
+    }
+    memset(ranges, 0, n * sizeof(*ranges));
+
+    for (size_t i = 0; i < n; i++) {
+        ranges[i].offset = misses[i]->index * cache->block_size;
+        ranges[i].length = cache->block_size;
+        ranges[i].buf = misses[i]->data;
+        ranges[i].fd = -1;
+    }
+
+    s3_get_ranges_opts_t gopts;
+    memset(&gopts, 0, sizeof(gopts));
+    gopts.bucket = opts->bucket;
+    gopts.key = opts->key;
+    gopts.if_match = opts->etag;
+    gopts.max_gap = 0;
+
+    s3_client_get_ranges(c, &gopts, ranges, n, &err);
+
+    for (size_t i = 0; i < n; i++) {
+        struct s3_block *b = misses[i];
+        if (ranges[i].code == S3_E_OK) {
+            b->state = S3_BLOCK_READY;
+            b->len = ranges[i].bytes;
+        } else if (ranges[i].code == err.code && err.http_status == 416) {
+            /* Блок целиком за концом объекта. */
+            b->state = S3_BLOCK_READY;
+            b->len = 0;
+        } else {
+            b->state = S3_BLOCK_FAILED;
+            b->err = err;
+        }
+    }
+    s3_free(&c->alloc, ranges);
+
+out:
+    /* Упавшие блоки — из кэша: следующий вызов попробует снова. */
+    for (size_t i = 0; i < n; i++) {
+        if (misses[i]->state == S3_BLOCK_FAILED)
+            s3_block_unhash(misses[i]);
+    }
+    fiber_cond_broadcast(cache->cond);
+}
+
+static s3_error_code_t
+s3_block_cache_pread(struct s3_block_cache *cache,
+                     const s3_pread_opts_t *opts,
+                     void *buf, size_t len, uint64_t offset,
+                     size_t *bytes_read, s3_error_t *err)
+{
+    s3_client_t *c = cache->client;
+    size_t bs = cache->block_size;
+
+    const char *bucket = opts->bucket != NULL ? opts->bucket :
+        (c->default_bucket != NULL ? c->default_bucket : "");
+    const char *etag = opts->etag;
+    size_t bl = strlen(bucket), kl = strlen(opts->key), el = strlen(etag);
+    size_t id_len = bl + 1 + kl + 1 + el;
+
+    uint64_t first = offset / bs;
+    uint64_t last = (offset + len - 1) / bs;
+    size_t count = (size_t)(last - first + 1);
+
+    char *id = (char *)s3_alloc(&c->alloc, id_len);
+    struct s3_block **blocks =
+        (struct s3_block **)s3_alloc(&c->alloc, 2 * count * sizeof(*blocks));
+    if (id == NULL || blocks == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Out of memory in block cache", ENOMEM, 0, 0);
+        if (id != NULL)
+            s3_free(&c->alloc, id);
+        if (blocks != NULL)
+            s3_free(&c->alloc, blocks);
+        return err->code;
+    }
+    memcpy(id, bucket, bl);
+    id[bl] = '\0';
+    memcpy(id + bl + 1, opts->key, kl);
+    id[bl + 1 + kl] = '\0';
+    memcpy(id + bl + 1 + kl + 1, etag, el);
+
+    struct s3_block **misses = blocks + count;
+    size_t nmiss = 0;
+    size_t npinned = 0;
+    s3_error_code_t code = S3_E_OK;
+
+    /* Закрепить все блоки диапазона, для отсутствующих — завести LOADING. */
+    for (size_t i = 0; i < count; i++) {
+        uint64_t index = first + i;
+        uint64_t hash = s3_block_hash(id, id_len, index);
+        struct s3_block *b = s3_block_find(cache, id, id_len, hash, index);
+        if (b != NULL) {
+            s3_block_pin(b);
+            cache->hits++;
+        } else {
+            b = s3_block_new(cache, id, id_len, hash, index, err);
+            if (b == NULL) {
+                code = err->code;
+                break;
+            }
+            misses[nmiss++] = b;
+            cache->misses++;
+        }
+        blocks[npinned++] = b;
+    }
+
+    if (nmiss > 0) {
+        if (code == S3_E_OK) {
+            s3_block_cache_fetch(cache, opts, misses, nmiss);
+        } else {
+            for (size_t i = 0; i < nmiss; i++) {
+                misses[i]->state = S3_BLOCK_FAILED;
+                misses[i]->err = *err;
+                s3_block_unhash(misses[i]);
+            }
+            fiber_cond_broadcast(cache->cond);
+        }
+    }
+
+    /* Блоки, которые грузят другие файберы. */
+    for (size_t i = 0; i < npinned && code == S3_E_OK; i++) {
+        while (blocks[i]->state == S3_BLOCK_LOADING) {
+            if (fiber_cond_wait(cache->cond) != 0 && fiber_is_cancelled()) {
+                s3_error_set(err, S3_E_CANCELLED,
+                             "fiber is cancelled while waiting for block",
+                             0, 0, 0);
+                code = err->code;
+                break;
+            }
+        }
+    }
+
+    size_t done = 0;
+    for (size_t i = 0; i < npinned && code == S3_E_OK; i++) {
+        struct s3_block *b = blocks[i];
+        if (b->state == S3_BLOCK_FAILED) {
+            *err = b->err;
+            code = err->code;
+            break;
+        }
+
+        uint64_t bstart = b->index * bs;
+        uint64_t from = offset + done;
+        if (from >= bstart + b->len)
+            break;
+        size_t n = (size_t)(bstart + b->len - from);
+        if (n > len - done)
+            n = len - done;
+        memcpy((char *)buf + done, b->data + (from - bstart), n);
+        done += n;
+        if (b->len < bs)
+            break; /* конец объекта */
+    }
+
+    for (size_t i = 0; i < npinned; i++)
+        s3_block_unpin(cache, blocks[i]);
+
+    s3_free(&c->alloc, blocks);
+    s3_free(&c->alloc, id);
+
+    if (code == S3_E_OK && bytes_read != NULL)
+        *bytes_read = done;
+    return code;
+}
+
+s3_error_code_t
+s3_client_pread(s3_client_t *client,
+                const s3_pread_opts_t *opts,
+                void *buf, size_t len, uint64_t offset,
+                size_t *bytes_read,
+                s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (client == NULL || opts == NULL || opts->key == NULL ||
+        (buf == NULL && len > 0))
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts, key or buf is NULL in pread", 0, 0, 0);
+        if (client != NULL)
+            s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    if (bytes_read != NULL)
+        *bytes_read = 0;
+    if (len == 0)
+        return S3_E_OK;
+
+    /* Без ETag'а перезапись объекта не заметить — мимо кэша. */
+    s3_error_code_t code;
+    if (client->block_cache != NULL && opts->etag != NULL &&
+        opts->etag[0] != '\0')
+    {
+        code = s3_block_cache_pread(client->block_cache, opts, buf, len,
+                                    offset, bytes_read, err);
+    } else {
+        /* Без кэша — один Range GET. */
+        s3_range_t r;
+        memset(&r, 0, sizeof(r));
+        r.offset = offset;
+        r.length = len;
+        r.buf = buf;
+        r.fd = -1;
+
+        s3_get_ranges_opts_t gopts;
+        memset(&gopts, 0, sizeof(gopts));
+        gopts.bucket = opts->bucket;
+        gopts.key = opts->key;
+        gopts.if_match = opts->etag;
+
+        code = s3_client_get_ranges(client, &gopts, &r, 1, err);
+        if (code != S3_E_OK && err->http_status == 416) {
+            s3_error_clear(err);
+            code = S3_E_OK;
+        }
+        if (code == S3_E_OK && bytes_read != NULL)
+            *bytes_read = r.bytes;
+    }
+
+    s3_client_set_error(client, err);
+    return code;
+}
@@ -0,0 +1,37 @@
+#ifndef TARANTOOL_S3_BLOCK_CACHE_H_INCLUDED
+#define TARANTOOL_S3_BLOCK_CACHE_H_INCLUDED 1
+
+#include "s3_internal.h"
+
+/*
+ * Кэш блоков объектов для s3_client_pread (block_cache_bytes).
+ *
+ * Объект режется на блоки по block_size; блок — ключ (bucket, key, ETag,
+ * номер блока). Промахи одного вызова читаются s3_client_get_ranges,
+ * смежные блоки — одним Range GET. Блок, который уже грузит другой
+ * файбер, не запрашивается повторно: ждём его.
+ *
+ * Объём ограничен block_cache_bytes, вытесняются давно не читанные
+ * блоки (LRU). Блоки, которые прямо сейчас читаются или грузятся, не
+ * вытесняются, поэтому на время вызовов кэш может превысить лимит.
+ *
+ * Трогается только из файберов tx-треда, без блокировок.
+ */
+
+struct s3_block_cache;
+
+s3_error_code_t
+s3_block_cache_new(struct s3_client *client,
+                   const s3_client_opts_t *opts,
+                   struct s3_block_cache **out,
+                   s3_error_t *err);
+
+void
+s3_block_cache_delete(struct s3_block_cache *cache);
+
+/* Попадания/промахи в блоках, для s3_client_stats. */
+void
+s3_block_cache_stats(const struct s3_block_cache *cache,
+                     uint64_t *hits, uint64_t *misses);
+
+#endif /* TARANTOOL_S3_BLOCK_CACHE_H_INCLUDED */
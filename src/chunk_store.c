@@ -0,0 +1,772 @@
+#include "s3_internal.h"
+#include "s3/curl_easy_factory.h"
+#include "http/http_util.h"
+#include "error.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+
+#include <tarantool/module.h>
+
+#define S3_CHUNK_DEFAULT_AVG         (1024u * 1024)
+#define S3_CHUNK_MIN_AVG             (64u * 1024)
+#define S3_CHUNK_MAX_AVG             (8u * 1024 * 1024)
+#define S3_CHUNK_DEFAULT_CONCURRENCY 8
+#define S3_CHUNK_MAX_CONCURRENCY     64
+#define S3_CHUNK_RETRIES             2
+#define S3_CHUNK_DEFAULT_PREFIX      "chunks/"
+#define S3_CHUNK_SHA_LEN             32
+#define S3_CHUNK_KEY_MAX             1024
+
+/*
+ * FastCDC: gear hash fp = (fp << 1) + gear[byte], граница там, где
+ * выбранные старшие биты fp нулевые. До avg маска строже (на бит больше),
+ * после — мягче: размеры кусков жмутся к avg. Первые min байт не
+ * хешируются вовсе.
+ */
+struct s3_cdc {
+    size_t min;
+    size_t avg;
+    size_t max;
+    uint64_t mask_s;
+    uint64_t mask_l;
+};
+
+/*
+ * Таблица gear — часть формата: от неё зависят границы кусков, а
+ * значит, и дедупликация между версиями. Поэтому она не случайная, а
+ * splitmix64 от фиксированного seed'а.
+ */
+static uint64_t s3_cdc_gear[256];
+static pthread_once_t s3_cdc_gear_once = PTHREAD_ONCE_INIT;
+
+static void
+s3_cdc_gear_init(void)
+{
+    uint64_t x = 0x5333636463676561ULL; /* "S3cdcgea" */
+    for (int i = 0; i < 256; i++) {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        s3_cdc_gear[i] = z ^ (z >> 31);
+    }
+}
+
+static uint64_t
+s3_cdc_mask(unsigned bits)
+{
+    return ((1ULL << bits) - 1) << (64 - bits);
+}
+
+static void
+s3_cdc_init(struct s3_cdc *cdc, size_t avg)
+{
+    unsigned bits = 0;
+    while (((size_t)1 << bits) < avg)
+        bits++;
+    cdc->avg = avg;
+    cdc->min = avg / 4;
+    cdc->max = avg * 4;
+    cdc->mask_s = s3_cdc_mask(bits + 1);
+    cdc->mask_l = s3_cdc_mask(bits - 1);
+    pthread_once(&s3_cdc_gear_once, s3_cdc_gear_init);
+}
+
+/* Длина куска в начале p[0..n); n < max бывает только в конце файла. */
+static size_t
+s3_cdc_cut(const struct s3_cdc *cdc, const unsigned char *p, size_t n)
+{
+    if (n <= cdc->min)
+        return n;
+    if (n > cdc->max)
+        n = cdc->max;
+    size_t normal = n < cdc->avg ? n : cdc->avg;
+
+    uint64_t fp = 0;
+    size_t i = cdc->min;
+    for (; i < normal; i++) {
+        fp = (fp << 1) + s3_cdc_gear[p[i]];
+        if ((fp & cdc->mask_s) == 0)
+            return i + 1;
+    }
+    for (; i < n; i++) {
+        fp = (fp << 1) + s3_cdc_gear[p[i]];
+        if ((fp & cdc->mask_l) == 0)
+            return i + 1;
+    }
+    return n;
+}
+
+struct s3_chunk {
+    uint64_t offset;
+    size_t len;
+    unsigned char sha[S3_CHUNK_SHA_LEN];
+    bool transfer;      /* put: загружать (нет в bucket'е, первый в файле) */
+};
+
+struct s3_chunk_task {
+    s3_client_t *client;
+    s3_chunk_opts_t opts;
+    const char *manifest_key;
+    int fd;
+
+    struct s3_chunk *chunks;
+    size_t count;
+    size_t cap;
+    uint64_t size;
+
+    s3_easy_handle_t **handles;
+    s3_error_code_t *codes;
+    s3_error_t *errs;
+    char (*keys)[S3_CHUNK_KEY_MAX];
+
+    s3_chunk_result_t result;
+    s3_error_t err;
+    s3_error_code_t code;
+};
+
+static s3_error_code_t
+s3_chunk_nomem(struct s3_chunk_task *t)
+{
+    s3_error_set(&t->err, S3_E_NOMEM, "Out of memory in chunk store",
+                 ENOMEM, 0, 0);
+    return t->err.code;
+}
+
+static void
+s3_chunk_hex(const unsigned char *sha, char *out)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < S3_CHUNK_SHA_LEN; i++) {
+        out[2 * i] = digits[sha[i] >> 4];
+        out[2 * i + 1] = digits[sha[i] & 0xf];
+    }
+    out[2 * S3_CHUNK_SHA_LEN] = '\0';
+}
+
+static int
+s3_chunk_unhex(const char *s, unsigned char *sha)
+{
+    for (int i = 0; i < S3_CHUNK_SHA_LEN; i++) {
+        unsigned v = 0;
+        if (sscanf(s + 2 * i, "%2x", &v) != 1)
+            return -1;
+        sha[i] = (unsigned char)v;
+    }
+    return 0;
+}
+
+/* sha256 куска в base64 — значение x-amz-checksum-sha256. */
+static void
+s3_chunk_b64(const struct s3_chunk *ch, char *out, size_t cap)
+{
+    if (s3_base64_encode(ch->sha, S3_CHUNK_SHA_LEN, out, cap) < 0)
+        out[0] = '\0';
+}
+
+static void
+s3_chunk_key(struct s3_chunk_task *t, const struct s3_chunk *ch, char *key)
+{
+    char hex[2 * S3_CHUNK_SHA_LEN + 1];
+    s3_chunk_hex(ch->sha, hex);
+    snprintf(key, S3_CHUNK_KEY_MAX, "%s%s", t->opts.chunk_prefix, hex);
+}
+
+static s3_error_code_t
+s3_chunk_append(struct s3_chunk_task *t, uint64_t offset, size_t len)
+{
+    if (t->count == t->cap) {
+        size_t ncap = t->cap != 0 ? t->cap * 2 : 1024;
+        void *p = s3_realloc(&t->client->alloc, t->chunks,
+                             ncap * sizeof(*t->chunks));
+        if (p == NULL)
+            return s3_chunk_nomem(t);
+        t->chunks = p;
+        t->cap = ncap;
+    }
+    struct s3_chunk *ch = &t->chunks[t->count++];
+    memset(ch, 0, sizeof(*ch));
+    ch->offset = offset;
+    ch->len = len;
+    return S3_E_OK;
+}
+
+/*
+ * Выполнить n хендлов одновременно; упавшие повторить по одной.
+ * Код первой ошибки — в t->err.
+ */
+static s3_error_code_t
+s3_chunk_perform(struct s3_chunk_task *t, size_t n, bool retry)
+{
+    struct s3_http_backend_impl *b = t->client->backend;
+
+    s3_error_t batch_err = S3_ERROR_INIT;
+    s3_error_code_t rc = b->vtbl->perform_many(b, t->handles, n, t->codes,
+                                               t->errs, &batch_err);
+    s3_error_code_t code = S3_E_OK;
+
+    for (size_t i = 0; i < n; i++) {
+        if (rc != S3_E_OK && t->codes[i] == S3_E_INTERNAL) {
+            t->codes[i] = rc;
+            t->errs[i] = batch_err;
+        }
+        for (int a = 0; retry && a < S3_CHUNK_RETRIES &&
+             t->codes[i] != S3_E_OK && t->codes[i] != S3_E_ACCESS_DENIED &&
+             t->codes[i] != S3_E_AUTH && t->codes[i] != S3_E_NOT_FOUND &&
+             t->codes[i] != S3_E_INVALID_ARG; a++)
+        {
+            if (s3_easy_handle_rewind(t->handles[i]) != 0)
+                break;
+            t->codes[i] = b->vtbl->perform(b, t->handles[i], &t->errs[i]);
+        }
+        if (t->codes[i] != S3_E_OK && code == S3_E_OK) {
+            code = t->codes[i];
+            t->err = t->errs[i];
+        }
+    }
+    return code;
+}
+
+static void
+s3_chunk_destroy_handles(struct s3_chunk_task *t, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        s3_easy_handle_destroy(t->handles[i]);
+        t->handles[i] = NULL;
+    }
+}
+
+/* ----------------- put ----------------- */
+
+/* Один проход по файлу: границы кусков и sha256 каждого. */
+static s3_error_code_t
+s3_chunk_split(struct s3_chunk_task *t)
+{
+    struct s3_cdc cdc;
+    s3_cdc_init(&cdc, t->opts.avg_chunk);
+
+    size_t cap = cdc.max * 2;
+    unsigned char *buf = malloc(cap);
+    if (buf == NULL)
+        return s3_chunk_nomem(t);
+
+    s3_error_code_t code = S3_E_OK;
+    uint64_t base = 0; /* смещение buf[0] в файле */
+    size_t pos = 0;
+    size_t end = 0;
+    bool eof = false;
+
+    for (;;) {
+        /* Перед резом в буфере должно быть max байт или весь хвост. */
+        if (!eof && end - pos < cdc.max) {
+            memmove(buf, buf + pos, end - pos);
+            base += pos;
+            end -= pos;
+            pos = 0;
+            while (!eof && end < cap) {
+                ssize_t n = pread(t->fd, buf + end, cap - end,
+                                  (off_t)(base + end));
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n < 0) {
+                    s3_error_set(&t->err, S3_E_IO,
+                                 "read failed in chunk_put", errno, 0, 0);
+                    code = t->err.code;
+                    goto out;
+                }
+                if (n == 0)
+                    eof = true;
+                end += (size_t)n;
+            }
+        }
+        if (pos == end)
+            break;
+
+        size_t len = s3_cdc_cut(&cdc, buf + pos, end - pos);
+        if ((code = s3_chunk_append(t, base + pos, len)) != S3_E_OK)
+            goto out;
+        EVP_Digest(buf + pos, len, t->chunks[t->count - 1].sha, NULL,
+                   EVP_sha256(), NULL);
+        pos += len;
+    }
+    t->size = base + end;
+
+out:
+    free(buf);
+    return code;
+}
+
+static int
+s3_chunk_sha_cmp(const void *a, const void *b)
+{
+    const struct s3_chunk *x = *(const struct s3_chunk *const *)a;
+    const struct s3_chunk *y = *(const struct s3_chunk *const *)b;
+    return memcmp(x->sha, y->sha, S3_CHUNK_SHA_LEN);
+}
+
+/* Повторы внутри файла: загружать только первый из одинаковых. */
+static s3_error_code_t
+s3_chunk_dedup_local(struct s3_chunk_task *t)
+{
+    struct s3_chunk **idx = s3_alloc(&t->client->alloc,
+                                     t->count * sizeof(*idx));
+    if (idx == NULL)
+        return s3_chunk_nomem(t);
+    for (size_t i = 0; i < t->count; i++)
+        idx[i] = &t->chunks[i];
+    qsort(idx, t->count, sizeof(*idx), s3_chunk_sha_cmp);
+
+    for (size_t i = 0; i < t->count; i++)
+        idx[i]->transfer = i == 0 || s3_chunk_sha_cmp(&idx[i - 1], &idx[i]);
+    s3_free(&t->client->alloc, idx);
+    return S3_E_OK;
+}
+
+/* HEAD пачками: что уже лежит в bucket'е, не грузить. */
+static s3_error_code_t
+s3_chunk_dedup_remote(struct s3_chunk_task *t)
+{
+    uint32_t conc = t->opts.concurrency;
+    size_t *batch = s3_alloc(&t->client->alloc, conc * sizeof(*batch));
+    if (batch == NULL)
+        return s3_chunk_nomem(t);
+
+    s3_error_code_t code = S3_E_OK;
+    for (size_t i = 0; i < t->count && code == S3_E_OK; ) {
+        size_t n = 0;
+        for (; n < conc && i < t->count; i++) {
+            if (!t->chunks[i].transfer)
+                continue;
+            s3_chunk_key(t, &t->chunks[i], t->keys[n]);
+            code = s3_easy_factory_new_head_object(t->client, t->opts.bucket,
+                                                   t->keys[n],
+                                                   &t->handles[n], &t->err);
+            if (code != S3_E_OK)
+                break;
+            batch[n++] = i;
+        }
+        if (code != S3_E_OK) {
+            s3_chunk_destroy_handles(t, n);
+            break;
+        }
+        if (n == 0)
+            continue;
+
+        /*
+         * Ошибки не страшны: такой кусок просто загрузится. Объект
+         * засчитывается, только если S3 хранит для него тот же sha256
+         * (x-amz-checksum-sha256 при загрузке) — ключа и размера мало.
+         */
+        s3_chunk_perform(t, n, false);
+        for (size_t k = 0; k < n; k++) {
+            struct s3_chunk *ch = &t->chunks[batch[k]];
+            curl_off_t len = -1;
+            char b64[48];
+            if (t->codes[k] != S3_E_OK)
+                continue;
+            curl_easy_getinfo(t->handles[k]->easy,
+                              CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &len);
+            s3_chunk_b64(ch, b64, sizeof(b64));
+            if (len == (curl_off_t)ch->len && b64[0] != '\0' &&
+                strcmp(t->handles[k]->checksum_sha256, b64) == 0)
+                ch->transfer = false;
+        }
+        s3_chunk_destroy_handles(t, n);
+    }
+
+    if (code == S3_E_OK)
+        s3_error_clear(&t->err);
+    s3_free(&t->client->alloc, batch);
+    return code;
+}
+
+static s3_error_code_t
+s3_chunk_upload(struct s3_chunk_task *t)
+{
+    uint32_t conc = t->opts.concurrency;
+    s3_error_code_t code = S3_E_OK;
+
+    for (size_t i = 0; i < t->count && code == S3_E_OK; ) {
+        size_t n = 0;
+        uint64_t bytes = 0;
+        for (; n < conc && i < t->count; i++) {
+            struct s3_chunk *ch = &t->chunks[i];
+            if (!ch->transfer)
+                continue;
+
+            /*
+             * Тело читается из fd заново уже после хеширования: S3
+             * сверит его с sha256 из split'а и отвергнет, если файл
+             * успел измениться.
+             */
+            char b64[48];
+            s3_chunk_b64(ch, b64, sizeof(b64));
+
+            s3_put_opts_t popts;
+            memset(&popts, 0, sizeof(popts));
+            popts.bucket = t->opts.bucket;
+            popts.key = t->keys[n];
+            popts.checksum_sha256 = b64;
+            s3_chunk_key(t, ch, t->keys[n]);
+
+            code = s3_easy_factory_new_put_fd(t->client, &popts, t->fd,
+                                              (off_t)ch->offset, ch->len,
+                                              &t->handles[n], &t->err);
+            if (code != S3_E_OK)
+                break;
+            bytes += ch->len;
+            n++;
+        }
+        if (code == S3_E_OK && n > 0) {
+            code = s3_chunk_perform(t, n, true);
+            if (code == S3_E_OK) {
+                t->result.transferred += n;
+                t->result.bytes_transferred += bytes;
+            }
+        }
+        s3_chunk_destroy_handles(t, n);
+    }
+    return code;
+}
+
+/*
+ * {"version":1,"size":N,"avg_chunk":N,"chunks":[
+ * {"sha256":"...","size":N},
+ * ...
+ * ]}
+ * Смещения — сумма размеров предыдущих кусков.
+ */
+static s3_error_code_t
+s3_chunk_write_manifest(struct s3_chunk_task *t)
+{
+    s3_client_t *c = t->client;
+    s3_error_t *err = &t->err;
+    s3_mem_buf_t b = { NULL, 0, 0 };
+    char line[160];
+
+    snprintf(line, sizeof(line),
+             "{\"version\":1,\"size\":%" PRIu64 ",\"avg_chunk\":%zu,"
+             "\"chunks\":[\n", t->size, t->opts.avg_chunk);
+    s3_error_code_t code = s3_mem_buf_append(c, &b, line, strlen(line), err);
+
+    for (size_t i = 0; i < t->count && code == S3_E_OK; i++) {
+        char hex[2 * S3_CHUNK_SHA_LEN + 1];
+        s3_chunk_hex(t->chunks[i].sha, hex);
+        snprintf(line, sizeof(line), "{\"sha256\":\"%s\",\"size\":%zu}%s\n",
+                 hex, t->chunks[i].len, i + 1 < t->count ? "," : "");
+        code = s3_mem_buf_append(c, &b, line, strlen(line), err);
+    }
+    if (code == S3_E_OK)
+        code = s3_mem_buf_append(c, &b, "]}\n", 3, err);
+
+    if (code == S3_E_OK) {
+        s3_put_opts_t popts;
+        memset(&popts, 0, sizeof(popts));
+        popts.bucket = t->opts.bucket;
+        popts.key = t->manifest_key;
+        popts.content_type = "application/json";
+
+        s3_easy_handle_t *h = NULL;
+        code = s3_easy_factory_new_put_buf(c, &popts, b.data, b.size,
+                                           &h, err);
+        if (code == S3_E_OK) {
+            struct s3_http_backend_impl *be = c->backend;
+            code = be->vtbl->perform(be, h, err);
+            s3_easy_handle_destroy(h);
+        }
+    }
+
+    if (b.data != NULL)
+        s3_free(&c->alloc, b.data);
+    return code;
+}
+
+static s3_error_code_t
+s3_chunk_put_run(struct s3_chunk_task *t)
+{
+    s3_error_code_t code;
+    if ((code = s3_chunk_split(t)) != S3_E_OK ||
+        (code = s3_chunk_dedup_local(t)) != S3_E_OK ||
+        (code = s3_chunk_dedup_remote(t)) != S3_E_OK ||
+        (code = s3_chunk_upload(t)) != S3_E_OK)
+        return code;
+
+    /* manifest — последним: до него все куски уже в bucket'е. */
+    return s3_chunk_write_manifest(t);
+}
+
+/* ----------------- get ----------------- */
+
+static s3_error_code_t
+s3_chunk_bad_manifest(struct s3_chunk_task *t)
+{
+    s3_error_set(&t->err, S3_E_INVALID_ARG, "malformed chunk manifest",
+                 0, 0, 0);
+    return t->err.code;
+}
+
+static s3_error_code_t
+s3_chunk_parse_manifest(struct s3_chunk_task *t, const char *m)
+{
+    uint64_t size = 0;
+    size_t avg = 0;
+    if (sscanf(m, "{\"version\":1,\"size\":%" SCNu64 ",\"avg_chunk\":%zu,",
+               &size, &avg) != 2)
+        return s3_chunk_bad_manifest(t);
+
+    uint64_t offset = 0;
+    static const char entry[] = "\n{\"sha256\":\"";
+    for (const char *p = m; (p = strstr(p, entry)) != NULL; ) {
+        p += sizeof(entry) - 1;
+        size_t len = 0;
+        if (strlen(p) < 2 * S3_CHUNK_SHA_LEN ||
+            sscanf(p + 2 * S3_CHUNK_SHA_LEN, "\",\"size\":%zu}", &len) != 1 ||
+            len == 0 || len > S3_CHUNK_MAX_AVG * 4)
+            return s3_chunk_bad_manifest(t);
+
+        s3_error_code_t code = s3_chunk_append(t, offset, len);
+        if (code != S3_E_OK)
+            return code;
+        if (s3_chunk_unhex(p, t->chunks[t->count - 1].sha) != 0)
+            return s3_chunk_bad_manifest(t);
+        offset += len;
+    }
+    if (offset != size)
+        return s3_chunk_bad_manifest(t);
+    t->size = size;
+    return S3_E_OK;
+}
+
+/* Перечитать скачанный кусок и сверить sha256 с его именем. */
+static bool
+s3_chunk_verify(struct s3_chunk_task *t, const struct s3_chunk *ch,
+                unsigned char *buf)
+{
+    for (size_t done = 0; done < ch->len; ) {
+        ssize_t n = pread(t->fd, buf + done, ch->len - done,
+                          (off_t)(ch->offset + done));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        done += (size_t)n;
+    }
+    unsigned char sha[S3_CHUNK_SHA_LEN];
+    EVP_Digest(buf, ch->len, sha, NULL, EVP_sha256(), NULL);
+    return memcmp(sha, ch->sha, sizeof(sha)) == 0;
+}
+
+static s3_error_code_t
+s3_chunk_download(struct s3_chunk_task *t)
+{
+    uint32_t conc = t->opts.concurrency;
+
+    if (ftruncate(t->fd, (off_t)t->size) != 0) {
+        s3_error_set(&t->err, S3_E_IO, "ftruncate failed in chunk_get",
+                     errno, 0, 0);
+        return t->err.code;
+    }
+
+    unsigned char *buf = malloc(S3_CHUNK_MAX_AVG * 4);
+    if (buf == NULL)
+        return s3_chunk_nomem(t);
+
+    s3_error_code_t code = S3_E_OK;
+    for (size_t i = 0; i < t->count && code == S3_E_OK; ) {
+        size_t n = 0;
+        for (; n < conc && i + n < t->count; n++) {
+            struct s3_chunk *ch = &t->chunks[i + n];
+            s3_chunk_key(t, ch, t->keys[n]);
+
+            s3_get_opts_t gopts;
+            memset(&gopts, 0, sizeof(gopts));
+            gopts.bucket = t->opts.bucket;
+            gopts.key = t->keys[n];
+
+            code = s3_easy_factory_new_get_fd(t->client, &gopts, t->fd,
+                                              (off_t)ch->offset, ch->len,
+                                              &t->handles[n], &t->err);
+            if (code != S3_E_OK)
+                break;
+        }
+        if (code == S3_E_OK)
+            code = s3_chunk_perform(t, n, true);
+
+        for (size_t k = 0; k < n && code == S3_E_OK; k++) {
+            struct s3_chunk *ch = &t->chunks[i + k];
+            if (t->handles[k]->write_bytes_total != ch->len ||
+                !s3_chunk_verify(t, ch, buf))
+            {
+                char msg[128 + S3_CHUNK_KEY_MAX];
+                snprintf(msg, sizeof(msg), "chunk %s is corrupted",
+                         t->keys[k]);
+                s3_error_set(&t->err, S3_E_IO, msg, 0, 0, 0);
+                code = t->err.code;
+                break;
+            }
+            t->result.transferred++;
+            t->result.bytes_transferred += ch->len;
+        }
+        s3_chunk_destroy_handles(t, n);
+        i += n;
+    }
+
+    free(buf);
+    return code;
+}
+
+static s3_error_code_t
+s3_chunk_get_run(struct s3_chunk_task *t)
+{
+    char *manifest = NULL;
+    s3_error_code_t code = s3_fetch_object(t->client, t->opts.bucket,
+                                           t->manifest_key, &manifest, NULL,
+                                           &t->err);
+    if (code != S3_E_OK)
+        return code;
+
+    code = s3_chunk_parse_manifest(t, manifest);
+    s3_free(&t->client->alloc, manifest);
+    if (code != S3_E_OK)
+        return code;
+    return s3_chunk_download(t);
+}
+
+/* ----------------- API ----------------- */
+
+static double
+s3_chunk_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static ssize_t
+s3_client_chunk_worker(va_list ap)
+{
+    struct s3_chunk_task *t = va_arg(ap, struct s3_chunk_task *);
+    s3_error_code_t (*run)(struct s3_chunk_task *) =
+        va_arg(ap, s3_error_code_t (*)(struct s3_chunk_task *));
+    s3_client_t *c = t->client;
+    uint32_t conc = t->opts.concurrency;
+    double start = s3_chunk_now();
+
+    t->handles = s3_alloc(&c->alloc, conc * sizeof(*t->handles));
+    t->codes = s3_alloc(&c->alloc, conc * sizeof(*t->codes));
+    t->errs = s3_alloc(&c->alloc, conc * sizeof(*t->errs));
+    t->keys = s3_alloc(&c->alloc, conc * sizeof(*t->keys));
+    if (t->handles == NULL || t->codes == NULL || t->errs == NULL ||
+        t->keys == NULL)
+        t->code = s3_chunk_nomem(t);
+    else
+        t->code = run(t);
+
+    t->result.chunks = t->count;
+    t->result.bytes = t->size;
+    t->result.elapsed = s3_chunk_now() - start;
+
+    if (t->keys != NULL)
+        s3_free(&c->alloc, t->keys);
+    if (t->errs != NULL)
+        s3_free(&c->alloc, t->errs);
+    if (t->codes != NULL)
+        s3_free(&c->alloc, t->codes);
+    if (t->handles != NULL)
+        s3_free(&c->alloc, t->handles);
+    if (t->chunks != NULL)
+        s3_free(&c->alloc, t->chunks);
+    return 0;
+}
+
+static s3_error_code_t
+s3_client_chunk_call(s3_client_t *client, const s3_chunk_opts_t *opts,
+                     const char *manifest_key, int fd,
+                     s3_error_code_t (*run)(struct s3_chunk_task *),
+                     s3_chunk_result_t *result, s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (client == NULL || manifest_key == NULL || fd < 0) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, manifest_key or fd is invalid in chunk store",
+                     0, 0, 0);
+        if (client != NULL)
+            s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    struct s3_chunk_task task;
+    memset(&task, 0, sizeof(task));
+    task.client = client;
+    if (opts != NULL)
+        task.opts = *opts;
+    task.manifest_key = manifest_key;
+    task.fd = fd;
+    if (task.opts.chunk_prefix == NULL)
+        task.opts.chunk_prefix = S3_CHUNK_DEFAULT_PREFIX;
+    if (task.opts.avg_chunk == 0)
+        task.opts.avg_chunk = S3_CHUNK_DEFAULT_AVG;
+    if (task.opts.concurrency == 0)
+        task.opts.concurrency = S3_CHUNK_DEFAULT_CONCURRENCY;
+
+    size_t avg = task.opts.avg_chunk;
+    if (avg < S3_CHUNK_MIN_AVG || avg > S3_CHUNK_MAX_AVG ||
+        (avg & (avg - 1)) != 0 ||
+        task.opts.concurrency > S3_CHUNK_MAX_CONCURRENCY ||
+        strlen(task.opts.chunk_prefix) + 2 * S3_CHUNK_SHA_LEN >=
+        S3_CHUNK_KEY_MAX)
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "avg_chunk must be a power of two in [64 KiB, 8 MiB], "
+                     "concurrency <= 64 in chunk store", 0, 0, 0);
+        s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    s3_error_clear(&task.err);
+    task.code = S3_E_OK;
+
+    coio_call(s3_client_chunk_worker, &task, run);
+
+    if (result != NULL)
+        *result = task.result;
+
+    *err = task.err;
+    s3_client_set_error(client, &task.err);
+    return task.code;
+}
+
+s3_error_code_t
+s3_client_chunk_put(s3_client_t *client,
+                    const s3_chunk_opts_t *opts,
+                    const char *manifest_key,
+                    int fd,
+                    s3_chunk_result_t *result,
+                    s3_error_t *error)
+{
+    return s3_client_chunk_call(client, opts, manifest_key, fd,
+                                s3_chunk_put_run, result, error);
+}
+
+s3_error_code_t
+s3_client_chunk_get(s3_client_t *client,
+                    const s3_chunk_opts_t *opts,
+                    const char *manifest_key,
+                    int fd,
+                    s3_chunk_result_t *result,
+                    s3_error_t *error)
+{
+    return s3_client_chunk_call(client, opts, manifest_key, fd,
+                                s3_chunk_get_run, result, error);
+}
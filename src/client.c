@@ -1,7 +1,14 @@
 #include "s3/client.h"
 #include "s3/alloc.h"
+#include "s3/curl_easy_factory.h"
 #include "s3_internal.h"
+#include "singleflight.h"
+#include "endpoint.h"
+#include "resolve.h"
+#include "prewarm.h"
+#include "block_cache.h"
 #include "error.h"
+#include "http/http_util.h"
 
 #include <sys/types.h>
 #include <string.h>
@@ -84,6 +91,9 @@ s3_client_init_defaults(struct s3_client *c, const s3_client_opts_t *opts)
     c->multi_idle_timeout_ms = opts->multi_idle_timeout_ms > 0 ?
                                opts->multi_idle_timeout_ms : 50;
 
+    c->max_concurrent_streams = opts->max_concurrent_streams > 0 ?
+                                opts->max_concurrent_streams : 100;
+
     c->flags = opts->flags;
     c->require_sigv4 = opts->require_sigv4;
 }
@@ -132,7 +142,9 @@ s3_client_new(const s3_client_opts_t *opts,
 
     *out_client = NULL;
 
-    if (opts->endpoint == NULL || opts->region == NULL ||
+    if ((opts->endpoint == NULL && opts->endpoints_count == 0) ||
+        (opts->endpoints_count > 0 && opts->endpoints == NULL) ||
+        opts->region == NULL ||
         opts->access_key == NULL || opts->secret_key == NULL)
     {
         s3_error_set(err, S3_E_INVALID_ARG,
@@ -158,10 +170,19 @@ s3_client_new(const s3_client_opts_t *opts,
     memset(c, 0, sizeof(*c));
     c->alloc = *a;
     c->last_error = (s3_error_t)S3_ERROR_INIT;
-
-    /* Копируем строки. */
-    c->endpoint = s3_strdup_a(&c->alloc, opts->endpoint, err);
-    if (opts->endpoint != NULL && c->endpoint == NULL)
+    rlist_create(&c->sf_calls);
+    pthread_mutex_init(&c->handle_pool_mutex, NULL);
+
+    /*
+     * Копируем строки. При списке endpoints URL строится от первого из них,
+     * а перед запросом префикс заменяется на выбранный (endpoint.c).
+     */
+    const char *endpoint = opts->endpoint;
+    if (endpoint == NULL)
+        endpoint = opts->endpoints[0];
+
+    c->endpoint = s3_strdup_a(&c->alloc, endpoint, err);
+    if (c->endpoint == NULL)
         goto fail;
 
     c->region = s3_strdup_a(&c->alloc, opts->region, err);
@@ -208,6 +229,14 @@ s3_client_new(const s3_client_opts_t *opts,
 
     s3_client_init_defaults(c, opts);
 
+    if (opts->endpoints_count > 1 &&
+        s3_endpoint_set_new(c, opts, &c->endpoints, err) != S3_E_OK)
+        goto fail;
+
+    if ((c->flags & S3_CLIENT_F_PIN_DNS) &&
+        s3_resolver_new(c, opts, &c->resolver, err) != S3_E_OK)
+        goto fail;
+
     /* Создаём backend. */
     switch (opts->backend) {
     case S3_HTTP_BACKEND_CURL_EASY:
@@ -216,6 +245,9 @@ s3_client_new(const s3_client_opts_t *opts,
     case S3_HTTP_BACKEND_CURL_MULTI:
         c->backend = s3_http_multi_backend_new(c, err);
         break;
+    case S3_HTTP_BACKEND_NATIVE:
+        c->backend = s3_http_native_backend_new(c, err);
+        break;
     default:
         s3_error_set(err, S3_E_INVALID_ARG,
                      "Unknown HTTP backend type", 0, 0, 0);
@@ -226,17 +258,31 @@ s3_client_new(const s3_client_opts_t *opts,
     if (c->backend == NULL)
         goto fail;
 
+    if (opts->prewarm_connections > 0 &&
+        s3_prewarm_new(c, opts, &c->prewarm, err) != S3_E_OK)
+        goto fail;
+
+    if (opts->block_cache_bytes > 0 &&
+        s3_block_cache_new(c, opts, &c->block_cache, err) != S3_E_OK)
+        goto fail;
+
     *out_client = c;
     s3_client_set_error(c, err); /* last_error = OK */
     return S3_E_OK;
 
 fail:
     s3_client_set_error(c, err);
+    s3_block_cache_delete(c->block_cache);
+    s3_prewarm_delete(c->prewarm);
+    s3_easy_handle_pool_drain(c);
     if (c->backend != NULL && c->backend->vtbl != NULL &&
         c->backend->vtbl->destroy != NULL)
     {
         c->backend->vtbl->destroy(c->backend);
     }
+    pthread_mutex_destroy(&c->handle_pool_mutex);
+    s3_endpoint_set_delete(c->endpoints);
+    s3_resolver_delete(c->resolver);
     s3_client_free_strings(c);
     s3_free(&c->alloc, c);
     return err->code;
@@ -248,16 +294,56 @@ s3_client_delete(s3_client_t *client)
     if (client == NULL)
         return;
 
+    /* Поток прогрева пользуется backend'ом — останавливаем первым. */
+    s3_prewarm_delete(client->prewarm);
+    s3_block_cache_delete(client->block_cache);
+
+    /* Хендлы в пуле привязаны к CURLSH backend'а — до его удаления. */
+    s3_easy_handle_pool_drain(client);
+
     if (client->backend != NULL && client->backend->vtbl != NULL &&
         client->backend->vtbl->destroy != NULL)
     {
         client->backend->vtbl->destroy(client->backend);
     }
 
+    pthread_mutex_destroy(&client->handle_pool_mutex);
+    s3_endpoint_set_delete(client->endpoints);
+    s3_resolver_delete(client->resolver);
     s3_client_free_strings(client);
     s3_free(&client->alloc, client);
 }
 
+size_t
+s3_client_endpoints(const s3_client_t *client,
+                    s3_endpoint_info_t *out, size_t cap)
+{
+    if (client == NULL || client->endpoints == NULL)
+        return 0;
+    return s3_endpoint_set_info(client->endpoints, out, cap);
+}
+
+void
+s3_client_stats(const s3_client_t *client, s3_client_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (client == NULL)
+        return;
+
+    out->requests = __atomic_load_n(&client->stat_requests,
+                                    __ATOMIC_RELAXED);
+    out->connections = __atomic_load_n(&client->stat_connections,
+                                       __ATOMIC_RELAXED);
+    out->http2_requests = __atomic_load_n(&client->stat_http2_requests,
+                                          __ATOMIC_RELAXED);
+    if (out->connections > 0)
+        out->requests_per_connection =
+            (double)out->requests / (double)out->connections;
+    if (client->block_cache != NULL)
+        s3_block_cache_stats(client->block_cache, &out->block_cache_hits,
+                             &out->block_cache_misses);
+}
+
 /* ----------------- API ----------------- */
 
 struct s3_put_task {
@@ -343,6 +429,32 @@ s3_client_get_fd_worker(va_list ap)
     return 0;
 }
 
+s3_error_code_t
+s3_client_get_fd_direct(s3_client_t *client,
+                        const s3_get_opts_t *opts,
+                        int fd, off_t offset, size_t max_size,
+                        size_t *bytes_written,
+                        s3_error_t *err)
+{
+    struct s3_get_task task;
+    memset(&task, 0, sizeof(task));
+    task.client = client;
+    task.opts = *opts;
+    task.fd = fd;
+    task.offset = offset;
+    task.max_size = max_size;
+    s3_error_clear(&task.err);
+    task.code = S3_E_OK;
+
+    coio_call(s3_client_get_fd_worker, &task);
+
+    if (bytes_written != NULL)
+        *bytes_written = task.bytes_written;
+
+    *err = task.err;
+    return task.code;
+}
+
 s3_error_code_t
 s3_client_get_fd(s3_client_t *client,
                  const s3_get_opts_t *opts,
@@ -362,17 +474,296 @@ s3_client_get_fd(s3_client_t *client,
         return err->code;
     }
 
-    struct s3_get_task task;
+    s3_error_code_t code;
+    if ((client->flags & S3_CLIENT_F_COALESCE_GETS) &&
+        !(opts->flags & S3_GET_F_NO_COALESCE))
+    {
+        code = s3_singleflight_get_fd(client, opts, fd, offset, max_size,
+                                      bytes_written, err);
+    } else {
+        code = s3_client_get_fd_direct(client, opts, fd, offset, max_size,
+                                       bytes_written, err);
+    }
+
+    s3_client_set_error(client, err);
+    return code;
+}
+
+struct s3_put_buf_task {
+    s3_client_t *client;
+    s3_put_opts_t opts;
+    const void *data;
+    size_t size;
+
+    s3_error_t err;
+    s3_error_code_t code;
+};
+
+static ssize_t
+s3_client_put_buf_worker(va_list ap)
+{
+    struct s3_put_buf_task *t = va_arg(ap, struct s3_put_buf_task *);
+    struct s3_http_backend_impl *b = t->client->backend;
+
+    s3_easy_handle_t *h = NULL;
+    t->code = s3_easy_factory_new_put_buf(t->client, &t->opts,
+                                          t->data, t->size, &h, &t->err);
+    if (t->code != S3_E_OK)
+        return 0;
+
+    t->code = b->vtbl->perform(b, h, &t->err);
+    s3_easy_handle_destroy(h);
+    return 0;
+}
+
+s3_error_code_t
+s3_client_put_buf(s3_client_t *client,
+                  const s3_put_opts_t *opts,
+                  const void *data, size_t size,
+                  s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (client == NULL || opts == NULL || (data == NULL && size != 0)) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts or data is NULL in put_buf", 0, 0, 0);
+        if (client != NULL)
+            s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    struct s3_put_buf_task task;
+    memset(&task, 0, sizeof(task));
+    task.client = client;
+    task.opts = *opts;
+    task.data = data;
+    task.size = size;
+    s3_error_clear(&task.err);
+    task.code = S3_E_OK;
+
+    coio_call(s3_client_put_buf_worker, &task);
+
+    *err = task.err;
+    s3_client_set_error(client, &task.err);
+    return task.code;
+}
+
+struct s3_get_buf_task {
+    s3_client_t *client;
+    s3_get_opts_t opts;
+    void *buf;
+    size_t cap;
+    size_t bytes_read;
+    uint64_t object_size;
+
+    s3_error_t err;
+    s3_error_code_t code;
+};
+
+static ssize_t
+s3_client_get_buf_worker(va_list ap)
+{
+    struct s3_get_buf_task *t = va_arg(ap, struct s3_get_buf_task *);
+    struct s3_http_backend_impl *b = t->client->backend;
+
+    s3_easy_handle_t *h = NULL;
+    t->code = s3_easy_factory_new_get_buf(t->client, &t->opts,
+                                          t->buf, t->cap, &h, &t->err);
+    if (t->code != S3_E_OK)
+        return 0;
+
+    t->code = b->vtbl->perform(b, h, &t->err);
+    t->bytes_read = h->write_bytes_total;
+    t->object_size = h->object_size;
+    s3_easy_handle_destroy(h);
+    return 0;
+}
+
+s3_error_code_t
+s3_client_get_buf(s3_client_t *client,
+                  const s3_get_opts_t *opts,
+                  void *buf, size_t cap,
+                  size_t *bytes_read,
+                  s3_error_t *error)
+{
+    return s3_client_get_buf_sized(client, opts, buf, cap, bytes_read,
+                                   NULL, error);
+}
+
+s3_error_code_t
+s3_client_get_buf_sized(s3_client_t *client,
+                        const s3_get_opts_t *opts,
+                        void *buf, size_t cap,
+                        size_t *bytes_read, uint64_t *object_size,
+                        s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (client == NULL || opts == NULL || buf == NULL || cap == 0) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts or buf is invalid in get_buf", 0, 0, 0);
+        if (client != NULL)
+            s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    struct s3_get_buf_task task;
+    memset(&task, 0, sizeof(task));
+    task.client = client;
+    task.opts = *opts;
+    task.buf = buf;
+    task.cap = cap;
+    s3_error_clear(&task.err);
+    task.code = S3_E_OK;
+
+    coio_call(s3_client_get_buf_worker, &task);
+
+    if (bytes_read != NULL)
+        *bytes_read = task.bytes_read;
+    if (object_size != NULL)
+        *object_size = task.object_size;
+
+    *err = task.err;
+    s3_client_set_error(client, &task.err);
+    return task.code;
+}
+
+struct s3_head_task {
+    s3_client_t *client;
+    const char *bucket;
+    const char *key;
+    s3_head_info_t info;
+
+    s3_error_t err;
+    s3_error_code_t code;
+};
+
+static ssize_t
+s3_client_head_worker(va_list ap)
+{
+    struct s3_head_task *t = va_arg(ap, struct s3_head_task *);
+    struct s3_http_backend_impl *b = t->client->backend;
+
+    s3_easy_handle_t *h = NULL;
+    t->code = s3_easy_factory_new_head_object(t->client, t->bucket, t->key,
+                                              &h, &t->err);
+    if (t->code != S3_E_OK)
+        return 0;
+
+    t->code = b->vtbl->perform(b, h, &t->err);
+    if (t->code == S3_E_OK) {
+        curl_off_t len = -1;
+        curl_easy_getinfo(h->easy, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &len);
+        if (len < 0) {
+            s3_error_set(&t->err, S3_E_HTTP,
+                         "no Content-Length in HEAD response", 0, 0, 0);
+            t->code = t->err.code;
+        } else {
+            t->info.size = (uint64_t)len;
+            memcpy(t->info.etag, h->etag, sizeof(t->info.etag));
+        }
+    }
+    s3_easy_handle_destroy(h);
+    return 0;
+}
+
+s3_error_code_t
+s3_client_head(s3_client_t *client,
+               const char *bucket, const char *key,
+               s3_head_info_t *info,
+               s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (client == NULL || key == NULL || info == NULL) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, key or info is NULL in head", 0, 0, 0);
+        if (client != NULL)
+            s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    struct s3_head_task task;
+    memset(&task, 0, sizeof(task));
+    task.client = client;
+    task.bucket = bucket;
+    task.key = key;
+    s3_error_clear(&task.err);
+    task.code = S3_E_OK;
+
+    coio_call(s3_client_head_worker, &task);
+
+    if (task.code == S3_E_OK)
+        *info = task.info;
+
+    *err = task.err;
+    s3_client_set_error(client, &task.err);
+    return task.code;
+}
+
+struct s3_get_stream_task {
+    s3_client_t *client;
+    s3_get_opts_t opts;
+    int fd;
+    size_t bytes_written;
+
+    s3_error_t err;
+    s3_error_code_t code;
+};
+
+static ssize_t
+s3_client_get_stream_worker(va_list ap)
+{
+    struct s3_get_stream_task *t = va_arg(ap, struct s3_get_stream_task *);
+
+    s3_easy_handle_t *h = NULL;
+    t->code = s3_easy_factory_new_get_stream(t->client, &t->opts, t->fd,
+                                             &h, &t->err);
+    if (t->code != S3_E_OK)
+        return 0;
+
+    /* Мимо backend'а: паузы не должны занимать общий multi-поток. */
+    t->code = s3_endpoint_perform(t->client, h, s3_http_stream_perform,
+                                  NULL, &t->err);
+    t->bytes_written = h->write_bytes_total;
+    s3_easy_handle_destroy(h);
+    return 0;
+}
+
+s3_error_code_t
+s3_client_get_stream(s3_client_t *client,
+                     const s3_get_opts_t *opts,
+                     int fd,
+                     size_t *bytes_written,
+                     s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (client == NULL || opts == NULL || fd < 0) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts or fd is invalid in get_stream", 0, 0, 0);
+        if (client != NULL)
+            s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    struct s3_get_stream_task task;
     memset(&task, 0, sizeof(task));
     task.client = client;
     task.opts = *opts;
     task.fd = fd;
-    task.offset = offset;
-    task.max_size = max_size;
     s3_error_clear(&task.err);
     task.code = S3_E_OK;
 
-    coio_call(s3_client_get_fd_worker, &task);
+    coio_call(s3_client_get_stream_worker, &task);
 
     if (bytes_written != NULL)
         *bytes_written = task.bytes_written;
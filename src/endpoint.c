@@ -0,0 +1,505 @@
+#include "endpoint.h"
+#include "resolve.h"
+#include "s3/curl_easy_factory.h"
+#include "error.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <tarantool/module.h>
+
+#define S3_ENDPOINT_DEFAULT_EJECT_ERRORS     3
+#define S3_ENDPOINT_DEFAULT_PROBE_INTERVAL   2000
+#define S3_ENDPOINT_DEFAULT_MAX_ATTEMPTS     3
+
+/* Вес нового замера в EWMA. */
+#define S3_ENDPOINT_EWMA_ALPHA 0.2
+
+struct s3_endpoint {
+    char *url;      /* без завершающего '/' */
+    size_t url_len;
+
+    /* Всё ниже — под set->mutex. */
+    double ewma_us;          /* 0 — ещё нет замеров */
+    uint32_t inflight;
+    uint32_t consecutive_errors;
+    uint64_t requests;
+    uint64_t errors;
+    bool ejected;
+};
+
+struct s3_endpoint_set {
+    struct s3_client *client;
+
+    struct s3_endpoint *eps;
+    size_t count;
+
+    /* Длина префикса client->endpoint в URL, который строит фабрика. */
+    size_t base_len;
+
+    uint32_t eject_errors;
+    uint32_t probe_interval_ms;
+    uint32_t max_attempts;
+
+    pthread_mutex_t mutex;
+    uint64_t rnd; /* xorshift, под mutex */
+
+    /* Поток проверки исключённых endpoint'ов. */
+    pthread_t probe_thread;
+    pthread_cond_t probe_cond;
+    bool probe_started;
+    bool stop;
+};
+
+static uint64_t
+s3_endpoint_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static size_t
+s3_endpoint_trim_len(const char *url)
+{
+    size_t len = strlen(url);
+    if (len > 0 && url[len - 1] == '/')
+        len--;
+    return len;
+}
+
+/* ----------------- выбор endpoint'а ----------------- */
+
+static uint64_t
+s3_endpoint_rand_locked(struct s3_endpoint_set *set)
+{
+    uint64_t x = set->rnd;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    set->rnd = x;
+    return x;
+}
+
+/* Чем меньше, тем лучше. */
+static double
+s3_endpoint_score(const struct s3_endpoint *ep)
+{
+    return (ep->ewma_us + 1.0) * (double)(ep->inflight + 1);
+}
+
+static bool
+s3_endpoint_tried(uint64_t tried, size_t i)
+{
+    return i < 64 && (tried & (1ull << i)) != 0;
+}
+
+/*
+ * Power of two choices среди кандидатов: не пробованных и не исключённых.
+ * Если таких нет — среди не пробованных, затем среди всех.
+ */
+static size_t
+s3_endpoint_pick_locked(struct s3_endpoint_set *set, uint64_t tried)
+{
+    size_t cand[64];
+
+    for (int pass = 0; pass < 3; pass++) {
+        size_t n = 0;
+        for (size_t i = 0; i < set->count && n < 64; i++) {
+            const struct s3_endpoint *ep = &set->eps[i];
+            if (pass < 2 && s3_endpoint_tried(tried, i))
+                continue;
+            if (pass == 0 && ep->ejected)
+                continue;
+            cand[n++] = i;
+        }
+
+        if (n == 0)
+            continue;
+        if (n == 1)
+            return cand[0];
+
+        size_t a = cand[s3_endpoint_rand_locked(set) % n];
+        size_t b = cand[s3_endpoint_rand_locked(set) % (n - 1)];
+        if (b == a)
+            b = cand[n - 1];
+
+        return s3_endpoint_score(&set->eps[a]) <=
+               s3_endpoint_score(&set->eps[b]) ? a : b;
+    }
+
+    return 0;
+}
+
+/*
+ * Переписать URL хендла на endpoint ep: ep->url + хвост h->url.
+ */
+static void
+s3_endpoint_apply_url(struct s3_endpoint_set *set, struct s3_endpoint *ep,
+                      s3_easy_handle_t *h)
+{
+    if (h->url == NULL || strlen(h->url) < set->base_len)
+        return;
+
+    const char *tail = h->url + set->base_len;
+    size_t tail_len = strlen(tail);
+
+    char stack_buf[1024];
+    char *url = stack_buf;
+    size_t need = ep->url_len + tail_len + 1;
+    if (need > sizeof(stack_buf)) {
+        url = (char *)s3_alloc(&set->client->alloc, need);
+        if (url == NULL)
+            return; /* остаёмся на исходном endpoint'е */
+    }
+
+    memcpy(url, ep->url, ep->url_len);
+    memcpy(url + ep->url_len, tail, tail_len + 1);
+
+    /* CURLOPT_URL копирует строку. */
+    curl_easy_setopt(h->easy, CURLOPT_URL, url);
+
+    if (url != stack_buf)
+        s3_free(&set->client->alloc, url);
+}
+
+static void
+s3_endpoint_begin_tried(struct s3_client *client, s3_easy_handle_t *h,
+                        uint64_t tried, size_t *picked)
+{
+    struct s3_endpoint_set *set = client->endpoints;
+
+    pthread_mutex_lock(&set->mutex);
+    size_t i = s3_endpoint_pick_locked(set, tried);
+    struct s3_endpoint *ep = &set->eps[i];
+    ep->inflight++;
+    ep->requests++;
+    pthread_mutex_unlock(&set->mutex);
+
+    s3_endpoint_apply_url(set, ep, h);
+    s3_resolver_apply(client->resolver, h, ep->url);
+
+    h->ep = ep;
+    h->ep_start_us = s3_endpoint_now_us();
+    if (picked != NULL)
+        *picked = i;
+}
+
+void
+s3_endpoint_begin(struct s3_client *client, s3_easy_handle_t *h)
+{
+    if (client->endpoints == NULL) {
+        s3_resolver_apply(client->resolver, h, NULL);
+        return;
+    }
+    s3_endpoint_begin_tried(client, h, 0, NULL);
+}
+
+bool
+s3_endpoint_error_retryable(s3_error_code_t code, const s3_error_t *err)
+{
+    switch (code) {
+    case S3_E_INIT:     /* не удалось соединиться/разрезолвить */
+    case S3_E_TIMEOUT:
+    case S3_E_CURL:
+        return true;
+    case S3_E_HTTP:
+        return err != NULL && err->http_status >= 500;
+    default:
+        return false;
+    }
+}
+
+void
+s3_endpoint_end(struct s3_client *client, s3_easy_handle_t *h,
+                s3_error_code_t code, const s3_error_t *err)
+{
+    struct s3_endpoint_set *set = client->endpoints;
+    struct s3_endpoint *ep = h->ep;
+
+    if (set == NULL || ep == NULL)
+        return;
+
+    uint64_t elapsed = s3_endpoint_now_us() - h->ep_start_us;
+    bool failed = s3_endpoint_error_retryable(code, err);
+    bool ejected_now = false;
+
+    pthread_mutex_lock(&set->mutex);
+
+    ep->inflight--;
+
+    if (failed) {
+        ep->errors++;
+        ep->consecutive_errors++;
+        if (!ep->ejected && ep->consecutive_errors >= set->eject_errors) {
+            ep->ejected = true;
+            ejected_now = true;
+            pthread_cond_signal(&set->probe_cond);
+        }
+    } else {
+        /*
+         * Латентность включает передачу тела, так что большие объекты
+         * тянут EWMA вверх у всех endpoint'ов примерно одинаково.
+         */
+        ep->consecutive_errors = 0;
+        if (ep->ewma_us == 0)
+            ep->ewma_us = (double)elapsed;
+        else
+            ep->ewma_us += S3_ENDPOINT_EWMA_ALPHA *
+                           ((double)elapsed - ep->ewma_us);
+    }
+
+    pthread_mutex_unlock(&set->mutex);
+
+    h->ep = NULL;
+
+    if (ejected_now)
+        say_warn("s3: endpoint %s ejected after %u errors",
+                 ep->url, set->eject_errors);
+}
+
+s3_error_code_t
+s3_endpoint_perform(struct s3_client *client, s3_easy_handle_t *h,
+                    s3_endpoint_perform_fn fn, void *ctx,
+                    s3_error_t *err)
+{
+    struct s3_endpoint_set *set = client->endpoints;
+    if (set == NULL) {
+        s3_resolver_apply(client->resolver, h, NULL);
+        return fn(ctx, h, err);
+    }
+
+    uint32_t attempts = set->max_attempts;
+    if (!h->idempotent)
+        attempts = 1;
+
+    uint64_t tried = 0;
+    s3_error_code_t code = S3_E_INTERNAL;
+
+    for (uint32_t attempt = 0; attempt < attempts; attempt++) {
+        size_t i = 0;
+        s3_endpoint_begin_tried(client, h, tried, &i);
+        if (i < 64)
+            tried |= 1ull << i;
+
+        code = fn(ctx, h, err);
+        s3_endpoint_end(client, h, code, err);
+
+        if (code == S3_E_OK || !s3_endpoint_error_retryable(code, err))
+            break;
+        if (attempt + 1 == attempts || s3_easy_handle_rewind(h) != 0)
+            break;
+    }
+
+    return code;
+}
+
+/* ----------------- фоновые проверки ----------------- */
+
+/*
+ * Живой ли endpoint: любой HTTP ответ (даже 403) на HEAD /.
+ */
+static bool
+s3_endpoint_probe_one(struct s3_client *client, const char *url)
+{
+    CURL *easy = curl_easy_init();
+    if (easy == NULL)
+        return false;
+
+    char buf[1024];
+    snprintf(buf, sizeof(buf), "%s/", url);
+
+    curl_easy_setopt(easy, CURLOPT_URL, buf);
+    curl_easy_setopt(easy, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS,
+                     (long)client->connect_timeout_ms);
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS,
+                     (long)client->connect_timeout_ms * 2);
+
+    if (client->ca_file != NULL)
+        curl_easy_setopt(easy, CURLOPT_CAINFO, client->ca_file);
+    if (client->ca_path != NULL)
+        curl_easy_setopt(easy, CURLOPT_CAPATH, client->ca_path);
+    if (client->flags & S3_CLIENT_F_SKIP_PEER_VERIFICATION)
+        curl_easy_setopt(easy, CURLOPT_SSL_VERIFYPEER, 0L);
+    if (client->flags & S3_CLIENT_F_SKIP_HOSTNAME_VERIF)
+        curl_easy_setopt(easy, CURLOPT_SSL_VERIFYHOST, 0L);
+
+    CURLcode cc = curl_easy_perform(easy);
+    long status = 0;
+    if (cc == CURLE_OK)
+        curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+
+    curl_easy_cleanup(easy);
+    return cc == CURLE_OK && status > 0 && status < 500;
+}
+
+static void *
+s3_endpoint_probe_main(void *arg)
+{
+    struct s3_endpoint_set *set = (struct s3_endpoint_set *)arg;
+
+    pthread_mutex_lock(&set->mutex);
+
+    while (!set->stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += set->probe_interval_ms / 1000;
+        deadline.tv_nsec += (long)(set->probe_interval_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&set->probe_cond, &set->mutex, &deadline);
+
+        for (size_t i = 0; i < set->count && !set->stop; i++) {
+            struct s3_endpoint *ep = &set->eps[i];
+            if (!ep->ejected)
+                continue;
+
+            /* url неизменен, пробуем без блокировки. */
+            pthread_mutex_unlock(&set->mutex);
+            bool alive = s3_endpoint_probe_one(set->client, ep->url);
+            pthread_mutex_lock(&set->mutex);
+
+            if (alive && ep->ejected) {
+                ep->ejected = false;
+                ep->consecutive_errors = 0;
+                say_info("s3: endpoint %s is back", ep->url);
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&set->mutex);
+    return NULL;
+}
+
+/* ----------------- создание / удаление ----------------- */
+
+s3_error_code_t
+s3_endpoint_set_new(struct s3_client *client,
+                    const s3_client_opts_t *opts,
+                    struct s3_endpoint_set **out,
+                    s3_error_t *err)
+{
+    size_t count = opts->endpoints_count;
+
+    struct s3_endpoint_set *set =
+        (struct s3_endpoint_set *)s3_alloc(&client->alloc, sizeof(*set));
+    if (set == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate endpoint set", ENOMEM, 0, 0);
+        return err->code;
+    }
+    memset(set, 0, sizeof(*set));
+    set->client = client;
+    set->base_len = s3_endpoint_trim_len(client->endpoint);
+
+    set->eject_errors = opts->endpoint_eject_errors > 0 ?
+        opts->endpoint_eject_errors : S3_ENDPOINT_DEFAULT_EJECT_ERRORS;
+    set->probe_interval_ms = opts->endpoint_probe_interval_ms > 0 ?
+        opts->endpoint_probe_interval_ms : S3_ENDPOINT_DEFAULT_PROBE_INTERVAL;
+    set->max_attempts = opts->endpoint_max_attempts > 0 ?
+        opts->endpoint_max_attempts : S3_ENDPOINT_DEFAULT_MAX_ATTEMPTS;
+    if (set->max_attempts > count)
+        set->max_attempts = (uint32_t)count;
+
+    set->rnd = s3_endpoint_now_us() | 1;
+
+    set->eps = (struct s3_endpoint *)s3_alloc(&client->alloc,
+                                              count * sizeof(*set->eps));
+    if (set->eps == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate endpoints", ENOMEM, 0, 0);
+        s3_free(&client->alloc, set);
+        return err->code;
+    }
+    memset(set->eps, 0, count * sizeof(*set->eps));
+
+    pthread_mutex_init(&set->mutex, NULL);
+    pthread_cond_init(&set->probe_cond, NULL);
+
+    for (size_t i = 0; i < count; i++) {
+        const char *url = opts->endpoints[i];
+        if (url == NULL || url[0] == '\0') {
+            s3_error_set(err, S3_E_INVALID_ARG,
+                         "empty endpoint in endpoints list", 0, 0, 0);
+            goto fail;
+        }
+
+        struct s3_endpoint *ep = &set->eps[i];
+        ep->url = s3_strdup_a(&client->alloc, url, err);
+        if (ep->url == NULL)
+            goto fail;
+        ep->url_len = s3_endpoint_trim_len(ep->url);
+        ep->url[ep->url_len] = '\0';
+        set->count++;
+    }
+
+    int rc = pthread_create(&set->probe_thread, NULL,
+                            s3_endpoint_probe_main, set);
+    if (rc != 0) {
+        s3_error_set(err, S3_E_INIT,
+                     "pthread_create failed for endpoint probes", rc, 0, 0);
+        goto fail;
+    }
+    set->probe_started = true;
+
+    *out = set;
+    return S3_E_OK;
+
+fail:
+    s3_endpoint_set_delete(set);
+    return err->code;
+}
+
+void
+s3_endpoint_set_delete(struct s3_endpoint_set *set)
+{
+    if (set == NULL)
+        return;
+
+    s3_client_t *c = set->client;
+
+    if (set->probe_started) {
+        pthread_mutex_lock(&set->mutex);
+        set->stop = true;
+        pthread_cond_signal(&set->probe_cond);
+        pthread_mutex_unlock(&set->mutex);
+        pthread_join(set->probe_thread, NULL);
+    }
+
+    pthread_cond_destroy(&set->probe_cond);
+    pthread_mutex_destroy(&set->mutex);
+
+    for (size_t i = 0; i < set->count; i++)
+        s3_free(&c->alloc, set->eps[i].url);
+    s3_free(&c->alloc, set->eps);
+    s3_free(&c->alloc, set);
+}
+
+size_t
+s3_endpoint_set_info(struct s3_endpoint_set *set,
+                     s3_endpoint_info_t *out, size_t cap)
+{
+    pthread_mutex_lock(&set->mutex);
+
+    size_t n = set->count < cap ? set->count : cap;
+    for (size_t i = 0; i < n; i++) {
+        const struct s3_endpoint *ep = &set->eps[i];
+        out[i].url = ep->url;
+        out[i].ewma_latency_ms = ep->ewma_us / 1000.0;
+        out[i].inflight = ep->inflight;
+        out[i].requests = ep->requests;
+        out[i].errors = ep->errors;
+        out[i].ejected = ep->ejected;
+    }
+
+    size_t total = set->count;
+    pthread_mutex_unlock(&set->mutex);
+    return total;
+}
@@ -0,0 +1,76 @@
+#ifndef TARANTOOL_S3_ENDPOINT_H_INCLUDED
+#define TARANTOOL_S3_ENDPOINT_H_INCLUDED 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "s3_internal.h"
+
+/*
+ * Несколько endpoint'ов одного кластера (s3_client_opts_t.endpoints).
+ *
+ * URL запроса всегда строится от client->endpoint; перед выполнением
+ * префикс заменяется на выбранный endpoint. Выбор — power of two choices
+ * по EWMA латентности с поправкой на число запросов в полёте.
+ *
+ * Endpoint, на котором подряд случилось endpoint_eject_errors сетевых
+ * ошибок/5xx, исключается из выбора; фоновый поток раз в
+ * endpoint_probe_interval_ms шлёт ему HEAD и возвращает, как только тот
+ * ответит. Если исключены все — выбираем среди всех (fail-open).
+ *
+ * Все функции потокобезопасны: вызываются из coio-воркеров и multi-потока.
+ */
+
+struct s3_endpoint_set;
+struct s3_endpoint;
+
+s3_error_code_t
+s3_endpoint_set_new(struct s3_client *client,
+                    const s3_client_opts_t *opts,
+                    struct s3_endpoint_set **out,
+                    s3_error_t *err);
+
+void
+s3_endpoint_set_delete(struct s3_endpoint_set *set);
+
+/*
+ * Выбрать endpoint для хендла и переписать его URL, закрепить адрес
+ * (S3_CLIENT_F_PIN_DNS). Без client->endpoints — только адрес.
+ */
+void
+s3_endpoint_begin(struct s3_client *client, struct s3_easy_handle *h);
+
+/*
+ * Учесть результат запроса, начатого s3_endpoint_begin.
+ */
+void
+s3_endpoint_end(struct s3_client *client, struct s3_easy_handle *h,
+                s3_error_code_t code, const s3_error_t *err);
+
+/*
+ * Ошибка, после которой имеет смысл повторить запрос на другом
+ * endpoint'е: сеть, таймаут, 5xx.
+ */
+bool
+s3_endpoint_error_retryable(s3_error_code_t code, const s3_error_t *err);
+
+typedef s3_error_code_t
+(*s3_endpoint_perform_fn)(void *ctx, struct s3_easy_handle *h,
+                          s3_error_t *err);
+
+/*
+ * Выполнить хендл через fn с выбором endpoint'а и повтором
+ * идемпотентных запросов на другом endpoint'е.
+ * Без client->endpoints — просто вызывает fn.
+ */
+s3_error_code_t
+s3_endpoint_perform(struct s3_client *client, struct s3_easy_handle *h,
+                    s3_endpoint_perform_fn fn, void *ctx,
+                    s3_error_t *err);
+
+/* Снимок состояния для s3_client_endpoints. */
+size_t
+s3_endpoint_set_info(struct s3_endpoint_set *set,
+                     s3_endpoint_info_t *out, size_t cap);
+
+#endif /* TARANTOOL_S3_ENDPOINT_H_INCLUDED */
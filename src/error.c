@@ -1,5 +1,7 @@
 #include "error.h"
 
+#include <stdio.h>
+
 void
 s3_error_clear(s3_error_t *err)
 {
@@ -132,3 +134,38 @@ s3_http_map_http_status(long status)
         return S3_E_TIMEOUT;
     return S3_E_HTTP;
 }
+
+s3_error_code_t
+s3_http_map_result(CURL *easy, CURLcode cc, s3_error_t *err)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    if (err == NULL)
+        err = &local_err;
+
+    if (cc != CURLE_OK) {
+        s3_error_set(err, s3_http_map_curl_error(cc),
+                     curl_easy_strerror(cc), 0, 0, (long)cc);
+        return err->code;
+    }
+
+    long http_status = 0;
+    if (curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE,
+                          &http_status) != CURLE_OK)
+    {
+        s3_error_set(err, S3_E_INTERNAL,
+                     "Failed to get HTTP response code", 0, 0, 0);
+        return err->code;
+    }
+
+    s3_error_code_t code = s3_http_map_http_status(http_status);
+    if (code != S3_E_OK) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "HTTP status %ld", http_status);
+        s3_error_set(err, code, msg, 0, (int)http_status, 0);
+        return code;
+    }
+
+    s3_error_clear(err);
+    err->http_status = (int)http_status;
+    return S3_E_OK;
+}
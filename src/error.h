@@ -23,4 +23,11 @@ s3_http_map_curl_error(CURLcode cc);
 s3_error_code_t
 s3_http_map_http_status(long status);
 
+/*
+ * Итог завершившегося easy: результат curl + HTTP статус.
+ * Заполняет err (если не NULL) и возвращает код.
+ */
+s3_error_code_t
+s3_http_map_result(CURL *easy, CURLcode cc, s3_error_t *err);
+
 #endif /* TARANTOOL_S3_CURL_EASY_FACTORY_H_INCLUDED */
\ No newline at end of file
@@ -0,0 +1,449 @@
+#include "s3_internal.h"
+#include "multipart.h"
+#include "s3/curl_easy_factory.h"
+#include "http/http_util.h"
+#include "error.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tarantool/module.h>
+
+#define S3_FANOUT_DEFAULT_PART_SIZE   (8u * 1024 * 1024)
+#define S3_FANOUT_DEFAULT_CONCURRENCY 2
+#define S3_FANOUT_MAX_CONCURRENCY     64
+
+/* Состояние одного места назначения. */
+struct s3_fanout_slot {
+    s3_client_t *client;
+    s3_put_opts_t opts;
+    struct s3_mpu mpu;
+    bool alive;
+};
+
+/* Чей хендл в пачке s3_fanout_wave и какой это номер части. */
+struct s3_fanout_part {
+    size_t dest;
+    uint32_t number;
+};
+
+struct s3_put_fanout_task {
+    s3_client_t *client;
+    s3_put_fanout_opts_t opts;
+    int fd;
+    off_t offset;
+    size_t size;
+    s3_fanout_dest_t *dests;
+    size_t count;
+    uint32_t quorum;
+
+    struct s3_fanout_slot *slots;
+    size_t alive;
+
+    s3_error_t err;
+    s3_error_code_t code;
+};
+
+/* Место выбывает: запомнить ошибку, отменить его multipart upload. */
+static void
+s3_fanout_fail(struct s3_put_fanout_task *t, size_t i,
+               s3_error_code_t code, const s3_error_t *err)
+{
+    struct s3_fanout_slot *s = &t->slots[i];
+    if (!s->alive)
+        return;
+
+    s->alive = false;
+    t->alive--;
+    t->dests[i].code = code;
+    t->dests[i].err = *err;
+    if (t->err.code == S3_E_OK)
+        t->err = *err;
+
+    s3_mpu_abort(&s->mpu);
+
+    say_warn("s3: put_fanout dropped destination %s/%s: %s",
+             s->opts.bucket != NULL ? s->opts.bucket : "",
+             s->opts.key, s3_error_message(err));
+}
+
+static bool
+s3_fanout_quorum_lost(struct s3_put_fanout_task *t)
+{
+    if (t->alive >= t->quorum)
+        return false;
+    t->code = t->err.code != S3_E_OK ? t->err.code : S3_E_INTERNAL;
+    return true;
+}
+
+static s3_error_code_t
+s3_fanout_pread(struct s3_put_fanout_task *t, char *buf, size_t len,
+                off_t off)
+{
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = pread(t->fd, buf + got, len - got, off + (off_t)got);
+        if (n > 0) {
+            got += (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        s3_error_set(&t->err, S3_E_IO,
+                     n == 0 ? "unexpected EOF in put_fanout source"
+                            : "pread failed in put_fanout",
+                     n == 0 ? 0 : errno, 0, 0);
+        t->code = t->err.code;
+        return t->code;
+    }
+    return S3_E_OK;
+}
+
+/* Объект не больше одной части: PUT во все места одной пачкой. */
+static void
+s3_fanout_single(struct s3_put_fanout_task *t, const char *data)
+{
+    s3_easy_handle_t **handles =
+        s3_alloc(&t->client->alloc, t->count * sizeof(*handles));
+    s3_error_code_t *codes =
+        s3_alloc(&t->client->alloc, t->count * sizeof(*codes));
+    s3_error_t *errs = s3_alloc(&t->client->alloc, t->count * sizeof(*errs));
+
+    if (handles == NULL || codes == NULL || errs == NULL) {
+        s3_error_set(&t->err, S3_E_NOMEM,
+                     "Out of memory in put_fanout", ENOMEM, 0, 0);
+        t->code = t->err.code;
+        goto out;
+    }
+    memset(handles, 0, t->count * sizeof(*handles));
+
+    for (size_t i = 0; i < t->count; i++) {
+        struct s3_fanout_slot *s = &t->slots[i];
+        s3_error_t e = S3_ERROR_INIT;
+        if (s3_easy_factory_new_put_buf(s->client, &s->opts, data, t->size,
+                                        &handles[i], &e) != S3_E_OK)
+            s3_fanout_fail(t, i, e.code, &e);
+    }
+
+    /* Пачка без дырок: хендлы живых мест подряд. */
+    s3_easy_handle_t **batch = handles;
+    size_t n = 0;
+    for (size_t i = 0; i < t->count; i++) {
+        if (handles[i] != NULL)
+            batch[n++] = handles[i];
+    }
+
+    s3_error_t batch_err = S3_ERROR_INIT;
+    s3_error_code_t rc = s3_http_batch_perform(t->client, batch, n, codes,
+                                               errs, &batch_err);
+
+    for (size_t i = 0, j = 0; i < t->count; i++) {
+        if (!t->slots[i].alive)
+            continue;
+
+        s3_easy_handle_t *h = batch[j];
+        s3_error_code_t c = codes[j];
+        s3_error_t e = errs[j];
+        j++;
+
+        if (rc != S3_E_OK && c == S3_E_INTERNAL) {
+            c = rc;
+            e = batch_err;
+        }
+        /* Одна повторная попытка через backend места (с его endpoint'ами). */
+        if (c != S3_E_OK && s3_easy_handle_rewind(h) == 0) {
+            struct s3_http_backend_impl *b = t->slots[i].client->backend;
+            c = b->vtbl->perform(b, h, &e);
+        }
+        if (c != S3_E_OK)
+            s3_fanout_fail(t, i, c, &e);
+    }
+
+    for (size_t i = 0; i < n; i++)
+        s3_easy_handle_destroy(batch[i]);
+
+    s3_fanout_quorum_lost(t);
+
+out:
+    if (errs != NULL)
+        s3_free(&t->client->alloc, errs);
+    if (codes != NULL)
+        s3_free(&t->client->alloc, codes);
+    if (handles != NULL)
+        s3_free(&t->client->alloc, handles);
+}
+
+/*
+ * Отправить n частей (first, first + 1, ...) во все живые места одной
+ * пачкой. Место, у которого не прошла хотя бы одна часть, выбывает.
+ */
+static void
+s3_fanout_wave(struct s3_put_fanout_task *t, uint32_t first,
+               char *const *bufs, const size_t *sizes, size_t n)
+{
+    size_t cap = t->alive * n;
+    s3_easy_handle_t **handles =
+        s3_alloc(&t->client->alloc, cap * sizeof(*handles));
+    struct s3_fanout_part *owner =
+        s3_alloc(&t->client->alloc, cap * sizeof(*owner));
+    s3_error_code_t *codes = s3_alloc(&t->client->alloc, cap * sizeof(*codes));
+    s3_error_t *errs = s3_alloc(&t->client->alloc, cap * sizeof(*errs));
+    size_t nh = 0;
+
+    if (handles == NULL || owner == NULL || codes == NULL || errs == NULL) {
+        s3_error_set(&t->err, S3_E_NOMEM,
+                     "Out of memory in put_fanout", ENOMEM, 0, 0);
+        t->code = t->err.code;
+        goto out;
+    }
+
+    for (size_t i = 0; i < t->count; i++) {
+        struct s3_fanout_slot *s = &t->slots[i];
+        size_t start = nh;
+
+        for (size_t p = 0; p < n && s->alive; p++) {
+            s3_error_t e = S3_ERROR_INIT;
+            if (s3_mpu_part_handle(&s->mpu, first + (uint32_t)p, bufs[p],
+                                   sizes[p], &handles[nh], &e) != S3_E_OK)
+            {
+                for (size_t k = start; k < nh; k++)
+                    s3_easy_handle_destroy(handles[k]);
+                nh = start;
+                s3_fanout_fail(t, i, e.code, &e);
+                break;
+            }
+            owner[nh].dest = i;
+            owner[nh].number = first + (uint32_t)p;
+            nh++;
+        }
+    }
+
+    s3_error_t batch_err = S3_ERROR_INIT;
+    s3_error_code_t rc = s3_http_batch_perform(t->client, handles, nh, codes,
+                                               errs, &batch_err);
+
+    for (size_t k = 0; k < nh; k++) {
+        struct s3_fanout_slot *s = &t->slots[owner[k].dest];
+        if (!s->alive)
+            continue;
+
+        s3_error_code_t c = codes[k];
+        s3_error_t e = errs[k];
+        if (rc != S3_E_OK && c == S3_E_INTERNAL) {
+            c = rc;
+            e = batch_err;
+        }
+
+        c = s3_mpu_part_retry(&s->mpu, handles[k], c, &e);
+        if (c == S3_E_OK)
+            c = s3_mpu_part_done(&s->mpu, owner[k].number, handles[k], &e);
+        if (c != S3_E_OK)
+            s3_fanout_fail(t, owner[k].dest, c, &e);
+    }
+
+    s3_fanout_quorum_lost(t);
+
+out:
+    for (size_t k = 0; k < nh; k++)
+        s3_easy_handle_destroy(handles[k]);
+    if (errs != NULL)
+        s3_free(&t->client->alloc, errs);
+    if (codes != NULL)
+        s3_free(&t->client->alloc, codes);
+    if (owner != NULL)
+        s3_free(&t->client->alloc, owner);
+    if (handles != NULL)
+        s3_free(&t->client->alloc, handles);
+}
+
+static void
+s3_fanout_multipart(struct s3_put_fanout_task *t, char *const *bufs,
+                    size_t *sizes)
+{
+    for (size_t i = 0; i < t->count; i++) {
+        s3_error_t e = S3_ERROR_INIT;
+        struct s3_fanout_slot *s = &t->slots[i];
+        if (s3_mpu_begin(&s->mpu, s->client, &s->opts, &e) != S3_E_OK)
+            s3_fanout_fail(t, i, e.code, &e);
+    }
+    if (s3_fanout_quorum_lost(t))
+        return;
+
+    size_t total_parts = (t->size + t->opts.part_size - 1) / t->opts.part_size;
+    if (total_parts > S3_MPU_MAX_PARTS) {
+        s3_error_set(&t->err, S3_E_INVALID_ARG,
+                     "object exceeds 10000 parts, increase part_size",
+                     0, 0, 0);
+        t->code = t->err.code;
+        return;
+    }
+
+    size_t pos = 0;
+    uint32_t next_part = 1;
+
+    while (pos < t->size) {
+        size_t n = 0;
+        for (; n < t->opts.concurrency && pos < t->size; n++) {
+            sizes[n] = t->size - pos < t->opts.part_size ?
+                t->size - pos : t->opts.part_size;
+            if (s3_fanout_pread(t, bufs[n], sizes[n],
+                                t->offset + (off_t)pos) != S3_E_OK)
+                return;
+            pos += sizes[n];
+        }
+
+        s3_fanout_wave(t, next_part, bufs, sizes, n);
+        if (t->code != S3_E_OK)
+            return;
+        next_part += (uint32_t)n;
+    }
+
+    for (size_t i = 0; i < t->count; i++) {
+        struct s3_fanout_slot *s = &t->slots[i];
+        if (!s->alive)
+            continue;
+
+        s3_error_t e = S3_ERROR_INIT;
+        if (s3_mpu_complete(&s->mpu, &e) != S3_E_OK)
+            s3_fanout_fail(t, i, e.code, &e);
+    }
+    s3_fanout_quorum_lost(t);
+}
+
+static ssize_t
+s3_client_put_fanout_worker(va_list ap)
+{
+    struct s3_put_fanout_task *t = va_arg(ap, struct s3_put_fanout_task *);
+    s3_client_t *client = t->client;
+
+    size_t buf_size = t->size < t->opts.part_size ? t->size : t->opts.part_size;
+    uint32_t nbufs_max = t->size <= t->opts.part_size ? 1 : t->opts.concurrency;
+
+    char **bufs = s3_alloc(&client->alloc, nbufs_max * sizeof(*bufs));
+    size_t *sizes = s3_alloc(&client->alloc, nbufs_max * sizeof(*sizes));
+    uint32_t nbufs = 0;
+
+    if (bufs == NULL || sizes == NULL)
+        goto nomem;
+    for (; nbufs < nbufs_max; nbufs++) {
+        bufs[nbufs] = s3_alloc(&client->alloc, buf_size > 0 ? buf_size : 1);
+        if (bufs[nbufs] == NULL)
+            goto nomem;
+    }
+
+    if (t->size <= t->opts.part_size) {
+        if (s3_fanout_pread(t, bufs[0], t->size, t->offset) == S3_E_OK)
+            s3_fanout_single(t, bufs[0]);
+    } else {
+        s3_fanout_multipart(t, bufs, sizes);
+    }
+    goto out;
+
+nomem:
+    s3_error_set(&t->err, S3_E_NOMEM,
+                 "Out of memory for put_fanout buffers", ENOMEM, 0, 0);
+    t->code = t->err.code;
+
+out:
+    for (size_t i = 0; i < t->count; i++) {
+        struct s3_fanout_slot *s = &t->slots[i];
+        if (s->alive && t->code != S3_E_OK)
+            s3_fanout_fail(t, i, t->code, &t->err);
+        s3_mpu_destroy(&s->mpu);
+    }
+
+    for (uint32_t i = 0; i < nbufs; i++)
+        s3_free(&client->alloc, bufs[i]);
+    if (sizes != NULL)
+        s3_free(&client->alloc, sizes);
+    if (bufs != NULL)
+        s3_free(&client->alloc, bufs);
+    return 0;
+}
+
+s3_error_code_t
+s3_client_put_fanout(s3_client_t *client,
+                     const s3_put_fanout_opts_t *opts,
+                     int fd, off_t offset, size_t size,
+                     s3_fanout_dest_t *dests, size_t count,
+                     s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (client == NULL || fd < 0 || dests == NULL || count == 0) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, fd or dests is invalid in put_fanout", 0, 0, 0);
+        if (client != NULL)
+            s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    struct s3_put_fanout_task task;
+    memset(&task, 0, sizeof(task));
+    task.client = client;
+    if (opts != NULL)
+        task.opts = *opts;
+    if (task.opts.part_size == 0)
+        task.opts.part_size = S3_FANOUT_DEFAULT_PART_SIZE;
+    if (task.opts.concurrency == 0)
+        task.opts.concurrency = S3_FANOUT_DEFAULT_CONCURRENCY;
+    task.quorum = task.opts.quorum > 0 ? task.opts.quorum : (uint32_t)count;
+
+    bool keys_ok = true;
+    for (size_t i = 0; i < count; i++)
+        keys_ok = keys_ok && dests[i].key != NULL;
+
+    if (!keys_ok || task.quorum > count ||
+        task.opts.part_size < S3_MPU_MIN_PART_SIZE ||
+        task.opts.concurrency > S3_FANOUT_MAX_CONCURRENCY)
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "key is NULL, quorum > count, part_size < 5 MiB or "
+                     "concurrency > 64 in put_fanout", 0, 0, 0);
+        s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    task.slots = s3_alloc(&client->alloc, count * sizeof(*task.slots));
+    if (task.slots == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Out of memory in put_fanout", ENOMEM, 0, 0);
+        s3_client_set_error(client, err);
+        return err->code;
+    }
+    memset(task.slots, 0, count * sizeof(*task.slots));
+
+    for (size_t i = 0; i < count; i++) {
+        struct s3_fanout_slot *s = &task.slots[i];
+        s->client = dests[i].client != NULL ? dests[i].client : client;
+        s->opts.bucket = dests[i].bucket;
+        s->opts.key = dests[i].key;
+        s->opts.content_type = task.opts.content_type;
+        s->alive = true;
+
+        dests[i].code = S3_E_OK;
+        s3_error_clear(&dests[i].err);
+    }
+
+    task.fd = fd;
+    task.offset = offset;
+    task.size = size;
+    task.dests = dests;
+    task.count = count;
+    task.alive = count;
+    s3_error_clear(&task.err);
+    task.code = S3_E_OK;
+
+    coio_call(s3_client_put_fanout_worker, &task);
+
+    s3_free(&client->alloc, task.slots);
+
+    *err = task.err;
+    if (task.code == S3_E_OK)
+        s3_error_clear(err);
+    s3_client_set_error(client, err);
+    return task.code;
+}
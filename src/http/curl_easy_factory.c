@@ -6,10 +6,13 @@
 #include "error.h"
 
 #include <errno.h>
+#include <pthread.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stddef.h>
+#include <strings.h>
 
 #ifdef S3_USE_TARANTOOL_CURL
 #  pragma message(">>> using tarantool/curl.h")
@@ -61,9 +64,62 @@ s3_curl_apply_common_opts(s3_easy_handle_t *h)
     }
 
     curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+
+    /*
+     * h2 через ALPN; PIPEWAIT — дождаться, подходит ли уже открытое
+     * соединение для мультиплексирования, а не открывать новое.
+     */
+    if (c->flags & S3_CLIENT_F_HTTP2) {
+        curl_easy_setopt(easy, CURLOPT_HTTP_VERSION,
+                         (long)CURL_HTTP_VERSION_2TLS);
+        curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+    }
+
+    /* DNS и TLS-сессии общие для всех хендлов easy backend'а. */
+    if (c->share != NULL)
+        s3_http_share_attach(c->share, easy);
 }
 /* ----------------- read/write callbacks с pread/pwrite ----------------- */
 
+/*
+ * S3_IO_IOV: до len байт тела с позиции read_bytes_total, pread'ом
+ * по segs начиная с cursor. Файл короче сегмента — ошибка: тело
+ * с уже объявленным Content-Length добить нечем.
+ */
+static size_t
+s3_curl_read_iov(s3_easy_handle_t *h, char *ptr, size_t len)
+{
+    s3_easy_io_t *io = &h->read_io;
+    size_t done = 0;
+
+    while (done < len && io->u.iov.cursor < io->u.iov.count) {
+        const s3_put_seg_t *seg = &io->u.iov.segs[io->u.iov.cursor];
+        size_t in_seg = h->read_bytes_total + done - io->u.iov.cursor_start;
+        if (in_seg >= seg->len) {
+            io->u.iov.cursor_start += seg->len;
+            io->u.iov.cursor++;
+            continue;
+        }
+
+        size_t want = seg->len - in_seg;
+        if (want > len - done)
+            want = len - done;
+
+        ssize_t rc;
+        do {
+            rc = pread(seg->fd, ptr + done, want,
+                       seg->offset + (off_t)in_seg);
+        } while (rc < 0 && errno == EINTR);
+
+        if (rc <= 0)
+            return CURL_READFUNC_ABORT;
+        done += (size_t)rc;
+    }
+
+    h->read_bytes_total += done;
+    return done;
+}
+
 static size_t
 s3_curl_read_cb(char *ptr, size_t size, size_t nmemb, void *userdata)
 {
@@ -142,12 +198,140 @@ s3_curl_read_cb(char *ptr, size_t size, size_t nmemb, void *userdata)
         return to_read;
     }
 
+    case S3_IO_IOV:
+        return s3_curl_read_iov(h, ptr, max_to_read);
+
     case S3_IO_NONE:
     default:
         return 0;
     }
 }
 
+/*
+ * Записать len байт в сегмент начиная с seg_off (смещение внутри сегмента).
+ * Возвращает 0 или -1 при ошибке pwrite.
+ */
+static int
+s3_curl_scatter_put(s3_easy_scatter_seg_t *seg, size_t seg_off,
+                    const char *data, size_t len)
+{
+    if (seg->ptr != NULL) {
+        memcpy(seg->ptr + seg_off, data, len);
+        return 0;
+    }
+
+    size_t done = 0;
+    while (done < len) {
+        ssize_t rc;
+        do {
+            rc = pwrite(seg->fd, data + done, len - done,
+                        seg->fd_offset + (off_t)(seg_off + done));
+        } while (rc < 0 && errno == EINTR);
+        if (rc < 0)
+            return -1;
+        done += (size_t)rc;
+    }
+    return 0;
+}
+
+/*
+ * S3_IO_SCATTER: кусок ответа [pos, pos + len) в координатах объекта
+ * раскладываем по всем пересекающимся сегментам.
+ */
+static size_t
+s3_curl_write_scatter(s3_easy_handle_t *h, const char *ptr, size_t len)
+{
+    s3_easy_io_t *io = &h->write_io;
+
+    long status = 0;
+    curl_easy_getinfo(h->easy, CURLINFO_RESPONSE_CODE, &status);
+
+    /* 200 вместо 206: сервер отдал объект целиком. */
+    if (h->write_bytes_total == 0 && status == 200)
+        io->u.scatter.base = 0;
+
+    if (status < 200 || status >= 300) {
+        /* Тело ошибки в буферы пользователя не пишем. */
+        h->write_bytes_total += len;
+        return len;
+    }
+
+    uint64_t pos = io->u.scatter.base + h->write_bytes_total;
+    uint64_t end = pos + len;
+
+    s3_easy_scatter_seg_t *segs = io->u.scatter.segs;
+    size_t count = io->u.scatter.count;
+
+    for (size_t i = io->u.scatter.cursor; i < count; i++) {
+        s3_easy_scatter_seg_t *seg = &segs[i];
+        if (seg->offset >= end)
+            break;
+
+        uint64_t seg_end = seg->offset + seg->len;
+        uint64_t lo = seg->offset > pos ? seg->offset : pos;
+        uint64_t hi = seg_end < end ? seg_end : end;
+        if (lo >= hi)
+            continue;
+
+        if (s3_curl_scatter_put(seg, (size_t)(lo - seg->offset),
+                                ptr + (lo - pos), (size_t)(hi - lo)) != 0)
+            return 0; /* CURLE_WRITE_ERROR */
+        seg->written += (size_t)(hi - lo);
+    }
+
+    /* Сегменты, которые уже целиком позади, больше не смотрим. */
+    while (io->u.scatter.cursor < count) {
+        s3_easy_scatter_seg_t *seg = &segs[io->u.scatter.cursor];
+        if (seg->offset + seg->len > end)
+            break;
+        io->u.scatter.cursor++;
+    }
+
+    h->write_bytes_total += len;
+    return len;
+}
+
+/*
+ * S3_IO_STREAM: write() с дозаписью. Если fd заполнен (EAGAIN) —
+ * запоминаем, сколько уже ушло, и ставим передачу на паузу.
+ */
+static size_t
+s3_curl_write_stream(s3_easy_handle_t *h, const char *ptr, size_t len)
+{
+    s3_easy_io_t *io = &h->write_io;
+
+    long status = 0;
+    curl_easy_getinfo(h->easy, CURLINFO_RESPONSE_CODE, &status);
+
+    /* Тело ошибки клиенту не отдаём и не считаем. */
+    if (status < 200 || status >= 300)
+        return len;
+
+    size_t done = io->u.stream.skip;
+    if (done > len)
+        done = len;
+    io->u.stream.paused = false;
+
+    while (done < len) {
+        ssize_t rc = write(io->u.stream.fd, ptr + done, len - done);
+        if (rc < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                io->u.stream.skip = done;
+                io->u.stream.paused = true;
+                return CURL_WRITEFUNC_PAUSE;
+            }
+            return 0; /* CURLE_WRITE_ERROR */
+        }
+        done += (size_t)rc;
+        h->write_bytes_total += (size_t)rc;
+    }
+
+    io->u.stream.skip = 0;
+    return len;
+}
+
 static size_t
 s3_curl_write_cb(char *ptr, size_t size, size_t nmemb, void *userdata)
 {
@@ -158,6 +342,11 @@ s3_curl_write_cb(char *ptr, size_t size, size_t nmemb, void *userdata)
     if (buf_size == 0)
         return 0;
 
+    if (io->kind == S3_IO_SCATTER)
+        return s3_curl_write_scatter(h, ptr, buf_size);
+    if (io->kind == S3_IO_STREAM)
+        return s3_curl_write_stream(h, ptr, buf_size);
+
     /* Если вывод никуда не нужно писать — просто "проглатываем" данные. */
     if (io->kind == S3_IO_NONE) {
         h->write_bytes_total += buf_size;
@@ -212,14 +401,175 @@ s3_curl_write_cb(char *ptr, size_t size, size_t nmemb, void *userdata)
         h->write_bytes_total += to_write;
         return to_write;
     }
+    case S3_IO_CHAIN: {
+        s3_buf_chain_t *ch = io->u.chain.chain;
+        if (ch == NULL ||
+            s3_buf_chain_append(h->client, ch, ptr, to_write) != 0)
+            return 0; /* curl воспримет это как CURLE_WRITE_ERROR */
+
+        h->write_bytes_total += to_write;
+        return to_write;
+    }
+    case S3_IO_BUF: {
+        /* size_limit == ёмкость буфера, to_write уже обрезан по ней. */
+        if (io->u.buf.ptr == NULL)
+            return 0;
+
+        memcpy(io->u.buf.ptr + h->write_bytes_total, ptr, to_write);
+        h->write_bytes_total += to_write;
+        return to_write;
+    }
     case S3_IO_NONE:
     default:
         return 0;
     }
 }
 
+/* Значение заголовка name ("etag:") без пробелов и CRLF в out. */
+static bool
+s3_curl_header_value(const char *ptr, size_t len, const char *name,
+                     char *out, size_t cap)
+{
+    size_t name_len = strlen(name);
+    if (len <= name_len || strncasecmp(ptr, name, name_len) != 0)
+        return false;
+
+    const char *v = ptr + name_len;
+    const char *end = ptr + len;
+    while (v < end && (*v == ' ' || *v == '\t'))
+        v++;
+    while (end > v && (end[-1] == '\r' || end[-1] == '\n' ||
+                       end[-1] == ' '))
+        end--;
+
+    size_t n = (size_t)(end - v);
+    if (n >= cap)
+        n = cap - 1;
+    memcpy(out, v, n);
+    out[n] = '\0';
+    return true;
+}
+
+/*
+ * Заголовки ответа: вытаскиваем ETag в h->etag, сохранённый
+ * x-amz-checksum-sha256 в h->checksum_sha256 и полный размер объекта
+ * из Content-Range ("bytes a-b/N") в h->object_size.
+ */
+static size_t
+s3_curl_header_cb(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    s3_easy_handle_t *h = (s3_easy_handle_t *)userdata;
+    size_t len = size * nmemb;
+    char range[96];
+
+    if (s3_curl_header_value(ptr, len, "etag:", h->etag, sizeof(h->etag)))
+        return len;
+    if (s3_curl_header_value(ptr, len, "x-amz-checksum-sha256:",
+                             h->checksum_sha256,
+                             sizeof(h->checksum_sha256)))
+        return len;
+    if (s3_curl_header_value(ptr, len, "content-range:", range,
+                             sizeof(range)))
+    {
+        const char *slash = strchr(range, '/');
+        char *end = NULL;
+        unsigned long long total = slash != NULL ?
+            strtoull(slash + 1, &end, 10) : 0;
+        h->object_size = end != NULL && end != slash + 1 && *end == '\0' ?
+            (uint64_t)total : 0;
+    }
+    return len;
+}
+
 /* ----------------- AWS SigV4 через CURLOPT_AWS_SIGV4 ----------------- */
 
+/*
+ * "prefix" + a [+ sep + b] во временный буфер: обычно хватает стека,
+ * иначе — через аллокатор клиента. Освобождать s3_curl_tmp_str_free.
+ */
+static char *
+s3_curl_tmp_str(s3_client_t *c, char *stack, size_t stack_cap,
+                const char *prefix, const char *a, char sep, const char *b)
+{
+    size_t p_len = strlen(prefix);
+    size_t a_len = strlen(a);
+    size_t b_len = b != NULL ? strlen(b) : 0;
+    size_t total = p_len + a_len + (b != NULL ? 1 + b_len : 0) + 1;
+
+    char *str = stack;
+    if (total > stack_cap) {
+        str = (char *)s3_alloc(&c->alloc, total);
+        if (str == NULL)
+            return NULL;
+    }
+
+    memcpy(str, prefix, p_len);
+    memcpy(str + p_len, a, a_len);
+    if (b != NULL) {
+        str[p_len + a_len] = sep;
+        memcpy(str + p_len + a_len + 1, b, b_len);
+    }
+    str[total - 1] = '\0';
+    return str;
+}
+
+static void
+s3_curl_tmp_str_free(s3_client_t *c, char *str, char *stack)
+{
+    if (str != stack)
+        s3_free(&c->alloc, str);
+}
+
+/* access_key:secret_key в CURLOPT_USERPWD (curl копирует строку). */
+static s3_error_code_t
+s3_curl_apply_userpwd(s3_easy_handle_t *h, s3_error_t *err)
+{
+    s3_client_t *c = h->client;
+
+    char stack[256];
+    char *cred = s3_curl_tmp_str(c, stack, sizeof(stack), "",
+                                 c->access_key, ':', c->secret_key);
+    if (cred == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Out of memory building credentials", ENOMEM, 0, 0);
+        return err->code;
+    }
+
+    CURLcode cc = curl_easy_setopt(h->easy, CURLOPT_USERPWD, cred);
+    s3_curl_tmp_str_free(c, cred, stack);
+
+    if (cc != CURLE_OK) {
+        s3_error_set(err, S3_E_CURL,
+                     curl_easy_strerror(cc), 0, 0, (long)cc);
+        return err->code;
+    }
+    return S3_E_OK;
+}
+
+/* x-amz-security-token, если есть session_token. */
+static s3_error_code_t
+s3_curl_apply_session_token(s3_easy_handle_t *h, s3_error_t *err)
+{
+    s3_client_t *c = h->client;
+    if (c->session_token == NULL)
+        return S3_E_OK;
+
+    char stack[1024];
+    char *hdr = s3_curl_tmp_str(c, stack, sizeof(stack),
+                                "x-amz-security-token: ",
+                                c->session_token, 0, NULL);
+    if (hdr == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Out of memory building x-amz-security-token header",
+                     ENOMEM, 0, 0);
+        return err->code;
+    }
+
+    h->headers = curl_slist_append(h->headers, hdr);
+    s3_curl_tmp_str_free(c, hdr, stack);
+    return S3_E_OK;
+}
+
 static s3_error_code_t
 s3_curl_apply_sigv4(s3_easy_handle_t *h, s3_error_t *error)
 {
@@ -239,60 +589,17 @@ s3_curl_apply_sigv4(s3_easy_handle_t *h, s3_error_t *error)
      * 1) Если SigV4 НЕ требуется, используем обычный Basic Auth.
      */
     if (!c->require_sigv4) {
-        size_t ak_len = strlen(c->access_key);
-        size_t sk_len = strlen(c->secret_key);
-
-        size_t cred_len = ak_len + 1 + sk_len + 1;
-        char *cred = (char *)s3_alloc(&c->alloc, cred_len);
-        if (cred == NULL) {
-            s3_error_set(err, S3_E_NOMEM,
-                         "Out of memory building basic auth credentials",
-                         ENOMEM, 0, 0);
-            return err->code;
-        }
-
-        memcpy(cred, c->access_key, ak_len);
-        cred[ak_len] = ':';
-        memcpy(cred + ak_len + 1, c->secret_key, sk_len);
-        cred[cred_len - 1] = '\0';
-
-        CURLcode cc;
-        cc = curl_easy_setopt(h->easy, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
-        if (cc == CURLE_OK)
-            cc = curl_easy_setopt(h->easy, CURLOPT_USERPWD, cred);
-
-        s3_free(&c->alloc, cred);
-
+        CURLcode cc = curl_easy_setopt(h->easy, CURLOPT_HTTPAUTH,
+                                       CURLAUTH_BASIC);
         if (cc != CURLE_OK) {
             s3_error_set(err, S3_E_CURL,
                          curl_easy_strerror(cc), 0, 0, (long)cc);
             return err->code;
         }
 
-        /* x-amz-security-token, если есть session_token */
-        if (c->session_token != NULL) {
-            const char header_prefix[] = "x-amz-security-token: ";
-            size_t hp_len = sizeof(header_prefix) - 1;
-            size_t token_len = strlen(c->session_token);
-
-            size_t total = hp_len + token_len + 1;
-            char *hdr = (char *)s3_alloc(&c->alloc, total);
-            if (hdr == NULL) {
-                s3_error_set(err, S3_E_NOMEM,
-                             "Out of memory building x-amz-security-token header",
-                             ENOMEM, 0, 0);
-                return err->code;
-            }
-
-            memcpy(hdr, header_prefix, hp_len);
-            memcpy(hdr + hp_len, c->session_token, token_len);
-            hdr[total - 1] = '\0';
-
-            h->headers = curl_slist_append(h->headers, hdr);
-            s3_free(&c->alloc, hdr);
-        }
-
-        return S3_E_OK;
+        if (s3_curl_apply_userpwd(h, err) != S3_E_OK)
+            return err->code;
+        return s3_curl_apply_session_token(h, err);
     }
 
     /*
@@ -327,62 +634,37 @@ s3_curl_apply_sigv4(s3_easy_handle_t *h, s3_error_t *error)
     }
 
     /* Креды через USERPWD как раньше. */
-    size_t ak_len = strlen(c->access_key);
-    size_t sk_len = strlen(c->secret_key);
-
-    size_t cred_len = ak_len + 1 + sk_len + 1;
-    char *cred = (char *)s3_alloc(&c->alloc, cred_len);
-    if (cred == NULL) {
-        s3_error_set(err, S3_E_NOMEM,
-                     "Out of memory building SigV4 credentials", ENOMEM, 0, 0);
-        return err->code;
-    }
-
-    memcpy(cred, c->access_key, ak_len);
-    cred[ak_len] = ':';
-    memcpy(cred + ak_len + 1, c->secret_key, sk_len);
-    cred[cred_len - 1] = '\0';
-
-    cc = curl_easy_setopt(h->easy, CURLOPT_USERPWD, cred);
-    s3_free(&c->alloc, cred);
-
-    if (cc != CURLE_OK) {
-        s3_error_set(err, S3_E_CURL,
-                     curl_easy_strerror(cc), 0, 0, (long)cc);
+    if (s3_curl_apply_userpwd(h, err) != S3_E_OK)
         return err->code;
-    }
-
-    if (c->session_token != NULL) {
-        const char header_prefix[] = "x-amz-security-token: ";
-        size_t hp_len = sizeof(header_prefix) - 1;
-        size_t token_len = strlen(c->session_token);
-
-        size_t total = hp_len + token_len + 1;
-        char *hdr = (char *)s3_alloc(&c->alloc, total);
-        if (hdr == NULL) {
-            s3_error_set(err, S3_E_NOMEM,
-                         "Out of memory building x-amz-security-token header",
-                         ENOMEM, 0, 0);
-            return err->code;
-        }
-
-        memcpy(hdr, header_prefix, hp_len);
-        memcpy(hdr + hp_len, c->session_token, token_len);
-        hdr[total - 1] = '\0';
-
-        h->headers = curl_slist_append(h->headers, hdr);
-        s3_free(&c->alloc, hdr);
-    }
-
-    return S3_E_OK;
+    return s3_curl_apply_session_token(h, err);
 }
 
 /* ----------------- создание/уничтожение easy handle ----------------- */
 
+/*
+ * Хендлы переиспользуются через пул клиента: CURL после curl_easy_reset
+ * сохраняет открытые соединения, DNS-кэш и TLS-сессии, а буфер URL —
+ * свою ёмкость. В установившемся режиме запрос не делает ни одной
+ * аллокации на хендл.
+ */
+
 static s3_easy_handle_t *
 s3_easy_handle_alloc(s3_client_t *client)
 {
-    s3_easy_handle_t *h = (s3_easy_handle_t *)s3_alloc(&client->alloc, sizeof(*h));
+    pthread_mutex_lock(&client->handle_pool_mutex);
+    s3_easy_handle_t *h = client->handle_pool;
+    if (h != NULL) {
+        client->handle_pool = h->pool_next;
+        client->handle_pool_count--;
+    }
+    pthread_mutex_unlock(&client->handle_pool_mutex);
+
+    if (h != NULL) {
+        h->pool_next = NULL;
+        return h;
+    }
+
+    h = (s3_easy_handle_t *)s3_alloc(&client->alloc, sizeof(*h));
     if (h == NULL)
         return NULL;
 
@@ -397,6 +679,18 @@ s3_easy_handle_alloc(s3_client_t *client)
     return h;
 }
 
+static void
+s3_easy_handle_free(s3_easy_handle_t *h)
+{
+    s3_client_t *c = h->client;
+
+    if (h->easy != NULL)
+        curl_easy_cleanup(h->easy);
+    if (h->url != NULL)
+        s3_free(&c->alloc, h->url);
+    s3_free(&c->alloc, h);
+}
+
 void
 s3_easy_handle_destroy(s3_easy_handle_t *h)
 {
@@ -405,81 +699,195 @@ s3_easy_handle_destroy(s3_easy_handle_t *h)
 
     if (h->headers != NULL)
         curl_slist_free_all(h->headers);
-    if (h->easy != NULL)
-        curl_easy_cleanup(h->easy);
+    if (h->connect_to != NULL)
+        curl_slist_free_all(h->connect_to);
 
     s3_client_t *c = h->client;
 
-    if (h->url != NULL && c != NULL)
-        s3_free(&c->alloc, h->url);
-
     if (h->owned_body.data)
         s3_free(&c->alloc, h->owned_body.data);
 
     if (h->owned_resp.data)
         s3_free(&c->alloc, h->owned_resp.data);
+    s3_buf_chain_reset(c, &h->resp_chain);
+
+    if (h->easy == NULL) {
+        s3_easy_handle_free(h);
+        return;
+    }
 
-    if (c != NULL)
-        s3_free(&c->alloc, h);
+    /* Всё, кроме CURL и буфера URL, — в исходное состояние. */
+    CURL *easy = h->easy;
+    char *url = h->url;
+    size_t url_cap = h->url_cap;
+    curl_easy_reset(easy);
+    memset(h, 0, sizeof(*h));
+    h->client = c;
+    h->easy = easy;
+    h->url = url;
+    h->url_cap = url_cap;
+    if (url != NULL)
+        url[0] = '\0';
+
+    pthread_mutex_lock(&c->handle_pool_mutex);
+    if (c->handle_pool_count < c->max_total_connections) {
+        h->pool_next = c->handle_pool;
+        c->handle_pool = h;
+        c->handle_pool_count++;
+        h = NULL;
+    }
+    pthread_mutex_unlock(&c->handle_pool_mutex);
+
+    if (h != NULL)
+        s3_easy_handle_free(h);
 }
 
-/* ----------------- публичные фабрики методов ----------------- */
+void
+s3_easy_handle_pool_drain(s3_client_t *client)
+{
+    pthread_mutex_lock(&client->handle_pool_mutex);
+    s3_easy_handle_t *h = client->handle_pool;
+    client->handle_pool = NULL;
+    client->handle_pool_count = 0;
+    pthread_mutex_unlock(&client->handle_pool_mutex);
+
+    while (h != NULL) {
+        s3_easy_handle_t *next = h->pool_next;
+        s3_easy_handle_free(h);
+        h = next;
+    }
+}
+
+/*
+ * URL, построенный отдельно (с query и т.п.), забирается хендлом
+ * вместо буфера из пула.
+ */
+static void
+s3_easy_handle_set_url(s3_easy_handle_t *h, char *url)
+{
+    if (h->url != NULL)
+        s3_free(&h->client->alloc, h->url);
+    h->url = url;
+    h->url_cap = strlen(url) + 1;
+}
 
 s3_error_code_t
-s3_easy_factory_new_put_fd(s3_client_t *client,
-                        const s3_put_opts_t *opts,
-                        int fd, off_t offset, size_t size,
-                        s3_easy_handle_t **out_handle,
-                        s3_error_t *error)
+s3_easy_handle_resp(s3_easy_handle_t *h, const char **out, s3_error_t *err)
 {
-    s3_error_t local_err = S3_ERROR_INIT;
-    s3_error_t *err = error ? error : &local_err;
+    s3_buf_chain_t *ch = &h->resp_chain;
 
-    if (out_handle == NULL || client == NULL || opts == NULL) {
-        s3_error_set(err, S3_E_INVALID_ARG,
-                     "client, opts or out_handle is NULL", 0, 0, 0);
-        return err->code;
+    if (h->owned_resp.data != NULL) {
+        *out = h->owned_resp.data;
+        return S3_E_OK;
     }
-
-    if (fd < 0 || size == 0) {
-        s3_error_set(err, S3_E_INVALID_ARG,
-                     "invalid fd or size for PUT", 0, 0, 0);
-        return err->code;
+    if (ch->head == NULL) {
+        *out = "";
+        return S3_E_OK;
+    }
+    if (ch->nsegs == 1 && ch->head->size < ch->head->cap) {
+        ch->head->data[ch->head->size] = '\0';
+        *out = ch->head->data;
+        return S3_E_OK;
     }
 
-    s3_easy_handle_t *h = s3_easy_handle_alloc(client);
-    if (h == NULL) {
+    if (s3_buf_chain_flatten(h->client, ch, &h->owned_resp) != 0) {
         s3_error_set(err, S3_E_NOMEM,
-                     "Failed to allocate s3_easy_handle", ENOMEM, 0, 0);
+                     "Out of memory assembling response body", ENOMEM, 0, 0);
         return err->code;
     }
+    *out = h->owned_resp.data;
+    return S3_E_OK;
+}
+
+int
+s3_easy_handle_rewind(s3_easy_handle_t *h)
+{
+    /* Отправленное в сокет не вернуть. */
+    if (h->write_io.kind == S3_IO_STREAM) {
+        if (h->write_bytes_total > 0)
+            return -1;
+        h->write_io.u.stream.skip = 0;
+        h->write_io.u.stream.paused = false;
+    }
 
-    /* Настраиваем I/O: читаем тело из fd, ничего не пишем. */
-    s3_easy_io_init_fd(&h->read_io, fd, offset, size);
+    h->read_bytes_total = 0;
+    h->write_bytes_total = 0;
+
+    /* Тело PUT из кусков — снова с первого сегмента. */
+    if (h->read_io.kind == S3_IO_IOV) {
+        h->read_io.u.iov.cursor = 0;
+        h->read_io.u.iov.cursor_start = 0;
+    }
+
+    s3_easy_io_t *io = &h->write_io;
+    switch (io->kind) {
+    case S3_IO_MEM:
+        if (io->u.mem.buf != NULL) {
+            io->u.mem.buf->size = 0;
+            if (io->u.mem.buf->data != NULL)
+                io->u.mem.buf->data[0] = '\0';
+        }
+        break;
+    case S3_IO_CHAIN:
+        if (io->u.chain.chain != NULL)
+            s3_buf_chain_reset(h->client, io->u.chain.chain);
+        if (h->owned_resp.data != NULL) {
+            s3_free(&h->client->alloc, h->owned_resp.data);
+            memset(&h->owned_resp, 0, sizeof(h->owned_resp));
+        }
+        break;
+    case S3_IO_SCATTER:
+        io->u.scatter.cursor = 0;
+        io->u.scatter.base = io->u.scatter.start;
+        for (size_t i = 0; i < io->u.scatter.count; i++)
+            io->u.scatter.segs[i].written = 0;
+        break;
+    default:
+        /* FD/BUF пишутся по смещению от начала — перезапишутся. */
+        break;
+    }
+    return 0;
+}
+
+/* ----------------- публичные фабрики методов ----------------- */
+
+/*
+ * Общая часть PUT: тело читается через read_io (уже заполненный),
+ * size — Content-Length.
+ */
+static s3_error_code_t
+s3_easy_factory_new_put(s3_client_t *client,
+                        const s3_put_opts_t *opts,
+                        const s3_easy_io_t *read_io, size_t size,
+                        s3_easy_handle_t *h,
+                        s3_error_t *err)
+{
+    h->read_io = *read_io;
     s3_easy_io_init_none(&h->write_io);
 
     h->read_bytes_total = 0;
     h->write_bytes_total = 0;
+    h->idempotent = true;
 
-    char *url = NULL;
-    s3_error_code_t rc = s3_build_url(client,
-                                      opts->bucket,
-                                      opts->key,
-                                      &url, err);
-    if (rc != S3_E_OK) {
-        goto fail;
-    }
-    /* Сохраняем URL внутри easy-хендла для последующего free. */
-    h->url = url;
+    /* URL строится в буфере хендла (переживает возврат в пул). */
+    s3_error_code_t rc = s3_build_url_buf(client,
+                                          opts->bucket,
+                                          opts->key,
+                                          &h->url, &h->url_cap, err);
+    if (rc != S3_E_OK)
+        return rc;
+    const char *url = h->url;
 
     curl_easy_setopt(h->easy, CURLOPT_URL, url);
     curl_easy_setopt(h->easy, CURLOPT_UPLOAD, 1L);
     curl_easy_setopt(h->easy, CURLOPT_READFUNCTION, s3_curl_read_cb);
     curl_easy_setopt(h->easy, CURLOPT_READDATA, h);
     curl_easy_setopt(h->easy, CURLOPT_INFILESIZE_LARGE, (curl_off_t)size);
+    curl_easy_setopt(h->easy, CURLOPT_HEADERFUNCTION, s3_curl_header_cb);
+    curl_easy_setopt(h->easy, CURLOPT_HEADERDATA, h);
 
     s3_curl_apply_common_opts(h);
-    
+
     if (opts->content_type != NULL) {
         // TODO: всегда ли хватит?
         char buf[256];
@@ -489,20 +897,629 @@ s3_easy_factory_new_put_fd(s3_client_t *client,
         else {
             s3_error_set(err, S3_E_NOMEM,
                      "Failed to make Content-Type header", ENOMEM, 0, 0);
-            goto fail;
+            return err->code;
         }
 
     }
 
-    rc = s3_curl_apply_sigv4(h, err);
+    if (opts->checksum_sha256 != NULL) {
+        char buf[128];
+        int n = snprintf(buf, sizeof(buf), "x-amz-checksum-sha256: %s",
+                         opts->checksum_sha256);
+        if (n <= 0 || (size_t)n >= sizeof(buf)) {
+            s3_error_set(err, S3_E_INVALID_ARG,
+                         "checksum_sha256 is too long", 0, 0, 0);
+            return err->code;
+        }
+        h->headers = curl_slist_append(h->headers, buf);
+    }
+
+    rc = s3_curl_apply_sigv4(h, err);
+    if (rc != S3_E_OK)
+        return rc;
+
+    if (h->headers != NULL) {
+        curl_easy_setopt(h->easy, CURLOPT_HTTPHEADER, h->headers);
+    }
+
+    return S3_E_OK;
+}
+
+s3_error_code_t
+s3_easy_factory_new_put_fd(s3_client_t *client,
+                        const s3_put_opts_t *opts,
+                        int fd, off_t offset, size_t size,
+                        s3_easy_handle_t **out_handle,
+                        s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    if (out_handle == NULL || client == NULL || opts == NULL) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts or out_handle is NULL", 0, 0, 0);
+        return err->code;
+    }
+
+    if (fd < 0 || size == 0) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "invalid fd or size for PUT", 0, 0, 0);
+        return err->code;
+    }
+
+    s3_easy_handle_t *h = s3_easy_handle_alloc(client);
+    if (h == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate s3_easy_handle", ENOMEM, 0, 0);
+        return err->code;
+    }
+
+    /* Настраиваем I/O: читаем тело из fd, ничего не пишем. */
+    s3_easy_io_t io;
+    s3_easy_io_init_fd(&io, fd, offset, size);
+
+    if (s3_easy_factory_new_put(client, opts, &io, size, h, err) != S3_E_OK) {
+        s3_easy_handle_destroy(h);
+        return err->code;
+    }
+
+    *out_handle = h;
+    return S3_E_OK;
+}
+
+s3_error_code_t
+s3_easy_factory_new_put_buf(s3_client_t *client,
+                            const s3_put_opts_t *opts,
+                            const void *data, size_t size,
+                            s3_easy_handle_t **out_handle,
+                            s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    if (out_handle == NULL || client == NULL || opts == NULL) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts or out_handle is NULL", 0, 0, 0);
+        return err->code;
+    }
+
+    if (data == NULL && size != 0) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "data is NULL for PUT from buffer", 0, 0, 0);
+        return err->code;
+    }
+
+    s3_easy_handle_t *h = s3_easy_handle_alloc(client);
+    if (h == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate s3_easy_handle", ENOMEM, 0, 0);
+        return err->code;
+    }
+
+    /* Память не наша: только читаем, освобождать не нужно. */
+    h->borrowed_body.data = (char *)data;
+    h->borrowed_body.size = size;
+    h->borrowed_body.capacity = size;
+
+    s3_easy_io_t io;
+    s3_easy_io_init_mem(&io, &h->borrowed_body, size);
+
+    if (s3_easy_factory_new_put(client, opts, &io, size, h, err) != S3_E_OK) {
+        s3_easy_handle_destroy(h);
+        return err->code;
+    }
+
+    *out_handle = h;
+    return S3_E_OK;
+}
+
+/* Суммарная длина сегментов или -1, если какой-то fd некорректен. */
+static ssize_t
+s3_put_segs_size(const s3_put_seg_t *segs, size_t count)
+{
+    size_t size = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (segs[i].fd < 0 && segs[i].len > 0)
+            return -1;
+        size += segs[i].len;
+    }
+    return (ssize_t)size;
+}
+
+s3_error_code_t
+s3_easy_factory_new_put_iov(s3_client_t *client,
+                            const s3_put_opts_t *opts,
+                            const s3_put_seg_t *segs, size_t count,
+                            s3_easy_handle_t **out_handle,
+                            s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    if (out_handle == NULL || client == NULL || opts == NULL) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts or out_handle is NULL", 0, 0, 0);
+        return err->code;
+    }
+
+    ssize_t size = segs != NULL ? s3_put_segs_size(segs, count) : -1;
+    if (size < 0) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "invalid segments for PUT", 0, 0, 0);
+        return err->code;
+    }
+
+    s3_easy_handle_t *h = s3_easy_handle_alloc(client);
+    if (h == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate s3_easy_handle", ENOMEM, 0, 0);
+        return err->code;
+    }
+
+    s3_easy_io_t io;
+    s3_easy_io_init_iov(&io, segs, count, (size_t)size);
+
+    if (s3_easy_factory_new_put(client, opts, &io, (size_t)size,
+                                h, err) != S3_E_OK)
+    {
+        s3_easy_handle_destroy(h);
+        return err->code;
+    }
+
+    *out_handle = h;
+    return S3_E_OK;
+}
+
+/*
+ * Общая часть GET: тело ответа пишется через write_io (уже заполненный).
+ */
+static s3_error_code_t
+s3_easy_factory_new_get(s3_client_t *client,
+                        const s3_get_opts_t *opts,
+                        const s3_easy_io_t *write_io,
+                        s3_easy_handle_t *h,
+                        s3_error_t *err)
+{
+    h->write_io = *write_io;
+    s3_easy_io_init_none(&h->read_io);
+
+    h->read_bytes_total = 0;
+    h->write_bytes_total = 0;
+    h->idempotent = true;
+
+    s3_error_code_t rc = s3_build_url_buf(client,
+                                          opts->bucket,
+                                          opts->key,
+                                          &h->url, &h->url_cap, err);
+    if (rc != S3_E_OK)
+        return rc;
+    const char *url = h->url;
+
+    curl_easy_setopt(h->easy, CURLOPT_URL, url);
+    curl_easy_setopt(h->easy, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(h->easy, CURLOPT_WRITEFUNCTION, s3_curl_write_cb);
+    curl_easy_setopt(h->easy, CURLOPT_WRITEDATA, h);
+    curl_easy_setopt(h->easy, CURLOPT_HEADERFUNCTION, s3_curl_header_cb);
+    curl_easy_setopt(h->easy, CURLOPT_HEADERDATA, h);
+
+    /* Range при необходимости. */
+    if (opts->range != NULL)
+        curl_easy_setopt(h->easy, CURLOPT_RANGE, opts->range);
+
+    /* If-Match: ETag должен быть в кавычках. */
+    if (opts->if_match != NULL && opts->if_match[0] != '\0') {
+        char buf[256];
+        const char *q = opts->if_match[0] == '"' ? "" : "\"";
+        int n = snprintf(buf, sizeof(buf), "If-Match: %s%s%s",
+                         q, opts->if_match, q);
+        if (n <= 0 || (size_t)n >= sizeof(buf)) {
+            s3_error_set(err, S3_E_INVALID_ARG,
+                         "if_match ETag is too long", 0, 0, 0);
+            return err->code;
+        }
+        h->headers = curl_slist_append(h->headers, buf);
+    }
+
+    s3_curl_apply_common_opts(h);
+
+    rc = s3_curl_apply_sigv4(h, err);
+    if (rc != S3_E_OK)
+        return rc;
+
+    if (h->headers != NULL) {
+        curl_easy_setopt(h->easy, CURLOPT_HTTPHEADER, h->headers);
+    }
+
+    return S3_E_OK;
+}
+
+s3_error_code_t
+s3_easy_factory_new_get_fd(s3_client_t *client,
+                        const s3_get_opts_t *opts,
+                        int fd, off_t offset, size_t max_size,
+                        s3_easy_handle_t **out_handle,
+                        s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    if (out_handle == NULL || client == NULL || opts == NULL) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts or out_handle is NULL", 0, 0, 0);
+        return err->code;
+    }
+
+    if (fd < 0) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "invalid fd for GET", 0, 0, 0);
+        return err->code;
+    }
+
+    s3_easy_handle_t *h = s3_easy_handle_alloc(client);
+    if (h == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate s3_easy_handle", ENOMEM, 0, 0);
+        return err->code;
+    }
+
+    /* Читаем из сети → пишем в fd.
+     * max_size == 0 → без ограничения (это уже интерпретирует write_cb).
+     */
+    s3_easy_io_t io;
+    s3_easy_io_init_fd(&io, fd, offset, max_size);
+
+    if (s3_easy_factory_new_get(client, opts, &io, h, err) != S3_E_OK) {
+        s3_easy_handle_destroy(h);
+        return err->code;
+    }
+
+    *out_handle = h;
+    return S3_E_OK;
+}
+
+s3_error_code_t
+s3_easy_factory_new_get_buf(s3_client_t *client,
+                            const s3_get_opts_t *opts,
+                            void *buf, size_t cap,
+                            s3_easy_handle_t **out_handle,
+                            s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    if (out_handle == NULL || client == NULL || opts == NULL) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts or out_handle is NULL", 0, 0, 0);
+        return err->code;
+    }
+
+    if (buf == NULL || cap == 0) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "invalid buffer for GET", 0, 0, 0);
+        return err->code;
+    }
+
+    s3_easy_handle_t *h = s3_easy_handle_alloc(client);
+    if (h == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate s3_easy_handle", ENOMEM, 0, 0);
+        return err->code;
+    }
+
+    s3_easy_io_t io;
+    s3_easy_io_init_buf(&io, buf, cap);
+
+    if (s3_easy_factory_new_get(client, opts, &io, h, err) != S3_E_OK) {
+        s3_easy_handle_destroy(h);
+        return err->code;
+    }
+
+    *out_handle = h;
+    return S3_E_OK;
+}
+
+s3_error_code_t
+s3_easy_factory_new_get_stream(s3_client_t *client,
+                               const s3_get_opts_t *opts,
+                               int fd,
+                               s3_easy_handle_t **out_handle,
+                               s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    if (out_handle == NULL || client == NULL || opts == NULL) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts or out_handle is NULL", 0, 0, 0);
+        return err->code;
+    }
+
+    if (fd < 0) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "invalid fd for GET", 0, 0, 0);
+        return err->code;
+    }
+
+    s3_easy_handle_t *h = s3_easy_handle_alloc(client);
+    if (h == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate s3_easy_handle", ENOMEM, 0, 0);
+        return err->code;
+    }
+
+    s3_easy_io_t io;
+    s3_easy_io_init_stream(&io, fd);
+
+    if (s3_easy_factory_new_get(client, opts, &io, h, err) != S3_E_OK) {
+        s3_easy_handle_destroy(h);
+        return err->code;
+    }
+
+    /*
+     * Большой объект в медленный сокет может идти сколько угодно долго:
+     * вместо общего таймаута обрываем только простой.
+     */
+    curl_easy_setopt(h->easy, CURLOPT_TIMEOUT_MS, 0L);
+    curl_easy_setopt(h->easy, CURLOPT_LOW_SPEED_LIMIT, 1L);
+    curl_easy_setopt(h->easy, CURLOPT_LOW_SPEED_TIME,
+                     (long)((client->request_timeout_ms + 999) / 1000));
+
+    *out_handle = h;
+    return S3_E_OK;
+}
+
+s3_error_code_t
+s3_easy_factory_new_get_scatter(s3_client_t *client,
+                                const s3_get_opts_t *opts,
+                                uint64_t start, uint64_t end,
+                                s3_easy_scatter_seg_t *segs, size_t count,
+                                s3_easy_handle_t **out_handle,
+                                s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    if (out_handle == NULL || client == NULL || opts == NULL) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts or out_handle is NULL", 0, 0, 0);
+        return err->code;
+    }
+
+    if (segs == NULL || count == 0 || end <= start) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "invalid scatter segments for GET", 0, 0, 0);
+        return err->code;
+    }
+
+    s3_easy_handle_t *h = s3_easy_handle_alloc(client);
+    if (h == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate s3_easy_handle", ENOMEM, 0, 0);
+        return err->code;
+    }
+
+    char range[64];
+    snprintf(range, sizeof(range), "bytes=%llu-%llu",
+             (unsigned long long)start, (unsigned long long)(end - 1));
+
+    /* CURLOPT_RANGE копирует строку, так что стек здесь безопасен. */
+    s3_get_opts_t get = *opts;
+    get.range = range;
+
+    s3_easy_io_t io;
+    s3_easy_io_init_scatter(&io, segs, count, start);
+
+    if (s3_easy_factory_new_get(client, &get, &io, h, err) != S3_E_OK) {
+        s3_easy_handle_destroy(h);
+        return err->code;
+    }
+
+    *out_handle = h;
+    return S3_E_OK;
+}
+
+s3_error_code_t
+s3_easy_factory_new_create_bucket(s3_client_t *client,
+                                  const s3_create_bucket_opts_t *opts,
+                                  s3_easy_handle_t **out_handle,
+                                  s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    if (out_handle == NULL || client == NULL || opts == NULL) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts, io or out_handle is NULL", 0, 0, 0);
+        return err->code;
+    }
+
+    s3_easy_handle_t *h = s3_easy_handle_alloc(client);
+    if (h == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate s3_easy_handle", ENOMEM, 0, 0);
+        return err->code;
+    }
+
+    s3_error_code_t rc = s3_build_url_buf(client,
+                                          opts->bucket,
+                                          NULL,
+                                          &h->url, &h->url_cap, err);
     if (rc != S3_E_OK) {
-       goto fail;
+        goto fail;
+    }
+    curl_easy_setopt(h->easy, CURLOPT_URL, h->url);
+    /* PUT без тела. */
+    curl_easy_setopt(h->easy, CURLOPT_UPLOAD, 0L);
+    curl_easy_setopt(h->easy, CURLOPT_CUSTOMREQUEST, "PUT");
+
+    s3_curl_apply_common_opts(h);
+
+    s3_error_code_t rc2 = s3_curl_apply_sigv4(h, err);
+    if (rc2 != S3_E_OK) {
+        goto fail;
+    }
+
+    if (h->headers != NULL) {
+        curl_easy_setopt(h->easy, CURLOPT_HTTPHEADER, h->headers);
+    }
+
+    *out_handle = h;
+    return S3_E_OK;
+
+fail:
+    s3_easy_handle_destroy(h);
+    return err->code;
+}
+
+/* ----------------- multipart upload ----------------- */
+
+/*
+ * Общая часть: URL объекта с query "<prefix>uploadId=<id>", ответ в
+ * resp_chain, заголовки ответа — в s3_curl_header_cb.
+ */
+static s3_error_code_t
+s3_easy_factory_new_mpu(s3_client_t *client,
+                        const s3_put_opts_t *opts,
+                        const char *query_prefix,
+                        const char *upload_id,
+                        s3_easy_handle_t *h,
+                        s3_error_t *err)
+{
+    char *query = NULL;
+    char *enc_id = NULL;
+
+    if (upload_id != NULL) {
+        if (s3_url_encode_query(client, upload_id, &enc_id, err) != 0)
+            return err->code;
+        size_t need = strlen(query_prefix) + strlen("uploadId=") +
+                      strlen(enc_id) + 1;
+        query = (char *)s3_alloc(&client->alloc, need);
+        if (query == NULL) {
+            s3_free(&client->alloc, enc_id);
+            s3_error_set(err, S3_E_NOMEM,
+                         "Out of memory building multipart URL", ENOMEM, 0, 0);
+            return err->code;
+        }
+        snprintf(query, need, "%suploadId=%s", query_prefix, enc_id);
+        s3_free(&client->alloc, enc_id);
+    }
+
+    char *url = NULL;
+    s3_error_code_t rc = s3_build_url_query(client, opts->bucket, opts->key,
+                                            query != NULL ? query : query_prefix,
+                                            &url, err);
+    if (query != NULL)
+        s3_free(&client->alloc, query);
+    if (rc != S3_E_OK)
+        return rc;
+    s3_easy_handle_set_url(h, url);
+
+    curl_easy_setopt(h->easy, CURLOPT_URL, url);
+
+    s3_easy_io_init_chain(&h->write_io, &h->resp_chain);
+    curl_easy_setopt(h->easy, CURLOPT_WRITEFUNCTION, s3_curl_write_cb);
+    curl_easy_setopt(h->easy, CURLOPT_WRITEDATA, h);
+    curl_easy_setopt(h->easy, CURLOPT_HEADERFUNCTION, s3_curl_header_cb);
+    curl_easy_setopt(h->easy, CURLOPT_HEADERDATA, h);
+
+    s3_curl_apply_common_opts(h);
+    return S3_E_OK;
+}
+
+static s3_error_code_t
+s3_easy_factory_finish(s3_easy_handle_t *h, s3_error_t *err)
+{
+    if (s3_curl_apply_sigv4(h, err) != S3_E_OK)
+        return err->code;
+    if (h->headers != NULL)
+        curl_easy_setopt(h->easy, CURLOPT_HTTPHEADER, h->headers);
+    return S3_E_OK;
+}
+
+s3_error_code_t
+s3_easy_factory_new_mpu_create(s3_client_t *client,
+                               const s3_put_opts_t *opts,
+                               s3_easy_handle_t **out_handle,
+                               s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    if (out_handle == NULL || client == NULL || opts == NULL) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts or out_handle is NULL", 0, 0, 0);
+        return err->code;
     }
 
-    if (h->headers != NULL) {
-        curl_easy_setopt(h->easy, CURLOPT_HTTPHEADER, h->headers);
+    s3_easy_handle_t *h = s3_easy_handle_alloc(client);
+    if (h == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate s3_easy_handle", ENOMEM, 0, 0);
+        return err->code;
+    }
+
+    /* Повтор создал бы вторую загрузку, которую никто не завершит. */
+    h->idempotent = false;
+
+    if (s3_easy_factory_new_mpu(client, opts, "uploads", NULL, h, err) != S3_E_OK)
+        goto fail;
+
+    curl_easy_setopt(h->easy, CURLOPT_POST, 1L);
+    curl_easy_setopt(h->easy, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)0);
+    curl_easy_setopt(h->easy, CURLOPT_POSTFIELDS, "");
+
+    if (opts->content_type != NULL) {
+        char buf[256];
+        int n = snprintf(buf, sizeof(buf), "Content-Type: %s",
+                         opts->content_type);
+        if (n <= 0 || (size_t)n >= sizeof(buf)) {
+            s3_error_set(err, S3_E_INVALID_ARG,
+                         "content_type is too long", 0, 0, 0);
+            goto fail;
+        }
+        h->headers = curl_slist_append(h->headers, buf);
     }
 
+    if (s3_easy_factory_finish(h, err) != S3_E_OK)
+        goto fail;
+
+    *out_handle = h;
+    return S3_E_OK;
+
+fail:
+    s3_easy_handle_destroy(h);
+    return err->code;
+}
+
+/*
+ * Общая часть UploadPart: h уже с read_io, size — Content-Length.
+ * При ошибке хендл уничтожается.
+ */
+static s3_error_code_t
+s3_easy_factory_mpu_part(s3_client_t *client,
+                         const s3_put_opts_t *opts,
+                         const char *upload_id,
+                         uint32_t part_number,
+                         size_t size,
+                         s3_easy_handle_t *h,
+                         s3_easy_handle_t **out_handle,
+                         s3_error_t *err)
+{
+    h->idempotent = true;
+
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "partNumber=%u&", part_number);
+    if (s3_easy_factory_new_mpu(client, opts, prefix, upload_id, h, err) != S3_E_OK)
+        goto fail;
+
+    curl_easy_setopt(h->easy, CURLOPT_UPLOAD, 1L);
+    curl_easy_setopt(h->easy, CURLOPT_READFUNCTION, s3_curl_read_cb);
+    curl_easy_setopt(h->easy, CURLOPT_READDATA, h);
+    curl_easy_setopt(h->easy, CURLOPT_INFILESIZE_LARGE, (curl_off_t)size);
+
+    if (s3_easy_factory_finish(h, err) != S3_E_OK)
+        goto fail;
+
     *out_handle = h;
     return S3_E_OK;
 
@@ -512,24 +1529,58 @@ fail:
 }
 
 s3_error_code_t
-s3_easy_factory_new_get_fd(s3_client_t *client,
-                        const s3_get_opts_t *opts,
-                        int fd, off_t offset, size_t max_size,
-                        s3_easy_handle_t **out_handle,
-                        s3_error_t *error)
+s3_easy_factory_new_mpu_part(s3_client_t *client,
+                             const s3_put_opts_t *opts,
+                             const char *upload_id,
+                             uint32_t part_number,
+                             const void *data, size_t size,
+                             s3_easy_handle_t **out_handle,
+                             s3_error_t *error)
 {
     s3_error_t local_err = S3_ERROR_INIT;
     s3_error_t *err = error ? error : &local_err;
 
-    if (out_handle == NULL || client == NULL || opts == NULL) {
+    if (out_handle == NULL || client == NULL || opts == NULL ||
+        upload_id == NULL || (data == NULL && size != 0))
+    {
         s3_error_set(err, S3_E_INVALID_ARG,
-                     "client, opts or out_handle is NULL", 0, 0, 0);
+                     "invalid arguments for UploadPart", 0, 0, 0);
         return err->code;
     }
 
-    if (fd < 0) {
+    s3_easy_handle_t *h = s3_easy_handle_alloc(client);
+    if (h == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate s3_easy_handle", ENOMEM, 0, 0);
+        return err->code;
+    }
+
+    h->borrowed_body.data = (char *)data;
+    h->borrowed_body.size = size;
+    h->borrowed_body.capacity = size;
+    s3_easy_io_init_mem(&h->read_io, &h->borrowed_body, size);
+
+    return s3_easy_factory_mpu_part(client, opts, upload_id, part_number,
+                                    size, h, out_handle, err);
+}
+
+s3_error_code_t
+s3_easy_factory_new_mpu_part_fd(s3_client_t *client,
+                                const s3_put_opts_t *opts,
+                                const char *upload_id,
+                                uint32_t part_number,
+                                int fd, off_t offset, size_t size,
+                                s3_easy_handle_t **out_handle,
+                                s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    if (out_handle == NULL || client == NULL || opts == NULL ||
+        upload_id == NULL || fd < 0 || size == 0)
+    {
         s3_error_set(err, S3_E_INVALID_ARG,
-                     "invalid fd for GET", 0, 0, 0);
+                     "invalid arguments for UploadPart", 0, 0, 0);
         return err->code;
     }
 
@@ -540,45 +1591,182 @@ s3_easy_factory_new_get_fd(s3_client_t *client,
         return err->code;
     }
 
-    /* Читаем из сети → пишем в fd.
-     * max_size == 0 → без ограничения (это уже интерпретирует write_cb).
-     */
-    s3_easy_io_init_fd(&h->write_io, fd, offset, max_size);
-    s3_easy_io_init_none(&h->read_io);
+    s3_easy_io_init_fd(&h->read_io, fd, offset, size);
 
-    h->read_bytes_total = 0;
-    h->write_bytes_total = 0;
+    return s3_easy_factory_mpu_part(client, opts, upload_id, part_number,
+                                    size, h, out_handle, err);
+}
 
-    char *url = NULL;
-    s3_error_code_t rc = s3_build_url(client,
-                                      opts->bucket,
-                                      opts->key,
-                                      &url, err);
-    if (rc != S3_E_OK) {
-        goto fail;
+s3_error_code_t
+s3_easy_factory_new_mpu_part_iov(s3_client_t *client,
+                                 const s3_put_opts_t *opts,
+                                 const char *upload_id,
+                                 uint32_t part_number,
+                                 const s3_put_seg_t *segs, size_t count,
+                                 s3_easy_handle_t **out_handle,
+                                 s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    ssize_t size = segs != NULL ? s3_put_segs_size(segs, count) : -1;
+    if (out_handle == NULL || client == NULL || opts == NULL ||
+        upload_id == NULL || size < 0)
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "invalid arguments for UploadPart", 0, 0, 0);
+        return err->code;
     }
-    h->url = url;
 
-    curl_easy_setopt(h->easy, CURLOPT_URL, url);
-    curl_easy_setopt(h->easy, CURLOPT_HTTPGET, 1L);
-    curl_easy_setopt(h->easy, CURLOPT_WRITEFUNCTION, s3_curl_write_cb);
-    curl_easy_setopt(h->easy, CURLOPT_WRITEDATA, h);
+    s3_easy_handle_t *h = s3_easy_handle_alloc(client);
+    if (h == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate s3_easy_handle", ENOMEM, 0, 0);
+        return err->code;
+    }
 
-    /* Range при необходимости. */
-    if (opts->range != NULL)
-        curl_easy_setopt(h->easy, CURLOPT_RANGE, opts->range);
+    s3_easy_io_init_iov(&h->read_io, segs, count, (size_t)size);
 
-    s3_curl_apply_common_opts(h);
+    return s3_easy_factory_mpu_part(client, opts, upload_id, part_number,
+                                    (size_t)size, h, out_handle, err);
+}
 
-    rc = s3_curl_apply_sigv4(h, err);
-    if (rc != S3_E_OK) {
+/* "<name>: <value>" в h->headers. */
+static s3_error_code_t
+s3_easy_handle_add_header(s3_easy_handle_t *h, const char *name,
+                          const char *value, s3_error_t *err)
+{
+    s3_client_t *c = h->client;
+    char stack[512];
+    char *hdr = s3_curl_tmp_str(c, stack, sizeof(stack), name, value, 0,
+                                NULL);
+    if (hdr == NULL) {
+        s3_error_set(err, S3_E_NOMEM, "Out of memory building header",
+                     ENOMEM, 0, 0);
+        return err->code;
+    }
+    h->headers = curl_slist_append(h->headers, hdr);
+    s3_curl_tmp_str_free(c, hdr, stack);
+    return S3_E_OK;
+}
+
+s3_error_code_t
+s3_easy_factory_new_mpu_part_copy(s3_client_t *client,
+                                  const s3_put_opts_t *opts,
+                                  const char *upload_id,
+                                  uint32_t part_number,
+                                  const char *src_bucket,
+                                  const char *src_key,
+                                  const char *range,
+                                  const char *if_match,
+                                  s3_easy_handle_t **out_handle,
+                                  s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    if (src_bucket == NULL)
+        src_bucket = opts != NULL && opts->bucket != NULL ?
+            opts->bucket : client != NULL ? client->default_bucket : NULL;
+    if (out_handle == NULL || client == NULL || opts == NULL ||
+        upload_id == NULL || src_bucket == NULL || src_key == NULL)
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "invalid arguments for UploadPartCopy", 0, 0, 0);
+        return err->code;
+    }
+
+    s3_easy_handle_t *h = s3_easy_handle_alloc(client);
+    if (h == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate s3_easy_handle", ENOMEM, 0, 0);
+        return err->code;
+    }
+
+    /* x-amz-copy-source: /bucket/key, key закодирован. */
+    char *enc_key = NULL;
+    if (s3_url_encode_query(client, src_key, &enc_key, err) != 0)
+        goto fail;
+    char stack[512];
+    char *src = s3_curl_tmp_str(client, stack, sizeof(stack), "/",
+                                src_bucket, '/', enc_key);
+    s3_free(&client->alloc, enc_key);
+    if (src == NULL) {
+        s3_error_set(err, S3_E_NOMEM, "Out of memory building copy source",
+                     ENOMEM, 0, 0);
         goto fail;
     }
+    s3_error_code_t rc = s3_easy_handle_add_header(h, "x-amz-copy-source: ",
+                                                   src, err);
+    s3_curl_tmp_str_free(client, src, stack);
+    if (rc != S3_E_OK)
+        goto fail;
 
-    if (h->headers != NULL) {
-        curl_easy_setopt(h->easy, CURLOPT_HTTPHEADER, h->headers);
+    if (range != NULL &&
+        s3_easy_handle_add_header(h, "x-amz-copy-source-range: ", range,
+                                  err) != S3_E_OK)
+        goto fail;
+    if (if_match != NULL &&
+        s3_easy_handle_add_header(h, "x-amz-copy-source-if-match: ",
+                                  if_match, err) != S3_E_OK)
+        goto fail;
+
+    s3_easy_io_init_mem(&h->read_io, &h->borrowed_body, 0);
+
+    return s3_easy_factory_mpu_part(client, opts, upload_id, part_number,
+                                    0, h, out_handle, err);
+
+fail:
+    s3_easy_handle_destroy(h);
+    return err->code;
+}
+
+s3_error_code_t
+s3_easy_factory_new_mpu_complete(s3_client_t *client,
+                                 const s3_put_opts_t *opts,
+                                 const char *upload_id,
+                                 s3_mem_buf_t *body,
+                                 s3_easy_handle_t **out_handle,
+                                 s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    if (out_handle == NULL || client == NULL || opts == NULL ||
+        upload_id == NULL || body == NULL)
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "invalid arguments for CompleteMultipartUpload", 0, 0, 0);
+        return err->code;
+    }
+
+    s3_easy_handle_t *h = s3_easy_handle_alloc(client);
+    if (h == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate s3_easy_handle", ENOMEM, 0, 0);
+        return err->code;
     }
 
+    /* Тело теперь наше. */
+    h->owned_body = *body;
+    memset(body, 0, sizeof(*body));
+    h->idempotent = true;
+
+    if (s3_easy_factory_new_mpu(client, opts, "", upload_id, h, err) != S3_E_OK)
+        goto fail;
+
+    s3_easy_io_init_mem(&h->read_io, &h->owned_body, h->owned_body.size);
+    curl_easy_setopt(h->easy, CURLOPT_POST, 1L);
+    curl_easy_setopt(h->easy, CURLOPT_READFUNCTION, s3_curl_read_cb);
+    curl_easy_setopt(h->easy, CURLOPT_READDATA, h);
+    curl_easy_setopt(h->easy, CURLOPT_POSTFIELDSIZE_LARGE,
+                     (curl_off_t)h->owned_body.size);
+
+    h->headers = curl_slist_append(h->headers, "Content-Type: application/xml");
+
+    if (s3_easy_factory_finish(h, err) != S3_E_OK)
+        goto fail;
+
     *out_handle = h;
     return S3_E_OK;
 
@@ -588,17 +1776,20 @@ fail:
 }
 
 s3_error_code_t
-s3_easy_factory_new_create_bucket(s3_client_t *client,
-                                  const s3_create_bucket_opts_t *opts,
-                                  s3_easy_handle_t **out_handle,
-                                  s3_error_t *error)
+s3_easy_factory_new_mpu_abort(s3_client_t *client,
+                              const s3_put_opts_t *opts,
+                              const char *upload_id,
+                              s3_easy_handle_t **out_handle,
+                              s3_error_t *error)
 {
     s3_error_t local_err = S3_ERROR_INIT;
     s3_error_t *err = error ? error : &local_err;
 
-    if (out_handle == NULL || client == NULL || opts == NULL) {
+    if (out_handle == NULL || client == NULL || opts == NULL ||
+        upload_id == NULL)
+    {
         s3_error_set(err, S3_E_INVALID_ARG,
-                     "client, opts, io or out_handle is NULL", 0, 0, 0);
+                     "invalid arguments for AbortMultipartUpload", 0, 0, 0);
         return err->code;
     }
 
@@ -608,32 +1799,110 @@ s3_easy_factory_new_create_bucket(s3_client_t *client,
                      "Failed to allocate s3_easy_handle", ENOMEM, 0, 0);
         return err->code;
     }
+    h->idempotent = true;
 
-    char *url = NULL;
-    s3_error_code_t rc = s3_build_url(client,
-                                      opts->bucket,
-                                      NULL,
-                                      &url, err);
-    if (rc != S3_E_OK) {
+    if (s3_easy_factory_new_mpu(client, opts, "", upload_id, h, err) != S3_E_OK)
+        goto fail;
+
+    curl_easy_setopt(h->easy, CURLOPT_CUSTOMREQUEST, "DELETE");
+
+    if (s3_easy_factory_finish(h, err) != S3_E_OK)
         goto fail;
+
+    *out_handle = h;
+    return S3_E_OK;
+
+fail:
+    s3_easy_handle_destroy(h);
+    return err->code;
+}
+
+s3_error_code_t
+s3_easy_factory_new_head_bucket(s3_client_t *client,
+                                const char *bucket,
+                                s3_easy_handle_t **out_handle,
+                                s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    if (out_handle == NULL || client == NULL) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client or out_handle is NULL", 0, 0, 0);
+        return err->code;
     }
-    h->url = url;
-    curl_easy_setopt(h->easy, CURLOPT_URL, url);
-    /* PUT без тела. */
-    curl_easy_setopt(h->easy, CURLOPT_UPLOAD, 0L);
-    curl_easy_setopt(h->easy, CURLOPT_CUSTOMREQUEST, "PUT");
+
+    s3_easy_handle_t *h = s3_easy_handle_alloc(client);
+    if (h == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate s3_easy_handle", ENOMEM, 0, 0);
+        return err->code;
+    }
+
+    if (s3_build_url_buf(client, bucket, NULL,
+                         &h->url, &h->url_cap, err) != S3_E_OK)
+        goto fail;
+    curl_easy_setopt(h->easy, CURLOPT_URL, h->url);
+    curl_easy_setopt(h->easy, CURLOPT_NOBODY, 1L);
+    h->idempotent = true;
 
     s3_curl_apply_common_opts(h);
 
-    s3_error_code_t rc2 = s3_curl_apply_sigv4(h, err);
-    if (rc2 != S3_E_OK) {
+    if (s3_curl_apply_sigv4(h, err) != S3_E_OK)
         goto fail;
-    }
 
-    if (h->headers != NULL) {
+    if (h->headers != NULL)
         curl_easy_setopt(h->easy, CURLOPT_HTTPHEADER, h->headers);
+
+    *out_handle = h;
+    return S3_E_OK;
+
+fail:
+    s3_easy_handle_destroy(h);
+    return err->code;
+}
+
+s3_error_code_t
+s3_easy_factory_new_head_object(s3_client_t *client,
+                                const char *bucket,
+                                const char *key,
+                                s3_easy_handle_t **out_handle,
+                                s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    if (out_handle == NULL || client == NULL || key == NULL) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, key or out_handle is NULL", 0, 0, 0);
+        return err->code;
     }
 
+    s3_easy_handle_t *h = s3_easy_handle_alloc(client);
+    if (h == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate s3_easy_handle", ENOMEM, 0, 0);
+        return err->code;
+    }
+
+    if (s3_build_url_buf(client, bucket, key,
+                         &h->url, &h->url_cap, err) != S3_E_OK)
+        goto fail;
+    curl_easy_setopt(h->easy, CURLOPT_URL, h->url);
+    curl_easy_setopt(h->easy, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(h->easy, CURLOPT_HEADERFUNCTION, s3_curl_header_cb);
+    curl_easy_setopt(h->easy, CURLOPT_HEADERDATA, h);
+    h->idempotent = true;
+
+    s3_curl_apply_common_opts(h);
+
+    /* Без него S3 не отдаёт x-amz-checksum-* в ответе. */
+    h->headers = curl_slist_append(h->headers,
+                                   "x-amz-checksum-mode: ENABLED");
+
+    if (s3_easy_factory_finish(h, err) != S3_E_OK)
+        goto fail;
+
     *out_handle = h;
     return S3_E_OK;
 
@@ -667,22 +1936,19 @@ s3_easy_factory_new_list_objects(s3_client_t *client,
     /* Читаем только ответ (XML), запрос без тела. */
     s3_easy_io_init_none(&h->read_io);
 
-    /* Пишем ответ в h->owned_resp (как и в delete_objects). */
-    s3_mem_buf_t *resp = &h->owned_resp;
-    resp->data = NULL;
-    resp->size = 0;
-    resp->capacity = 0;
-    s3_easy_io_init_mem(&h->write_io, resp, 0); /* 0 = без лимита */
+    /* Пишем ответ в h->resp_chain (как и в delete_objects). */
+    s3_easy_io_init_chain(&h->write_io, &h->resp_chain);
 
     h->read_bytes_total = 0;
     h->write_bytes_total = 0;
+    h->idempotent = true;
 
     char *url = NULL;
     s3_error_code_t rc = s3_build_list_url(client, opts, &url, err);
     if (rc != S3_E_OK) {
         goto fail;
     }
-    h->url = url;
+    s3_easy_handle_set_url(h, url);
 
     curl_easy_setopt(h->easy, CURLOPT_URL, url);
     curl_easy_setopt(h->easy, CURLOPT_HTTPGET, 1L);
@@ -743,15 +2009,13 @@ s3_easy_factory_new_delete_objects(s3_client_t *client,
     /* Исходящее тело: читаем XML из памяти. */
     s3_easy_io_init_mem(&h->read_io, body, body->size);
 
-    /* Входящее тело (ответ): сразу собираем в h->owned_resp. */
-    s3_mem_buf_t *resp = &h->owned_resp;
-    resp->data = NULL;
-    resp->size = 0;
-    resp->capacity = 0;
-    s3_easy_io_init_mem(&h->write_io, resp, 0); /* 0 = без лимита */
+    /* Входящее тело (ответ): сразу собираем в h->resp_chain. */
+    s3_easy_io_init_chain(&h->write_io, &h->resp_chain);
 
     h->read_bytes_total  = 0;
     h->write_bytes_total = 0;
+    /* Повторное удаление уже удалённых ключей — не ошибка. */
+    h->idempotent = true;
 
     /* URL: endpoint/bucket?delete */
     char *url = NULL;
@@ -759,7 +2023,7 @@ s3_easy_factory_new_delete_objects(s3_client_t *client,
     if (rc != S3_E_OK) {
         goto fail;
     }
-    h->url = url;
+    s3_easy_handle_set_url(h, url);
 
     curl_easy_setopt(h->easy, CURLOPT_URL, url);
     curl_easy_setopt(h->easy, CURLOPT_POST, 1L);
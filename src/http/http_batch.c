@@ -0,0 +1,269 @@
+#include <errno.h>
+#include <string.h>
+
+#include "s3_internal.h"
+#include "endpoint.h"
+#include "s3/curl_easy_factory.h"
+#include "http_util.h"
+#include "error.h"
+
+/*
+ * Локальный curl_multi в текущем (coio) потоке: выполнить пачку
+ * easy-хендлов одновременно и дождаться всех.
+ *
+ * Используется easy backend'ом для perform_many: общего multi-потока
+ * у него нет, а отдельный CURLM на пачку стоит дешевле, чем N coio-воркеров.
+ *
+ * Хендлы могут принадлежать разным клиентам (put_fanout): endpoint'ы и
+ * статистика берутся из h->client, из client — только лимиты CURLM.
+ */
+s3_error_code_t
+s3_http_batch_perform(s3_client_t *client,
+                      s3_easy_handle_t **handles, size_t count,
+                      s3_error_code_t *codes, s3_error_t *errs,
+                      s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    if (handles == NULL || codes == NULL || errs == NULL) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "invalid batch arguments", 0, 0, 0);
+        return err->code;
+    }
+
+    if (count == 0) {
+        s3_error_clear(err);
+        return S3_E_OK;
+    }
+
+    CURLM *multi = curl_multi_init();
+    if (multi == NULL) {
+        s3_error_set(err, S3_E_INIT, "curl_multi_init failed", 0, 0, 0);
+        return err->code;
+    }
+
+    if (client->max_connections_per_host > 0) {
+        curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS,
+                          (long)client->max_connections_per_host);
+    }
+
+    size_t added = 0;
+    for (size_t i = 0; i < count; i++) {
+        /* Перезапишется, когда запрос завершится. */
+        s3_error_set(&errs[i], S3_E_INTERNAL,
+                     "request in batch did not complete", 0, 0, 0);
+        codes[i] = S3_E_INTERNAL;
+
+        CURL *easy = handles[i]->easy;
+        curl_easy_setopt(easy, CURLOPT_PRIVATE, (void *)&codes[i]);
+        s3_endpoint_begin(handles[i]->client, handles[i]);
+
+        CURLMcode mc = curl_multi_add_handle(multi, easy);
+        if (mc != CURLM_OK) {
+            s3_error_set(&errs[i], S3_E_CURL, curl_multi_strerror(mc),
+                         0, 0, (long)mc);
+            codes[i] = S3_E_CURL;
+            continue;
+        }
+        added++;
+    }
+
+    int still_running = 0;
+    size_t done = 0;
+
+    while (done < added) {
+        CURLMcode mc = curl_multi_perform(multi, &still_running);
+        if (mc != CURLM_OK) {
+            s3_error_set(err, S3_E_CURL, curl_multi_strerror(mc),
+                         0, 0, (long)mc);
+            break;
+        }
+
+        int msgs_in_queue = 0;
+        CURLMsg *msg;
+        while ((msg = curl_multi_info_read(multi, &msgs_in_queue)) != NULL) {
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+
+            s3_error_code_t *code = NULL;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE,
+                              (char **)&code);
+            size_t i = (size_t)(code - codes);
+
+            *code = s3_http_map_result(msg->easy_handle, msg->data.result,
+                                       &errs[i]);
+            s3_http_account(handles[i]->client, msg->easy_handle);
+            s3_endpoint_end(handles[i]->client, handles[i], *code, &errs[i]);
+            done++;
+        }
+
+        if (done < added && still_running > 0) {
+            int numfds = 0;
+            curl_multi_poll(multi, NULL, 0, 1000, &numfds);
+        }
+    }
+
+    /* Для не добавленных хендлов remove_handle — no-op. */
+    for (size_t i = 0; i < count; i++) {
+        curl_multi_remove_handle(multi, handles[i]->easy);
+        s3_endpoint_end(handles[i]->client, handles[i], codes[i], &errs[i]);
+    }
+    curl_multi_cleanup(multi);
+
+    if (done < added)
+        return err->code;
+
+    s3_error_clear(err);
+    return S3_E_OK;
+}
+
+/* Запрос в полёте: хендл и его номер для done. */
+struct s3_http_batch_slot {
+    s3_easy_handle_t *h;
+    size_t i;
+};
+
+s3_error_code_t
+s3_http_batch_run(s3_client_t *client, size_t count, size_t concurrency,
+                  s3_http_batch_start_fn start, s3_http_batch_done_fn done,
+                  void *ctx, s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    if (start == NULL || done == NULL || concurrency == 0) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "invalid batch arguments", 0, 0, 0);
+        return err->code;
+    }
+
+    if (count == 0) {
+        s3_error_clear(err);
+        return S3_E_OK;
+    }
+    if (concurrency > count)
+        concurrency = count;
+
+    struct s3_http_batch_slot *slots =
+        s3_alloc(&client->alloc, concurrency * sizeof(*slots));
+    CURLM *multi = slots != NULL ? curl_multi_init() : NULL;
+    if (multi == NULL) {
+        if (slots == NULL)
+            s3_error_set(err, S3_E_NOMEM, "Out of memory in batch",
+                         ENOMEM, 0, 0);
+        else
+            s3_error_set(err, S3_E_INIT, "curl_multi_init failed", 0, 0, 0);
+        for (size_t i = 0; i < count; i++)
+            done(ctx, i, NULL, err->code, err);
+        if (slots != NULL)
+            s3_free(&client->alloc, slots);
+        return err->code;
+    }
+    memset(slots, 0, concurrency * sizeof(*slots));
+
+    if (client->max_connections_per_host > 0) {
+        curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS,
+                          (long)client->max_connections_per_host);
+    }
+
+    size_t next = 0;
+    size_t running = 0;
+    s3_error_code_t rc = S3_E_OK;
+
+    for (;;) {
+        /* Свободные места — следующим запросам. */
+        for (size_t k = 0; k < concurrency && next < count; k++) {
+            if (slots[k].h != NULL)
+                continue;
+
+            size_t i = next++;
+            s3_easy_handle_t *h = NULL;
+            s3_error_t e = S3_ERROR_INIT;
+            s3_error_code_t code = start(ctx, i, &h, &e);
+            if (code == S3_E_OK) {
+                curl_easy_setopt(h->easy, CURLOPT_PRIVATE,
+                                 (void *)&slots[k]);
+                s3_endpoint_begin(h->client, h);
+
+                CURLMcode mc = curl_multi_add_handle(multi, h->easy);
+                if (mc == CURLM_OK) {
+                    slots[k].h = h;
+                    slots[k].i = i;
+                    running++;
+                    continue;
+                }
+                s3_error_set(&e, S3_E_CURL, curl_multi_strerror(mc),
+                             0, 0, (long)mc);
+                code = S3_E_CURL;
+                s3_endpoint_end(h->client, h, code, &e);
+            }
+            done(ctx, i, h, code, &e);
+        }
+
+        if (running == 0) {
+            if (next < count)
+                continue;
+            break;
+        }
+
+        int still_running = 0;
+        CURLMcode mc = curl_multi_perform(multi, &still_running);
+        if (mc != CURLM_OK) {
+            s3_error_set(err, S3_E_CURL, curl_multi_strerror(mc),
+                         0, 0, (long)mc);
+            rc = err->code;
+            break;
+        }
+
+        size_t finished = 0;
+        int msgs_in_queue = 0;
+        CURLMsg *msg;
+        while ((msg = curl_multi_info_read(multi, &msgs_in_queue)) != NULL) {
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+
+            struct s3_http_batch_slot *slot = NULL;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE,
+                              (char **)&slot);
+            s3_easy_handle_t *h = slot->h;
+
+            s3_error_t e = S3_ERROR_INIT;
+            s3_error_code_t code = s3_http_map_result(msg->easy_handle,
+                                                      msg->data.result, &e);
+            s3_http_account(h->client, msg->easy_handle);
+            curl_multi_remove_handle(multi, h->easy);
+            s3_endpoint_end(h->client, h, code, &e);
+
+            slot->h = NULL;
+            running--;
+            finished++;
+            done(ctx, slot->i, h, code, &e);
+        }
+
+        if (finished == 0 && still_running > 0) {
+            int numfds = 0;
+            curl_multi_poll(multi, NULL, 0, 1000, &numfds);
+        }
+    }
+
+    /* curl_multi сломался: и начатые, и не начатые получают его ошибку. */
+    for (size_t k = 0; k < concurrency; k++) {
+        s3_easy_handle_t *h = slots[k].h;
+        if (h == NULL)
+            continue;
+        curl_multi_remove_handle(multi, h->easy);
+        s3_endpoint_end(h->client, h, rc, err);
+        done(ctx, slots[k].i, h, rc, err);
+    }
+    for (; next < count; next++)
+        done(ctx, next, NULL, rc, err);
+
+    curl_multi_cleanup(multi);
+    s3_free(&client->alloc, slots);
+
+    if (rc != S3_E_OK)
+        return rc;
+    s3_error_clear(err);
+    return S3_E_OK;
+}
@@ -2,6 +2,7 @@
 #include <string.h>
 
 #include "s3_internal.h"
+#include "endpoint.h"
 #include "s3/curl_easy_factory.h"
 #include "s3/alloc.h"
 #include "s3/parser.h"
@@ -16,12 +17,14 @@ struct s3_http_easy_backend {
 };
 
 /*
- * Общий helper: выполнить curl_easy_perform и заполнить s3_error_t.
+ * Одна попытка: выполнить curl_easy_perform и заполнить s3_error_t.
  */
 static s3_error_code_t
-s3_http_easy_perform(s3_easy_handle_t *h,
-                     s3_error_t *error)
+s3_http_easy_perform_once(void *ctx, s3_easy_handle_t *h,
+                          s3_error_t *error)
 {
+    (void)ctx;
+
     s3_error_t local_err = S3_ERROR_INIT;
     s3_error_t *err = error ? error : &local_err;
 
@@ -30,6 +33,7 @@ s3_http_easy_perform(s3_easy_handle_t *h,
 
     CURLcode cc = curl_easy_perform(easy);
     s3_error_code_t code = s3_http_map_curl_error(cc);
+    s3_http_account(h->client, easy);
 
     if (cc != CURLE_OK) {
         s3_error_set(err, code, curl_easy_strerror(cc),
@@ -57,6 +61,20 @@ s3_http_easy_perform(s3_easy_handle_t *h,
     return S3_E_OK;
 }
 
+/*
+ * Общий helper: выполнить запрос (с выбором endpoint'а и повторами).
+ */
+static s3_error_code_t
+s3_http_easy_perform(s3_easy_handle_t *h,
+                     s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    return s3_endpoint_perform(h->client, h, s3_http_easy_perform_once,
+                               NULL, err);
+}
+
 /* ----------------- реализация vtable: PUT / GET ----------------- */
 
 static s3_error_code_t
@@ -179,9 +197,10 @@ s3_http_easy_list_objects(struct s3_http_backend_impl *backend,
 
     code = s3_http_easy_perform(h, err);
 
-    /* После perform ответ лежит в h->owned_resp. */
-    s3_mem_buf_t *resp = &h->owned_resp;
-    const char *xml = resp->data ? resp->data : "";
+    /* После perform ответ лежит в h->resp_chain. */
+    const char *xml = NULL;
+    if (code == S3_E_OK)
+        code = s3_easy_handle_resp(h, &xml, err);
 
     if (code == S3_E_OK) {
         code = s3_parse_list_response(client, xml, out, err);
@@ -224,6 +243,25 @@ s3_http_easy_delete_objects(struct s3_http_backend_impl *backend,
     return code;
 }
 
+static s3_error_code_t
+s3_http_easy_perform_handle(struct s3_http_backend_impl *backend,
+                            s3_easy_handle_t *h,
+                            s3_error_t *error)
+{
+    (void)backend;
+    return s3_http_easy_perform(h, error);
+}
+
+static s3_error_code_t
+s3_http_easy_perform_many(struct s3_http_backend_impl *backend,
+                          s3_easy_handle_t **handles, size_t count,
+                          s3_error_code_t *codes, s3_error_t *errs,
+                          s3_error_t *error)
+{
+    return s3_http_batch_perform(backend->client, handles, count,
+                                 codes, errs, error);
+}
+
 /* ----------------- destroy + фабрика backend'а ----------------- */
 
 static void
@@ -235,8 +273,11 @@ s3_http_easy_destroy(struct s3_http_backend_impl *backend)
     struct s3_http_easy_backend *eb = (struct s3_http_easy_backend *)backend;
     s3_client_t *client = eb->base.client;
 
-    if (client != NULL)
+    if (client != NULL) {
+        s3_http_share_delete(client->share);
+        client->share = NULL;
         s3_free(&client->alloc, eb);
+    }
 }
 
 /* vtable для easy backend'а */
@@ -247,6 +288,8 @@ static const struct s3_http_backend_vtbl s3_http_easy_vtbl = {
     .create_bucket   = s3_http_easy_create_bucket,
     .list_objects    = s3_http_easy_list_objects,
     .delete_objects  = s3_http_easy_delete_objects, 
+    .perform         = s3_http_easy_perform_handle,
+    .perform_many    = s3_http_easy_perform_many,
     .destroy         = s3_http_easy_destroy,
 };
 
@@ -274,5 +317,10 @@ s3_http_easy_backend_new(struct s3_client *client, s3_error_t *error)
     eb->base.vtbl = &s3_http_easy_vtbl;
     eb->base.client = client;
 
+    if (s3_http_share_new(client, &client->share, err) != S3_E_OK) {
+        s3_free(&client->alloc, eb);
+        return NULL;
+    }
+
     return &eb->base;
 }
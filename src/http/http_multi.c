@@ -6,6 +6,7 @@
 #include <stdio.h>
 
 #include "s3_internal.h"
+#include "endpoint.h"
 #include "s3/curl_easy_factory.h"
 #include "s3/parser.h"
 #include "s3/alloc.h"
@@ -16,7 +17,7 @@ typedef struct s3_http_multi_backend s3_http_multi_backend_t;
 
 /*
  * Запрос, который обрабатывается в multi-потоке.
- * Живёт в heap'e, coio-воркер ждёт его завершения.
+ * Живёт на стеке coio-воркера, который ждёт его завершения.
  */
 struct s3_multi_req {
     struct s3_multi_req *next;
@@ -157,6 +158,7 @@ s3_multi_backend_process_done(s3_http_multi_backend_t *mb)
             snprintf(buf, sizeof(buf), "%s", curl_easy_strerror(cc));
         }
 
+        s3_http_account(mb->base.client, easy);
         curl_multi_remove_handle(mb->multi, easy);
 
         pthread_mutex_lock(&mb->mutex);
@@ -241,21 +243,16 @@ s3_multi_thread_main(void *arg)
 /* --------- submit + wait для coio-воркера --------- */
 
 static s3_error_code_t
-s3_http_multi_submit_and_wait(s3_http_multi_backend_t *mb,
-                              s3_easy_handle_t *easy,
-                              s3_error_t *error)
+s3_http_multi_submit_and_wait_once(void *ctx,
+                                   s3_easy_handle_t *easy,
+                                   s3_error_t *error)
 {
+    s3_http_multi_backend_t *mb = (s3_http_multi_backend_t *)ctx;
     s3_error_t local_err = S3_ERROR_INIT;
     s3_error_t *err = error ? error : &local_err;
 
-    struct s3_multi_req *req = s3_alloc(&mb->base.client->alloc, sizeof(*req));
-
-    if (req == NULL) {
-        s3_error_set(err, S3_E_NOMEM,
-                     "Out of memory in multi backend",
-                     ENOMEM, 0, 0);
-        return S3_E_NOMEM;
-    }
+    struct s3_multi_req req_buf;
+    struct s3_multi_req *req = &req_buf;
 
     s3_multi_req_init(req, easy);
 
@@ -263,7 +260,6 @@ s3_http_multi_submit_and_wait(s3_http_multi_backend_t *mb,
 
     if (mb->stop) {
         pthread_mutex_unlock(&mb->mutex);
-        free(req);
         s3_error_set(err, S3_E_INTERNAL,
                      "S3 multi backend is stopping",
                      0, 0, 0);
@@ -291,12 +287,102 @@ s3_http_multi_submit_and_wait(s3_http_multi_backend_t *mb,
     if (error != NULL)
         *error = req->err;
 
-    s3_error_code_t code = req->code;
-
-    s3_free(&mb->base.client->alloc, req);
     /* easy не трогаем – ответственность вызывающей стороны */
+    return req->code;
+}
 
-    return code;
+/*
+ * Выполнить запрос в multi-потоке (с выбором endpoint'а и повторами).
+ */
+static s3_error_code_t
+s3_http_multi_submit_and_wait(s3_http_multi_backend_t *mb,
+                              s3_easy_handle_t *easy,
+                              s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    return s3_endpoint_perform(mb->base.client, easy,
+                               s3_http_multi_submit_and_wait_once, mb, err);
+}
+
+/*
+ * Отдать в multi-поток сразу count хендлов и дождаться всех.
+ * Все запросы попадают в pending под одной блокировкой, так что
+ * multi-поток добавит их в CURLM одной пачкой.
+ */
+static s3_error_code_t
+s3_http_multi_submit_many_and_wait(s3_http_multi_backend_t *mb,
+                                   s3_easy_handle_t **handles, size_t count,
+                                   s3_error_code_t *codes, s3_error_t *errs,
+                                   s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    if (count == 0) {
+        s3_error_clear(err);
+        return S3_E_OK;
+    }
+
+    s3_client_t *client = mb->base.client;
+    struct s3_multi_req *reqs =
+        s3_alloc(&client->alloc, count * sizeof(*reqs));
+    if (reqs == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Out of memory in multi backend",
+                     ENOMEM, 0, 0);
+        return S3_E_NOMEM;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        s3_multi_req_init(&reqs[i], handles[i]);
+        s3_endpoint_begin(client, handles[i]);
+    }
+
+    pthread_mutex_lock(&mb->mutex);
+
+    if (mb->stop) {
+        pthread_mutex_unlock(&mb->mutex);
+        for (size_t i = 0; i < count; i++)
+            s3_endpoint_end(client, handles[i], S3_E_INTERNAL, NULL);
+        s3_free(&client->alloc, reqs);
+        s3_error_set(err, S3_E_INTERNAL,
+                     "S3 multi backend is stopping",
+                     0, 0, 0);
+        return S3_E_INTERNAL;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        struct s3_multi_req *req = &reqs[i];
+        req->next = NULL;
+        if (mb->pending_tail == NULL) {
+            mb->pending_head = mb->pending_tail = req;
+        } else {
+            mb->pending_tail->next = req;
+            mb->pending_tail = req;
+        }
+    }
+
+    s3_multi_backend_wakeup(mb);
+
+    for (size_t i = 0; i < count; i++) {
+        while (!reqs[i].done)
+            pthread_cond_wait(&mb->cond, &mb->mutex);
+    }
+
+    pthread_mutex_unlock(&mb->mutex);
+
+    for (size_t i = 0; i < count; i++) {
+        codes[i] = reqs[i].code;
+        errs[i] = reqs[i].err;
+        s3_endpoint_end(client, handles[i], codes[i], &errs[i]);
+    }
+
+    s3_free(&client->alloc, reqs);
+
+    s3_error_clear(err);
+    return S3_E_OK;
 }
 
 /* --------- реализация vtable: PUT / GET --------- */
@@ -422,8 +508,10 @@ s3_http_multi_list_objects(struct s3_http_backend_impl *backend,
 
     code = s3_http_multi_submit_and_wait(mb, h, err);
 
-    s3_mem_buf_t *resp = &h->owned_resp;
-    const char *xml = resp->data ? resp->data : "";
+    /* После perform ответ лежит в h->resp_chain. */
+    const char *xml = NULL;
+    if (code == S3_E_OK)
+        code = s3_easy_handle_resp(h, &xml, err);
 
     if (code == S3_E_OK) {
         code = s3_parse_list_response(client, xml, out, err);
@@ -466,6 +554,26 @@ s3_http_multi_delete_objects(struct s3_http_backend_impl *backend,
     return code;
 }
 
+static s3_error_code_t
+s3_http_multi_perform(struct s3_http_backend_impl *backend,
+                      s3_easy_handle_t *h,
+                      s3_error_t *error)
+{
+    s3_http_multi_backend_t *mb = (s3_http_multi_backend_t *)backend;
+    return s3_http_multi_submit_and_wait(mb, h, error);
+}
+
+static s3_error_code_t
+s3_http_multi_perform_many(struct s3_http_backend_impl *backend,
+                           s3_easy_handle_t **handles, size_t count,
+                           s3_error_code_t *codes, s3_error_t *errs,
+                           s3_error_t *error)
+{
+    s3_http_multi_backend_t *mb = (s3_http_multi_backend_t *)backend;
+    return s3_http_multi_submit_many_and_wait(mb, handles, count,
+                                              codes, errs, error);
+}
+
 /* --------- destroy + фабрика backend'а --------- */
 
 static void
@@ -513,6 +621,8 @@ static const struct s3_http_backend_vtbl s3_http_multi_vtbl = {
     .create_bucket   = s3_http_multi_create_bucket,
     .list_objects    = s3_http_multi_list_objects,
     .delete_objects  = s3_http_multi_delete_objects,
+    .perform         = s3_http_multi_perform,
+    .perform_many    = s3_http_multi_perform_many,
     .destroy         = s3_http_multi_destroy,
 };
 
@@ -557,6 +667,27 @@ s3_http_multi_backend_new(struct s3_client *client, s3_error_t *error)
        curl_multi_setopt(mb->multi, CURLMOPT_MAX_HOST_CONNECTIONS,
                        (long)client->max_connections_per_host);
     }
+    /*
+     * HTTP/2: до max_concurrent_streams запросов на одном соединении.
+     * Тогда max_total_connections ограничивает сокеты, а не параллелизм.
+     */
+    if (client->flags & S3_CLIENT_F_HTTP2) {
+       curl_multi_setopt(mb->multi, CURLMOPT_PIPELINING,
+                       (long)CURLPIPE_MULTIPLEX);
+#if LIBCURL_VERSION_NUM >= 0x074300 /* 7.67.0 */
+       curl_multi_setopt(mb->multi, CURLMOPT_MAX_CONCURRENT_STREAMS,
+                       (long)client->max_concurrent_streams);
+#endif
+    }
+    /*
+     * По умолчанию кэш соединений — 4 * число хендлов в CURLM, и
+     * простаивающие (в т.ч. прогретые) соединения закрываются, как только
+     * запросов становится меньше. Держим до max_total_connections.
+     */
+    if (client->max_total_connections > 0) {
+       curl_multi_setopt(mb->multi, CURLMOPT_MAXCONNECTS,
+                       (long)client->max_total_connections);
+    }
 
     pthread_mutex_init(&mb->mutex, NULL);
     pthread_cond_init(&mb->cond, NULL);
@@ -0,0 +1,1347 @@
+#define _GNU_SOURCE 1
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+#include "s3_internal.h"
+#include "s3/curl_easy_factory.h"
+#include "http_util.h"
+#include "error.h"
+
+/*
+ * Backend без libcurl для plain-HTTP endpoint'ов (S3_HTTP_BACKEND_NATIVE).
+ *
+ * put_fd и get_fd — минимальный HTTP/1.1 клиент с keep-alive: тело PUT
+ * уходит из файла в сокет через sendfile, тело GET — из сокета в файл
+ * через splice (сокет -> pipe -> файл), байты не проходят через
+ * user space. Как и у easy backend'а, запрос целиком выполняется на
+ * coio-воркере: блокирующий сокет, на весь запрос — один срок
+ * request_timeout_ms. Перед каждым send/recv/splice остаток срока
+ * выставляется в SO_RCVTIMEO/SO_SNDTIMEO, так что медленный сервер,
+ * отдающий по байту, не растянет запрос сверх таймаута.
+ *
+ * Остальные операции (LIST, DELETE, multipart, perform/perform_many
+ * готовых easy-хендлов) делегируются вложенному curl easy backend'у.
+ *
+ * Поддерживается один endpoint вида http://host[:port]; TLS нет.
+ * Адреса только path-style (http://host/bucket/key), поэтому клиенту
+ * нужен S3_CLIENT_F_FORCE_PATH_STYLE.
+ */
+
+#define S3_NATIVE_BUF_SIZE   (16 * 1024)
+#define S3_NATIVE_SPLICE_MAX (1024 * 1024)
+#define S3_NATIVE_ERR_BODY   4096
+
+struct s3_native_conn {
+    struct s3_native_conn *next;
+    int sock;
+    int pipe[2];       /* для splice, создаётся при первом GET */
+    bool reused;       /* взят из пула: сервер мог уже закрыть */
+    uint64_t deadline; /* CLOCK_MONOTONIC, мс; 0 — без таймаута */
+
+    /* Принятые, но ещё не разобранные байты. */
+    char buf[S3_NATIVE_BUF_SIZE];
+    size_t pos;
+    size_t len;
+};
+
+struct s3_native_resp {
+    int status;
+    int64_t content_length; /* -1 — нет заголовка */
+    bool chunked;
+    bool close;             /* Connection: close */
+};
+
+struct s3_http_native_backend {
+    struct s3_http_backend_impl base;
+
+    /* Всё, кроме put_fd/get_fd. */
+    struct s3_http_backend_impl *curl;
+
+    char host[256];
+    char port[8];
+    char host_hdr[272];      /* значение Host: */
+    char *path_prefix;       /* путь из endpoint'а без завершающего '/' */
+
+    pthread_mutex_t mutex;
+    struct s3_native_conn *idle;
+    size_t idle_count;
+    size_t idle_max;
+};
+
+/* ----------------- соединения ----------------- */
+
+static void
+s3_native_conn_close(struct s3_http_native_backend *nb,
+                     struct s3_native_conn *conn)
+{
+    if (conn->sock >= 0)
+        close(conn->sock);
+    if (conn->pipe[0] >= 0) {
+        close(conn->pipe[0]);
+        close(conn->pipe[1]);
+    }
+    s3_free(&nb->base.client->alloc, conn);
+}
+
+static int
+s3_native_connect_one(const struct addrinfo *ai, uint32_t timeout_ms)
+{
+    int s = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+                   ai->ai_protocol);
+    if (s < 0)
+        return -1;
+
+    int flags = fcntl(s, F_GETFL, 0);
+    fcntl(s, F_SETFL, flags | O_NONBLOCK);
+
+    if (connect(s, ai->ai_addr, ai->ai_addrlen) != 0) {
+        if (errno != EINPROGRESS)
+            goto fail;
+
+        struct pollfd pfd = { .fd = s, .events = POLLOUT };
+        int rc;
+        do {
+            rc = poll(&pfd, 1, timeout_ms > 0 ? (int)timeout_ms : -1);
+        } while (rc < 0 && errno == EINTR);
+        if (rc <= 0) {
+            if (rc == 0)
+                errno = ETIMEDOUT;
+            goto fail;
+        }
+
+        int so_err = 0;
+        socklen_t len = sizeof(so_err);
+        getsockopt(s, SOL_SOCKET, SO_ERROR, &so_err, &len);
+        if (so_err != 0) {
+            errno = so_err;
+            goto fail;
+        }
+    }
+
+    fcntl(s, F_SETFL, flags);
+    return s;
+
+fail:;
+    int saved = errno;
+    close(s);
+    errno = saved;
+    return -1;
+}
+
+static s3_error_code_t
+s3_native_connect(struct s3_http_native_backend *nb,
+                  struct s3_native_conn **out, s3_error_t *err)
+{
+    s3_client_t *c = nb->base.client;
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo *res = NULL;
+    int gai = getaddrinfo(nb->host, nb->port, &hints, &res);
+    if (gai != 0) {
+        s3_error_set(err, S3_E_IO, gai_strerror(gai), 0, 0, 0);
+        return err->code;
+    }
+
+    int s = -1;
+    for (struct addrinfo *ai = res; ai != NULL && s < 0; ai = ai->ai_next)
+        s = s3_native_connect_one(ai, c->connect_timeout_ms);
+    int saved = errno;
+    freeaddrinfo(res);
+
+    if (s < 0) {
+        s3_error_set(err, saved == ETIMEDOUT ? S3_E_TIMEOUT : S3_E_IO,
+                     "connect failed", saved, 0, 0);
+        return err->code;
+    }
+
+    int one = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    struct s3_native_conn *conn =
+        (struct s3_native_conn *)s3_alloc(&c->alloc, sizeof(*conn));
+    if (conn == NULL) {
+        close(s);
+        s3_error_set(err, S3_E_NOMEM,
+                     "Out of memory in native backend", ENOMEM, 0, 0);
+        return err->code;
+    }
+    conn->next = NULL;
+    conn->sock = s;
+    conn->pipe[0] = conn->pipe[1] = -1;
+    conn->reused = false;
+    conn->deadline = 0;
+    conn->pos = conn->len = 0;
+
+    __atomic_add_fetch(&c->stat_connections, 1, __ATOMIC_RELAXED);
+    *out = conn;
+    return S3_E_OK;
+}
+
+static uint64_t
+s3_native_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/* Срок запроса, начатого сейчас; 0 — request_timeout_ms не задан. */
+static uint64_t
+s3_native_deadline(struct s3_http_native_backend *nb)
+{
+    uint32_t timeout_ms = nb->base.client->request_timeout_ms;
+    return timeout_ms > 0 ? s3_native_now_ms() + timeout_ms : 0;
+}
+
+static s3_error_code_t
+s3_native_conn_get(struct s3_http_native_backend *nb,
+                   struct s3_native_conn **out, s3_error_t *err)
+{
+    pthread_mutex_lock(&nb->mutex);
+    struct s3_native_conn *conn = nb->idle;
+    if (conn != NULL) {
+        nb->idle = conn->next;
+        nb->idle_count--;
+    }
+    pthread_mutex_unlock(&nb->mutex);
+
+    if (conn != NULL) {
+        conn->next = NULL;
+        conn->reused = true;
+        *out = conn;
+        return S3_E_OK;
+    }
+    return s3_native_connect(nb, out, err);
+}
+
+/* Вернуть соединение в пул (keep) или закрыть. */
+static void
+s3_native_conn_put(struct s3_http_native_backend *nb,
+                   struct s3_native_conn *conn, bool keep)
+{
+    /* Лишние байты после ответа — протокол сломан, не переиспользуем. */
+    if (keep && conn->pos == conn->len) {
+        conn->pos = conn->len = 0;
+        pthread_mutex_lock(&nb->mutex);
+        if (nb->idle_count < nb->idle_max) {
+            conn->next = nb->idle;
+            nb->idle = conn;
+            nb->idle_count++;
+            conn = NULL;
+        }
+        pthread_mutex_unlock(&nb->mutex);
+    }
+    if (conn != NULL)
+        s3_native_conn_close(nb, conn);
+}
+
+/* ----------------- ввод/вывод ----------------- */
+
+static s3_error_code_t
+s3_native_io_error(s3_error_t *err, const char *what)
+{
+    int e = errno;
+    if (e == EAGAIN || e == EWOULDBLOCK || e == ETIMEDOUT) {
+        s3_error_set(err, S3_E_TIMEOUT, "request timed out", e, 0, 0);
+    } else {
+        s3_error_set(err, S3_E_IO, what, e, 0, 0);
+    }
+    return err->code;
+}
+
+/*
+ * Остаток срока запроса — в таймауты сокета перед блокирующим вызовом.
+ * -1 и errno = ETIMEDOUT, если срок уже вышел.
+ */
+static int
+s3_native_arm(struct s3_native_conn *conn)
+{
+    if (conn->deadline == 0)
+        return 0;
+
+    uint64_t now = s3_native_now_ms();
+    if (now >= conn->deadline) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+    uint64_t left = conn->deadline - now;
+    struct timeval tv;
+    tv.tv_sec = (time_t)(left / 1000);
+    tv.tv_usec = (suseconds_t)(left % 1000) * 1000;
+    setsockopt(conn->sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(conn->sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    return 0;
+}
+
+static int
+s3_native_send_all(struct s3_native_conn *conn, const char *data, size_t len,
+                   int flags)
+{
+    while (len > 0) {
+        if (s3_native_arm(conn) != 0)
+            return -1;
+        ssize_t n = send(conn->sock, data, len, flags | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Дочитать в conn->buf; 0 — EOF, -1 — ошибка. */
+static ssize_t
+s3_native_fill(struct s3_native_conn *conn)
+{
+    if (conn->pos == conn->len)
+        conn->pos = conn->len = 0;
+    if (conn->len == sizeof(conn->buf)) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    ssize_t n;
+    do {
+        if (s3_native_arm(conn) != 0)
+            return -1;
+        n = recv(conn->sock, conn->buf + conn->len,
+                 sizeof(conn->buf) - conn->len, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n > 0)
+        conn->len += (size_t)n;
+    return n;
+}
+
+static int
+s3_native_pwrite_all(int fd, const char *data, size_t len, off_t off)
+{
+    while (len > 0) {
+        ssize_t n = pwrite(fd, data, len, off);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+        off += n;
+    }
+    return 0;
+}
+
+/*
+ * Прочитать и разобрать статус и заголовки ответа.
+ * *stale — соединение оказалось закрыто до первого байта ответа.
+ */
+static s3_error_code_t
+s3_native_read_head(struct s3_native_conn *conn, struct s3_native_resp *resp,
+                    bool *stale, s3_error_t *err)
+{
+    memset(resp, 0, sizeof(*resp));
+    resp->content_length = -1;
+    *stale = false;
+
+    char *end = NULL;
+    while ((end = memmem(conn->buf + conn->pos, conn->len - conn->pos,
+                         "\r\n\r\n", 4)) == NULL)
+    {
+        /* Заголовки должны влезть в буфер целиком. */
+        if (conn->pos > 0) {
+            memmove(conn->buf, conn->buf + conn->pos, conn->len - conn->pos);
+            conn->len -= conn->pos;
+            conn->pos = 0;
+        }
+        ssize_t n = s3_native_fill(conn);
+        if (n == 0) {
+            *stale = conn->len == 0;
+            s3_error_set(err, S3_E_IO,
+                         "connection closed before response", 0, 0, 0);
+            return err->code;
+        }
+        if (n < 0) {
+            *stale = conn->len == 0 && (errno == ECONNRESET || errno == EPIPE);
+            return s3_native_io_error(err, "failed to read response");
+        }
+    }
+
+    char *line = conn->buf + conn->pos;
+    *end = '\0';
+    conn->pos = (size_t)(end + 4 - conn->buf);
+
+    /* HTTP/1.1 200 OK */
+    if (strncmp(line, "HTTP/1.", 7) != 0 || strlen(line) < 12) {
+        s3_error_set(err, S3_E_IO, "malformed HTTP response", 0, 0, 0);
+        return err->code;
+    }
+    resp->status = atoi(line + 9);
+    if (line[7] == '0')
+        resp->close = true; /* HTTP/1.0 без keep-alive */
+
+    char *save = NULL;
+    strtok_r(line, "\r\n", &save);
+    for (char *h = strtok_r(NULL, "\r\n", &save); h != NULL;
+         h = strtok_r(NULL, "\r\n", &save))
+    {
+        char *colon = strchr(h, ':');
+        if (colon == NULL)
+            continue;
+        *colon = '\0';
+        char *v = colon + 1;
+        while (*v == ' ' || *v == '\t')
+            v++;
+
+        if (strcasecmp(h, "Content-Length") == 0)
+            resp->content_length = strtoll(v, NULL, 10);
+        else if (strcasecmp(h, "Transfer-Encoding") == 0)
+            resp->chunked = strcasestr(v, "chunked") != NULL;
+        else if (strcasecmp(h, "Connection") == 0)
+            resp->close = strcasestr(v, "close") != NULL;
+    }
+    return S3_E_OK;
+}
+
+/*
+ * Разбор тела ответа в chunked: вызывает sink для каждого куска.
+ * Тела S3/MinIO обычно с Content-Length, поэтому здесь без splice.
+ */
+typedef int (*s3_native_sink_fn)(void *ctx, const char *data, size_t len);
+
+static s3_error_code_t
+s3_native_read_chunked(struct s3_native_conn *conn,
+                       s3_native_sink_fn sink, void *ctx, s3_error_t *err)
+{
+    for (;;) {
+        char *eol;
+        while ((eol = memmem(conn->buf + conn->pos, conn->len - conn->pos,
+                             "\r\n", 2)) == NULL)
+        {
+            if (conn->pos > 0) {
+                memmove(conn->buf, conn->buf + conn->pos,
+                        conn->len - conn->pos);
+                conn->len -= conn->pos;
+                conn->pos = 0;
+            }
+            ssize_t n = s3_native_fill(conn);
+            if (n <= 0)
+                return s3_native_io_error(err, "failed to read chunk");
+        }
+
+        size_t chunk = strtoul(conn->buf + conn->pos, NULL, 16);
+        conn->pos = (size_t)(eol + 2 - conn->buf);
+
+        /* chunk + "\r\n"; у последнего (0) — пустой трейлер "\r\n". */
+        size_t left = chunk + 2;
+        while (left > 0) {
+            if (conn->pos == conn->len) {
+                ssize_t n = s3_native_fill(conn);
+                if (n <= 0)
+                    return s3_native_io_error(err, "failed to read chunk");
+            }
+            size_t avail = conn->len - conn->pos;
+            if (avail > left)
+                avail = left;
+            size_t data = left > 2 ? left - 2 : 0;
+            if (data > avail)
+                data = avail;
+            if (data > 0 && sink(ctx, conn->buf + conn->pos, data) != 0) {
+                s3_error_set(err, S3_E_IO, "failed to write response body",
+                             errno, 0, 0);
+                return err->code;
+            }
+            conn->pos += avail;
+            left -= avail;
+        }
+        if (chunk == 0)
+            return S3_E_OK;
+    }
+}
+
+/* Прочитать тело по Content-Length в sink через буфер соединения. */
+static s3_error_code_t
+s3_native_read_body(struct s3_native_conn *conn, uint64_t len,
+                    s3_native_sink_fn sink, void *ctx, s3_error_t *err)
+{
+    while (len > 0) {
+        if (conn->pos == conn->len) {
+            ssize_t n = s3_native_fill(conn);
+            if (n == 0) {
+                s3_error_set(err, S3_E_IO,
+                             "connection closed in response body", 0, 0, 0);
+                return err->code;
+            }
+            if (n < 0)
+                return s3_native_io_error(err, "failed to read response");
+        }
+        size_t avail = conn->len - conn->pos;
+        if (avail > len)
+            avail = (size_t)len;
+        if (sink != NULL && sink(ctx, conn->buf + conn->pos, avail) != 0) {
+            s3_error_set(err, S3_E_IO, "failed to write response body",
+                         errno, 0, 0);
+            return err->code;
+        }
+        conn->pos += avail;
+        len -= avail;
+    }
+    return S3_E_OK;
+}
+
+static int
+s3_native_sink_discard(void *ctx, const char *data, size_t len)
+{
+    (void)ctx;
+    (void)data;
+    (void)len;
+    return 0;
+}
+
+/* Тело ответа с ошибкой: прочитать и выбросить, чтобы сохранить соединение. */
+static bool
+s3_native_drain(struct s3_native_conn *conn, const struct s3_native_resp *resp)
+{
+    s3_error_t tmp = S3_ERROR_INIT;
+    if (resp->chunked)
+        return s3_native_read_chunked(conn, s3_native_sink_discard, NULL,
+                                      &tmp) == S3_E_OK;
+    if (resp->content_length < 0)
+        return false;
+    if (resp->content_length > S3_NATIVE_ERR_BODY)
+        return false; /* дешевле переподключиться */
+    return s3_native_read_body(conn, (uint64_t)resp->content_length,
+                               NULL, NULL, &tmp) == S3_E_OK;
+}
+
+/* ----------------- запрос: строка, заголовки, подпись ----------------- */
+
+/* URI-encode по правилам SigV4; '/' в ключе не кодируется. */
+static s3_error_code_t
+s3_native_append_encoded(s3_client_t *c, s3_mem_buf_t *b, const char *s,
+                         s3_error_t *err)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    for (; *s != '\0'; s++) {
+        unsigned char ch = (unsigned char)*s;
+        if ((ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') ||
+            (ch >= '0' && ch <= '9') || ch == '-' || ch == '_' ||
+            ch == '.' || ch == '~' || ch == '/')
+        {
+            if (s3_mem_buf_append(c, b, (const char *)&ch, 1, err) != S3_E_OK)
+                return err->code;
+        } else {
+            char e[3] = { '%', hex[ch >> 4], hex[ch & 0xF] };
+            if (s3_mem_buf_append(c, b, e, 3, err) != S3_E_OK)
+                return err->code;
+        }
+    }
+    return S3_E_OK;
+}
+
+static void
+s3_native_hmac(const void *key, size_t key_len, const char *msg,
+               unsigned char out[32])
+{
+    unsigned int len = 32;
+    HMAC(EVP_sha256(), key, (int)key_len,
+         (const unsigned char *)msg, strlen(msg), out, &len);
+}
+
+static void
+s3_native_hex(const unsigned char *in, size_t len, char *out)
+{
+    static const char hex[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; i++) {
+        out[2 * i] = hex[in[i] >> 4];
+        out[2 * i + 1] = hex[in[i] & 0xF];
+    }
+    out[2 * len] = '\0';
+}
+
+/*
+ * Заголовки авторизации для method + path (уже закодирован).
+ * SigV4 с UNSIGNED-PAYLOAD: тело не хэшируется, его можно отдать
+ * через sendfile. Без require_sigv4 — Basic, как у curl backend'ов.
+ */
+static s3_error_code_t
+s3_native_append_auth(struct s3_http_native_backend *nb, s3_mem_buf_t *b,
+                      const char *method, const char *path, s3_error_t *err)
+{
+    s3_client_t *c = nb->base.client;
+    char line[1024];
+
+    if (!c->require_sigv4) {
+        char cred[512];
+        int n = snprintf(cred, sizeof(cred), "%s:%s",
+                         c->access_key, c->secret_key);
+        char b64[700];
+        if (n <= 0 || (size_t)n >= sizeof(cred) ||
+            s3_base64_encode((const unsigned char *)cred, (size_t)n,
+                             b64, sizeof(b64)) < 0)
+        {
+            s3_error_set(err, S3_E_INVALID_ARG,
+                         "credentials are too long", 0, 0, 0);
+            return err->code;
+        }
+        snprintf(line, sizeof(line), "Authorization: Basic %s\r\n", b64);
+        if (s3_mem_buf_append(c, b, line, strlen(line), err) != S3_E_OK)
+            return err->code;
+        goto token;
+    }
+
+    time_t now = time(NULL);
+    struct tm tm;
+    gmtime_r(&now, &tm);
+    char amz_date[17], day[9];
+    strftime(amz_date, sizeof(amz_date), "%Y%m%dT%H%M%SZ", &tm);
+    strftime(day, sizeof(day), "%Y%m%d", &tm);
+
+    const char *signed_headers = c->session_token != NULL ?
+        "host;x-amz-content-sha256;x-amz-date;x-amz-security-token" :
+        "host;x-amz-content-sha256;x-amz-date";
+
+    /* Каноничный запрос. */
+    s3_mem_buf_t creq = { NULL, 0, 0 };
+    char *parts[] = {
+        (char *)method, "\n", (char *)path, "\n\n",
+        "host:", nb->host_hdr, "\n",
+        "x-amz-content-sha256:UNSIGNED-PAYLOAD\n",
+        "x-amz-date:", amz_date, "\n",
+    };
+    for (size_t i = 0; i < sizeof(parts) / sizeof(parts[0]); i++) {
+        if (s3_mem_buf_append(c, &creq, parts[i], strlen(parts[i]),
+                              err) != S3_E_OK)
+            goto fail;
+    }
+    if (c->session_token != NULL) {
+        if (s3_mem_buf_append(c, &creq, "x-amz-security-token:", 21,
+                              err) != S3_E_OK ||
+            s3_mem_buf_append(c, &creq, c->session_token,
+                              strlen(c->session_token), err) != S3_E_OK ||
+            s3_mem_buf_append(c, &creq, "\n", 1, err) != S3_E_OK)
+            goto fail;
+    }
+    if (s3_mem_buf_append(c, &creq, "\n", 1, err) != S3_E_OK ||
+        s3_mem_buf_append(c, &creq, signed_headers, strlen(signed_headers),
+                          err) != S3_E_OK ||
+        s3_mem_buf_append(c, &creq, "\nUNSIGNED-PAYLOAD", 17, err) != S3_E_OK)
+        goto fail;
+
+    unsigned char md[32];
+    char creq_hash[65];
+    EVP_Digest(creq.data, creq.size, md, NULL, EVP_sha256(), NULL);
+    s3_native_hex(md, 32, creq_hash);
+    s3_free(&c->alloc, creq.data);
+
+    char scope[128];
+    snprintf(scope, sizeof(scope), "%s/%s/s3/aws4_request", day, c->region);
+
+    char sts[256];
+    snprintf(sts, sizeof(sts), "AWS4-HMAC-SHA256\n%s\n%s\n%s",
+             amz_date, scope, creq_hash);
+
+    /* kSigning = HMAC(HMAC(HMAC(HMAC("AWS4"+secret, day), region), "s3"), "aws4_request") */
+    char ksecret[256];
+    int kn = snprintf(ksecret, sizeof(ksecret), "AWS4%s", c->secret_key);
+    if (kn <= 0 || (size_t)kn >= sizeof(ksecret)) {
+        s3_error_set(err, S3_E_SIGV4, "secret_key is too long", 0, 0, 0);
+        return err->code;
+    }
+    unsigned char k1[32], k2[32], k3[32], k4[32], sig[32];
+    s3_native_hmac(ksecret, (size_t)kn, day, k1);
+    s3_native_hmac(k1, 32, c->region, k2);
+    s3_native_hmac(k2, 32, "s3", k3);
+    s3_native_hmac(k3, 32, "aws4_request", k4);
+    s3_native_hmac(k4, 32, sts, sig);
+    char sig_hex[65];
+    s3_native_hex(sig, 32, sig_hex);
+
+    snprintf(line, sizeof(line),
+             "x-amz-content-sha256: UNSIGNED-PAYLOAD\r\n"
+             "x-amz-date: %s\r\n"
+             "Authorization: AWS4-HMAC-SHA256 Credential=%s/%s, "
+             "SignedHeaders=%s, Signature=%s\r\n",
+             amz_date, c->access_key, scope, signed_headers, sig_hex);
+    if (s3_mem_buf_append(c, b, line, strlen(line), err) != S3_E_OK)
+        return err->code;
+
+token:
+    if (c->session_token != NULL) {
+        if (s3_mem_buf_append(c, b, "x-amz-security-token: ", 22,
+                              err) != S3_E_OK ||
+            s3_mem_buf_append(c, b, c->session_token,
+                              strlen(c->session_token), err) != S3_E_OK ||
+            s3_mem_buf_append(c, b, "\r\n", 2, err) != S3_E_OK)
+            return err->code;
+    }
+    return S3_E_OK;
+
+fail:
+    if (creq.data != NULL)
+        s3_free(&c->alloc, creq.data);
+    return err->code;
+}
+
+/*
+ * Начало запроса: "METHOD path HTTP/1.1", Host, авторизация.
+ * Остальные заголовки и пустую строку дописывает вызывающий.
+ */
+static s3_error_code_t
+s3_native_build_head(struct s3_http_native_backend *nb, s3_mem_buf_t *b,
+                     const char *method, const char *bucket, const char *key,
+                     s3_error_t *err)
+{
+    s3_client_t *c = nb->base.client;
+
+    if (bucket == NULL)
+        bucket = c->default_bucket;
+    if (bucket == NULL || key == NULL) {
+        s3_error_set(err, S3_E_INVALID_ARG, "bucket and key must be set",
+                     0, 0, 0);
+        return err->code;
+    }
+
+    s3_mem_buf_t path = { NULL, 0, 0 };
+    if (s3_mem_buf_append(c, &path, nb->path_prefix,
+                          strlen(nb->path_prefix), err) != S3_E_OK ||
+        s3_mem_buf_append(c, &path, "/", 1, err) != S3_E_OK ||
+        s3_native_append_encoded(c, &path, bucket, err) != S3_E_OK ||
+        s3_mem_buf_append(c, &path, "/", 1, err) != S3_E_OK ||
+        s3_native_append_encoded(c, &path, key, err) != S3_E_OK)
+        goto out;
+
+    char line[320];
+    if (s3_mem_buf_append(c, b, method, strlen(method), err) != S3_E_OK ||
+        s3_mem_buf_append(c, b, " ", 1, err) != S3_E_OK ||
+        s3_mem_buf_append(c, b, path.data, path.size, err) != S3_E_OK)
+        goto out;
+    snprintf(line, sizeof(line), " HTTP/1.1\r\nHost: %s\r\n", nb->host_hdr);
+    if (s3_mem_buf_append(c, b, line, strlen(line), err) != S3_E_OK)
+        goto out;
+
+    s3_native_append_auth(nb, b, method, path.data, err);
+
+out:
+    if (path.data != NULL)
+        s3_free(&c->alloc, path.data);
+    return err->code;
+}
+
+static s3_error_code_t
+s3_native_status_error(const struct s3_native_resp *resp, s3_error_t *err)
+{
+    s3_error_code_t code = s3_http_map_http_status(resp->status);
+    if (code == S3_E_OK) {
+        s3_error_clear(err);
+        err->http_status = resp->status;
+        return S3_E_OK;
+    }
+    char msg[64];
+    snprintf(msg, sizeof(msg), "HTTP status %d", resp->status);
+    s3_error_set(err, code, msg, 0, resp->status, 0);
+    return code;
+}
+
+/* ----------------- PUT: файл -> сокет через sendfile ----------------- */
+
+static s3_error_code_t
+s3_native_send_file(struct s3_native_conn *conn, int fd, off_t offset,
+                    size_t size, s3_error_t *err)
+{
+    bool use_sendfile = true;
+    char buf[S3_NATIVE_BUF_SIZE];
+
+    while (size > 0) {
+        ssize_t n;
+        if (use_sendfile) {
+            if (s3_native_arm(conn) != 0)
+                return s3_native_io_error(err, "failed to send body");
+            n = sendfile(conn->sock, fd, &offset, size);
+            if (n < 0 && (errno == EINVAL || errno == ENOSYS)) {
+                /* fd без поддержки sendfile (pipe и т.п.) */
+                use_sendfile = false;
+                continue;
+            }
+        } else {
+            size_t want = size < sizeof(buf) ? size : sizeof(buf);
+            n = pread(fd, buf, want, offset);
+            if (n > 0) {
+                if (s3_native_send_all(conn, buf, (size_t)n, 0) != 0)
+                    return s3_native_io_error(err, "failed to send body");
+                offset += n;
+            }
+        }
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return s3_native_io_error(err, "failed to send body");
+        }
+        if (n == 0) {
+            s3_error_set(err, S3_E_IO, "unexpected EOF in PUT source",
+                         0, 0, 0);
+            return err->code;
+        }
+        size -= (size_t)n;
+    }
+    return S3_E_OK;
+}
+
+static s3_error_code_t
+s3_http_native_put_fd(struct s3_http_backend_impl *backend,
+                      const s3_put_opts_t *opts,
+                      int fd, off_t offset, size_t size,
+                      s3_error_t *error)
+{
+    struct s3_http_native_backend *nb =
+        (struct s3_http_native_backend *)backend;
+    s3_client_t *c = nb->base.client;
+
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    if (fd < 0 || size == 0) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "invalid fd or size for PUT", 0, 0, 0);
+        return err->code;
+    }
+    /* Подпись здесь покрывает только host и x-amz-content-sha256/date. */
+    if (opts->checksum_sha256 != NULL) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "checksum_sha256 is not supported by native backend",
+                     0, 0, 0);
+        return err->code;
+    }
+    if (opts->content_length > 0)
+        size = (size_t)opts->content_length;
+
+    s3_mem_buf_t head = { NULL, 0, 0 };
+    if (s3_native_build_head(nb, &head, "PUT", opts->bucket, opts->key,
+                             err) != S3_E_OK)
+        goto out;
+
+    char line[320];
+    snprintf(line, sizeof(line), "Content-Length: %zu\r\n", size);
+    if (s3_mem_buf_append(c, &head, line, strlen(line), err) != S3_E_OK)
+        goto out;
+    if (opts->content_type != NULL) {
+        snprintf(line, sizeof(line), "Content-Type: %s\r\n",
+                 opts->content_type);
+        if (s3_mem_buf_append(c, &head, line, strlen(line), err) != S3_E_OK)
+            goto out;
+    }
+    if (s3_mem_buf_append(c, &head, "\r\n", 2, err) != S3_E_OK)
+        goto out;
+
+    /*
+     * Соединение из пула могло быть закрыто сервером по простою —
+     * тогда один раз повторяем на новом, в пределах того же срока.
+     */
+    uint64_t deadline = s3_native_deadline(nb);
+    for (int attempt = 0; attempt < 2; attempt++) {
+        struct s3_native_conn *conn = NULL;
+        if (s3_native_conn_get(nb, &conn, err) != S3_E_OK)
+            goto out;
+        conn->deadline = deadline;
+
+        bool stale = false;
+        struct s3_native_resp resp;
+        if (s3_native_send_all(conn, head.data, head.size, MSG_MORE) != 0)
+        {
+            stale = conn->reused && (errno == EPIPE || errno == ECONNRESET);
+            s3_native_io_error(err, "failed to send request");
+        } else if (s3_native_send_file(conn, fd, offset, size,
+                                       err) != S3_E_OK)
+        {
+            /* Сервер закрыл соединение из пула, пока мы слали тело. */
+            stale = conn->reused && (err->os_error == EPIPE ||
+                                     err->os_error == ECONNRESET);
+        } else if (s3_native_read_head(conn, &resp, &stale,
+                                       err) == S3_E_OK)
+        {
+            __atomic_add_fetch(&c->stat_requests, 1, __ATOMIC_RELAXED);
+            bool keep = !resp.close && s3_native_drain(conn, &resp);
+            s3_native_status_error(&resp, err);
+            s3_native_conn_put(nb, conn, keep);
+            goto out;
+        } else {
+            stale = stale && conn->reused;
+        }
+
+        s3_native_conn_put(nb, conn, false);
+        if (!stale)
+            break;
+    }
+
+out:
+    if (head.data != NULL)
+        s3_free(&c->alloc, head.data);
+    return err->code;
+}
+
+/* ----------------- GET: сокет -> файл через splice ----------------- */
+
+struct s3_native_fd_sink {
+    int fd;
+    off_t offset;
+    size_t written;
+    size_t max_size; /* 0 — без ограничения */
+};
+
+static int
+s3_native_sink_fd(void *ctx, const char *data, size_t len)
+{
+    struct s3_native_fd_sink *s = (struct s3_native_fd_sink *)ctx;
+    if (s->max_size > 0 && s->written + len > s->max_size) {
+        errno = EFBIG;
+        return -1;
+    }
+    if (s3_native_pwrite_all(s->fd, data, len,
+                             s->offset + (off_t)s->written) != 0)
+        return -1;
+    s->written += len;
+    return 0;
+}
+
+/* Переложить len байт из pipe в файл; fallback — read + pwrite. */
+static int
+s3_native_pipe_to_fd(struct s3_native_conn *conn,
+                     struct s3_native_fd_sink *sink, size_t len,
+                     bool *use_splice)
+{
+    while (len > 0) {
+        ssize_t n;
+        if (*use_splice) {
+            loff_t off = sink->offset + (off_t)sink->written;
+            n = splice(conn->pipe[0], NULL, sink->fd, &off, len,
+                       SPLICE_F_MOVE);
+            if (n < 0 && errno == EINVAL) {
+                /* Файл не умеет splice (O_APPEND и т.п.). */
+                *use_splice = false;
+                continue;
+            }
+            if (n > 0)
+                sink->written += (size_t)n;
+        } else {
+            char buf[S3_NATIVE_BUF_SIZE];
+            n = read(conn->pipe[0], buf, len < sizeof(buf) ? len : sizeof(buf));
+            if (n > 0 && s3_native_sink_fd(sink, buf, (size_t)n) != 0)
+                return -1;
+        }
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (n == 0) {
+            errno = EIO;
+            return -1;
+        }
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static s3_error_code_t
+s3_native_splice_body(struct s3_native_conn *conn, uint64_t len,
+                      struct s3_native_fd_sink *sink, s3_error_t *err)
+{
+    /* Что уже прочитано вместе с заголовками — обычной записью. */
+    size_t buffered = conn->len - conn->pos;
+    if (buffered > len)
+        buffered = (size_t)len;
+    if (buffered > 0) {
+        if (s3_native_sink_fd(sink, conn->buf + conn->pos, buffered) != 0)
+            return s3_native_io_error(err, "failed to write response body");
+        conn->pos += buffered;
+        len -= buffered;
+    }
+    if (len == 0)
+        return S3_E_OK;
+
+    if (conn->pipe[0] < 0 && pipe2(conn->pipe, O_CLOEXEC) != 0)
+        return s3_native_io_error(err, "pipe2 failed");
+
+    bool use_splice = true;
+    while (len > 0) {
+        size_t want = len < S3_NATIVE_SPLICE_MAX ?
+            (size_t)len : S3_NATIVE_SPLICE_MAX;
+        if (sink->max_size > 0) {
+            /* Тело без Content-Length: на байт больше — уже ошибка. */
+            if (sink->written >= sink->max_size) {
+                s3_error_set(err, S3_E_IO,
+                             "response body is larger than max_size",
+                             EFBIG, 0, 0);
+                return err->code;
+            }
+            if (want > sink->max_size - sink->written + 1)
+                want = sink->max_size - sink->written + 1;
+        }
+        if (s3_native_arm(conn) != 0)
+            return s3_native_io_error(err, "failed to read response body");
+        ssize_t n = splice(conn->sock, NULL, conn->pipe[1], NULL, want,
+                           SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return s3_native_io_error(err, "failed to read response body");
+        }
+        if (n == 0) {
+            s3_error_set(err, S3_E_IO,
+                         "connection closed in response body", 0, 0, 0);
+            return err->code;
+        }
+        if (sink->max_size > 0 && sink->written + (size_t)n > sink->max_size) {
+            s3_error_set(err, S3_E_IO, "response body is larger than max_size",
+                         EFBIG, 0, 0);
+            return err->code;
+        }
+        if (s3_native_pipe_to_fd(conn, sink, (size_t)n, &use_splice) != 0)
+            return s3_native_io_error(err, "failed to write response body");
+        len -= (uint64_t)n;
+    }
+    return S3_E_OK;
+}
+
+static s3_error_code_t
+s3_http_native_get_fd(struct s3_http_backend_impl *backend,
+                      const s3_get_opts_t *opts,
+                      int fd, off_t offset, size_t max_size,
+                      size_t *bytes_written,
+                      s3_error_t *error)
+{
+    struct s3_http_native_backend *nb =
+        (struct s3_http_native_backend *)backend;
+    s3_client_t *c = nb->base.client;
+
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    struct s3_native_fd_sink sink = { fd, offset, 0, max_size };
+
+    if (fd < 0) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "invalid fd for GET", 0, 0, 0);
+        return err->code;
+    }
+
+    s3_mem_buf_t head = { NULL, 0, 0 };
+    if (s3_native_build_head(nb, &head, "GET", opts->bucket, opts->key,
+                             err) != S3_E_OK)
+        goto out;
+
+    char line[320];
+    if (opts->range != NULL) {
+        snprintf(line, sizeof(line), "Range: %s\r\n", opts->range);
+        if (s3_mem_buf_append(c, &head, line, strlen(line), err) != S3_E_OK)
+            goto out;
+    }
+    if (opts->if_match != NULL && opts->if_match[0] != '\0') {
+        const char *q = opts->if_match[0] == '"' ? "" : "\"";
+        int n = snprintf(line, sizeof(line), "If-Match: %s%s%s\r\n",
+                         q, opts->if_match, q);
+        if (n <= 0 || (size_t)n >= sizeof(line)) {
+            s3_error_set(err, S3_E_INVALID_ARG,
+                         "if_match ETag is too long", 0, 0, 0);
+            goto out;
+        }
+        if (s3_mem_buf_append(c, &head, line, (size_t)n, err) != S3_E_OK)
+            goto out;
+    }
+    if (s3_mem_buf_append(c, &head, "\r\n", 2, err) != S3_E_OK)
+        goto out;
+
+    uint64_t deadline = s3_native_deadline(nb);
+    for (int attempt = 0; attempt < 2; attempt++) {
+        struct s3_native_conn *conn = NULL;
+        if (s3_native_conn_get(nb, &conn, err) != S3_E_OK)
+            goto out;
+        conn->deadline = deadline;
+
+        bool stale = false;
+        struct s3_native_resp resp;
+        if (s3_native_send_all(conn, head.data, head.size, 0) != 0) {
+            stale = conn->reused && (errno == EPIPE || errno == ECONNRESET);
+            s3_native_io_error(err, "failed to send request");
+            s3_native_conn_put(nb, conn, false);
+            if (stale)
+                continue;
+            goto out;
+        }
+        if (s3_native_read_head(conn, &resp, &stale, err) != S3_E_OK) {
+            stale = stale && conn->reused;
+            s3_native_conn_put(nb, conn, false);
+            if (stale)
+                continue;
+            goto out;
+        }
+        __atomic_add_fetch(&c->stat_requests, 1, __ATOMIC_RELAXED);
+
+        if (s3_native_status_error(&resp, err) != S3_E_OK) {
+            bool keep = !resp.close && s3_native_drain(conn, &resp);
+            s3_native_conn_put(nb, conn, keep);
+            goto out;
+        }
+
+        s3_error_code_t code;
+        bool keep = !resp.close;
+        if (resp.chunked) {
+            code = s3_native_read_chunked(conn, s3_native_sink_fd, &sink, err);
+        } else if (resp.content_length < 0) {
+            /* Тело до закрытия соединения. */
+            keep = false;
+            code = s3_native_splice_body(conn, UINT64_MAX, &sink, err);
+            if (code == S3_E_IO && err->os_error == 0)
+                code = S3_E_OK; /* EOF — конец тела */
+        } else if (max_size > 0 &&
+                   (uint64_t)resp.content_length > max_size) {
+            keep = false;
+            s3_error_set(err, S3_E_IO,
+                         "response body is larger than max_size", 0,
+                         resp.status, 0);
+            code = err->code;
+        } else {
+            code = s3_native_splice_body(conn,
+                                         (uint64_t)resp.content_length,
+                                         &sink, err);
+        }
+
+        if (code == S3_E_OK)
+            s3_native_status_error(&resp, err);
+        else
+            keep = false;
+        s3_native_conn_put(nb, conn, keep);
+        goto out;
+    }
+
+out:
+    if (bytes_written != NULL)
+        *bytes_written = sink.written;
+    if (head.data != NULL)
+        s3_free(&c->alloc, head.data);
+    return err->code;
+}
+
+/* ----------------- делегирование curl backend'у ----------------- */
+
+static s3_error_code_t
+s3_http_native_create_bucket(struct s3_http_backend_impl *backend,
+                             const s3_create_bucket_opts_t *opts,
+                             s3_error_t *error)
+{
+    struct s3_http_native_backend *nb =
+        (struct s3_http_native_backend *)backend;
+    return nb->curl->vtbl->create_bucket(nb->curl, opts, error);
+}
+
+static s3_error_code_t
+s3_http_native_list_objects(struct s3_http_backend_impl *backend,
+                            const s3_list_objects_opts_t *opts,
+                            s3_list_objects_result_t *out,
+                            s3_error_t *error)
+{
+    struct s3_http_native_backend *nb =
+        (struct s3_http_native_backend *)backend;
+    return nb->curl->vtbl->list_objects(nb->curl, opts, out, error);
+}
+
+static s3_error_code_t
+s3_http_native_delete_objects(struct s3_http_backend_impl *backend,
+                              const s3_delete_objects_opts_t *opts,
+                              s3_error_t *error)
+{
+    struct s3_http_native_backend *nb =
+        (struct s3_http_native_backend *)backend;
+    return nb->curl->vtbl->delete_objects(nb->curl, opts, error);
+}
+
+static s3_error_code_t
+s3_http_native_perform(struct s3_http_backend_impl *backend,
+                       s3_easy_handle_t *h,
+                       s3_error_t *error)
+{
+    struct s3_http_native_backend *nb =
+        (struct s3_http_native_backend *)backend;
+    return nb->curl->vtbl->perform(nb->curl, h, error);
+}
+
+static s3_error_code_t
+s3_http_native_perform_many(struct s3_http_backend_impl *backend,
+                            s3_easy_handle_t **handles, size_t count,
+                            s3_error_code_t *codes, s3_error_t *errs,
+                            s3_error_t *error)
+{
+    struct s3_http_native_backend *nb =
+        (struct s3_http_native_backend *)backend;
+    return nb->curl->vtbl->perform_many(nb->curl, handles, count,
+                                        codes, errs, error);
+}
+
+/* ----------------- destroy + фабрика backend'а ----------------- */
+
+static void
+s3_http_native_destroy(struct s3_http_backend_impl *backend)
+{
+    struct s3_http_native_backend *nb =
+        (struct s3_http_native_backend *)backend;
+    s3_client_t *client = nb->base.client;
+
+    struct s3_native_conn *conn = nb->idle;
+    while (conn != NULL) {
+        struct s3_native_conn *next = conn->next;
+        s3_native_conn_close(nb, conn);
+        conn = next;
+    }
+
+    if (nb->curl != NULL)
+        nb->curl->vtbl->destroy(nb->curl);
+
+    pthread_mutex_destroy(&nb->mutex);
+    if (nb->path_prefix != NULL)
+        s3_free(&client->alloc, nb->path_prefix);
+    s3_free(&client->alloc, nb);
+}
+
+static const struct s3_http_backend_vtbl s3_http_native_vtbl = {
+    .put_fd          = s3_http_native_put_fd,
+    .get_fd          = s3_http_native_get_fd,
+    .create_bucket   = s3_http_native_create_bucket,
+    .list_objects    = s3_http_native_list_objects,
+    .delete_objects  = s3_http_native_delete_objects,
+    .perform         = s3_http_native_perform,
+    .perform_many    = s3_http_native_perform_many,
+    .destroy         = s3_http_native_destroy,
+};
+
+/* http://host[:port][/path] -> host, port, Host:, префикс пути. */
+static s3_error_code_t
+s3_native_parse_endpoint(struct s3_http_native_backend *nb,
+                         const char *url, s3_error_t *err)
+{
+    if (strncasecmp(url, "http://", 7) != 0) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "native backend supports only http:// endpoints",
+                     0, 0, 0);
+        return err->code;
+    }
+    const char *p = url + 7;
+    const char *host_end;
+    const char *rest;
+
+    if (*p == '[') {
+        host_end = strchr(p, ']');
+        if (host_end == NULL)
+            goto bad;
+        rest = host_end + 1;
+        p++;
+    } else {
+        host_end = p + strcspn(p, ":/");
+        rest = host_end;
+    }
+
+    size_t host_len = (size_t)(host_end - p);
+    if (host_len == 0 || host_len >= sizeof(nb->host))
+        goto bad;
+    memcpy(nb->host, p, host_len);
+    nb->host[host_len] = '\0';
+
+    snprintf(nb->port, sizeof(nb->port), "80");
+    if (*rest == ':') {
+        size_t port_len = strcspn(rest + 1, "/");
+        if (port_len == 0 || port_len >= sizeof(nb->port))
+            goto bad;
+        memcpy(nb->port, rest + 1, port_len);
+        nb->port[port_len] = '\0';
+        rest += 1 + port_len;
+    }
+
+    /* Host: как в URL, но без порта 80 (так делает и curl). */
+    const char *authority_end = strcmp(nb->port, "80") == 0 ?
+        host_end + (url[7] == '[' ? 1 : 0) : rest;
+    size_t authority_len = (size_t)(authority_end - (url + 7));
+    if (authority_len >= sizeof(nb->host_hdr))
+        goto bad;
+    memcpy(nb->host_hdr, url + 7, authority_len);
+    nb->host_hdr[authority_len] = '\0';
+
+    nb->path_prefix = s3_strdup_a(&nb->base.client->alloc, rest, err);
+    if (nb->path_prefix == NULL)
+        return err->code;
+    size_t plen = strlen(nb->path_prefix);
+    while (plen > 0 && nb->path_prefix[plen - 1] == '/')
+        nb->path_prefix[--plen] = '\0';
+    return S3_E_OK;
+
+bad:
+    s3_error_set(err, S3_E_INVALID_ARG, "malformed endpoint URL", 0, 0, 0);
+    return err->code;
+}
+
+struct s3_http_backend_impl *
+s3_http_native_backend_new(s3_client_t *client, s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    if (client->endpoints != NULL) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "native backend supports a single endpoint", 0, 0, 0);
+        return NULL;
+    }
+    if (!(client->flags & S3_CLIENT_F_FORCE_PATH_STYLE)) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "native backend supports only path-style addressing, "
+                     "set S3_CLIENT_F_FORCE_PATH_STYLE", 0, 0, 0);
+        return NULL;
+    }
+
+    struct s3_http_native_backend *nb =
+        (struct s3_http_native_backend *)s3_alloc(&client->alloc,
+                                                  sizeof(*nb));
+    if (nb == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate native backend", ENOMEM, 0, 0);
+        return NULL;
+    }
+    memset(nb, 0, sizeof(*nb));
+    nb->base.vtbl = &s3_http_native_vtbl;
+    nb->base.client = client;
+    nb->idle_max = client->max_connections_per_host;
+    pthread_mutex_init(&nb->mutex, NULL);
+
+    if (s3_native_parse_endpoint(nb, client->endpoint, err) != S3_E_OK)
+        goto fail;
+
+    nb->curl = s3_http_easy_backend_new(client, err);
+    if (nb->curl == NULL)
+        goto fail;
+
+    return &nb->base;
+
+fail:
+    s3_http_native_destroy(&nb->base);
+    return NULL;
+}
@@ -0,0 +1,101 @@
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "s3_internal.h"
+#include "http_util.h"
+#include "error.h"
+
+/*
+ * CURLSH для easy backend'а: общий DNS-кэш и TLS-сессии.
+ *
+ * Каждый запрос easy backend'а живёт в своём CURL и после
+ * curl_easy_cleanup теряет всё, что успел закэшировать. С общим CURLSH
+ * новый хендл не резолвит хост заново и делает сокращённый TLS handshake
+ * (session resumption).
+ *
+ * Соединения (CURL_LOCK_DATA_CONNECT) не шарим: libcurl не поддерживает
+ * общий пул соединений между потоками, а easy-запросы идут из разных
+ * coio-воркеров. Пул соединений есть у multi backend'а.
+ */
+struct s3_http_share {
+    s3_client_t *client;
+    CURLSH *sh;
+    pthread_mutex_t locks[CURL_LOCK_DATA_LAST];
+};
+
+static void
+s3_http_share_lock(CURL *easy, curl_lock_data data,
+                   curl_lock_access access, void *userptr)
+{
+    (void)easy;
+    (void)access;
+    struct s3_http_share *s = (struct s3_http_share *)userptr;
+    pthread_mutex_lock(&s->locks[data]);
+}
+
+static void
+s3_http_share_unlock(CURL *easy, curl_lock_data data, void *userptr)
+{
+    (void)easy;
+    struct s3_http_share *s = (struct s3_http_share *)userptr;
+    pthread_mutex_unlock(&s->locks[data]);
+}
+
+s3_error_code_t
+s3_http_share_new(s3_client_t *client, struct s3_http_share **out,
+                  s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    struct s3_http_share *s =
+        (struct s3_http_share *)s3_alloc(&client->alloc, sizeof(*s));
+    if (s == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate curl share", ENOMEM, 0, 0);
+        return err->code;
+    }
+    memset(s, 0, sizeof(*s));
+    s->client = client;
+
+    s->sh = curl_share_init();
+    if (s->sh == NULL) {
+        s3_error_set(err, S3_E_INIT, "curl_share_init failed", 0, 0, 0);
+        s3_free(&client->alloc, s);
+        return err->code;
+    }
+
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+        pthread_mutex_init(&s->locks[i], NULL);
+
+    curl_share_setopt(s->sh, CURLSHOPT_LOCKFUNC, s3_http_share_lock);
+    curl_share_setopt(s->sh, CURLSHOPT_UNLOCKFUNC, s3_http_share_unlock);
+    curl_share_setopt(s->sh, CURLSHOPT_USERDATA, (void *)s);
+    curl_share_setopt(s->sh, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(s->sh, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
+    *out = s;
+    return S3_E_OK;
+}
+
+void
+s3_http_share_delete(struct s3_http_share *s)
+{
+    if (s == NULL)
+        return;
+
+    s3_client_t *c = s->client;
+
+    curl_share_cleanup(s->sh);
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+        pthread_mutex_destroy(&s->locks[i]);
+
+    s3_free(&c->alloc, s);
+}
+
+void
+s3_http_share_attach(struct s3_http_share *s, CURL *easy)
+{
+    curl_easy_setopt(easy, CURLOPT_SHARE, s->sh);
+}
@@ -0,0 +1,113 @@
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include "s3_internal.h"
+#include "s3/curl_easy_factory.h"
+#include "http_util.h"
+#include "error.h"
+
+/*
+ * Выполнение S3_IO_STREAM хендла на локальном curl_multi в текущем
+ * (coio) потоке.
+ *
+ * Когда fd получателя заполнен, write-callback ставит передачу на паузу;
+ * здесь мы ждём POLLOUT на этом fd вместе с сокетами curl (extra_fds у
+ * curl_multi_poll) и снимаем паузу. Пока получатель не читает, curl не
+ * читает из S3, так что память не растёт. В общий multi-поток такие
+ * запросы не отдаём: пауза может длиться долго.
+ */
+
+static uint64_t
+s3_http_stream_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+s3_error_code_t
+s3_http_stream_perform(void *ctx, s3_easy_handle_t *h, s3_error_t *error)
+{
+    (void)ctx;
+
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    s3_client_t *client = h->client;
+    s3_easy_io_t *io = &h->write_io;
+
+    CURLM *multi = curl_multi_init();
+    if (multi == NULL) {
+        s3_error_set(err, S3_E_INIT, "curl_multi_init failed", 0, 0, 0);
+        return err->code;
+    }
+
+    CURLMcode mc = curl_multi_add_handle(multi, h->easy);
+    if (mc != CURLM_OK) {
+        s3_error_set(err, S3_E_CURL, curl_multi_strerror(mc),
+                     0, 0, (long)mc);
+        curl_multi_cleanup(multi);
+        return err->code;
+    }
+
+    s3_error_code_t code = S3_E_INTERNAL;
+    bool done = false;
+    uint64_t paused_since = 0;
+
+    while (!done) {
+        int still_running = 0;
+        mc = curl_multi_perform(multi, &still_running);
+        if (mc != CURLM_OK) {
+            code = S3_E_CURL;
+            s3_error_set(err, code, curl_multi_strerror(mc), 0, 0, (long)mc);
+            break;
+        }
+
+        int msgs_in_queue = 0;
+        CURLMsg *msg;
+        while ((msg = curl_multi_info_read(multi, &msgs_in_queue)) != NULL) {
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+            code = s3_http_map_result(msg->easy_handle, msg->data.result,
+                                      err);
+            s3_http_account(client, msg->easy_handle);
+            done = true;
+        }
+        if (done)
+            break;
+
+        struct curl_waitfd wfd;
+        unsigned int nfds = 0;
+        if (io->u.stream.paused) {
+            wfd.fd = io->u.stream.fd;
+            wfd.events = CURL_WAIT_POLLOUT;
+            wfd.revents = 0;
+            nfds = 1;
+            if (paused_since == 0)
+                paused_since = s3_http_stream_now_ms();
+        }
+
+        int numfds = 0;
+        curl_multi_poll(multi, nfds > 0 ? &wfd : NULL, nfds, 1000, &numfds);
+
+        if (!io->u.stream.paused)
+            continue;
+
+        if (wfd.revents != 0) {
+            paused_since = 0;
+            /* Может сразу вызвать write-callback и снова встать на паузу. */
+            curl_easy_pause(h->easy, CURLPAUSE_CONT);
+        } else if (s3_http_stream_now_ms() - paused_since >=
+                   client->request_timeout_ms) {
+            code = S3_E_TIMEOUT;
+            s3_error_set(err, code,
+                         "stream receiver did not read in time", 0, 0, 0);
+            break;
+        }
+    }
+
+    curl_multi_remove_handle(multi, h->easy);
+    curl_multi_cleanup(multi);
+    return code;
+}
@@ -18,20 +18,99 @@ s3_mem_buf_reserve(s3_client_t *c, s3_mem_buf_t *b, size_t need)
     while (new_cap < need)
         new_cap *= 2;
 
-    char *p = (char *)s3_alloc(&c->alloc, new_cap);
+    /* realloc может расширить блок на месте, без копии. */
+    char *p = (char *)s3_realloc(&c->alloc, b->data, new_cap);
     if (!p)
         return -1;
 
-    if (b->data) {
-        memcpy(p, b->data, b->size);
-        s3_free(&c->alloc, b->data);
-    }
-
     b->data = p;
     b->capacity = new_cap;
     return 0;
 }
 
+/* ---------- работа с s3_buf_chain_t ---------- */
+
+int
+s3_buf_chain_append(s3_client_t *c, s3_buf_chain_t *ch,
+                    const char *data, size_t len)
+{
+    while (len > 0) {
+        s3_buf_seg_t *seg = ch->tail;
+        if (seg == NULL || seg->size == seg->cap) {
+            seg = (s3_buf_seg_t *)s3_alloc(&c->alloc,
+                                           sizeof(*seg) + S3_BUF_SEG_SIZE);
+            if (seg == NULL)
+                return -1;
+            seg->next = NULL;
+            seg->size = 0;
+            seg->cap = S3_BUF_SEG_SIZE;
+
+            if (ch->tail != NULL)
+                ch->tail->next = seg;
+            else
+                ch->head = seg;
+            ch->tail = seg;
+            ch->nsegs++;
+        }
+
+        size_t n = seg->cap - seg->size;
+        if (n > len)
+            n = len;
+        memcpy(seg->data + seg->size, data, n);
+        seg->size += n;
+        ch->size += n;
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+void
+s3_buf_chain_reset(s3_client_t *c, s3_buf_chain_t *ch)
+{
+    s3_buf_seg_t *seg = ch->head;
+    while (seg != NULL) {
+        s3_buf_seg_t *next = seg->next;
+        s3_free(&c->alloc, seg);
+        seg = next;
+    }
+    memset(ch, 0, sizeof(*ch));
+}
+
+size_t
+s3_buf_chain_iov(const s3_buf_chain_t *ch, struct iovec *iov, size_t cap)
+{
+    size_t i = 0;
+    for (s3_buf_seg_t *seg = ch->head; seg != NULL; seg = seg->next, i++) {
+        if (i < cap) {
+            iov[i].iov_base = seg->data;
+            iov[i].iov_len = seg->size;
+        }
+    }
+    return i;
+}
+
+int
+s3_buf_chain_flatten(s3_client_t *c, const s3_buf_chain_t *ch,
+                     s3_mem_buf_t *out)
+{
+    char *p = (char *)s3_alloc(&c->alloc, ch->size + 1);
+    if (p == NULL)
+        return -1;
+
+    size_t pos = 0;
+    for (s3_buf_seg_t *seg = ch->head; seg != NULL; seg = seg->next) {
+        memcpy(p + pos, seg->data, seg->size);
+        pos += seg->size;
+    }
+    p[pos] = '\0';
+
+    out->data = p;
+    out->size = pos;
+    out->capacity = pos + 1;
+    return 0;
+}
+
 s3_error_code_t
 s3_mem_buf_append(s3_client_t *c, s3_mem_buf_t *b,
                   const char *data, size_t len,
@@ -177,11 +256,11 @@ s3_url_encode_query(s3_client_t *client, const char *src,
  * endpoint не должен заканчиватьcя слэшем.
  */
 s3_error_code_t
-s3_build_url(s3_client_t *client,
-             const char *bucket,
-             const char *key,         /* может быть NULL */
-             char **out_url,
-             s3_error_t *error)
+s3_build_url_buf(s3_client_t *client,
+                 const char *bucket,
+                 const char *key,         /* может быть NULL */
+                 char **buf, size_t *cap,
+                 s3_error_t *error)
 {
     s3_error_t local_err = S3_ERROR_INIT;
     s3_error_t *err = error ? error : &local_err;
@@ -217,13 +296,18 @@ s3_build_url(s3_client_t *client,
     if (key != NULL)
         need += 1 + key_len;
 
-    char *url = (char *)s3_alloc(&client->alloc, need);
-    if (url == NULL) {
-        s3_error_set(err, S3_E_NOMEM,
-                     "Out of memory in s3_build_url", ENOMEM, 0, 0);
-        return err->code;
+    if (*buf == NULL || *cap < need) {
+        char *nb = (char *)s3_realloc(&client->alloc, *buf, need);
+        if (nb == NULL) {
+            s3_error_set(err, S3_E_NOMEM,
+                         "Out of memory in s3_build_url", ENOMEM, 0, 0);
+            return err->code;
+        }
+        *buf = nb;
+        *cap = need;
     }
 
+    char *url = *buf;
     size_t pos = 0;
 
     /* Копируем endpoint */
@@ -247,6 +331,58 @@ s3_build_url(s3_client_t *client,
     }
 
     url[pos] = '\0';
+    return S3_E_OK;
+}
+
+s3_error_code_t
+s3_build_url(s3_client_t *client,
+             const char *bucket,
+             const char *key,         /* может быть NULL */
+             char **out_url,
+             s3_error_t *error)
+{
+    char *url = NULL;
+    size_t cap = 0;
+    s3_error_code_t rc = s3_build_url_buf(client, bucket, key,
+                                          &url, &cap, error);
+    if (rc == S3_E_OK)
+        *out_url = url;
+    return rc;
+}
+
+/*
+ * URL объекта с query: endpoint/bucket/key?query.
+ */
+s3_error_code_t
+s3_build_url_query(s3_client_t *client,
+                   const char *bucket,
+                   const char *key,
+                   const char *query,
+                   char **out_url,
+                   s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    char *base = NULL;
+    if (s3_build_url(client, bucket, key, &base, err) != S3_E_OK)
+        return err->code;
+
+    size_t base_len = strlen(base);
+    size_t query_len = strlen(query);
+
+    char *url = (char *)s3_alloc(&client->alloc, base_len + 1 + query_len + 1);
+    if (url == NULL) {
+        s3_free(&client->alloc, base);
+        s3_error_set(err, S3_E_NOMEM,
+                     "Out of memory in s3_build_url_query", ENOMEM, 0, 0);
+        return err->code;
+    }
+
+    memcpy(url, base, base_len);
+    url[base_len] = '?';
+    memcpy(url + base_len + 1, query, query_len + 1);
+    s3_free(&client->alloc, base);
 
     *out_url = url;
     return S3_E_OK;
@@ -596,3 +732,23 @@ s3_build_content_md5_header(const void *data, size_t len,
 
     return S3_E_OK;
 }
+
+/* ---------- счётчики s3_client_stats ---------- */
+
+void
+s3_http_account(s3_client_t *client, CURL *easy)
+{
+    long connects = 0;
+    long version = 0;
+
+    curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &connects);
+    curl_easy_getinfo(easy, CURLINFO_HTTP_VERSION, &version);
+
+    __atomic_add_fetch(&client->stat_requests, 1, __ATOMIC_RELAXED);
+    if (connects > 0)
+        __atomic_add_fetch(&client->stat_connections, (uint64_t)connects,
+                           __ATOMIC_RELAXED);
+    if (version == CURL_HTTP_VERSION_2_0)
+        __atomic_add_fetch(&client->stat_http2_requests, 1,
+                           __ATOMIC_RELAXED);
+}
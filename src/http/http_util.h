@@ -5,6 +5,8 @@
 #include "s3/curl_easy_factory.h"
 #include "error.h"
 
+#include <sys/uio.h>
+
 /*
  * Утилиты для работы с s3_mem_buf_t, XML и URL.
  *
@@ -14,14 +16,43 @@
 /*
  * Гарантирует, что в буфере b есть хотя бы `need` байт capacity.
  * Если capacity уже достаточен — ничего не делает.
- * При необходимости аллоцирует новый буфер через client->alloc,
- * копирует старые данные и освобождает старый.
+ * При необходимости расширяет буфер через s3_realloc (client->alloc).
  *
  * Возвращает 0 при успехе, -1 при OOM.
  */
 int
 s3_mem_buf_reserve(s3_client_t *c, s3_mem_buf_t *b, size_t need);
 
+/* Размер данных одного сегмента s3_buf_chain_t. */
+#define S3_BUF_SEG_SIZE (16 * 1024)
+
+/*
+ * Дописать len байт в цепочку: в хвостовой сегмент, при нехватке —
+ * в новые. Возвращает 0 при успехе, -1 при OOM.
+ */
+int
+s3_buf_chain_append(s3_client_t *c, s3_buf_chain_t *ch,
+                    const char *data, size_t len);
+
+/* Освободить все сегменты, цепочка снова пустая. */
+void
+s3_buf_chain_reset(s3_client_t *c, s3_buf_chain_t *ch);
+
+/*
+ * Заполнить iov (до cap штук) сегментами цепочки.
+ * Возвращает общее число сегментов (может быть больше cap).
+ */
+size_t
+s3_buf_chain_iov(const s3_buf_chain_t *ch, struct iovec *iov, size_t cap);
+
+/*
+ * Собрать цепочку в один буфер out (ёмкость ровно size + 1, с '\0').
+ * Возвращает 0 при успехе, -1 при OOM.
+ */
+int
+s3_buf_chain_flatten(s3_client_t *c, const s3_buf_chain_t *ch,
+                     s3_mem_buf_t *out);
+
 /*
  * Добавить произвольный кусок данных в s3_mem_buf_t, с завершающим '\0'.
  * При нехватке места расширяет буфер через s3_mem_buf_reserve().
@@ -72,6 +103,30 @@ s3_build_url(s3_client_t *client,
              char **out_url,
              s3_error_t *error);
 
+/*
+ * То же в буфер *buf ёмкостью *cap (через client->alloc): если не
+ * хватает — буфер растёт, *buf и *cap обновляются. Позволяет хендлу
+ * переиспользовать память под URL между запросами.
+ */
+s3_error_code_t
+s3_build_url_buf(s3_client_t *client,
+                 const char *bucket,
+                 const char *key,
+                 char **buf, size_t *cap,
+                 s3_error_t *error);
+
+/*
+ * URL объекта с query-строкой (уже закодированной): endpoint/bucket/key?query.
+ * key может быть NULL.
+ */
+s3_error_code_t
+s3_build_url_query(s3_client_t *client,
+                   const char *bucket,
+                   const char *key,
+                   const char *query,
+                   char **out_url,
+                   s3_error_t *error);
+
 /*
  * Построение URL для ListObjectsV2:
  *   endpoint/bucket?list-type=2[&prefix=...][&max-keys=...][&continuation-token=...]
@@ -129,4 +184,76 @@ s3_build_content_md5_header(const void *data, size_t len,
                             char *out, size_t out_cap,
                             s3_error_t *err);
 
+/*
+ * Выполнить пачку easy-хендлов одновременно на локальном curl_multi
+ * в текущем потоке (http_batch.c).
+ *
+ * codes[i]/errs[i] — результат handles[i]. Сам вызов возвращает ошибку
+ * только если сломался curl_multi; тогда незавершённые запросы
+ * помечены S3_E_INTERNAL.
+ */
+s3_error_code_t
+s3_http_batch_perform(s3_client_t *client,
+                      s3_easy_handle_t **handles, size_t count,
+                      s3_error_code_t *codes, s3_error_t *errs,
+                      s3_error_t *error);
+
+/*
+ * Создать хендл i-го запроса s3_http_batch_run.
+ */
+typedef s3_error_code_t
+(*s3_http_batch_start_fn)(void *ctx, size_t i, s3_easy_handle_t **h,
+                          s3_error_t *err);
+
+/*
+ * Итог i-го запроса s3_http_batch_run. h — его хендл (NULL, если не
+ * создался), дальше им владеет done.
+ */
+typedef void
+(*s3_http_batch_done_fn)(void *ctx, size_t i, s3_easy_handle_t *h,
+                         s3_error_code_t code, s3_error_t *err);
+
+/*
+ * Выполнить count запросов на локальном curl_multi в текущем потоке
+ * (http_batch.c), держа в полёте до concurrency: на место
+ * завершившегося сразу ставится следующий, без ожидания всей пачки.
+ *
+ * done вызывается ровно раз на каждый запрос. Сам вызов возвращает
+ * ошибку только если сломался curl_multi (или не хватило памяти) —
+ * тогда оставшиеся запросы завершаются с ней.
+ */
+s3_error_code_t
+s3_http_batch_run(s3_client_t *client, size_t count, size_t concurrency,
+                  s3_http_batch_start_fn start, s3_http_batch_done_fn done,
+                  void *ctx, s3_error_t *error);
+
+/*
+ * Выполнить хендл с S3_IO_STREAM (s3_easy_factory_new_get_stream) на
+ * локальном curl_multi, снимая паузу, когда fd получателя готов к
+ * записи (http_stream.c). Сигнатура — s3_endpoint_perform_fn.
+ */
+s3_error_code_t
+s3_http_stream_perform(void *ctx, s3_easy_handle_t *h, s3_error_t *error);
+
+/*
+ * Учесть завершившийся запрос в счётчиках клиента (s3_client_stats):
+ * новые соединения и версию HTTP. Потокобезопасно.
+ */
+void
+s3_http_account(s3_client_t *client, CURL *easy);
+
+/*
+ * Общий CURLSH (DNS, TLS-сессии) для хендлов easy backend'а
+ * (http_share.c). Потокобезопасен.
+ */
+s3_error_code_t
+s3_http_share_new(s3_client_t *client, struct s3_http_share **out,
+                  s3_error_t *error);
+
+void
+s3_http_share_delete(struct s3_http_share *s);
+
+void
+s3_http_share_attach(struct s3_http_share *s, CURL *easy);
+
 #endif /* S3_HTTP_UTIL_H */
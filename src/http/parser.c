@@ -1,6 +1,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <stdio.h>
 
 #include "s3_internal.h"
 #include "s3/client.h"
@@ -158,3 +159,26 @@ s3_parse_list_response(s3_client_t *client,
     out->count = count;
     return S3_E_OK;
 }
+
+char *
+s3_parse_xml_value(s3_client_t *client,
+                   const char *xml,
+                   const char *tag,
+                   s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    if (xml == NULL)
+        return NULL;
+
+    char open_tag[64];
+    char close_tag[64];
+    int n1 = snprintf(open_tag, sizeof(open_tag), "<%s>", tag);
+    int n2 = snprintf(close_tag, sizeof(close_tag), "</%s>", tag);
+    if (n1 <= 0 || (size_t)n1 >= sizeof(open_tag) ||
+        n2 <= 0 || (size_t)n2 >= sizeof(close_tag))
+        return NULL;
+
+    return s3_xml_get_text_between(client, xml, open_tag, close_tag, err);
+}
@@ -0,0 +1,411 @@
+#include "multipart.h"
+#include "s3/parser.h"
+#include "http/http_util.h"
+#include "error.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tarantool/module.h>
+
+/* Сколько раз повторяем упавшую часть после perform_many. */
+#define S3_MPU_PART_RETRIES 2
+
+/*
+ * Выполнить хендл через backend. Для ответов с XML (Create/Complete)
+ * S3 может вернуть 200 и <Error> в теле — считаем это ошибкой.
+ */
+static s3_error_code_t
+s3_mpu_perform(s3_client_t *client, s3_easy_handle_t *h, s3_error_t *err)
+{
+    struct s3_http_backend_impl *b = client->backend;
+
+    s3_error_code_t code = b->vtbl->perform(b, h, err);
+    if (code != S3_E_OK)
+        return code;
+
+    const char *resp = NULL;
+    if (s3_easy_handle_resp(h, &resp, err) != S3_E_OK)
+        return err->code;
+    if (strstr(resp, "<Error>") != NULL) {
+        char *msg = s3_parse_xml_value(client, resp, "Code", NULL);
+        s3_error_set(err, S3_E_HTTP, msg != NULL ? msg : "multipart error",
+                     0, err->http_status, 0);
+        if (msg != NULL)
+            s3_free(&client->alloc, msg);
+        return err->code;
+    }
+    return S3_E_OK;
+}
+
+s3_error_code_t
+s3_mpu_begin(struct s3_mpu *m, s3_client_t *client,
+             const s3_put_opts_t *opts, s3_error_t *err)
+{
+    memset(m, 0, sizeof(*m));
+    m->client = client;
+    m->opts = *opts;
+
+    s3_easy_handle_t *h = NULL;
+    if (s3_easy_factory_new_mpu_create(client, opts, &h, err) != S3_E_OK)
+        return err->code;
+
+    s3_error_code_t code = s3_mpu_perform(client, h, err);
+    if (code == S3_E_OK) {
+        /* Тело уже собрано в s3_mpu_perform. */
+        const char *resp = NULL;
+        s3_easy_handle_resp(h, &resp, err);
+        m->upload_id = s3_parse_xml_value(client, resp, "UploadId", err);
+        if (m->upload_id == NULL && err->code == S3_E_OK) {
+            s3_error_set(err, S3_E_HTTP,
+                         "no UploadId in CreateMultipartUpload response",
+                         0, err->http_status, 0);
+        }
+        code = m->upload_id != NULL ? S3_E_OK : err->code;
+    }
+
+    s3_easy_handle_destroy(h);
+    return code;
+}
+
+static s3_error_code_t
+s3_mpu_check_number(uint32_t number, s3_error_t *err)
+{
+    if (number == 0 || number > S3_MPU_MAX_PARTS) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "multipart upload exceeds 10000 parts, "
+                     "increase part_size", 0, 0, 0);
+        return err->code;
+    }
+    return S3_E_OK;
+}
+
+s3_error_code_t
+s3_mpu_part_handle(struct s3_mpu *m, uint32_t number,
+                   const void *data, size_t size,
+                   s3_easy_handle_t **out, s3_error_t *err)
+{
+    if (s3_mpu_check_number(number, err) != S3_E_OK)
+        return err->code;
+    return s3_easy_factory_new_mpu_part(m->client, &m->opts, m->upload_id,
+                                        number, data, size, out, err);
+}
+
+s3_error_code_t
+s3_mpu_part_handle_fd(struct s3_mpu *m, uint32_t number,
+                      int fd, off_t offset, size_t size,
+                      s3_easy_handle_t **out, s3_error_t *err)
+{
+    if (s3_mpu_check_number(number, err) != S3_E_OK)
+        return err->code;
+    return s3_easy_factory_new_mpu_part_fd(m->client, &m->opts, m->upload_id,
+                                           number, fd, offset, size, out,
+                                           err);
+}
+
+s3_error_code_t
+s3_mpu_part_handle_iov(struct s3_mpu *m, uint32_t number,
+                       const s3_put_seg_t *segs, size_t count,
+                       s3_easy_handle_t **out, s3_error_t *err)
+{
+    if (s3_mpu_check_number(number, err) != S3_E_OK)
+        return err->code;
+    return s3_easy_factory_new_mpu_part_iov(m->client, &m->opts,
+                                            m->upload_id, number,
+                                            segs, count, out, err);
+}
+
+s3_error_code_t
+s3_mpu_part_done(struct s3_mpu *m, uint32_t number,
+                 const s3_easy_handle_t *h, s3_error_t *err)
+{
+    if (h->etag[0] == '\0') {
+        s3_error_set(err, S3_E_HTTP, "no ETag in UploadPart response",
+                     0, 0, 0);
+        return err->code;
+    }
+
+    if (m->count == m->cap) {
+        size_t cap = m->cap > 0 ? m->cap * 2 : 16;
+        struct s3_mpu_part *parts = s3_realloc(&m->client->alloc, m->parts,
+                                               cap * sizeof(*parts));
+        if (parts == NULL) {
+            s3_error_set(err, S3_E_NOMEM,
+                         "Out of memory in multipart upload", ENOMEM, 0, 0);
+            return err->code;
+        }
+        m->parts = parts;
+        m->cap = cap;
+    }
+
+    struct s3_mpu_part *p = &m->parts[m->count++];
+    p->number = number;
+    memcpy(p->etag, h->etag, sizeof(p->etag));
+    return S3_E_OK;
+}
+
+s3_error_code_t
+s3_mpu_part_retry(struct s3_mpu *m, s3_easy_handle_t *h,
+                  s3_error_code_t code, s3_error_t *err)
+{
+    struct s3_http_backend_impl *b = m->client->backend;
+
+    for (int attempt = 0; code != S3_E_OK && attempt < S3_MPU_PART_RETRIES &&
+         code != S3_E_INVALID_ARG && code != S3_E_ACCESS_DENIED &&
+         code != S3_E_AUTH && code != S3_E_NOT_FOUND; attempt++)
+    {
+        if (s3_easy_handle_rewind(h) != 0)
+            break;
+        h->etag[0] = '\0';
+        code = b->vtbl->perform(b, h, err);
+    }
+    return code;
+}
+
+s3_error_code_t
+s3_mpu_upload_handles(struct s3_mpu *m, uint32_t first,
+                      s3_easy_handle_t **handles, size_t n,
+                      s3_error_t *err)
+{
+    s3_client_t *client = m->client;
+    struct s3_http_backend_impl *b = client->backend;
+
+    s3_error_code_t *codes = s3_alloc(&client->alloc, n * sizeof(*codes));
+    s3_error_t *errs = s3_alloc(&client->alloc, n * sizeof(*errs));
+    s3_error_code_t code = S3_E_OK;
+
+    if (codes == NULL || errs == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Out of memory in multipart upload", ENOMEM, 0, 0);
+        code = err->code;
+        goto out;
+    }
+
+    s3_error_t batch_err = S3_ERROR_INIT;
+    s3_error_code_t rc = b->vtbl->perform_many(b, handles, n, codes, errs,
+                                               &batch_err);
+
+    for (size_t i = 0; i < n && code == S3_E_OK; i++) {
+        s3_error_code_t c = codes[i];
+        s3_error_t e = errs[i];
+        if (rc != S3_E_OK && c == S3_E_INTERNAL) {
+            c = rc;
+            e = batch_err;
+        }
+
+        /* perform_many не повторяет запросы — добиваем по одной. */
+        c = s3_mpu_part_retry(m, handles[i], c, &e);
+        if (c != S3_E_OK) {
+            *err = e;
+            code = c;
+            break;
+        }
+        code = s3_mpu_part_done(m, first + (uint32_t)i, handles[i], err);
+    }
+
+out:
+    for (size_t i = 0; i < n; i++)
+        s3_easy_handle_destroy(handles[i]);
+    if (errs != NULL)
+        s3_free(&client->alloc, errs);
+    if (codes != NULL)
+        s3_free(&client->alloc, codes);
+    return code;
+}
+
+s3_error_code_t
+s3_mpu_upload_parts(struct s3_mpu *m, uint32_t first,
+                    char *const *bufs, const size_t *sizes, size_t n,
+                    s3_error_t *err)
+{
+    s3_client_t *client = m->client;
+
+    s3_easy_handle_t **handles = s3_alloc(&client->alloc, n * sizeof(*handles));
+    if (handles == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Out of memory in multipart upload", ENOMEM, 0, 0);
+        return err->code;
+    }
+
+    s3_error_code_t code = S3_E_OK;
+    size_t nh = 0;
+    for (; nh < n; nh++) {
+        code = s3_mpu_part_handle(m, first + (uint32_t)nh, bufs[nh], sizes[nh],
+                                  &handles[nh], err);
+        if (code != S3_E_OK)
+            break;
+    }
+
+    if (code == S3_E_OK) {
+        code = s3_mpu_upload_handles(m, first, handles, nh, err);
+    } else {
+        for (size_t i = 0; i < nh; i++)
+            s3_easy_handle_destroy(handles[i]);
+    }
+
+    s3_free(&client->alloc, handles);
+    return code;
+}
+
+/*
+ * <ETag> XML-ответа (CompleteMultipartUpload, CopyPartResult) в out
+ * (S3_ETAG_MAX байт), кавычки там бывают как &quot;.
+ */
+static void
+s3_mpu_parse_etag(struct s3_mpu *m, const char *xml, char *out)
+{
+    char *v = s3_parse_xml_value(m->client, xml, "ETag", NULL);
+    if (v == NULL)
+        return;
+
+    size_t n = 0;
+    for (const char *p = v; *p != '\0' && n + 1 < S3_ETAG_MAX; ) {
+        if (strncmp(p, "&quot;", 6) == 0) {
+            out[n++] = '"';
+            p += 6;
+        } else {
+            out[n++] = *p++;
+        }
+    }
+    out[n] = '\0';
+    s3_free(&m->client->alloc, v);
+}
+
+s3_error_code_t
+s3_mpu_part_copy(struct s3_mpu *m, uint32_t number,
+                 const char *src_bucket, const char *src_key,
+                 const char *range, const char *if_match,
+                 s3_error_t *err)
+{
+    if (s3_mpu_check_number(number, err) != S3_E_OK)
+        return err->code;
+
+    s3_easy_handle_t *h = NULL;
+    if (s3_easy_factory_new_mpu_part_copy(m->client, &m->opts, m->upload_id,
+                                          number, src_bucket, src_key,
+                                          range, if_match, &h,
+                                          err) != S3_E_OK)
+        return err->code;
+
+    /*
+     * Копия может упасть и с 200 (<Error> в теле). 412 — источник уже
+     * не тот, повторять бессмысленно.
+     */
+    s3_error_code_t code;
+    for (int attempt = 0; ; attempt++) {
+        code = s3_mpu_perform(m->client, h, err);
+        if (code == S3_E_OK || attempt == S3_MPU_PART_RETRIES ||
+            code == S3_E_INVALID_ARG || code == S3_E_ACCESS_DENIED ||
+            code == S3_E_AUTH || code == S3_E_NOT_FOUND ||
+            err->http_status == 412 || s3_easy_handle_rewind(h) != 0)
+            break;
+    }
+
+    if (code == S3_E_OK) {
+        const char *resp = NULL;
+        s3_easy_handle_resp(h, &resp, err);
+        h->etag[0] = '\0';
+        s3_mpu_parse_etag(m, resp, h->etag);
+        code = s3_mpu_part_done(m, number, h, err);
+    }
+    s3_easy_handle_destroy(h);
+    return code;
+}
+
+static int
+s3_mpu_part_cmp(const void *a, const void *b)
+{
+    const struct s3_mpu_part *pa = (const struct s3_mpu_part *)a;
+    const struct s3_mpu_part *pb = (const struct s3_mpu_part *)b;
+    return pa->number < pb->number ? -1 : pa->number > pb->number;
+}
+
+s3_error_code_t
+s3_mpu_complete(struct s3_mpu *m, s3_error_t *err)
+{
+    s3_client_t *client = m->client;
+
+    qsort(m->parts, m->count, sizeof(*m->parts), s3_mpu_part_cmp);
+
+    s3_mem_buf_t body;
+    memset(&body, 0, sizeof(body));
+
+    s3_error_code_t code =
+        s3_mem_buf_append(client, &body, "<CompleteMultipartUpload>",
+                          strlen("<CompleteMultipartUpload>"), err);
+    for (size_t i = 0; i < m->count && code == S3_E_OK; i++) {
+        char part[64];
+        int n = snprintf(part, sizeof(part),
+                         "<Part><PartNumber>%u</PartNumber><ETag>",
+                         m->parts[i].number);
+        code = s3_mem_buf_append(client, &body, part, (size_t)n, err);
+        if (code == S3_E_OK)
+            code = s3_xml_append_escaped(client, &body, m->parts[i].etag, err);
+        if (code == S3_E_OK)
+            code = s3_mem_buf_append(client, &body, "</ETag></Part>",
+                                     strlen("</ETag></Part>"), err);
+    }
+    if (code == S3_E_OK)
+        code = s3_mem_buf_append(client, &body, "</CompleteMultipartUpload>",
+                                 strlen("</CompleteMultipartUpload>"), err);
+    if (code != S3_E_OK) {
+        if (body.data != NULL)
+            s3_free(&client->alloc, body.data);
+        return code;
+    }
+
+    s3_easy_handle_t *h = NULL;
+    code = s3_easy_factory_new_mpu_complete(client, &m->opts, m->upload_id,
+                                            &body, &h, err);
+    if (code != S3_E_OK) {
+        if (body.data != NULL)
+            s3_free(&client->alloc, body.data);
+        return code;
+    }
+
+    code = s3_mpu_perform(client, h, err);
+    if (code == S3_E_OK) {
+        const char *resp = NULL;
+        s3_easy_handle_resp(h, &resp, err);
+        s3_mpu_parse_etag(m, resp, m->etag);
+    }
+    s3_easy_handle_destroy(h);
+    return code;
+}
+
+void
+s3_mpu_abort(struct s3_mpu *m)
+{
+    if (m->upload_id == NULL)
+        return;
+
+    s3_error_t err = S3_ERROR_INIT;
+    s3_easy_handle_t *h = NULL;
+    if (s3_easy_factory_new_mpu_abort(m->client, &m->opts, m->upload_id,
+                                      &h, &err) == S3_E_OK)
+    {
+        struct s3_http_backend_impl *b = m->client->backend;
+        b->vtbl->perform(b, h, &err);
+        s3_easy_handle_destroy(h);
+    }
+
+    if (err.code != S3_E_OK)
+        say_warn("s3: failed to abort multipart upload %s: %s",
+                 m->upload_id, s3_error_message(&err));
+}
+
+void
+s3_mpu_destroy(struct s3_mpu *m)
+{
+    s3_client_t *client = m->client;
+    if (client == NULL)
+        return;
+
+    if (m->upload_id != NULL)
+        s3_free(&client->alloc, m->upload_id);
+    if (m->parts != NULL)
+        s3_free(&client->alloc, m->parts);
+    memset(m, 0, sizeof(*m));
+}
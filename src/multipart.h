@@ -0,0 +1,115 @@
+#ifndef TARANTOOL_S3_MULTIPART_H_INCLUDED
+#define TARANTOOL_S3_MULTIPART_H_INCLUDED 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "s3_internal.h"
+#include "s3/curl_easy_factory.h"
+
+/*
+ * Multipart upload поверх фабрики и backend->perform/perform_many.
+ *
+ * Все функции блокирующие и вызываются из coio-воркера (или другого
+ * не-tx потока). Строки opts должны жить, пока жив s3_mpu.
+ */
+
+/* Ограничения S3. */
+#define S3_MPU_MIN_PART_SIZE   (5u * 1024 * 1024)
+#define S3_MPU_MAX_PARTS       10000
+
+struct s3_mpu_part {
+    uint32_t number;
+    char etag[S3_ETAG_MAX];
+};
+
+struct s3_mpu {
+    s3_client_t *client;
+    s3_put_opts_t opts;
+    char *upload_id;
+    /* ETag объекта после s3_mpu_complete (с кавычками). */
+    char etag[S3_ETAG_MAX];
+
+    /* Загруженные части, в порядке завершения. */
+    struct s3_mpu_part *parts;
+    size_t count;
+    size_t cap;
+};
+
+/* CreateMultipartUpload. При ошибке m можно сразу s3_mpu_destroy. */
+s3_error_code_t
+s3_mpu_begin(struct s3_mpu *m, s3_client_t *client,
+             const s3_put_opts_t *opts, s3_error_t *err);
+
+/* Хендл UploadPart; data/size живут до уничтожения хендла. */
+s3_error_code_t
+s3_mpu_part_handle(struct s3_mpu *m, uint32_t number,
+                   const void *data, size_t size,
+                   s3_easy_handle_t **out, s3_error_t *err);
+
+/* Хендл UploadPart из size байт файла fd начиная с offset. */
+s3_error_code_t
+s3_mpu_part_handle_fd(struct s3_mpu *m, uint32_t number,
+                      int fd, off_t offset, size_t size,
+                      s3_easy_handle_t **out, s3_error_t *err);
+
+/* Хендл UploadPart из кусков файлов; segs живут до уничтожения хендла. */
+s3_error_code_t
+s3_mpu_part_handle_iov(struct s3_mpu *m, uint32_t number,
+                       const s3_put_seg_t *segs, size_t count,
+                       s3_easy_handle_t **out, s3_error_t *err);
+
+/*
+ * UploadPartCopy: часть number — range ("bytes=a-b", NULL — целиком)
+ * объекта src_bucket/src_key, с проверкой if_match (может быть NULL).
+ * Выполняется сразу, с повторами; ETag части запоминается.
+ */
+s3_error_code_t
+s3_mpu_part_copy(struct s3_mpu *m, uint32_t number,
+                 const char *src_bucket, const char *src_key,
+                 const char *range, const char *if_match,
+                 s3_error_t *err);
+
+/* Запомнить ETag выполненного UploadPart. */
+s3_error_code_t
+s3_mpu_part_done(struct s3_mpu *m, uint32_t number,
+                 const s3_easy_handle_t *h, s3_error_t *err);
+
+/*
+ * Повторить упавший UploadPart (code/err — результат первой попытки)
+ * через backend клиента m. Возвращает итоговый код, err — последняя ошибка.
+ */
+s3_error_code_t
+s3_mpu_part_retry(struct s3_mpu *m, s3_easy_handle_t *h,
+                  s3_error_code_t code, s3_error_t *err);
+
+/*
+ * Загрузить n частей с номерами first, first + 1, ... одновременно
+ * (perform_many). Упавшие части повторяются по одной.
+ */
+s3_error_code_t
+s3_mpu_upload_parts(struct s3_mpu *m, uint32_t first,
+                    char *const *bufs, const size_t *sizes, size_t n,
+                    s3_error_t *err);
+
+/*
+ * То же для готовых хендлов UploadPart (номера first, first + 1, ...).
+ * Хендлы уничтожаются в любом случае.
+ */
+s3_error_code_t
+s3_mpu_upload_handles(struct s3_mpu *m, uint32_t first,
+                      s3_easy_handle_t **handles, size_t n,
+                      s3_error_t *err);
+
+/* CompleteMultipartUpload по всем запомненным частям. */
+s3_error_code_t
+s3_mpu_complete(struct s3_mpu *m, s3_error_t *err);
+
+/* AbortMultipartUpload, ошибки только логируются. */
+void
+s3_mpu_abort(struct s3_mpu *m);
+
+void
+s3_mpu_destroy(struct s3_mpu *m);
+
+#endif /* TARANTOOL_S3_MULTIPART_H_INCLUDED */
@@ -0,0 +1,794 @@
+#include "s3/pack.h"
+#include "s3/alloc.h"
+
+#include "s3_internal.h"
+#include "http/http_util.h"
+#include "error.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+/*
+ * Сколько байт хвоста забираем при открытии pack'а. Для типичных pack'ов
+ * (тысячи member'ов с короткими именами) index целиком влезает сюда и
+ * открытие стоит один запрос.
+ */
+#define S3_PACK_TAIL_PROBE (64 * 1024)
+
+/* Размер заголовка записи index без имени: offset + size + name_len. */
+#define S3_PACK_ENTRY_HDR (8 + 8 + 2)
+
+struct s3_pack_entry {
+    const char *name; /* writer: своя копия; reader: указатель в tail */
+    size_t name_len;
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct s3_pack_writer {
+    s3_client_t *client;
+
+    s3_mem_buf_t data; /* данные member'ов, затем index + footer */
+
+    struct s3_pack_entry *entries;
+    size_t count;
+    size_t capacity;
+
+    bool finished;
+};
+
+struct s3_pack_reader {
+    s3_client_t *client;
+    char *bucket; /* NULL — default_bucket клиента */
+    char *key;
+
+    char *tail;   /* index + footer */
+    size_t tail_size;
+
+    struct s3_pack_entry *entries;
+    size_t count;
+};
+
+/* ----------------- little-endian ----------------- */
+
+static inline void
+s3_pack_store_u16(char *p, uint16_t v)
+{
+    p[0] = (char)(v & 0xff);
+    p[1] = (char)(v >> 8);
+}
+
+static inline void
+s3_pack_store_u32(char *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = (char)((v >> (8 * i)) & 0xff);
+}
+
+static inline void
+s3_pack_store_u64(char *p, uint64_t v)
+{
+    for (int i = 0; i < 8; i++)
+        p[i] = (char)((v >> (8 * i)) & 0xff);
+}
+
+static inline uint16_t
+s3_pack_load_u16(const char *p)
+{
+    const unsigned char *u = (const unsigned char *)p;
+    return (uint16_t)(u[0] | (u[1] << 8));
+}
+
+static inline uint32_t
+s3_pack_load_u32(const char *p)
+{
+    const unsigned char *u = (const unsigned char *)p;
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; i--)
+        v = (v << 8) | u[i];
+    return v;
+}
+
+static inline uint64_t
+s3_pack_load_u64(const char *p)
+{
+    const unsigned char *u = (const unsigned char *)p;
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--)
+        v = (v << 8) | u[i];
+    return v;
+}
+
+static int
+s3_pack_name_cmp(const char *a, size_t a_len, const char *b, size_t b_len)
+{
+    size_t n = a_len < b_len ? a_len : b_len;
+    int rc = memcmp(a, b, n);
+    if (rc != 0)
+        return rc;
+    if (a_len == b_len)
+        return 0;
+    return a_len < b_len ? -1 : 1;
+}
+
+static int
+s3_pack_entry_cmp(const void *a, const void *b)
+{
+    const struct s3_pack_entry *ea = (const struct s3_pack_entry *)a;
+    const struct s3_pack_entry *eb = (const struct s3_pack_entry *)b;
+    return s3_pack_name_cmp(ea->name, ea->name_len, eb->name, eb->name_len);
+}
+
+/* ----------------- writer ----------------- */
+
+s3_error_code_t
+s3_pack_writer_new(s3_client_t *client,
+                   s3_pack_writer_t **out_writer,
+                   s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (client == NULL || out_writer == NULL) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client or out_writer is NULL", 0, 0, 0);
+        return err->code;
+    }
+
+    s3_pack_writer_t *w = (s3_pack_writer_t *)s3_alloc(&client->alloc,
+                                                       sizeof(*w));
+    if (w == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate pack writer", ENOMEM, 0, 0);
+        return err->code;
+    }
+
+    memset(w, 0, sizeof(*w));
+    w->client = client;
+
+    *out_writer = w;
+    return S3_E_OK;
+}
+
+s3_error_code_t
+s3_pack_writer_add(s3_pack_writer_t *w,
+                   const char *name,
+                   const void *data, size_t size,
+                   s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (w == NULL || name == NULL || name[0] == '\0' ||
+        (data == NULL && size != 0))
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "invalid pack member", 0, 0, 0);
+        return err->code;
+    }
+
+    if (w->finished) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "pack writer is already finished", 0, 0, 0);
+        return err->code;
+    }
+
+    size_t name_len = strlen(name);
+    if (name_len > S3_PACK_NAME_MAX) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "pack member name is too long", 0, 0, 0);
+        return err->code;
+    }
+
+    s3_client_t *c = w->client;
+
+    if (w->count == w->capacity) {
+        size_t new_cap = w->capacity ? w->capacity * 2 : 64;
+        struct s3_pack_entry *tmp =
+            (struct s3_pack_entry *)s3_realloc(&c->alloc, w->entries,
+                                               new_cap * sizeof(*tmp));
+        if (tmp == NULL) {
+            s3_error_set(err, S3_E_NOMEM,
+                         "Out of memory in pack writer", ENOMEM, 0, 0);
+            return err->code;
+        }
+        w->entries = tmp;
+        w->capacity = new_cap;
+    }
+
+    char *name_copy = s3_strdup_a(&c->alloc, name, err);
+    if (name_copy == NULL)
+        return err->code;
+
+    uint64_t offset = w->data.size;
+    if (size > 0 &&
+        s3_mem_buf_append(c, &w->data, (const char *)data, size,
+                          err) != S3_E_OK)
+    {
+        s3_free(&c->alloc, name_copy);
+        return err->code;
+    }
+
+    struct s3_pack_entry *e = &w->entries[w->count++];
+    e->name = name_copy;
+    e->name_len = name_len;
+    e->offset = offset;
+    e->size = size;
+    return S3_E_OK;
+}
+
+size_t
+s3_pack_writer_count(const s3_pack_writer_t *w)
+{
+    return w != NULL ? w->count : 0;
+}
+
+s3_error_code_t
+s3_pack_writer_finish(s3_pack_writer_t *w,
+                      const s3_put_opts_t *opts,
+                      s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (w == NULL || opts == NULL || w->finished) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "invalid pack writer or opts", 0, 0, 0);
+        return err->code;
+    }
+
+    s3_client_t *c = w->client;
+
+    qsort(w->entries, w->count, sizeof(w->entries[0]), s3_pack_entry_cmp);
+
+    for (size_t i = 1; i < w->count; i++) {
+        if (s3_pack_entry_cmp(&w->entries[i - 1], &w->entries[i]) == 0) {
+            s3_error_set(err, S3_E_INVALID_ARG,
+                         "duplicate pack member name", 0, 0, 0);
+            return err->code;
+        }
+    }
+
+    /* Неудачу можно повторить: index и footer дописываются заново. */
+    uint64_t index_offset = w->data.size;
+
+    for (size_t i = 0; i < w->count; i++) {
+        const struct s3_pack_entry *e = &w->entries[i];
+        char hdr[S3_PACK_ENTRY_HDR];
+        s3_pack_store_u64(hdr, e->offset);
+        s3_pack_store_u64(hdr + 8, e->size);
+        s3_pack_store_u16(hdr + 16, (uint16_t)e->name_len);
+
+        if (s3_mem_buf_append(c, &w->data, hdr, sizeof(hdr), err) != S3_E_OK ||
+            s3_mem_buf_append(c, &w->data, e->name, e->name_len,
+                              err) != S3_E_OK)
+        {
+            goto fail;
+        }
+    }
+
+    uint64_t index_size = w->data.size - index_offset;
+
+    char footer[S3_PACK_FOOTER_SIZE];
+    memcpy(footer, S3_PACK_MAGIC, 8);
+    s3_pack_store_u64(footer + 8, index_offset);
+    s3_pack_store_u64(footer + 16, index_size);
+    s3_pack_store_u32(footer + 24, (uint32_t)w->count);
+    s3_pack_store_u32(footer + 28, 0);
+
+    if (s3_mem_buf_append(c, &w->data, footer, sizeof(footer),
+                          err) != S3_E_OK)
+        goto fail;
+
+    s3_put_opts_t put = *opts;
+    if (put.content_type == NULL)
+        put.content_type = "application/octet-stream";
+
+    if (s3_client_put_buf(c, &put, w->data.data, w->data.size,
+                          err) != S3_E_OK)
+        goto fail;
+
+    w->finished = true;
+    return S3_E_OK;
+
+fail:
+    w->data.size = (size_t)index_offset;
+    return err->code;
+}
+
+void
+s3_pack_writer_delete(s3_pack_writer_t *w)
+{
+    if (w == NULL)
+        return;
+
+    s3_client_t *c = w->client;
+
+    for (size_t i = 0; i < w->count; i++)
+        s3_free(&c->alloc, (char *)w->entries[i].name);
+    if (w->entries != NULL)
+        s3_free(&c->alloc, w->entries);
+    if (w->data.data != NULL)
+        s3_free(&c->alloc, w->data.data);
+
+    s3_free(&c->alloc, w);
+}
+
+/* ----------------- reader ----------------- */
+
+/*
+ * Разобрать tail (index + footer) в массив entries.
+ * Проверяем границы, но доверяем порядку сортировки writer'а.
+ */
+static s3_error_code_t
+s3_pack_reader_parse(s3_pack_reader_t *r, s3_error_t *err)
+{
+    s3_client_t *c = r->client;
+    const char *footer = r->tail + r->tail_size - S3_PACK_FOOTER_SIZE;
+    uint64_t index_offset = s3_pack_load_u64(footer + 8);
+    uint64_t index_size = s3_pack_load_u64(footer + 16);
+    uint32_t count = s3_pack_load_u32(footer + 24);
+
+    if (index_size != r->tail_size - S3_PACK_FOOTER_SIZE) {
+        s3_error_set(err, S3_E_INTERNAL,
+                     "pack index size mismatch", 0, 0, 0);
+        return err->code;
+    }
+
+    /* count из footer'а не верим, пока его записи не влезли в index. */
+    if ((uint64_t)count * S3_PACK_ENTRY_HDR > index_size)
+        goto corrupted;
+
+    if (count > 0) {
+        r->entries = (struct s3_pack_entry *)s3_alloc(&c->alloc,
+                                                      count * sizeof(*r->entries));
+        if (r->entries == NULL) {
+            s3_error_set(err, S3_E_NOMEM,
+                         "Out of memory parsing pack index", ENOMEM, 0, 0);
+            return err->code;
+        }
+    }
+
+    const char *p = r->tail;
+    const char *end = r->tail + index_size;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if ((size_t)(end - p) < S3_PACK_ENTRY_HDR)
+            goto corrupted;
+
+        struct s3_pack_entry *e = &r->entries[i];
+        e->offset = s3_pack_load_u64(p);
+        e->size = s3_pack_load_u64(p + 8);
+        e->name_len = s3_pack_load_u16(p + 16);
+        p += S3_PACK_ENTRY_HDR;
+
+        /* Данные member'а — только до index'а. */
+        if (e->size > index_offset || e->offset > index_offset - e->size)
+            goto corrupted;
+
+        if ((size_t)(end - p) < e->name_len)
+            goto corrupted;
+        e->name = p;
+        p += e->name_len;
+    }
+
+    if (p != end)
+        goto corrupted;
+
+    r->count = count;
+    return S3_E_OK;
+
+corrupted:
+    s3_error_set(err, S3_E_INTERNAL, "pack index is corrupted", 0, 0, 0);
+    return err->code;
+}
+
+static s3_error_code_t
+s3_pack_reader_alloc(s3_client_t *client,
+                     const char *bucket, const char *key,
+                     s3_pack_reader_t **out, s3_error_t *err)
+{
+    s3_pack_reader_t *r = (s3_pack_reader_t *)s3_alloc(&client->alloc,
+                                                       sizeof(*r));
+    if (r == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate pack reader", ENOMEM, 0, 0);
+        return err->code;
+    }
+    memset(r, 0, sizeof(*r));
+    r->client = client;
+
+    if (bucket != NULL) {
+        r->bucket = s3_strdup_a(&client->alloc, bucket, err);
+        if (r->bucket == NULL)
+            goto fail;
+    }
+    r->key = s3_strdup_a(&client->alloc, key, err);
+    if (r->key == NULL)
+        goto fail;
+
+    *out = r;
+    return S3_E_OK;
+
+fail:
+    s3_pack_reader_delete(r);
+    return err->code;
+}
+
+static bool
+s3_pack_footer_valid(const char *footer)
+{
+    return memcmp(footer, S3_PACK_MAGIC, 8) == 0;
+}
+
+s3_error_code_t
+s3_pack_reader_open(s3_client_t *client,
+                    const char *bucket, const char *key,
+                    s3_pack_reader_t **out_reader,
+                    s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (client == NULL || key == NULL || out_reader == NULL) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, key or out_reader is NULL", 0, 0, 0);
+        return err->code;
+    }
+
+    s3_pack_reader_t *r = NULL;
+    if (s3_pack_reader_alloc(client, bucket, key, &r, err) != S3_E_OK)
+        return err->code;
+
+    char *probe = (char *)s3_alloc(&client->alloc, S3_PACK_TAIL_PROBE);
+    if (probe == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Out of memory reading pack tail", ENOMEM, 0, 0);
+        goto fail;
+    }
+
+    /* 1) Хвост объекта: suffix range. */
+    char range[64];
+    snprintf(range, sizeof(range), "bytes=-%d", S3_PACK_TAIL_PROBE);
+
+    s3_get_opts_t get;
+    memset(&get, 0, sizeof(get));
+    get.bucket = bucket;
+    get.key = key;
+    get.range = range;
+
+    size_t got = 0;
+    uint64_t object_size = 0;
+    if (s3_client_get_buf_sized(client, &get, probe, S3_PACK_TAIL_PROBE,
+                                &got, &object_size, err) != S3_E_OK)
+    {
+        s3_free(&client->alloc, probe);
+        goto fail;
+    }
+
+    if (got < S3_PACK_FOOTER_SIZE ||
+        !s3_pack_footer_valid(probe + got - S3_PACK_FOOTER_SIZE))
+    {
+        s3_free(&client->alloc, probe);
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "object is not a pack (bad footer)", 0, 0, 0);
+        goto fail;
+    }
+
+    /* Без Content-Range размер известен, только если объект влез целиком. */
+    if (object_size == 0 && got < S3_PACK_TAIL_PROBE)
+        object_size = got;
+
+    /*
+     * footer не проверен ничем, кроме magic: index должен лежать ровно
+     * перед ним и кончаться концом объекта — до любой аллокации.
+     */
+    const char *footer = probe + got - S3_PACK_FOOTER_SIZE;
+    uint64_t index_offset = s3_pack_load_u64(footer + 8);
+    uint64_t index_size = s3_pack_load_u64(footer + 16);
+
+    if (object_size < S3_PACK_FOOTER_SIZE ||
+        index_size > object_size - S3_PACK_FOOTER_SIZE ||
+        index_offset != object_size - S3_PACK_FOOTER_SIZE - index_size)
+    {
+        s3_free(&client->alloc, probe);
+        s3_error_set(err, S3_E_INTERNAL,
+                     object_size == 0 ? "pack size is unknown" :
+                     "pack footer does not match object size", 0, 0, 0);
+        goto fail;
+    }
+    if (index_size > SIZE_MAX - S3_PACK_FOOTER_SIZE) {
+        s3_free(&client->alloc, probe);
+        s3_error_set(err, S3_E_INTERNAL,
+                     "pack index is too large", 0, 0, 0);
+        goto fail;
+    }
+    size_t tail_size = (size_t)index_size + S3_PACK_FOOTER_SIZE;
+
+    if (tail_size <= got) {
+        /* Index целиком в пробе — переносим хвост в начало буфера. */
+        memmove(probe, probe + got - tail_size, tail_size);
+        r->tail = probe;
+        r->tail_size = tail_size;
+    } else {
+        /* 2) Большой index — дочитываем его отдельным Range GET. */
+        s3_free(&client->alloc, probe);
+
+        r->tail = (char *)s3_alloc(&client->alloc, tail_size);
+        if (r->tail == NULL) {
+            s3_error_set(err, S3_E_NOMEM,
+                         "Out of memory reading pack index", ENOMEM, 0, 0);
+            goto fail;
+        }
+        r->tail_size = tail_size;
+
+        snprintf(range, sizeof(range), "bytes=%llu-%llu",
+                 (unsigned long long)index_offset,
+                 (unsigned long long)(index_offset + tail_size - 1));
+
+        if (s3_client_get_buf(client, &get, r->tail, tail_size,
+                              &got, err) != S3_E_OK)
+            goto fail;
+
+        if (got != tail_size ||
+            !s3_pack_footer_valid(r->tail + tail_size - S3_PACK_FOOTER_SIZE))
+        {
+            s3_error_set(err, S3_E_INTERNAL,
+                         "pack changed while reading index", 0, 0, 0);
+            goto fail;
+        }
+    }
+
+    if (s3_pack_reader_parse(r, err) != S3_E_OK)
+        goto fail;
+
+    *out_reader = r;
+    return S3_E_OK;
+
+fail:
+    s3_pack_reader_delete(r);
+    return err->code;
+}
+
+s3_error_code_t
+s3_pack_reader_open_index(s3_client_t *client,
+                          const char *bucket, const char *key,
+                          const void *tail, size_t tail_size,
+                          s3_pack_reader_t **out_reader,
+                          s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (client == NULL || key == NULL || out_reader == NULL ||
+        tail == NULL || tail_size < S3_PACK_FOOTER_SIZE ||
+        !s3_pack_footer_valid((const char *)tail + tail_size -
+                              S3_PACK_FOOTER_SIZE))
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "invalid cached pack index", 0, 0, 0);
+        return err->code;
+    }
+
+    s3_pack_reader_t *r = NULL;
+    if (s3_pack_reader_alloc(client, bucket, key, &r, err) != S3_E_OK)
+        return err->code;
+
+    r->tail = (char *)s3_alloc(&client->alloc, tail_size);
+    if (r->tail == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Out of memory copying pack index", ENOMEM, 0, 0);
+        goto fail;
+    }
+    memcpy(r->tail, tail, tail_size);
+    r->tail_size = tail_size;
+
+    if (s3_pack_reader_parse(r, err) != S3_E_OK)
+        goto fail;
+
+    *out_reader = r;
+    return S3_E_OK;
+
+fail:
+    s3_pack_reader_delete(r);
+    return err->code;
+}
+
+void
+s3_pack_reader_index(const s3_pack_reader_t *r,
+                     const void **tail, size_t *tail_size)
+{
+    if (tail != NULL)
+        *tail = r->tail;
+    if (tail_size != NULL)
+        *tail_size = r->tail_size;
+}
+
+size_t
+s3_pack_reader_count(const s3_pack_reader_t *r)
+{
+    return r != NULL ? r->count : 0;
+}
+
+s3_error_code_t
+s3_pack_reader_member(const s3_pack_reader_t *r, size_t i,
+                      const char **name, size_t *name_len,
+                      uint64_t *size)
+{
+    if (r == NULL || i >= r->count)
+        return S3_E_INVALID_ARG;
+
+    const struct s3_pack_entry *e = &r->entries[i];
+    if (name != NULL)
+        *name = e->name;
+    if (name_len != NULL)
+        *name_len = e->name_len;
+    if (size != NULL)
+        *size = e->size;
+    return S3_E_OK;
+}
+
+static const struct s3_pack_entry *
+s3_pack_reader_find(const s3_pack_reader_t *r, const char *name)
+{
+    size_t name_len = strlen(name);
+    size_t lo = 0;
+    size_t hi = r->count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const struct s3_pack_entry *e = &r->entries[mid];
+        int rc = s3_pack_name_cmp(e->name, e->name_len, name, name_len);
+        if (rc == 0)
+            return e;
+        if (rc < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return NULL;
+}
+
+s3_error_code_t
+s3_pack_reader_stat(const s3_pack_reader_t *r, const char *name,
+                    uint64_t *size)
+{
+    if (r == NULL || name == NULL)
+        return S3_E_INVALID_ARG;
+
+    const struct s3_pack_entry *e = s3_pack_reader_find(r, name);
+    if (e == NULL)
+        return S3_E_NOT_FOUND;
+
+    if (size != NULL)
+        *size = e->size;
+    return S3_E_OK;
+}
+
+/*
+ * Найти member и подготовить Range GET на него.
+ * range — буфер под заголовок Range.
+ */
+static s3_error_code_t
+s3_pack_reader_prepare_get(s3_pack_reader_t *r, const char *name,
+                           s3_get_opts_t *get,
+                           char *range, size_t range_cap,
+                           const struct s3_pack_entry **out_entry,
+                           s3_error_t *err)
+{
+    if (r == NULL || name == NULL) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "reader or name is NULL", 0, 0, 0);
+        return err->code;
+    }
+
+    const struct s3_pack_entry *e = s3_pack_reader_find(r, name);
+    if (e == NULL) {
+        s3_error_set(err, S3_E_NOT_FOUND,
+                     "pack member not found", 0, 0, 0);
+        return err->code;
+    }
+
+    memset(get, 0, sizeof(*get));
+    get->bucket = r->bucket;
+    get->key = r->key;
+    get->flags = S3_GET_F_NO_COALESCE;
+
+    if (e->size > 0) {
+        snprintf(range, range_cap, "bytes=%llu-%llu",
+                 (unsigned long long)e->offset,
+                 (unsigned long long)(e->offset + e->size - 1));
+        get->range = range;
+    }
+
+    *out_entry = e;
+    return S3_E_OK;
+}
+
+s3_error_code_t
+s3_pack_reader_get_buf(s3_pack_reader_t *r, const char *name,
+                       void *buf, size_t cap,
+                       size_t *bytes_read,
+                       s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    s3_get_opts_t get;
+    char range[64];
+    const struct s3_pack_entry *e = NULL;
+
+    if (s3_pack_reader_prepare_get(r, name, &get, range, sizeof(range),
+                                   &e, err) != S3_E_OK)
+        return err->code;
+
+    if (bytes_read != NULL)
+        *bytes_read = 0;
+    if (e->size == 0)
+        return S3_E_OK;
+
+    if (buf == NULL || cap < e->size) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "buffer is too small for pack member", 0, 0, 0);
+        return err->code;
+    }
+
+    return s3_client_get_buf(r->client, &get, buf, (size_t)e->size,
+                             bytes_read, err);
+}
+
+s3_error_code_t
+s3_pack_reader_get_fd(s3_pack_reader_t *r, const char *name,
+                      int fd, off_t offset,
+                      size_t *bytes_written,
+                      s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    s3_get_opts_t get;
+    char range[64];
+    const struct s3_pack_entry *e = NULL;
+
+    if (s3_pack_reader_prepare_get(r, name, &get, range, sizeof(range),
+                                   &e, err) != S3_E_OK)
+        return err->code;
+
+    if (bytes_written != NULL)
+        *bytes_written = 0;
+    if (e->size == 0)
+        return S3_E_OK;
+
+    return s3_client_get_fd(r->client, &get, fd, offset, (size_t)e->size,
+                            bytes_written, err);
+}
+
+void
+s3_pack_reader_delete(s3_pack_reader_t *r)
+{
+    if (r == NULL)
+        return;
+
+    s3_client_t *c = r->client;
+
+    if (r->entries != NULL)
+        s3_free(&c->alloc, r->entries);
+    if (r->tail != NULL)
+        s3_free(&c->alloc, r->tail);
+    if (r->bucket != NULL)
+        s3_free(&c->alloc, r->bucket);
+    if (r->key != NULL)
+        s3_free(&c->alloc, r->key);
+
+    s3_free(&c->alloc, r);
+}
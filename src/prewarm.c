@@ -0,0 +1,190 @@
+#include "prewarm.h"
+#include "s3/curl_easy_factory.h"
+#include "error.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include <tarantool/module.h>
+
+#define S3_PREWARM_DEFAULT_INTERVAL_MS 15000
+
+struct s3_prewarm {
+    struct s3_client *client;
+
+    char *bucket;
+    size_t count;   /* хендлов в раунде */
+    uint32_t interval_ms;
+
+    s3_easy_handle_t **handles;
+    s3_error_code_t *codes;
+    s3_error_t *errs;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t thread;
+    bool thread_started;
+    bool stop;
+};
+
+/*
+ * Один раунд. Возвращает число запросов, получивших HTTP ответ:
+ * 403/404 тоже значат, что соединение установлено.
+ */
+static size_t
+s3_prewarm_round(struct s3_prewarm *p)
+{
+    struct s3_client *client = p->client;
+    struct s3_http_backend_impl *b = client->backend;
+    size_t nh = 0;
+
+    for (size_t i = 0; i < p->count; i++) {
+        s3_error_t err = S3_ERROR_INIT;
+        if (s3_easy_factory_new_head_bucket(client, p->bucket,
+                                            &p->handles[nh], &err) != S3_E_OK)
+            break;
+        nh++;
+    }
+    if (nh == 0)
+        return 0;
+
+    s3_error_t batch_err = S3_ERROR_INIT;
+    b->vtbl->perform_many(b, p->handles, nh, p->codes, p->errs, &batch_err);
+
+    size_t ok = 0;
+    for (size_t i = 0; i < nh; i++) {
+        if (p->codes[i] == S3_E_OK || p->errs[i].http_status > 0)
+            ok++;
+        s3_easy_handle_destroy(p->handles[i]);
+    }
+    return ok;
+}
+
+static void *
+s3_prewarm_main(void *arg)
+{
+    struct s3_prewarm *p = (struct s3_prewarm *)arg;
+
+    size_t ok = s3_prewarm_round(p);
+    if (ok == 0)
+        say_warn("s3: connection prewarm failed for %s", p->client->endpoint);
+    else
+        say_info("s3: prewarmed %zu connections", ok);
+
+    pthread_mutex_lock(&p->mutex);
+    while (!p->stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += p->interval_ms / 1000;
+        deadline.tv_nsec += (long)(p->interval_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&p->cond, &p->mutex, &deadline);
+        if (p->stop)
+            break;
+
+        pthread_mutex_unlock(&p->mutex);
+        s3_prewarm_round(p);
+        pthread_mutex_lock(&p->mutex);
+    }
+    pthread_mutex_unlock(&p->mutex);
+    return NULL;
+}
+
+s3_error_code_t
+s3_prewarm_new(struct s3_client *client,
+               const s3_client_opts_t *opts,
+               struct s3_prewarm **out,
+               s3_error_t *err)
+{
+    const char *bucket = opts->prewarm_bucket != NULL ?
+        opts->prewarm_bucket : client->default_bucket;
+    if (bucket == NULL) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "prewarm_connections requires prewarm_bucket "
+                     "or default_bucket", 0, 0, 0);
+        return err->code;
+    }
+
+    struct s3_prewarm *p =
+        (struct s3_prewarm *)s3_alloc(&client->alloc, sizeof(*p));
+    if (p == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate prewarm", ENOMEM, 0, 0);
+        return err->code;
+    }
+    memset(p, 0, sizeof(*p));
+    p->client = client;
+    p->interval_ms = opts->keep_warm_interval_ms > 0 ?
+        opts->keep_warm_interval_ms : S3_PREWARM_DEFAULT_INTERVAL_MS;
+
+    /* Больше max_total_connections всё равно не откроется. */
+    size_t endpoints = opts->endpoints_count > 1 ? opts->endpoints_count : 1;
+    p->count = (size_t)opts->prewarm_connections * endpoints;
+    if (p->count > client->max_total_connections)
+        p->count = client->max_total_connections;
+
+    pthread_mutex_init(&p->mutex, NULL);
+    pthread_cond_init(&p->cond, NULL);
+
+    p->bucket = s3_strdup_a(&client->alloc, bucket, err);
+    p->handles = s3_alloc(&client->alloc, p->count * sizeof(*p->handles));
+    p->codes = s3_alloc(&client->alloc, p->count * sizeof(*p->codes));
+    p->errs = s3_alloc(&client->alloc, p->count * sizeof(*p->errs));
+    if (p->bucket == NULL || p->handles == NULL ||
+        p->codes == NULL || p->errs == NULL)
+    {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate prewarm", ENOMEM, 0, 0);
+        goto fail;
+    }
+
+    int rc = pthread_create(&p->thread, NULL, s3_prewarm_main, p);
+    if (rc != 0) {
+        s3_error_set(err, S3_E_INIT,
+                     "pthread_create failed for prewarm", rc, 0, 0);
+        goto fail;
+    }
+    p->thread_started = true;
+
+    *out = p;
+    return S3_E_OK;
+
+fail:
+    s3_prewarm_delete(p);
+    return err->code;
+}
+
+void
+s3_prewarm_delete(struct s3_prewarm *p)
+{
+    if (p == NULL)
+        return;
+
+    s3_client_t *c = p->client;
+
+    if (p->thread_started) {
+        pthread_mutex_lock(&p->mutex);
+        p->stop = true;
+        pthread_cond_signal(&p->cond);
+        pthread_mutex_unlock(&p->mutex);
+        pthread_join(p->thread, NULL);
+    }
+
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->mutex);
+
+    if (p->errs != NULL)
+        s3_free(&c->alloc, p->errs);
+    if (p->codes != NULL)
+        s3_free(&c->alloc, p->codes);
+    if (p->handles != NULL)
+        s3_free(&c->alloc, p->handles);
+    if (p->bucket != NULL)
+        s3_free(&c->alloc, p->bucket);
+    s3_free(&c->alloc, p);
+}
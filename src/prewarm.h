@@ -0,0 +1,34 @@
+#ifndef TARANTOOL_S3_PREWARM_H_INCLUDED
+#define TARANTOOL_S3_PREWARM_H_INCLUDED 1
+
+#include "s3_internal.h"
+
+/*
+ * Прогрев соединений (s3_client_opts_t.prewarm_connections).
+ *
+ * Фоновый поток сразу после создания клиента отправляет пачку
+ * одновременных HEAD bucket через backend->perform_many, так что
+ * TCP/TLS handshake'и случаются до первого пользовательского запроса, а
+ * соединения остаются в пуле multi backend'а. Затем раз в
+ * keep_warm_interval_ms пачка повторяется: живые соединения
+ * переиспользуются, закрытые сервером по простою открываются заново.
+ *
+ * Запросы идут обычным путём (endpoint.c, resolve.c), поэтому при
+ * нескольких endpoint'ах пачка (prewarm_connections на каждый)
+ * распределяется между ними, а вернувшийся после исключения endpoint
+ * прогревается на следующем раунде.
+ */
+
+struct s3_prewarm;
+
+s3_error_code_t
+s3_prewarm_new(struct s3_client *client,
+               const s3_client_opts_t *opts,
+               struct s3_prewarm **out,
+               s3_error_t *err);
+
+/* Останавливает поток; ждёт текущий раунд. */
+void
+s3_prewarm_delete(struct s3_prewarm *p);
+
+#endif /* TARANTOOL_S3_PREWARM_H_INCLUDED */
@@ -0,0 +1,287 @@
+#include "s3_internal.h"
+#include "multipart.h"
+#include "s3/curl_easy_factory.h"
+#include "error.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <tarantool/module.h>
+
+#define S3_PUT_IOV_DEFAULT_PART_SIZE   (8u * 1024 * 1024)
+#define S3_PUT_IOV_DEFAULT_CONCURRENCY 4
+#define S3_PUT_IOV_MAX_CONCURRENCY     64
+
+struct s3_put_iov_task {
+    s3_client_t *client;
+    s3_put_opts_t opts;
+    size_t part_size;
+    uint32_t concurrency;
+    const s3_put_seg_t *segs;
+    size_t count;
+    uint64_t size;
+    char etag[S3_ETAG_MAX];
+
+    s3_error_t err;
+    s3_error_code_t code;
+};
+
+/* Весь объект — одна часть: обычный PUT, read callback идёт по segs. */
+static s3_error_code_t
+s3_put_iov_single(struct s3_put_iov_task *t)
+{
+    struct s3_http_backend_impl *b = t->client->backend;
+
+    s3_easy_handle_t *h = NULL;
+    s3_error_code_t code = s3_easy_factory_new_put_iov(t->client, &t->opts,
+                                                       t->segs, t->count,
+                                                       &h, &t->err);
+    if (code != S3_E_OK)
+        return code;
+
+    code = b->vtbl->perform(b, h, &t->err);
+    if (code == S3_E_OK)
+        memcpy(t->etag, h->etag, sizeof(t->etag));
+    s3_easy_handle_destroy(h);
+    return code;
+}
+
+/*
+ * Нарезать segs на части по part_size: часть p — это
+ * slices[first[p] .. first[p] + nslices[p]). Сегмент, который пересекает
+ * границу части, делится на два куска. Пустые сегменты пропускаются.
+ */
+static void
+s3_put_iov_split(const struct s3_put_iov_task *t, size_t nparts,
+                 s3_put_seg_t *slices, size_t *first, size_t *nslices)
+{
+    size_t si = 0;
+    size_t i = 0;
+    size_t in_seg = 0;
+    uint64_t left = t->size;
+
+    for (size_t p = 0; p < nparts; p++) {
+        size_t need = left < t->part_size ? (size_t)left : t->part_size;
+        left -= need;
+        first[p] = si;
+
+        while (need > 0) {
+            while (in_seg == t->segs[i].len) {
+                i++;
+                in_seg = 0;
+            }
+            size_t take = t->segs[i].len - in_seg;
+            if (take > need)
+                take = need;
+
+            slices[si].fd = t->segs[i].fd;
+            slices[si].offset = t->segs[i].offset + (off_t)in_seg;
+            slices[si].len = take;
+            si++;
+
+            in_seg += take;
+            need -= take;
+        }
+        nslices[p] = si - first[p];
+    }
+}
+
+static s3_error_code_t
+s3_put_iov_multipart(struct s3_put_iov_task *t, struct s3_mpu *mpu)
+{
+    s3_client_t *client = t->client;
+
+    size_t nparts = (size_t)((t->size + t->part_size - 1) / t->part_size);
+    if (nparts > S3_MPU_MAX_PARTS) {
+        s3_error_set(&t->err, S3_E_INVALID_ARG,
+                     "object exceeds 10000 parts, increase part_size",
+                     0, 0, 0);
+        return t->err.code;
+    }
+
+    /* Каждая граница части добавляет не больше одного куска. */
+    size_t max_slices = t->count + nparts;
+    s3_put_seg_t *slices = s3_alloc(&client->alloc,
+                                    max_slices * sizeof(*slices));
+    size_t *first = s3_alloc(&client->alloc, nparts * sizeof(*first));
+    size_t *nslices = s3_alloc(&client->alloc, nparts * sizeof(*nslices));
+    s3_easy_handle_t **handles =
+        s3_alloc(&client->alloc, t->concurrency * sizeof(*handles));
+    s3_error_code_t code = S3_E_OK;
+
+    if (slices == NULL || first == NULL || nslices == NULL ||
+        handles == NULL)
+    {
+        s3_error_set(&t->err, S3_E_NOMEM,
+                     "Out of memory in put_iov", ENOMEM, 0, 0);
+        code = t->err.code;
+        goto out;
+    }
+
+    s3_put_iov_split(t, nparts, slices, first, nslices);
+
+    code = s3_mpu_begin(mpu, client, &t->opts, &t->err);
+
+    for (size_t p = 0; p < nparts && code == S3_E_OK; ) {
+        size_t n = 0;
+        for (; n < t->concurrency && p + n < nparts; n++) {
+            size_t k = p + n;
+            code = s3_mpu_part_handle_iov(mpu, (uint32_t)(k + 1),
+                                          &slices[first[k]], nslices[k],
+                                          &handles[n], &t->err);
+            if (code != S3_E_OK)
+                break;
+        }
+        if (code != S3_E_OK) {
+            for (size_t i = 0; i < n; i++)
+                s3_easy_handle_destroy(handles[i]);
+            break;
+        }
+
+        code = s3_mpu_upload_handles(mpu, (uint32_t)(p + 1), handles, n,
+                                     &t->err);
+        p += n;
+    }
+
+    if (code == S3_E_OK)
+        code = s3_mpu_complete(mpu, &t->err);
+    if (code == S3_E_OK)
+        memcpy(t->etag, mpu->etag, sizeof(t->etag));
+
+out:
+    if (handles != NULL)
+        s3_free(&client->alloc, handles);
+    if (nslices != NULL)
+        s3_free(&client->alloc, nslices);
+    if (first != NULL)
+        s3_free(&client->alloc, first);
+    if (slices != NULL)
+        s3_free(&client->alloc, slices);
+    return code;
+}
+
+static s3_error_code_t
+s3_put_iov_task_run(struct s3_put_iov_task *t)
+{
+    if (t->size <= t->part_size)
+        return s3_put_iov_single(t);
+
+    struct s3_mpu mpu;
+    memset(&mpu, 0, sizeof(mpu));
+
+    s3_error_code_t code = s3_put_iov_multipart(t, &mpu);
+    if (code != S3_E_OK)
+        s3_mpu_abort(&mpu);
+    s3_mpu_destroy(&mpu);
+    return code;
+}
+
+s3_error_code_t
+s3_put_iov_run(s3_client_t *client, const s3_put_opts_t *opts,
+               size_t part_size, uint32_t concurrency,
+               const s3_put_seg_t *segs, size_t count,
+               char *etag, s3_error_t *err)
+{
+    /* concurrency == 0 — цикл по частям не сдвинется. */
+    if (part_size < S3_MPU_MIN_PART_SIZE || concurrency == 0 ||
+        concurrency > S3_PUT_IOV_MAX_CONCURRENCY)
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "part_size must be >= 5 MiB and concurrency in 1..64 "
+                     "in put_iov", 0, 0, 0);
+        return err->code;
+    }
+
+    struct s3_put_iov_task task;
+    memset(&task, 0, sizeof(task));
+    task.client = client;
+    task.opts = *opts;
+    task.opts.content_length = 0;
+    task.part_size = part_size;
+    task.concurrency = concurrency;
+    task.segs = segs;
+    task.count = count;
+    for (size_t i = 0; i < count; i++)
+        task.size += segs[i].len;
+    s3_error_clear(&task.err);
+
+    s3_error_code_t code = s3_put_iov_task_run(&task);
+    *err = task.err;
+    if (code == S3_E_OK && etag != NULL)
+        memcpy(etag, task.etag, S3_ETAG_MAX);
+    return code;
+}
+
+static ssize_t
+s3_client_put_iov_worker(va_list ap)
+{
+    struct s3_put_iov_task *t = va_arg(ap, struct s3_put_iov_task *);
+    t->code = s3_put_iov_task_run(t);
+    return 0;
+}
+
+s3_error_code_t
+s3_client_put_iov(s3_client_t *client,
+                  const s3_put_opts_t *opts,
+                  const s3_put_stream_opts_t *mp_opts,
+                  const s3_put_seg_t *segs, size_t count,
+                  s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (client == NULL || opts == NULL || opts->key == NULL ||
+        segs == NULL || count == 0)
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts, key or segs is invalid in put_iov",
+                     0, 0, 0);
+        if (client != NULL)
+            s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    struct s3_put_iov_task task;
+    memset(&task, 0, sizeof(task));
+    task.client = client;
+    task.opts = *opts;
+    task.opts.content_length = 0;
+    task.segs = segs;
+    task.count = count;
+    task.part_size = S3_PUT_IOV_DEFAULT_PART_SIZE;
+    task.concurrency = S3_PUT_IOV_DEFAULT_CONCURRENCY;
+    if (mp_opts != NULL && mp_opts->part_size > 0)
+        task.part_size = mp_opts->part_size;
+    if (mp_opts != NULL && mp_opts->concurrency > 0)
+        task.concurrency = mp_opts->concurrency;
+
+    for (size_t i = 0; i < count; i++) {
+        if (segs[i].fd < 0 && segs[i].len > 0) {
+            s3_error_set(err, S3_E_INVALID_ARG,
+                         "invalid fd in put_iov segment", 0, 0, 0);
+            s3_client_set_error(client, err);
+            return err->code;
+        }
+        task.size += segs[i].len;
+    }
+
+    if (task.part_size < S3_MPU_MIN_PART_SIZE ||
+        task.concurrency > S3_PUT_IOV_MAX_CONCURRENCY)
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "part_size must be >= 5 MiB and concurrency <= 64 "
+                     "in put_iov", 0, 0, 0);
+        s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    s3_error_clear(&task.err);
+    task.code = S3_E_OK;
+
+    coio_call(s3_client_put_iov_worker, &task);
+
+    *err = task.err;
+    s3_client_set_error(client, &task.err);
+    return task.code;
+}
@@ -0,0 +1,223 @@
+#include "s3_internal.h"
+#include "s3/curl_easy_factory.h"
+#include "error.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <tarantool/module.h>
+
+#define S3_PUT_MANY_DEFAULT_CONCURRENCY 8
+#define S3_PUT_MANY_MAX_CONCURRENCY     64
+#define S3_PUT_MANY_RETRIES             2
+
+struct s3_put_many_task {
+    s3_client_t *client;
+    s3_put_item_t *items;
+    size_t count;
+    uint32_t concurrency;
+
+    /* текущая пачка */
+    s3_easy_handle_t **handles;
+    s3_error_code_t *codes;
+    s3_error_t *errs;
+    size_t *idx;
+    int *fds;
+
+    s3_error_t err;
+    s3_error_code_t code;
+};
+
+static bool
+s3_put_many_retryable(s3_error_code_t code)
+{
+    return code != S3_E_OK && code != S3_E_ACCESS_DENIED &&
+           code != S3_E_AUTH && code != S3_E_NOT_FOUND &&
+           code != S3_E_INVALID_ARG;
+}
+
+/* Хендл для items[i]; открытый файл — в *fd. */
+static s3_error_code_t
+s3_put_many_prepare(struct s3_put_many_task *t, s3_put_item_t *it, int *fd,
+                    s3_easy_handle_t **out)
+{
+    s3_put_opts_t popts;
+    memset(&popts, 0, sizeof(popts));
+    popts.bucket = it->bucket;
+    popts.key = it->key;
+    popts.content_type = it->content_type;
+
+    if (it->key == NULL) {
+        s3_error_set(&it->err, S3_E_INVALID_ARG, "key is NULL in put_many",
+                     0, 0, 0);
+        return it->err.code;
+    }
+
+    if (it->path == NULL)
+        return s3_easy_factory_new_put_buf(t->client, &popts, it->data,
+                                           it->size, out, &it->err);
+
+    *fd = open(it->path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (*fd < 0 || fstat(*fd, &st) != 0) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "cannot open %s in put_many", it->path);
+        s3_error_set(&it->err, S3_E_IO, msg, errno, 0, 0);
+        return it->err.code;
+    }
+
+    /* put_fd не умеет пустое тело. */
+    if (st.st_size == 0)
+        return s3_easy_factory_new_put_buf(t->client, &popts, NULL, 0,
+                                           out, &it->err);
+    return s3_easy_factory_new_put_fd(t->client, &popts, *fd, 0,
+                                      (size_t)st.st_size, out, &it->err);
+}
+
+/* Пачка items[first..first+n): собрать, выполнить, повторить упавшие. */
+static void
+s3_put_many_batch(struct s3_put_many_task *t, size_t first, size_t n)
+{
+    struct s3_http_backend_impl *b = t->client->backend;
+    size_t m = 0;
+
+    for (size_t i = first; i < first + n; i++) {
+        s3_put_item_t *it = &t->items[i];
+        int fd = -1;
+        s3_easy_handle_t *h = NULL;
+
+        s3_error_clear(&it->err);
+        it->code = s3_put_many_prepare(t, it, &fd, &h);
+        if (it->code != S3_E_OK) {
+            if (fd >= 0)
+                close(fd);
+            continue;
+        }
+        t->handles[m] = h;
+        t->fds[m] = fd;
+        t->idx[m] = i;
+        t->codes[m] = S3_E_INTERNAL;
+        s3_error_clear(&t->errs[m]);
+        m++;
+    }
+
+    if (m > 0) {
+        s3_error_t batch_err = S3_ERROR_INIT;
+        s3_error_code_t rc = b->vtbl->perform_many(b, t->handles, m, t->codes,
+                                                   t->errs, &batch_err);
+        for (size_t j = 0; j < m; j++) {
+            if (rc != S3_E_OK && t->codes[j] == S3_E_INTERNAL) {
+                t->codes[j] = rc;
+                t->errs[j] = batch_err;
+            }
+            for (int a = 0; a < S3_PUT_MANY_RETRIES &&
+                 s3_put_many_retryable(t->codes[j]); a++)
+            {
+                if (s3_easy_handle_rewind(t->handles[j]) != 0)
+                    break;
+                t->codes[j] = b->vtbl->perform(b, t->handles[j], &t->errs[j]);
+            }
+
+            s3_put_item_t *it = &t->items[t->idx[j]];
+            it->code = t->codes[j];
+            it->err = t->errs[j];
+            s3_easy_handle_destroy(t->handles[j]);
+            if (t->fds[j] >= 0)
+                close(t->fds[j]);
+        }
+    }
+
+    for (size_t i = first; i < first + n; i++) {
+        if (t->items[i].code != S3_E_OK && t->code == S3_E_OK) {
+            t->code = t->items[i].code;
+            t->err = t->items[i].err;
+        }
+    }
+}
+
+static ssize_t
+s3_client_put_many_worker(va_list ap)
+{
+    struct s3_put_many_task *t = va_arg(ap, struct s3_put_many_task *);
+    s3_client_t *client = t->client;
+    size_t c = t->concurrency;
+
+    t->handles = s3_alloc(&client->alloc, c * sizeof(*t->handles));
+    t->codes = s3_alloc(&client->alloc, c * sizeof(*t->codes));
+    t->errs = s3_alloc(&client->alloc, c * sizeof(*t->errs));
+    t->idx = s3_alloc(&client->alloc, c * sizeof(*t->idx));
+    t->fds = s3_alloc(&client->alloc, c * sizeof(*t->fds));
+
+    if (t->handles == NULL || t->codes == NULL || t->errs == NULL ||
+        t->idx == NULL || t->fds == NULL)
+    {
+        s3_error_set(&t->err, S3_E_NOMEM, "Out of memory in put_many",
+                     ENOMEM, 0, 0);
+        t->code = t->err.code;
+        goto out;
+    }
+
+    for (size_t first = 0; first < t->count; first += c) {
+        size_t n = t->count - first < c ? t->count - first : c;
+        s3_put_many_batch(t, first, n);
+    }
+
+out:
+    if (t->fds != NULL)
+        s3_free(&client->alloc, t->fds);
+    if (t->idx != NULL)
+        s3_free(&client->alloc, t->idx);
+    if (t->errs != NULL)
+        s3_free(&client->alloc, t->errs);
+    if (t->codes != NULL)
+        s3_free(&client->alloc, t->codes);
+    if (t->handles != NULL)
+        s3_free(&client->alloc, t->handles);
+    return 0;
+}
+
+s3_error_code_t
+s3_client_put_many(s3_client_t *client,
+                   s3_put_item_t *items, size_t count,
+                   uint32_t concurrency,
+                   s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (concurrency == 0)
+        concurrency = S3_PUT_MANY_DEFAULT_CONCURRENCY;
+
+    if (client == NULL || (items == NULL && count > 0) ||
+        concurrency > S3_PUT_MANY_MAX_CONCURRENCY)
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client or items is invalid or concurrency > 64 "
+                     "in put_many", 0, 0, 0);
+        if (client != NULL)
+            s3_client_set_error(client, err);
+        return err->code;
+    }
+    if (count == 0)
+        return S3_E_OK;
+
+    struct s3_put_many_task task;
+    memset(&task, 0, sizeof(task));
+    task.client = client;
+    task.items = items;
+    task.count = count;
+    task.concurrency = concurrency;
+    s3_error_clear(&task.err);
+    task.code = S3_E_OK;
+
+    coio_call(s3_client_put_many_worker, &task);
+
+    *err = task.err;
+    s3_client_set_error(client, &task.err);
+    return task.code;
+}
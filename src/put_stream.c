@@ -0,0 +1,322 @@
+#include "s3_internal.h"
+#include "multipart.h"
+#include "s3/curl_easy_factory.h"
+#include "error.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tarantool/module.h>
+
+#define S3_PUT_STREAM_DEFAULT_PART_SIZE   (8u * 1024 * 1024)
+#define S3_PUT_STREAM_DEFAULT_CONCURRENCY 4
+#define S3_PUT_STREAM_MAX_CONCURRENCY     64
+
+struct s3_put_stream_task {
+    s3_client_t *client;
+    s3_put_opts_t opts;
+    size_t part_size;
+    uint32_t concurrency;
+    int fd;
+    uint64_t bytes_read;
+
+    s3_error_t err;
+    s3_error_code_t code;
+};
+
+/*
+ * Набор из concurrency буферов. Наборов два: пока части одного грузятся,
+ * в другой читается следующая пачка.
+ */
+struct s3_put_stream_batch {
+    struct s3_put_stream_task *t;
+    char **bufs;
+    size_t *sizes;
+    size_t n;
+    bool eof;
+    bool stop;          /* загрузка упала, дальше читать незачем */
+    uint64_t bytes;
+
+    s3_error_t err;
+    s3_error_code_t code;
+};
+
+/*
+ * Дочитать до cap байт из fd. Возвращает прочитанное (< cap — конец
+ * потока) или -1 при ошибке. Неблокирующий fd ждём через poll не дольше
+ * request_timeout_ms.
+ */
+static ssize_t
+s3_put_stream_fill(s3_client_t *client, int fd, char *buf, size_t cap,
+                   s3_error_t *err)
+{
+    size_t got = 0;
+
+    while (got < cap) {
+        ssize_t n = read(fd, buf + got, cap - got);
+        if (n > 0) {
+            got += (size_t)n;
+            continue;
+        }
+        if (n == 0)
+            break;
+        if (errno == EINTR)
+            continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            s3_error_set(err, S3_E_IO, "read from fd failed in put_stream",
+                         errno, 0, 0);
+            return -1;
+        }
+
+        struct pollfd pfd = { .fd = fd, .events = POLLIN, .revents = 0 };
+        int rc = poll(&pfd, 1, (int)client->request_timeout_ms);
+        if (rc == 0) {
+            s3_error_set(err, S3_E_TIMEOUT,
+                         "no data from fd in put_stream", 0, 0, 0);
+            return -1;
+        }
+        if (rc < 0 && errno != EINTR) {
+            s3_error_set(err, S3_E_IO, "poll failed in put_stream",
+                         errno, 0, 0);
+            return -1;
+        }
+    }
+
+    return (ssize_t)got;
+}
+
+/* Весь поток влез в одну часть: обычный PUT без multipart. */
+static s3_error_code_t
+s3_put_stream_single(struct s3_put_stream_task *t, const char *data,
+                     size_t size)
+{
+    struct s3_http_backend_impl *b = t->client->backend;
+
+    s3_easy_handle_t *h = NULL;
+    s3_error_code_t code = s3_easy_factory_new_put_buf(t->client, &t->opts,
+                                                       data, size, &h, &t->err);
+    if (code != S3_E_OK)
+        return code;
+
+    code = b->vtbl->perform(b, h, &t->err);
+    s3_easy_handle_destroy(h);
+    return code;
+}
+
+/* Прочитать в batch до concurrency частей, до EOF или ошибки. */
+static void
+s3_put_stream_read_batch(struct s3_put_stream_batch *batch)
+{
+    struct s3_put_stream_task *t = batch->t;
+
+    batch->n = 0;
+    batch->bytes = 0;
+    batch->code = S3_E_OK;
+    s3_error_clear(&batch->err);
+
+    while (batch->n < t->concurrency && !batch->eof &&
+           !__atomic_load_n(&batch->stop, __ATOMIC_RELAXED))
+    {
+        ssize_t got = s3_put_stream_fill(t->client, t->fd,
+                                         batch->bufs[batch->n],
+                                         t->part_size, &batch->err);
+        if (got < 0) {
+            batch->code = batch->err.code;
+            return;
+        }
+        batch->sizes[batch->n++] = (size_t)got;
+        batch->bytes += (uint64_t)got;
+        batch->eof = (size_t)got < t->part_size;
+    }
+}
+
+static void *
+s3_put_stream_reader_main(void *arg)
+{
+    s3_put_stream_read_batch((struct s3_put_stream_batch *)arg);
+    return NULL;
+}
+
+static ssize_t
+s3_client_put_stream_worker(va_list ap)
+{
+    struct s3_put_stream_task *t = va_arg(ap, struct s3_put_stream_task *);
+    s3_client_t *client = t->client;
+
+    /* Памяти — 2 * part_size * concurrency, независимо от размера потока. */
+    uint32_t total = 2 * t->concurrency;
+    char **bufs = s3_alloc(&client->alloc, total * sizeof(*bufs));
+    size_t *sizes = s3_alloc(&client->alloc, total * sizeof(*sizes));
+    uint32_t nbufs = 0;
+
+    struct s3_put_stream_batch batches[2];
+    memset(batches, 0, sizeof(batches));
+
+    struct s3_mpu mpu;
+    memset(&mpu, 0, sizeof(mpu));
+
+    if (bufs == NULL || sizes == NULL)
+        goto nomem;
+    for (; nbufs < total; nbufs++) {
+        bufs[nbufs] = s3_alloc(&client->alloc, t->part_size);
+        if (bufs[nbufs] == NULL)
+            goto nomem;
+    }
+    for (int i = 0; i < 2; i++) {
+        batches[i].t = t;
+        batches[i].bufs = bufs + i * t->concurrency;
+        batches[i].sizes = sizes + i * t->concurrency;
+    }
+
+    uint32_t next_part = 1;
+    struct s3_put_stream_batch *cur = &batches[0];
+    s3_put_stream_read_batch(cur);
+
+    for (;;) {
+        t->bytes_read += cur->bytes;
+        if (cur->code != S3_E_OK) {
+            t->err = cur->err;
+            t->code = cur->code;
+            goto out;
+        }
+
+        size_t n = cur->n;
+        /* Пустая последняя часть не нужна (поток кратен part_size). */
+        if (n > 0 && cur->sizes[n - 1] == 0 && (n > 1 || next_part > 1))
+            n--;
+        if (n == 0)
+            break;
+
+        if (next_part == 1 && cur->eof && n <= 1) {
+            t->code = s3_put_stream_single(t, cur->bufs[0], cur->sizes[0]);
+            goto out;
+        }
+
+        if (next_part == 1) {
+            t->code = s3_mpu_begin(&mpu, client, &t->opts, &t->err);
+            if (t->code != S3_E_OK)
+                goto out;
+        }
+
+        if (next_part + n - 1 > S3_MPU_MAX_PARTS) {
+            s3_error_set(&t->err, S3_E_INVALID_ARG,
+                         "stream exceeds 10000 parts, increase part_size",
+                         0, 0, 0);
+            t->code = t->err.code;
+            goto out;
+        }
+
+        /*
+         * Следующая пачка читается в другой набор буферов отдельным
+         * потоком, пока эта грузится. Не создался поток — читаем после
+         * загрузки, как без двойной буферизации.
+         */
+        struct s3_put_stream_batch *next = cur == &batches[0] ?
+                                           &batches[1] : &batches[0];
+        bool reading = false;
+        pthread_t reader;
+        if (!cur->eof) {
+            next->stop = false;
+            reading = pthread_create(&reader, NULL,
+                                     s3_put_stream_reader_main, next) == 0;
+        }
+
+        t->code = s3_mpu_upload_parts(&mpu, next_part, cur->bufs,
+                                      cur->sizes, n, &t->err);
+        if (reading) {
+            if (t->code != S3_E_OK)
+                __atomic_store_n(&next->stop, true, __ATOMIC_RELAXED);
+            pthread_join(reader, NULL);
+        }
+        if (t->code != S3_E_OK)
+            goto out;
+        next_part += (uint32_t)n;
+
+        if (cur->eof)
+            break;
+        if (!reading)
+            s3_put_stream_read_batch(next);
+        cur = next;
+    }
+
+    t->code = s3_mpu_complete(&mpu, &t->err);
+    goto out;
+
+nomem:
+    s3_error_set(&t->err, S3_E_NOMEM,
+                 "Out of memory for put_stream buffers", ENOMEM, 0, 0);
+    t->code = t->err.code;
+
+out:
+    if (t->code != S3_E_OK)
+        s3_mpu_abort(&mpu);
+    s3_mpu_destroy(&mpu);
+
+    for (uint32_t i = 0; i < nbufs; i++)
+        s3_free(&client->alloc, bufs[i]);
+    if (sizes != NULL)
+        s3_free(&client->alloc, sizes);
+    if (bufs != NULL)
+        s3_free(&client->alloc, bufs);
+    return 0;
+}
+
+s3_error_code_t
+s3_client_put_stream(s3_client_t *client,
+                     const s3_put_opts_t *opts,
+                     const s3_put_stream_opts_t *stream_opts,
+                     int fd,
+                     uint64_t *bytes_read,
+                     s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (client == NULL || opts == NULL || opts->key == NULL || fd < 0) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts, key or fd is invalid in put_stream",
+                     0, 0, 0);
+        if (client != NULL)
+            s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    struct s3_put_stream_task task;
+    memset(&task, 0, sizeof(task));
+    task.client = client;
+    task.opts = *opts;
+    task.opts.content_length = 0;
+    task.fd = fd;
+    task.part_size = S3_PUT_STREAM_DEFAULT_PART_SIZE;
+    task.concurrency = S3_PUT_STREAM_DEFAULT_CONCURRENCY;
+    if (stream_opts != NULL && stream_opts->part_size > 0)
+        task.part_size = stream_opts->part_size;
+    if (stream_opts != NULL && stream_opts->concurrency > 0)
+        task.concurrency = stream_opts->concurrency;
+
+    if (task.part_size < S3_MPU_MIN_PART_SIZE ||
+        task.concurrency > S3_PUT_STREAM_MAX_CONCURRENCY)
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "part_size must be >= 5 MiB and concurrency <= 64 "
+                     "in put_stream", 0, 0, 0);
+        s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    s3_error_clear(&task.err);
+    task.code = S3_E_OK;
+
+    coio_call(s3_client_put_stream_worker, &task);
+
+    if (bytes_read != NULL)
+        *bytes_read = task.bytes_read;
+
+    *err = task.err;
+    s3_client_set_error(client, &task.err);
+    return task.code;
+}
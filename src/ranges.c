@@ -0,0 +1,295 @@
+#include "s3_internal.h"
+#include "endpoint.h"
+#include "s3/curl_easy_factory.h"
+#include "http/http_util.h"
+#include "error.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <tarantool/module.h>
+
+#define S3_GET_RANGES_DEFAULT_CONCURRENCY 8
+#define S3_GET_RANGES_MAX_CONCURRENCY     64
+
+/*
+ * Склеенный Range GET: [start, end) в объекте, покрывает сегменты
+ * segs[first .. first + count).
+ */
+struct s3_ranges_group {
+    uint64_t start;
+    uint64_t end;
+    size_t first;
+    size_t count;
+
+    s3_error_code_t code;
+    s3_error_t err;
+    /* Хендл упавшего GET, который стоит повторить на другом endpoint'е. */
+    s3_easy_handle_t *retry;
+};
+
+/* Группы для s3_http_batch_run. */
+struct s3_ranges_run {
+    s3_client_t *client;
+    const s3_get_opts_t *get;
+    s3_easy_scatter_seg_t *segs;
+    struct s3_ranges_group *groups;
+};
+
+struct s3_get_ranges_task {
+    s3_client_t *client;
+    const s3_get_ranges_opts_t *opts;
+    s3_range_t *ranges;
+    size_t count;
+
+    s3_error_t err;
+    s3_error_code_t code;
+};
+
+static int
+s3_ranges_cmp(const void *a, const void *b)
+{
+    const s3_range_t *ra = *(const s3_range_t * const *)a;
+    const s3_range_t *rb = *(const s3_range_t * const *)b;
+
+    if (ra->offset != rb->offset)
+        return ra->offset < rb->offset ? -1 : 1;
+    if (ra->length != rb->length)
+        return ra->length < rb->length ? -1 : 1;
+    return 0;
+}
+
+/*
+ * Разбить отсортированные сегменты на группы. Возвращает число групп.
+ */
+static size_t
+s3_ranges_build_groups(const s3_easy_scatter_seg_t *segs, size_t count,
+                       uint64_t max_gap, uint64_t max_span,
+                       struct s3_ranges_group *groups)
+{
+    size_t n = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        uint64_t start = segs[i].offset;
+        uint64_t end = start + segs[i].len;
+
+        if (n > 0) {
+            struct s3_ranges_group *g = &groups[n - 1];
+            uint64_t new_end = end > g->end ? end : g->end;
+
+            /* g->end + max_gap переполняется при огромном max_gap. */
+            if ((start <= g->end || start - g->end <= max_gap) &&
+                (max_span == 0 || new_end - g->start <= max_span))
+            {
+                g->end = new_end;
+                g->count++;
+                continue;
+            }
+        }
+
+        struct s3_ranges_group *g = &groups[n++];
+        memset(g, 0, sizeof(*g));
+        g->start = start;
+        g->end = end;
+        g->first = i;
+        g->count = 1;
+    }
+
+    return n;
+}
+
+static s3_error_code_t
+s3_ranges_start(void *ctx, size_t i, s3_easy_handle_t **h, s3_error_t *err)
+{
+    struct s3_ranges_run *r = (struct s3_ranges_run *)ctx;
+    struct s3_ranges_group *g = &r->groups[i];
+
+    return s3_easy_factory_new_get_scatter(r->client, r->get,
+                                           g->start, g->end,
+                                           &r->segs[g->first], g->count,
+                                           h, err);
+}
+
+static void
+s3_ranges_done(void *ctx, size_t i, s3_easy_handle_t *h,
+               s3_error_code_t code, s3_error_t *err)
+{
+    struct s3_ranges_run *r = (struct s3_ranges_run *)ctx;
+    struct s3_ranges_group *g = &r->groups[i];
+
+    g->code = code;
+    g->err = *err;
+    if (h == NULL)
+        return;
+    /* Повтор — после всех, чтобы не держать остальные GET. */
+    if (code != S3_E_OK && r->client->endpoints != NULL &&
+        s3_endpoint_error_retryable(code, err))
+    {
+        g->retry = h;
+        return;
+    }
+    s3_easy_handle_destroy(h);
+}
+
+static ssize_t
+s3_client_get_ranges_worker(va_list ap)
+{
+    struct s3_get_ranges_task *t = va_arg(ap, struct s3_get_ranges_task *);
+    s3_client_t *client = t->client;
+    const s3_get_ranges_opts_t *opts = t->opts;
+    size_t count = t->count;
+
+    uint32_t concurrency = opts->concurrency > 0
+        ? opts->concurrency : S3_GET_RANGES_DEFAULT_CONCURRENCY;
+    if (concurrency > S3_GET_RANGES_MAX_CONCURRENCY)
+        concurrency = S3_GET_RANGES_MAX_CONCURRENCY;
+
+    s3_range_t **order = s3_alloc(&client->alloc, count * sizeof(*order));
+    s3_easy_scatter_seg_t *segs = s3_alloc(&client->alloc,
+                                           count * sizeof(*segs));
+    struct s3_ranges_group *groups = s3_alloc(&client->alloc,
+                                              count * sizeof(*groups));
+
+    if (order == NULL || segs == NULL || groups == NULL) {
+        s3_error_set(&t->err, S3_E_NOMEM,
+                     "Out of memory in get_ranges", ENOMEM, 0, 0);
+        t->code = S3_E_NOMEM;
+        goto out;
+    }
+
+    for (size_t i = 0; i < count; i++)
+        order[i] = &t->ranges[i];
+    qsort(order, count, sizeof(*order), s3_ranges_cmp);
+
+    for (size_t i = 0; i < count; i++) {
+        s3_range_t *r = order[i];
+        s3_easy_scatter_seg_t *seg = &segs[i];
+
+        memset(seg, 0, sizeof(*seg));
+        seg->offset = r->offset;
+        seg->len = r->length;
+        seg->ptr = (char *)r->buf;
+        seg->fd = r->fd;
+        seg->fd_offset = r->fd_offset;
+    }
+
+    size_t ngroups = s3_ranges_build_groups(segs, count, opts->max_gap,
+                                            opts->max_span, groups);
+
+    s3_get_opts_t get;
+    memset(&get, 0, sizeof(get));
+    get.bucket = opts->bucket;
+    get.key = opts->key;
+    get.if_match = opts->if_match;
+
+    /*
+     * Все GET — на одном локальном curl_multi этого потока: до
+     * concurrency в полёте, следующий стартует, как только закончился
+     * любой из идущих.
+     */
+    struct s3_ranges_run run;
+    memset(&run, 0, sizeof(run));
+    run.client = client;
+    run.get = &get;
+    run.segs = segs;
+    run.groups = groups;
+
+    s3_error_t batch_err = S3_ERROR_INIT;
+    s3_http_batch_run(client, ngroups, concurrency, s3_ranges_start,
+                      s3_ranges_done, &run, &batch_err);
+
+    /* Сетевые ошибки и 5xx: perform повторит на другом endpoint'е. */
+    struct s3_http_backend_impl *b = client->backend;
+    for (size_t g = 0; g < ngroups; g++) {
+        struct s3_ranges_group *grp = &groups[g];
+        if (grp->retry == NULL)
+            continue;
+        if (s3_easy_handle_rewind(grp->retry) == 0)
+            grp->code = b->vtbl->perform(b, grp->retry, &grp->err);
+        s3_easy_handle_destroy(grp->retry);
+        grp->retry = NULL;
+    }
+
+    t->code = S3_E_OK;
+    s3_error_clear(&t->err);
+
+    for (size_t g = 0; g < ngroups; g++) {
+        struct s3_ranges_group *grp = &groups[g];
+
+        for (size_t i = grp->first; i < grp->first + grp->count; i++) {
+            order[i]->bytes = segs[i].written;
+            order[i]->code = grp->code;
+        }
+
+        if (grp->code != S3_E_OK && t->code == S3_E_OK) {
+            t->code = grp->code;
+            t->err = grp->err;
+        }
+    }
+
+out:
+    if (groups != NULL)
+        s3_free(&client->alloc, groups);
+    if (segs != NULL)
+        s3_free(&client->alloc, segs);
+    if (order != NULL)
+        s3_free(&client->alloc, order);
+    return 0;
+}
+
+s3_error_code_t
+s3_client_get_ranges(s3_client_t *client,
+                     const s3_get_ranges_opts_t *opts,
+                     s3_range_t *ranges, size_t count,
+                     s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (client == NULL || opts == NULL || opts->key == NULL ||
+        (ranges == NULL && count != 0))
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts, key or ranges is NULL in get_ranges",
+                     0, 0, 0);
+        if (client != NULL)
+            s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        ranges[i].bytes = 0;
+        ranges[i].code = S3_E_OK;
+
+        if (ranges[i].length == 0 ||
+            (ranges[i].buf == NULL && ranges[i].fd < 0))
+        {
+            s3_error_set(err, S3_E_INVALID_ARG,
+                         "empty range or no destination in get_ranges",
+                         0, 0, 0);
+            ranges[i].code = S3_E_INVALID_ARG;
+            s3_client_set_error(client, err);
+            return err->code;
+        }
+    }
+
+    if (count == 0)
+        return S3_E_OK;
+
+    struct s3_get_ranges_task task;
+    memset(&task, 0, sizeof(task));
+    task.client = client;
+    task.opts = opts;
+    task.ranges = ranges;
+    task.count = count;
+    s3_error_clear(&task.err);
+    task.code = S3_E_OK;
+
+    coio_call(s3_client_get_ranges_worker, &task);
+
+    *err = task.err;
+    s3_client_set_error(client, &task.err);
+    return task.code;
+}
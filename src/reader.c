@@ -0,0 +1,425 @@
+#include "s3/reader.h"
+#include "s3/alloc.h"
+
+#include "s3_internal.h"
+#include "error.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include <tarantool/module.h>
+
+#define S3_READER_DEFAULT_MIN_WINDOW (256 * 1024)
+#define S3_READER_DEFAULT_MAX_WINDOW (8 * 1024 * 1024)
+#define S3_READER_DEFAULT_PREFETCH   2
+#define S3_READER_MAX_PREFETCH       16
+
+/* Блок объекта [start, start + len) в памяти. */
+struct s3_reader_block {
+    uint64_t start;
+    size_t len;
+    char *data;
+    size_t cap;
+
+    /* Блок грузит фоновый файбер; data трогать нельзя до конца. */
+    bool loading;
+    /* Итог загрузки: блок с ошибкой в окно не входит. */
+    s3_error_code_t code;
+    s3_error_t err;
+};
+
+struct s3_reader {
+    s3_client_t *client;
+
+    char *bucket;
+    char *key;
+    uint64_t size;
+    char etag[S3_ETAG_MAX];
+
+    size_t min_window;
+    size_t max_window;
+    uint32_t prefetch;
+
+    /* Текущий размер блока: растёт при последовательном чтении. */
+    size_t window;
+
+    uint64_t pos;
+
+    /* Окно: nblocks соседних блоков по возрастанию start. */
+    struct s3_reader_block *blocks;
+    size_t nblocks;
+
+    /* Фоновые загрузки блоков prefetch'а. */
+    uint32_t inflight;
+    struct fiber_cond *cond;
+    /* s3_reader_delete уже был: освободит последний фоновый файбер. */
+    bool closed;
+
+    void (*on_free)(void *arg);
+    void *on_free_arg;
+};
+
+uint64_t
+s3_reader_size(const s3_reader_t *r)
+{
+    return r->size;
+}
+
+uint64_t
+s3_reader_tell(const s3_reader_t *r)
+{
+    return r->pos;
+}
+
+s3_error_code_t
+s3_reader_open(s3_client_t *client,
+               const s3_reader_opts_t *opts,
+               s3_reader_t **out_reader,
+               s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (client == NULL || opts == NULL || opts->key == NULL ||
+        out_reader == NULL)
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts, key or out_reader is NULL", 0, 0, 0);
+        return err->code;
+    }
+
+    s3_head_info_t info;
+    if (s3_client_head(client, opts->bucket, opts->key, &info,
+                       err) != S3_E_OK)
+        return err->code;
+
+    s3_reader_t *r = (s3_reader_t *)s3_alloc(&client->alloc, sizeof(*r));
+    if (r == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate s3 reader", ENOMEM, 0, 0);
+        return err->code;
+    }
+    memset(r, 0, sizeof(*r));
+    r->client = client;
+    r->size = info.size;
+    memcpy(r->etag, info.etag, sizeof(r->etag));
+
+    r->min_window = opts->min_window > 0 ?
+        opts->min_window : S3_READER_DEFAULT_MIN_WINDOW;
+    r->max_window = opts->max_window > 0 ?
+        opts->max_window : S3_READER_DEFAULT_MAX_WINDOW;
+    if (r->max_window < r->min_window)
+        r->max_window = r->min_window;
+    r->prefetch = opts->prefetch > 0 ?
+        opts->prefetch : S3_READER_DEFAULT_PREFETCH;
+    if (r->prefetch > S3_READER_MAX_PREFETCH)
+        r->prefetch = S3_READER_MAX_PREFETCH;
+    r->window = r->min_window;
+
+    r->cond = fiber_cond_new();
+    if (r->cond == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate s3 reader cond", ENOMEM, 0, 0);
+        goto fail;
+    }
+
+    if (opts->bucket != NULL) {
+        r->bucket = s3_strdup_a(&client->alloc, opts->bucket, err);
+        if (r->bucket == NULL)
+            goto fail;
+    }
+    r->key = s3_strdup_a(&client->alloc, opts->key, err);
+    if (r->key == NULL)
+        goto fail;
+
+    r->blocks = (struct s3_reader_block *)s3_alloc(&client->alloc,
+        (1 + r->prefetch) * sizeof(*r->blocks));
+    if (r->blocks == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate s3 reader blocks", ENOMEM, 0, 0);
+        goto fail;
+    }
+    memset(r->blocks, 0, (1 + r->prefetch) * sizeof(*r->blocks));
+
+    r->on_free = opts->on_free;
+    r->on_free_arg = opts->on_free_arg;
+    *out_reader = r;
+    return S3_E_OK;
+
+fail:
+    s3_reader_delete(r);
+    return err->code;
+}
+
+static void
+s3_reader_free(s3_reader_t *r)
+{
+    s3_client_t *c = r->client;
+    if (r->blocks != NULL) {
+        for (size_t i = 0; i < 1 + r->prefetch; i++) {
+            if (r->blocks[i].data != NULL)
+                s3_free(&c->alloc, r->blocks[i].data);
+        }
+        s3_free(&c->alloc, r->blocks);
+    }
+    if (r->key != NULL)
+        s3_free(&c->alloc, r->key);
+    if (r->bucket != NULL)
+        s3_free(&c->alloc, r->bucket);
+    if (r->cond != NULL)
+        fiber_cond_delete(r->cond);
+
+    void (*on_free)(void *) = r->on_free;
+    void *on_free_arg = r->on_free_arg;
+    s3_free(&c->alloc, r);
+    if (on_free != NULL)
+        on_free(on_free_arg);
+}
+
+void
+s3_reader_delete(s3_reader_t *r)
+{
+    if (r == NULL)
+        return;
+
+    /* Без ожидания: могут звать из __gc. Буферы ещё пишутся. */
+    if (r->inflight > 0) {
+        r->closed = true;
+        return;
+    }
+    s3_reader_free(r);
+}
+
+/* Блок окна (готовый или в загрузке), в который попадает pos, или NULL. */
+static struct s3_reader_block *
+s3_reader_find(s3_reader_t *r, uint64_t pos)
+{
+    for (size_t i = 0; i < r->nblocks; i++) {
+        struct s3_reader_block *b = &r->blocks[i];
+        if (!b->loading && b->code != S3_E_OK)
+            continue;
+        if (pos >= b->start && pos < b->start + b->len)
+            return b;
+    }
+    return NULL;
+}
+
+/* Range GET одного блока с If-Match на ETag открытия. */
+static s3_error_code_t
+s3_reader_get(s3_reader_t *r, struct s3_reader_block *b, s3_error_t *err)
+{
+    s3_range_t range;
+    memset(&range, 0, sizeof(range));
+    range.offset = b->start;
+    range.length = b->len;
+    range.buf = b->data;
+    range.fd = -1;
+
+    s3_get_ranges_opts_t gopts;
+    memset(&gopts, 0, sizeof(gopts));
+    gopts.bucket = r->bucket;
+    gopts.key = r->key;
+    gopts.if_match = r->etag[0] != '\0' ? r->etag : NULL;
+    gopts.concurrency = 1;
+
+    if (s3_client_get_ranges(r->client, &gopts, &range, 1, err) != S3_E_OK)
+        return err->code;
+    if (range.bytes != range.length) {
+        s3_error_set(err, S3_E_IO, "short read in s3 reader", 0, 0, 0);
+        return err->code;
+    }
+    return S3_E_OK;
+}
+
+static int
+s3_reader_fetch_f(va_list ap)
+{
+    s3_reader_t *r = va_arg(ap, s3_reader_t *);
+    struct s3_reader_block *b = va_arg(ap, struct s3_reader_block *);
+
+    s3_error_clear(&b->err);
+    b->code = s3_reader_get(r, b, &b->err);
+    b->loading = false;
+    r->inflight--;
+
+    if (r->closed) {
+        if (r->inflight == 0)
+            s3_reader_free(r);
+        return 0;
+    }
+    fiber_cond_broadcast(r->cond);
+    return 0;
+}
+
+/* Дождаться фоновой загрузки блока b (b == NULL — всех). */
+static s3_error_code_t
+s3_reader_wait(s3_reader_t *r, struct s3_reader_block *b, s3_error_t *err)
+{
+    while (b != NULL ? b->loading : r->inflight > 0) {
+        if (fiber_cond_wait(r->cond) != 0 && fiber_is_cancelled()) {
+            s3_error_set(err, S3_E_CANCELLED,
+                         "fiber is cancelled while waiting for s3 reader "
+                         "block", 0, 0, 0);
+            return err->code;
+        }
+    }
+    return S3_E_OK;
+}
+
+/*
+ * Загрузить новое окно с позиции r->pos. Если r->pos — сразу за старым
+ * окном (последовательное чтение), блок растёт вдвое.
+ *
+ * Блоки prefetch'а грузятся фоновыми файберами, первый — здесь же:
+ * возвращаемся, как только он пришёл, остальные догружаются, пока
+ * вызывающий разбирает первый.
+ */
+static s3_error_code_t
+s3_reader_fill(s3_reader_t *r, s3_error_t *err)
+{
+    s3_client_t *c = r->client;
+
+    /* В буферы старого окна ещё могут писать. */
+    if (s3_reader_wait(r, NULL, err) != S3_E_OK)
+        return err->code;
+
+    bool sequential = r->nblocks > 0 &&
+        r->pos == r->blocks[r->nblocks - 1].start +
+                  r->blocks[r->nblocks - 1].len;
+    if (sequential) {
+        if (r->window < r->max_window / 2)
+            r->window *= 2;
+        else
+            r->window = r->max_window;
+    } else if (r->nblocks > 0) {
+        r->window = r->min_window;
+    }
+    r->nblocks = 0;
+
+    size_t n = 0;
+    uint64_t start = r->pos;
+    for (; n < 1 + r->prefetch && start < r->size; n++) {
+        struct s3_reader_block *b = &r->blocks[n];
+        size_t len = r->size - start < r->window ?
+            (size_t)(r->size - start) : r->window;
+
+        if (b->cap < len) {
+            char *data = (char *)s3_realloc(&c->alloc, b->data, len);
+            if (data == NULL) {
+                s3_error_set(err, S3_E_NOMEM,
+                             "Out of memory for s3 reader window",
+                             ENOMEM, 0, 0);
+                return err->code;
+            }
+            b->data = data;
+            b->cap = len;
+        }
+        b->start = start;
+        b->len = len;
+        b->code = S3_E_OK;
+        start += len;
+    }
+
+    /* Не создался файбер — окно короче, блок прочитается следующим fill. */
+    size_t nblocks = n > 0 ? 1 : 0;
+    for (; nblocks < n; nblocks++) {
+        struct fiber *f = fiber_new("s3_reader", s3_reader_fetch_f);
+        if (f == NULL)
+            break;
+        r->blocks[nblocks].loading = true;
+        r->inflight++;
+        fiber_start(f, r, &r->blocks[nblocks]);
+    }
+    r->nblocks = nblocks;
+
+    struct s3_reader_block *first = &r->blocks[0];
+    first->code = s3_reader_get(r, first, err);
+    if (first->code != S3_E_OK)
+        first->err = *err;
+    return first->code;
+}
+
+s3_error_code_t
+s3_reader_seek(s3_reader_t *r, uint64_t pos, s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    if (pos > r->size) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "seek beyond end of object", 0, 0, 0);
+        return err->code;
+    }
+    r->pos = pos;
+    return S3_E_OK;
+}
+
+s3_error_code_t
+s3_reader_peek(s3_reader_t *r, const void **data, size_t *len,
+               s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    *data = NULL;
+    *len = 0;
+    if (r->pos >= r->size)
+        return S3_E_OK;
+
+    struct s3_reader_block *b = s3_reader_find(r, r->pos);
+    if (b == NULL) {
+        if (s3_reader_fill(r, err) != S3_E_OK)
+            return err->code;
+        b = &r->blocks[0];
+    } else if (b->loading) {
+        if (s3_reader_wait(r, b, err) != S3_E_OK)
+            return err->code;
+        if (b->code != S3_E_OK) {
+            *err = b->err;
+            return b->code;
+        }
+    }
+
+    size_t off = (size_t)(r->pos - b->start);
+    *data = b->data + off;
+    *len = b->len - off;
+    return S3_E_OK;
+}
+
+void
+s3_reader_consume(s3_reader_t *r, size_t n)
+{
+    r->pos += n;
+    if (r->pos > r->size)
+        r->pos = r->size;
+}
+
+s3_error_code_t
+s3_reader_read(s3_reader_t *r, void *buf, size_t n, size_t *got,
+               s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+
+    s3_error_code_t code = S3_E_OK;
+    size_t done = 0;
+    while (done < n) {
+        const void *data = NULL;
+        size_t len = 0;
+        code = s3_reader_peek(r, &data, &len, err);
+        if (code != S3_E_OK || len == 0)
+            break;
+        if (len > n - done)
+            len = n - done;
+        memcpy((char *)buf + done, data, len);
+        s3_reader_consume(r, len);
+        done += len;
+    }
+
+    if (got != NULL)
+        *got = done;
+    return code;
+}
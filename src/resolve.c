@@ -0,0 +1,337 @@
+#include "resolve.h"
+#include "s3/curl_easy_factory.h"
+#include "error.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#include <tarantool/module.h>
+
+#define S3_RESOLVE_DEFAULT_REFRESH_MS 30000
+#define S3_RESOLVE_MAX_ADDRS          16
+#define S3_RESOLVE_ADDR_LEN           (INET6_ADDRSTRLEN + 2) /* "[...]" */
+
+struct s3_resolve_host {
+    char *url;  /* endpoint без завершающего '/', ключ поиска */
+    char host[256];
+    int port;
+
+    /* Под resolver->mutex. */
+    char addrs[S3_RESOLVE_MAX_ADDRS][S3_RESOLVE_ADDR_LEN];
+    size_t naddrs;
+    uint32_t rr;
+};
+
+struct s3_resolver {
+    struct s3_client *client;
+
+    struct s3_resolve_host *hosts;
+    size_t count;
+
+    uint32_t refresh_ms;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t thread;
+    bool thread_started;
+    bool stop;
+};
+
+/*
+ * scheme://host[:port][/...] -> host, port.
+ * IPv6-литералы в [] и хосты-IP закреплять не нужно — возвращаем -1.
+ */
+static int
+s3_resolve_parse_url(const char *url, char *host, size_t host_cap, int *port)
+{
+    const char *p = strstr(url, "://");
+    bool https = strncasecmp(url, "https", 5) == 0;
+    p = p != NULL ? p + 3 : url;
+
+    if (*p == '[')
+        return -1;
+
+    size_t len = strcspn(p, ":/");
+    if (len == 0 || len >= host_cap)
+        return -1;
+    memcpy(host, p, len);
+    host[len] = '\0';
+
+    *port = https ? 443 : 80;
+    if (p[len] == ':')
+        *port = atoi(p + len + 1);
+
+    unsigned char tmp[sizeof(struct in6_addr)];
+    if (inet_pton(AF_INET, host, tmp) == 1)
+        return -1;
+
+    return 0;
+}
+
+/*
+ * getaddrinfo для хоста; адреса кладутся в out (уже в формате CONNECT_TO).
+ */
+static size_t
+s3_resolve_lookup(const char *host,
+                  char out[][S3_RESOLVE_ADDR_LEN], size_t cap)
+{
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(host, NULL, &hints, &res) != 0)
+        return 0;
+
+    size_t n = 0;
+    for (struct addrinfo *ai = res; ai != NULL && n < cap; ai = ai->ai_next) {
+        char buf[INET6_ADDRSTRLEN];
+
+        if (ai->ai_family == AF_INET) {
+            struct sockaddr_in *sa = (struct sockaddr_in *)ai->ai_addr;
+            inet_ntop(AF_INET, &sa->sin_addr, buf, sizeof(buf));
+            snprintf(out[n], S3_RESOLVE_ADDR_LEN, "%s", buf);
+        } else if (ai->ai_family == AF_INET6) {
+            struct sockaddr_in6 *sa = (struct sockaddr_in6 *)ai->ai_addr;
+            inet_ntop(AF_INET6, &sa->sin6_addr, buf, sizeof(buf));
+            snprintf(out[n], S3_RESOLVE_ADDR_LEN, "[%s]", buf);
+        } else {
+            continue;
+        }
+
+        /* getaddrinfo может вернуть один адрес несколько раз. */
+        bool dup = false;
+        for (size_t i = 0; i < n && !dup; i++)
+            dup = strcmp(out[i], out[n]) == 0;
+        if (!dup)
+            n++;
+    }
+
+    freeaddrinfo(res);
+    return n;
+}
+
+static void
+s3_resolve_refresh_host(struct s3_resolver *r, struct s3_resolve_host *rh)
+{
+    char addrs[S3_RESOLVE_MAX_ADDRS][S3_RESOLVE_ADDR_LEN];
+    size_t n = s3_resolve_lookup(rh->host, addrs, S3_RESOLVE_MAX_ADDRS);
+
+    if (n == 0) {
+        say_warn("s3: failed to resolve %s, keeping previous addresses",
+                 rh->host);
+        return;
+    }
+
+    pthread_mutex_lock(&r->mutex);
+    memcpy(rh->addrs, addrs, sizeof(addrs));
+    rh->naddrs = n;
+    pthread_mutex_unlock(&r->mutex);
+}
+
+static void *
+s3_resolve_thread_main(void *arg)
+{
+    struct s3_resolver *r = (struct s3_resolver *)arg;
+
+    pthread_mutex_lock(&r->mutex);
+    while (!r->stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += r->refresh_ms / 1000;
+        deadline.tv_nsec += (long)(r->refresh_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&r->cond, &r->mutex, &deadline);
+        if (r->stop)
+            break;
+
+        pthread_mutex_unlock(&r->mutex);
+        for (size_t i = 0; i < r->count; i++)
+            s3_resolve_refresh_host(r, &r->hosts[i]);
+        pthread_mutex_lock(&r->mutex);
+    }
+    pthread_mutex_unlock(&r->mutex);
+    return NULL;
+}
+
+static s3_error_code_t
+s3_resolver_add(struct s3_resolver *r, const char *url, s3_error_t *err)
+{
+    struct s3_resolve_host *rh = &r->hosts[r->count];
+    memset(rh, 0, sizeof(*rh));
+
+    if (s3_resolve_parse_url(url, rh->host, sizeof(rh->host), &rh->port) != 0)
+        return S3_E_OK; /* IP или что-то непонятное — оставляем curl'у */
+
+    /* endpoint обычно совпадает с endpoints[0]. */
+    size_t url_len = strlen(url);
+    if (url_len > 0 && url[url_len - 1] == '/')
+        url_len--;
+    for (size_t i = 0; i < r->count; i++) {
+        if (strncmp(r->hosts[i].url, url, url_len) == 0 &&
+            r->hosts[i].url[url_len] == '\0')
+            return S3_E_OK;
+    }
+
+    rh->url = s3_strdup_a(&r->client->alloc, url, err);
+    if (rh->url == NULL)
+        return err->code;
+
+    size_t len = strlen(rh->url);
+    if (len > 0 && rh->url[len - 1] == '/')
+        rh->url[len - 1] = '\0';
+
+    r->count++;
+    return S3_E_OK;
+}
+
+/* Первое разрешение всех хостов — в coio-потоке, не на tx. */
+static ssize_t
+s3_resolve_all_worker(va_list ap)
+{
+    struct s3_resolver *r = va_arg(ap, struct s3_resolver *);
+    for (size_t i = 0; i < r->count; i++)
+        s3_resolve_refresh_host(r, &r->hosts[i]);
+    return 0;
+}
+
+s3_error_code_t
+s3_resolver_new(struct s3_client *client,
+                const s3_client_opts_t *opts,
+                struct s3_resolver **out,
+                s3_error_t *err)
+{
+    struct s3_resolver *r =
+        (struct s3_resolver *)s3_alloc(&client->alloc, sizeof(*r));
+    if (r == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate resolver", ENOMEM, 0, 0);
+        return err->code;
+    }
+    memset(r, 0, sizeof(*r));
+    r->client = client;
+    r->refresh_ms = opts->dns_refresh_ms > 0 ?
+        opts->dns_refresh_ms : S3_RESOLVE_DEFAULT_REFRESH_MS;
+
+    pthread_mutex_init(&r->mutex, NULL);
+    pthread_cond_init(&r->cond, NULL);
+
+    size_t cap = 1 + opts->endpoints_count;
+    r->hosts = (struct s3_resolve_host *)s3_alloc(&client->alloc,
+                                                  cap * sizeof(*r->hosts));
+    if (r->hosts == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate resolver hosts", ENOMEM, 0, 0);
+        goto fail;
+    }
+
+    if (s3_resolver_add(r, client->endpoint, err) != S3_E_OK)
+        goto fail;
+    for (size_t i = 0; i < opts->endpoints_count; i++) {
+        if (s3_resolver_add(r, opts->endpoints[i], err) != S3_E_OK)
+            goto fail;
+    }
+    if (r->count > 0)
+        coio_call(s3_resolve_all_worker, r);
+
+    int rc = pthread_create(&r->thread, NULL, s3_resolve_thread_main, r);
+    if (rc != 0) {
+        s3_error_set(err, S3_E_INIT,
+                     "pthread_create failed for DNS refresh", rc, 0, 0);
+        goto fail;
+    }
+    r->thread_started = true;
+
+    *out = r;
+    return S3_E_OK;
+
+fail:
+    s3_resolver_delete(r);
+    return err->code;
+}
+
+void
+s3_resolver_delete(struct s3_resolver *r)
+{
+    if (r == NULL)
+        return;
+
+    s3_client_t *c = r->client;
+
+    if (r->thread_started) {
+        pthread_mutex_lock(&r->mutex);
+        r->stop = true;
+        pthread_cond_signal(&r->cond);
+        pthread_mutex_unlock(&r->mutex);
+        pthread_join(r->thread, NULL);
+    }
+
+    pthread_cond_destroy(&r->cond);
+    pthread_mutex_destroy(&r->mutex);
+
+    if (r->hosts != NULL) {
+        for (size_t i = 0; i < r->count; i++)
+            s3_free(&c->alloc, r->hosts[i].url);
+        s3_free(&c->alloc, r->hosts);
+    }
+    s3_free(&c->alloc, r);
+}
+
+void
+s3_resolver_apply(struct s3_resolver *r, s3_easy_handle_t *h,
+                  const char *url)
+{
+    if (r == NULL)
+        return;
+    if (url == NULL)
+        url = r->client->endpoint;
+
+    size_t url_len = strlen(url);
+    if (url_len > 0 && url[url_len - 1] == '/')
+        url_len--;
+
+    struct s3_resolve_host *rh = NULL;
+    for (size_t i = 0; i < r->count; i++) {
+        if (strncmp(r->hosts[i].url, url, url_len) == 0 &&
+            r->hosts[i].url[url_len] == '\0')
+        {
+            rh = &r->hosts[i];
+            break;
+        }
+    }
+    if (rh == NULL)
+        return;
+
+    char entry[512];
+    pthread_mutex_lock(&r->mutex);
+    if (rh->naddrs == 0) {
+        pthread_mutex_unlock(&r->mutex);
+        return;
+    }
+    const char *addr = rh->addrs[rh->rr++ % rh->naddrs];
+    snprintf(entry, sizeof(entry), "%s:%d:%s:%d",
+             rh->host, rh->port, addr, rh->port);
+    pthread_mutex_unlock(&r->mutex);
+
+    /* Список должен жить до конца perform — держим его в хендле. */
+    struct curl_slist *list = curl_slist_append(NULL, entry);
+    if (list == NULL)
+        return;
+
+    curl_easy_setopt(h->easy, CURLOPT_CONNECT_TO, list);
+    if (h->connect_to != NULL)
+        curl_slist_free_all(h->connect_to);
+    h->connect_to = list;
+}
@@ -0,0 +1,40 @@
+#ifndef TARANTOOL_S3_RESOLVE_H_INCLUDED
+#define TARANTOOL_S3_RESOLVE_H_INCLUDED 1
+
+#include "s3_internal.h"
+
+/*
+ * Закреплённые адреса endpoint'ов (S3_CLIENT_F_PIN_DNS).
+ *
+ * Хосты всех endpoint'ов резолвятся один раз при создании клиента (в
+ * coio-потоке, файбер ждёт) и затем фоновым потоком раз в dns_refresh_ms; запросы идут в curl через
+ * CURLOPT_CONNECT_TO, поэтому Host/SNI остаются прежними, а getaddrinfo
+ * на горячем пути не вызывается. Адрес выбирается по кругу среди всех
+ * A/AAAA записей хоста.
+ *
+ * getaddrinfo не отдаёт TTL, поэтому обновление — по интервалу. Если
+ * обновление не удалось, остаёмся на старых адресах; если адресов нет
+ * совсем — curl резолвит сам.
+ */
+
+struct s3_resolver;
+
+/* Вызывается из файбера на tx-треде. */
+s3_error_code_t
+s3_resolver_new(struct s3_client *client,
+                const s3_client_opts_t *opts,
+                struct s3_resolver **out,
+                s3_error_t *err);
+
+void
+s3_resolver_delete(struct s3_resolver *r);
+
+/*
+ * Закрепить адрес для запроса к endpoint'у url (NULL — client->endpoint):
+ * выставить h->connect_to и CURLOPT_CONNECT_TO.
+ */
+void
+s3_resolver_apply(struct s3_resolver *r, struct s3_easy_handle *h,
+                  const char *url);
+
+#endif /* TARANTOOL_S3_RESOLVE_H_INCLUDED */
@@ -0,0 +1,786 @@
+#define _GNU_SOURCE /* sync_file_range */
+#include "s3_internal.h"
+#include "multipart.h"
+#include "s3/curl_easy_factory.h"
+#include "error.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+
+#include <tarantool/module.h>
+
+#define S3_RESTORE_DEFAULT_CONCURRENCY 8
+#define S3_RESTORE_MAX_CONCURRENCY     64
+#define S3_RESTORE_RETRIES             2
+#define S3_RESTORE_READ_BUF            (1024 * 1024)
+#define S3_RESTORE_TMP_SUFFIX          ".s3tmp"
+#define S3_RESTORE_MD5_LEN             16
+#define S3_RESTORE_STRIPE              (16 * 1024 * 1024)
+
+struct s3_restore_file {
+    char *name;
+    char *key;
+    uint64_t size;
+    char etag[S3_ETAG_MAX];
+
+    char *path;
+    char *tmp_path;
+    int fd;
+    bool renamed;
+
+    bool multipart;
+    bool verify;        /* ETag можно свести из md5 полос */
+    size_t part_size;   /* полоса multipart-файла */
+    size_t first_stripe;
+    size_t nstripes;
+    size_t stripes_left;
+};
+
+/* Кусок файла, который качается одним Range GET. */
+struct s3_restore_stripe {
+    size_t file;
+    uint64_t offset;
+    size_t len;
+    unsigned char md5[S3_RESTORE_MD5_LEN];
+};
+
+struct s3_restore_task {
+    s3_client_t *client;
+    s3_restore_opts_t opts;
+
+    char *manifest;
+    struct s3_restore_file *files;
+    size_t nfiles;
+    struct s3_restore_stripe *stripes;
+    size_t nstripes;
+    char *buf; /* для md5 */
+
+    s3_restore_result_t result;
+    s3_error_t err;
+    s3_error_code_t code;
+};
+
+static s3_error_code_t
+s3_restore_nomem(struct s3_restore_task *t)
+{
+    s3_error_set(&t->err, S3_E_NOMEM, "Out of memory in restore",
+                 ENOMEM, 0, 0);
+    return t->err.code;
+}
+
+static s3_error_code_t
+s3_restore_bad_manifest(struct s3_restore_task *t, const char *what)
+{
+    char msg[128];
+    snprintf(msg, sizeof(msg), "malformed backup manifest: %s", what);
+    s3_error_set(&t->err, S3_E_INVALID_ARG, msg, 0, 0, 0);
+    return t->err.code;
+}
+
+/*
+ * Выполнить n хендлов одновременно; упавшие повторить по одной.
+ * Возвращает код первой ошибки (она же в t->err).
+ */
+static s3_error_code_t
+s3_restore_perform(struct s3_restore_task *t, s3_easy_handle_t **handles,
+                   size_t n, s3_error_code_t *codes, s3_error_t *errs)
+{
+    struct s3_http_backend_impl *b = t->client->backend;
+
+    s3_error_t batch_err = S3_ERROR_INIT;
+    s3_error_code_t rc = b->vtbl->perform_many(b, handles, n, codes, errs,
+                                               &batch_err);
+    s3_error_code_t code = S3_E_OK;
+
+    for (size_t i = 0; i < n; i++) {
+        if (rc != S3_E_OK && codes[i] == S3_E_INTERNAL) {
+            codes[i] = rc;
+            errs[i] = batch_err;
+        }
+        for (int a = 0; a < S3_RESTORE_RETRIES && codes[i] != S3_E_OK &&
+             codes[i] != S3_E_ACCESS_DENIED && codes[i] != S3_E_AUTH &&
+             codes[i] != S3_E_NOT_FOUND && codes[i] != S3_E_INVALID_ARG; a++)
+        {
+            if (s3_easy_handle_rewind(handles[i]) != 0)
+                break;
+            codes[i] = b->vtbl->perform(b, handles[i], &errs[i]);
+        }
+        if (codes[i] != S3_E_OK && code == S3_E_OK) {
+            code = codes[i];
+            t->err = errs[i];
+        }
+    }
+    return code;
+}
+
+/* ----------------- manifest ----------------- */
+
+s3_error_code_t
+s3_fetch_object(s3_client_t *c, const char *bucket, const char *key,
+                char **out, size_t *out_len, s3_error_t *err)
+{
+    struct s3_http_backend_impl *b = c->backend;
+
+    s3_easy_handle_t *h = NULL;
+    if (s3_easy_factory_new_head_object(c, bucket, key, &h, err) != S3_E_OK)
+        return err->code;
+
+    curl_off_t len = -1;
+    char etag[S3_ETAG_MAX];
+    s3_error_code_t code = b->vtbl->perform(b, h, err);
+    if (code == S3_E_OK) {
+        curl_easy_getinfo(h->easy, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &len);
+        memcpy(etag, h->etag, sizeof(etag));
+    }
+    s3_easy_handle_destroy(h);
+    if (code != S3_E_OK)
+        return code;
+    if (len < 0) {
+        s3_error_set(err, S3_E_HTTP,
+                     "no Content-Length in HEAD response", 0, 0, 0);
+        return err->code;
+    }
+
+    char *buf = s3_alloc(&c->alloc, (size_t)len + 1);
+    if (buf == NULL) {
+        s3_error_set(err, S3_E_NOMEM, "Out of memory in fetch_object",
+                     ENOMEM, 0, 0);
+        return err->code;
+    }
+
+    /* Между HEAD и GET объект мог смениться. */
+    s3_get_opts_t gopts;
+    memset(&gopts, 0, sizeof(gopts));
+    gopts.bucket = bucket;
+    gopts.key = key;
+    gopts.if_match = etag[0] != '\0' ? etag : NULL;
+
+    if (s3_easy_factory_new_get_buf(c, &gopts, buf, (size_t)len,
+                                    &h, err) != S3_E_OK)
+    {
+        s3_free(&c->alloc, buf);
+        return err->code;
+    }
+    code = b->vtbl->perform(b, h, err);
+    size_t got = code == S3_E_OK ? h->write_bytes_total : 0;
+    s3_easy_handle_destroy(h);
+    if (code != S3_E_OK) {
+        s3_free(&c->alloc, buf);
+        return code;
+    }
+
+    buf[got] = '\0';
+    *out = buf;
+    if (out_len != NULL)
+        *out_len = got;
+    return S3_E_OK;
+}
+
+static const char *
+s3_restore_expect(const char *p, const char *lit)
+{
+    size_t n = strlen(lit);
+    return p != NULL && strncmp(p, lit, n) == 0 ? p + n : NULL;
+}
+
+/* Строка JSON (p на открывающей кавычке) в out; NULL — ошибка. */
+static const char *
+s3_restore_json_str(s3_client_t *c, const char *p, char **out)
+{
+    if (p == NULL || *p != '"')
+        return NULL;
+    p++;
+
+    const char *end = p;
+    while (*end != '\0' && *end != '"')
+        end += *end == '\\' && end[1] != '\0' ? 2 : 1;
+    if (*end != '"')
+        return NULL;
+
+    char *s = s3_alloc(&c->alloc, (size_t)(end - p) + 1);
+    if (s == NULL)
+        return NULL;
+
+    size_t o = 0;
+    while (p < end) {
+        if (*p != '\\') {
+            s[o++] = *p++;
+            continue;
+        }
+        p++;
+        switch (*p) {
+        case 'u': {
+            /* backup пишет \u только для управляющих символов. */
+            unsigned v = 0;
+            if (sscanf(p + 1, "%4x", &v) != 1 || v >= 0x80)
+                goto fail;
+            s[o++] = (char)v;
+            p += 5;
+            break;
+        }
+        case 'n':  s[o++] = '\n'; p++; break;
+        case 't':  s[o++] = '\t'; p++; break;
+        case '"': case '\\': case '/':
+            s[o++] = *p++;
+            break;
+        default:
+            goto fail;
+        }
+    }
+    s[o] = '\0';
+    *out = s;
+    return end + 1;
+
+fail:
+    s3_free(&c->alloc, s);
+    return NULL;
+}
+
+/* Имя из manifest'а не должно выводить за пределы dir. */
+static bool
+s3_restore_name_ok(const char *name)
+{
+    if (name[0] == '\0' || name[0] == '/')
+        return false;
+    for (const char *p = name; *p != '\0'; ) {
+        size_t n = strcspn(p, "/");
+        if ((n == 1 && p[0] == '.') || (n == 2 && p[0] == '.' && p[1] == '.'))
+            return false;
+        p += n;
+        if (*p == '/')
+            p++;
+    }
+    return true;
+}
+
+/*
+ * Разбор manifest'а s3_backup_write_manifest: по записи на строку
+ * {"name":..,"path":..,"key":..,"size":..,"part_size":..,"etag":..};
+ * part_size в manifest'ах старых backup'ов нет — как 0, неизвестен.
+ */
+static s3_error_code_t
+s3_restore_parse_manifest(struct s3_restore_task *t)
+{
+    s3_client_t *c = t->client;
+    static const char entry[] = "\n{\"name\":";
+
+    if (strncmp(t->manifest, "{\"version\":1,", 13) != 0)
+        return s3_restore_bad_manifest(t, "unsupported version");
+
+    size_t count = 0;
+    for (const char *p = t->manifest; (p = strstr(p, entry)) != NULL; p++)
+        count++;
+    if (count == 0)
+        return s3_restore_bad_manifest(t, "no files");
+
+    t->files = s3_alloc(&c->alloc, count * sizeof(*t->files));
+    if (t->files == NULL)
+        return s3_restore_nomem(t);
+    memset(t->files, 0, count * sizeof(*t->files));
+    for (size_t i = 0; i < count; i++)
+        t->files[i].fd = -1;
+    t->nfiles = count;
+
+    const char *p = t->manifest;
+    for (size_t i = 0; i < count; i++) {
+        struct s3_restore_file *f = &t->files[i];
+        char *path = NULL;
+        char *etag = NULL;
+
+        p = strstr(p, entry) + 1;
+        p = s3_restore_json_str(c, s3_restore_expect(p, "{\"name\":"),
+                                &f->name);
+        p = s3_restore_json_str(c, s3_restore_expect(p, ",\"path\":"), &path);
+        if (path != NULL)
+            s3_free(&c->alloc, path);
+        p = s3_restore_json_str(c, s3_restore_expect(p, ",\"key\":"), &f->key);
+        p = s3_restore_expect(p, ",\"size\":");
+        if (p != NULL) {
+            char *end = NULL;
+            f->size = strtoull(p, &end, 10);
+            p = end;
+        }
+        if (p != NULL && strncmp(p, ",\"part_size\":", 13) == 0) {
+            char *end = NULL;
+            f->part_size = (size_t)strtoull(p + 13, &end, 10);
+            p = end;
+        }
+        p = s3_restore_json_str(c, s3_restore_expect(p, ",\"etag\":"), &etag);
+        if (p == NULL || etag == NULL || strlen(etag) >= sizeof(f->etag)) {
+            if (etag != NULL)
+                s3_free(&c->alloc, etag);
+            return s3_restore_bad_manifest(t, "bad file entry");
+        }
+        strcpy(f->etag, etag);
+        s3_free(&c->alloc, etag);
+
+        if (!s3_restore_name_ok(f->name))
+            return s3_restore_bad_manifest(t, "file name escapes dir");
+        t->result.bytes += f->size;
+    }
+    t->result.files = count;
+    return S3_E_OK;
+}
+
+/* ----------------- подготовка файлов ----------------- */
+
+/* mkdir -p для каталогов path, начиная с позиции from. */
+static int
+s3_restore_mkdirs(char *path, size_t from)
+{
+    for (char *p = path + from; (p = strchr(p, '/')) != NULL; p++) {
+        *p = '\0';
+        int rc = mkdir(path, 0755);
+        *p = '/';
+        if (rc != 0 && errno != EEXIST)
+            return -1;
+    }
+    return 0;
+}
+
+static s3_error_code_t
+s3_restore_prepare(struct s3_restore_task *t)
+{
+    s3_client_t *c = t->client;
+    size_t dir_len = strlen(t->opts.dir);
+
+    /*
+     * Полосы: у multipart — по его part_size из manifest'а, иначе весь
+     * файл одной. Если part_size multipart-файла неизвестен (0), полосы
+     * по S3_RESTORE_STRIPE, а ETag не сверяется: без размера частей его
+     * не свести.
+     */
+    bool verify = !(t->opts.flags & S3_RESTORE_F_NO_VERIFY);
+    size_t nstripes = 0;
+    for (size_t i = 0; i < t->nfiles; i++) {
+        struct s3_restore_file *f = &t->files[i];
+        const char *dash = strchr(f->etag, '-');
+        f->multipart = dash != NULL;
+        f->verify = verify;
+        f->first_stripe = nstripes;
+        if (f->multipart && f->part_size == 0) {
+            f->part_size = S3_RESTORE_STRIPE;
+            f->verify = false;
+        }
+
+        if (f->size == 0)
+            f->nstripes = 0;
+        else if (f->multipart && f->part_size > 0)
+            f->nstripes = (size_t)((f->size + f->part_size - 1) /
+                                   f->part_size);
+        else
+            f->nstripes = 1;
+
+        if (f->multipart && f->verify &&
+            strtoull(dash + 1, NULL, 10) != f->nstripes)
+        {
+            return s3_restore_bad_manifest(t, "part_size does not match "
+                                           "the multipart ETag");
+        }
+        f->stripes_left = f->nstripes;
+        nstripes += f->nstripes;
+    }
+
+    if (nstripes > 0) {
+        t->stripes = s3_alloc(&c->alloc, nstripes * sizeof(*t->stripes));
+        if (t->stripes == NULL)
+            return s3_restore_nomem(t);
+    }
+    t->nstripes = nstripes;
+
+    for (size_t i = 0; i < t->nfiles; i++) {
+        struct s3_restore_file *f = &t->files[i];
+
+        for (size_t k = 0; k < f->nstripes; k++) {
+            struct s3_restore_stripe *s = &t->stripes[f->first_stripe + k];
+            s->file = i;
+            s->offset = f->multipart ? (uint64_t)k * f->part_size : 0;
+            s->len = f->multipart && f->size - s->offset > f->part_size ?
+                f->part_size : (size_t)(f->size - s->offset);
+        }
+
+        size_t plen = dir_len + 1 + strlen(f->name) + 1;
+        f->path = s3_alloc(&c->alloc, plen);
+        f->tmp_path = s3_alloc(&c->alloc,
+                               plen + sizeof(S3_RESTORE_TMP_SUFFIX) - 1);
+        if (f->path == NULL || f->tmp_path == NULL)
+            return s3_restore_nomem(t);
+        snprintf(f->path, plen, "%s/%s", t->opts.dir, f->name);
+        snprintf(f->tmp_path, plen + sizeof(S3_RESTORE_TMP_SUFFIX) - 1,
+                 "%s" S3_RESTORE_TMP_SUFFIX, f->path);
+
+        if (s3_restore_mkdirs(f->tmp_path, dir_len + 1) != 0)
+            goto io_fail;
+
+        f->fd = open(f->tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                     0644);
+        if (f->fd < 0)
+            goto io_fail;
+
+        /* Место сразу целиком: полосы пишутся вразнобой. */
+        if (f->size > 0) {
+            int rc = posix_fallocate(f->fd, 0, (off_t)f->size);
+            if (rc != 0 && (rc == EINVAL || rc == EOPNOTSUPP))
+                rc = ftruncate(f->fd, (off_t)f->size) == 0 ? 0 : errno;
+            if (rc != 0) {
+                errno = rc;
+                goto io_fail;
+            }
+        }
+        continue;
+
+io_fail:;
+        char msg[256];
+        snprintf(msg, sizeof(msg), "cannot create %s", f->tmp_path);
+        s3_error_set(&t->err, S3_E_IO, msg, errno, 0, 0);
+        return t->err.code;
+    }
+    return S3_E_OK;
+}
+
+/* ----------------- загрузка и проверка ----------------- */
+
+/* md5 уже записанной полосы (из page cache). */
+static int
+s3_restore_stripe_md5(struct s3_restore_task *t, struct s3_restore_stripe *s)
+{
+    int fd = t->files[s->file].fd;
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    if (ctx == NULL)
+        return -1;
+
+    int rc = -1;
+    EVP_DigestInit_ex(ctx, EVP_md5(), NULL);
+    for (size_t done = 0; done < s->len; ) {
+        size_t want = s->len - done < S3_RESTORE_READ_BUF ?
+            s->len - done : S3_RESTORE_READ_BUF;
+        ssize_t n = pread(fd, t->buf, want, (off_t)(s->offset + done));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            goto out;
+        EVP_DigestUpdate(ctx, t->buf, (size_t)n);
+        done += (size_t)n;
+    }
+    unsigned int md_len = 0;
+    EVP_DigestFinal_ex(ctx, s->md5, &md_len);
+    rc = 0;
+out:
+    EVP_MD_CTX_free(ctx);
+    return rc;
+}
+
+/* Все полосы файла скачаны: свести md5 в ETag и сравнить. */
+static s3_error_code_t
+s3_restore_verify_file(struct s3_restore_task *t, struct s3_restore_file *f)
+{
+    unsigned char md[EVP_MAX_MD_SIZE];
+    unsigned int md_len = 0;
+
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    if (ctx == NULL)
+        return s3_restore_nomem(t);
+    EVP_DigestInit_ex(ctx, EVP_md5(), NULL);
+    if (f->multipart) {
+        for (size_t k = 0; k < f->nstripes; k++)
+            EVP_DigestUpdate(ctx, t->stripes[f->first_stripe + k].md5,
+                             S3_RESTORE_MD5_LEN);
+        EVP_DigestFinal_ex(ctx, md, &md_len);
+    } else if (f->nstripes == 1) {
+        md_len = S3_RESTORE_MD5_LEN;
+        memcpy(md, t->stripes[f->first_stripe].md5, md_len);
+    } else {
+        EVP_DigestFinal_ex(ctx, md, &md_len); /* пустой файл */
+    }
+    EVP_MD_CTX_free(ctx);
+
+    char etag[S3_ETAG_MAX];
+    size_t o = 0;
+    etag[o++] = '"';
+    for (unsigned int i = 0; i < md_len; i++)
+        o += (size_t)snprintf(etag + o, sizeof(etag) - o, "%02x", md[i]);
+    if (f->multipart)
+        o += (size_t)snprintf(etag + o, sizeof(etag) - o, "-%zu",
+                              f->nstripes);
+    snprintf(etag + o, sizeof(etag) - o, "\"");
+
+    if (strcmp(etag, f->etag) != 0) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "checksum mismatch for %s", f->name);
+        s3_error_set(&t->err, S3_E_IO, msg, 0, 0, 0);
+        return t->err.code;
+    }
+    return S3_E_OK;
+}
+
+static s3_error_code_t
+s3_restore_download(struct s3_restore_task *t)
+{
+    s3_client_t *c = t->client;
+    uint32_t conc = t->opts.concurrency;
+
+    s3_easy_handle_t **handles = s3_alloc(&c->alloc, conc * sizeof(*handles));
+    s3_error_code_t *codes = s3_alloc(&c->alloc, conc * sizeof(*codes));
+    s3_error_t *errs = s3_alloc(&c->alloc, conc * sizeof(*errs));
+    char (*ranges)[64] = s3_alloc(&c->alloc, conc * sizeof(*ranges));
+    s3_error_code_t code = S3_E_OK;
+
+    if (handles == NULL || codes == NULL || errs == NULL || ranges == NULL) {
+        code = s3_restore_nomem(t);
+        goto out;
+    }
+
+    for (size_t i = 0; i < t->nstripes && code == S3_E_OK; ) {
+        size_t n = 0;
+        for (; n < conc && i + n < t->nstripes; n++) {
+            struct s3_restore_stripe *s = &t->stripes[i + n];
+            struct s3_restore_file *f = &t->files[s->file];
+
+            snprintf(ranges[n], sizeof(ranges[n]),
+                     "bytes=%" PRIu64 "-%" PRIu64,
+                     s->offset, s->offset + s->len - 1);
+
+            s3_get_opts_t gopts;
+            memset(&gopts, 0, sizeof(gopts));
+            gopts.bucket = t->opts.bucket;
+            gopts.key = f->key;
+            gopts.range = ranges[n];
+            gopts.if_match = f->etag;
+
+            code = s3_easy_factory_new_get_fd(c, &gopts, f->fd,
+                                              (off_t)s->offset, s->len,
+                                              &handles[n], &t->err);
+            if (code != S3_E_OK)
+                break;
+        }
+
+        if (code == S3_E_OK)
+            code = s3_restore_perform(t, handles, n, codes, errs);
+
+        for (size_t k = 0; k < n && code == S3_E_OK; k++) {
+            struct s3_restore_stripe *s = &t->stripes[i + k];
+            struct s3_restore_file *f = &t->files[s->file];
+
+            if (handles[k]->write_bytes_total != s->len) {
+                char msg[256];
+                snprintf(msg, sizeof(msg), "short download for %s", f->name);
+                s3_error_set(&t->err, S3_E_IO, msg, 0, 0, 0);
+                code = t->err.code;
+                break;
+            }
+
+            /* Запустить writeback, fsync в конце будет почти бесплатным. */
+            sync_file_range(f->fd, (off_t)s->offset, (off_t)s->len,
+                            SYNC_FILE_RANGE_WRITE);
+
+            if (f->verify && s3_restore_stripe_md5(t, s) != 0) {
+                s3_error_set(&t->err, S3_E_IO, "failed to read back stripe",
+                             errno, 0, 0);
+                code = t->err.code;
+                break;
+            }
+            if (--f->stripes_left == 0 && f->verify)
+                code = s3_restore_verify_file(t, f);
+        }
+
+        for (size_t k = 0; k < n; k++)
+            s3_easy_handle_destroy(handles[k]);
+        i += n;
+    }
+
+    /* Пустые файлы: полос нет, md5 пустого тела. */
+    for (size_t i = 0; i < t->nfiles && code == S3_E_OK; i++) {
+        if (t->files[i].nstripes == 0 && t->files[i].verify)
+            code = s3_restore_verify_file(t, &t->files[i]);
+    }
+
+out:
+    if (ranges != NULL)
+        s3_free(&c->alloc, ranges);
+    if (errs != NULL)
+        s3_free(&c->alloc, errs);
+    if (codes != NULL)
+        s3_free(&c->alloc, codes);
+    if (handles != NULL)
+        s3_free(&c->alloc, handles);
+    return code;
+}
+
+static int
+s3_restore_fsync_dir(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    char dir[4096];
+    size_t len = slash != NULL ? (size_t)(slash - path) : 0;
+    if (len == 0 || len >= sizeof(dir))
+        return 0;
+    memcpy(dir, path, len);
+    dir[len] = '\0';
+
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    int rc = fsync(fd);
+    close(fd);
+    return rc;
+}
+
+/* fsync всех файлов, rename на место, fsync каталогов. */
+static s3_error_code_t
+s3_restore_commit(struct s3_restore_task *t)
+{
+    for (size_t i = 0; i < t->nfiles; i++) {
+        struct s3_restore_file *f = &t->files[i];
+        if (fsync(f->fd) != 0 || close(f->fd) != 0) {
+            f->fd = -1;
+            s3_error_set(&t->err, S3_E_IO, "fsync failed in restore",
+                         errno, 0, 0);
+            return t->err.code;
+        }
+        f->fd = -1;
+    }
+
+    for (size_t i = 0; i < t->nfiles; i++) {
+        struct s3_restore_file *f = &t->files[i];
+        if (rename(f->tmp_path, f->path) != 0) {
+            s3_error_set(&t->err, S3_E_IO, "rename failed in restore",
+                         errno, 0, 0);
+            return t->err.code;
+        }
+        f->renamed = true;
+    }
+
+    for (size_t i = 0; i < t->nfiles; i++) {
+        /* Соседние файлы обычно в одном каталоге. */
+        if (i > 0) {
+            const char *a = t->files[i - 1].path;
+            const char *b = t->files[i].path;
+            size_t la = (size_t)(strrchr(a, '/') - a);
+            size_t lb = (size_t)(strrchr(b, '/') - b);
+            if (la == lb && strncmp(a, b, la) == 0)
+                continue;
+        }
+        if (s3_restore_fsync_dir(t->files[i].path) != 0) {
+            s3_error_set(&t->err, S3_E_IO, "directory fsync failed",
+                         errno, 0, 0);
+            return t->err.code;
+        }
+    }
+    return S3_E_OK;
+}
+
+static double
+s3_restore_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static ssize_t
+s3_client_restore_worker(va_list ap)
+{
+    struct s3_restore_task *t = va_arg(ap, struct s3_restore_task *);
+    s3_client_t *c = t->client;
+    double start = s3_restore_now();
+
+    t->buf = malloc(S3_RESTORE_READ_BUF);
+    if (t->buf == NULL) {
+        t->code = s3_restore_nomem(t);
+        goto out;
+    }
+
+    if ((t->code = s3_fetch_object(c, t->opts.bucket, t->opts.manifest_key,
+                                   &t->manifest, NULL,
+                                   &t->err)) != S3_E_OK ||
+        (t->code = s3_restore_parse_manifest(t)) != S3_E_OK ||
+        (t->code = s3_restore_prepare(t)) != S3_E_OK ||
+        (t->code = s3_restore_download(t)) != S3_E_OK)
+        goto out;
+
+    t->code = s3_restore_commit(t);
+
+out:
+    for (size_t i = 0; i < t->nfiles; i++) {
+        struct s3_restore_file *f = &t->files[i];
+        if (f->fd >= 0)
+            close(f->fd);
+        if (f->tmp_path != NULL && !f->renamed)
+            unlink(f->tmp_path);
+        if (f->tmp_path != NULL)
+            s3_free(&c->alloc, f->tmp_path);
+        if (f->path != NULL)
+            s3_free(&c->alloc, f->path);
+        if (f->key != NULL)
+            s3_free(&c->alloc, f->key);
+        if (f->name != NULL)
+            s3_free(&c->alloc, f->name);
+    }
+    if (t->files != NULL)
+        s3_free(&c->alloc, t->files);
+    if (t->stripes != NULL)
+        s3_free(&c->alloc, t->stripes);
+    if (t->manifest != NULL)
+        s3_free(&c->alloc, t->manifest);
+    free(t->buf);
+
+    t->result.elapsed = s3_restore_now() - start;
+    return 0;
+}
+
+s3_error_code_t
+s3_client_restore(s3_client_t *client,
+                  const s3_restore_opts_t *opts,
+                  s3_restore_result_t *result,
+                  s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (client == NULL || opts == NULL || opts->manifest_key == NULL ||
+        opts->dir == NULL || opts->dir[0] == '\0')
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts, manifest_key or dir is invalid "
+                     "in restore", 0, 0, 0);
+        if (client != NULL)
+            s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    struct s3_restore_task task;
+    memset(&task, 0, sizeof(task));
+    task.client = client;
+    task.opts = *opts;
+    if (task.opts.concurrency == 0)
+        task.opts.concurrency = S3_RESTORE_DEFAULT_CONCURRENCY;
+
+    if (task.opts.concurrency > S3_RESTORE_MAX_CONCURRENCY) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "concurrency must be <= 64 in restore", 0, 0, 0);
+        s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    s3_error_clear(&task.err);
+    task.code = S3_E_OK;
+
+    coio_call(s3_client_restore_worker, &task);
+
+    if (result != NULL)
+        *result = task.result;
+
+    *err = task.err;
+    s3_client_set_error(client, &task.err);
+    return task.code;
+}
@@ -5,13 +5,22 @@
 extern "C" {
 #endif
 
+#include <pthread.h>
 #include <stdint.h>
 #include <stddef.h>
 
+#include <small/rlist.h>
+
 #include "s3/client.h"
 #include "s3/alloc.h"
 
 struct s3_http_backend_impl;
+struct s3_easy_handle;
+struct s3_endpoint_set;
+struct s3_resolver;
+struct s3_http_share;
+struct s3_prewarm;
+struct s3_block_cache;
 
 /*
  * Виртуальная таблица backend'а HTTP (curl_easy / curl_multi).
@@ -51,6 +60,26 @@ struct s3_http_backend_vtbl {
                       const s3_delete_objects_opts_t *opts,
                       s3_error_t *error);
 
+    /*
+     * Выполнить заранее собранный фабрикой easy-хендл.
+     * Хендлом по-прежнему владеет вызывающий.
+     */
+    s3_error_code_t
+    (*perform)(struct s3_http_backend_impl *backend,
+               struct s3_easy_handle *h,
+               s3_error_t *error);
+
+    /*
+     * Выполнить count хендлов одновременно и дождаться всех.
+     * Результат каждого — в codes[i]/errs[i]; сам вызов возвращает
+     * ошибку, только если пачку не удалось выполнить целиком.
+     */
+    s3_error_code_t
+    (*perform_many)(struct s3_http_backend_impl *backend,
+                    struct s3_easy_handle **handles, size_t count,
+                    s3_error_code_t *codes, s3_error_t *errs,
+                    s3_error_t *error);
+
     void
     (*destroy)(struct s3_http_backend_impl *backend);
 };
@@ -84,6 +113,7 @@ struct s3_client {
     uint32_t max_total_connections;
     uint32_t max_connections_per_host;
     uint32_t multi_idle_timeout_ms;
+    uint32_t max_concurrent_streams;
 
     char *ca_file;
     char *ca_path;
@@ -99,6 +129,44 @@ struct s3_client {
 
     /* Последняя ошибка (для s3_client_last_error). */
     s3_error_t last_error;
+
+    /*
+     * GET'ы в полёте для S3_CLIENT_F_COALESCE_GETS (struct s3_sf_call).
+     * Трогается только из файберов tx-треда, поэтому без блокировок.
+     */
+    struct rlist sf_calls;
+
+    /* Несколько endpoint'ов (endpoint.c), NULL — только client->endpoint. */
+    struct s3_endpoint_set *endpoints;
+
+    /* Закреплённые адреса (S3_CLIENT_F_PIN_DNS, resolve.c), иначе NULL. */
+    struct s3_resolver *resolver;
+
+    /* CURLSH easy backend'а (http_share.c), у multi — NULL. */
+    struct s3_http_share *share;
+
+    /* Прогрев соединений (prewarm_connections, prewarm.c), иначе NULL. */
+    struct s3_prewarm *prewarm;
+
+    /* Кэш блоков s3_client_pread (block_cache_bytes, block_cache.c), иначе NULL. */
+    struct s3_block_cache *block_cache;
+
+    /*
+     * Свободные s3_easy_handle вместе с CURL и буфером URL
+     * (curl_easy_factory.c). Хендлы создаются и уничтожаются в
+     * coio-воркерах и фоновых потоках — под мьютексом.
+     */
+    pthread_mutex_t handle_pool_mutex;
+    struct s3_easy_handle *handle_pool;
+    size_t handle_pool_count;
+
+    /*
+     * Счётчики s3_client_stats. Обновляются атомарно из coio-воркеров и
+     * multi-потока (s3_http_account).
+     */
+    uint64_t stat_requests;
+    uint64_t stat_connections;
+    uint64_t stat_http2_requests;
 };
 
 /*
@@ -118,7 +186,59 @@ void
 s3_client_set_error(struct s3_client *client, const s3_error_t *src);
 
 /*
- * Фабрики backend'ов (curl_easy / curl_multi).
+ * GET в fd напрямую через backend (coio_call), без singleflight.
+ * Вызывается из файбера на tx-треде.
+ */
+s3_error_code_t
+s3_client_get_fd_direct(s3_client_t *client,
+                        const s3_get_opts_t *opts,
+                        int fd, off_t offset, size_t max_size,
+                        size_t *bytes_written,
+                        s3_error_t *err);
+
+/*
+ * s3_client_get_buf, который вдобавок отдаёт полный размер объекта из
+ * Content-Range ответа на Range GET (0 — сервер его не прислал).
+ * Вызывается из файбера на tx-треде.
+ */
+s3_error_code_t
+s3_client_get_buf_sized(s3_client_t *client,
+                        const s3_get_opts_t *opts,
+                        void *buf, size_t cap,
+                        size_t *bytes_read, uint64_t *object_size,
+                        s3_error_t *error);
+
+/*
+ * Тело s3_client_put_iov без coio_call — для вызова из coio-воркера.
+ * part_size/concurrency уже проверены. etag (если не NULL, S3_ETAG_MAX
+ * байт) — ETag нового объекта.
+ */
+s3_error_code_t
+s3_put_iov_run(s3_client_t *client, const s3_put_opts_t *opts,
+               size_t part_size, uint32_t concurrency,
+               const s3_put_seg_t *segs, size_t count,
+               char *etag, s3_error_t *err);
+
+/*
+ * ETag, который S3 дал бы файлу: md5 тела или, у multipart ("...-N"),
+ * md5 от md5 частей по part_size с суффиксом "-N". С кавычками.
+ * 0 — успех, -1 — ошибка чтения или нехватка памяти.
+ */
+int
+s3_local_etag(int fd, uint64_t size, size_t part_size, bool multipart,
+              char *out, size_t cap);
+
+/*
+ * Прочитать небольшой объект (manifest) целиком: HEAD за размером,
+ * GET с If-Match в буфер из allocator'а клиента (+ '\0' в конце).
+ * Для вызова из coio-воркера. *out освобождает вызывающий.
+ */
+s3_error_code_t
+s3_fetch_object(s3_client_t *client, const char *bucket, const char *key,
+                char **out, size_t *out_len, s3_error_t *err);
+
+/*
+ * Фабрики backend'ов (curl_easy / curl_multi / native).
  * При ошибке возвращают NULL и заполняют error (если не NULL).
  */
 struct s3_http_backend_impl *
@@ -127,6 +247,9 @@ s3_http_easy_backend_new(struct s3_client *client, s3_error_t *error);
 struct s3_http_backend_impl *
 s3_http_multi_backend_new(struct s3_client *client, s3_error_t *error);
 
+struct s3_http_backend_impl *
+s3_http_native_backend_new(struct s3_client *client, s3_error_t *error);
+
 /*
  * Глобальная инициализация libcurl.
  * Вызывается один раз (pthread_once) при первом создании клиента.
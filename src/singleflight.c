@@ -0,0 +1,303 @@
+#define _GNU_SOURCE /* copy_file_range */
+
+#include "singleflight.h"
+#include "error.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+
+#include <tarantool/module.h>
+
+/*
+ * GET "в полёте". Живёт на стеке файбера-лидера: лидер не выходит из
+ * s3_singleflight_get_fd, пока followers != 0, так что указатель,
+ * сохранённый последователем, остаётся валидным.
+ */
+struct s3_sf_call {
+    struct rlist link; /* в client->sf_calls, пока запрос не завершён */
+
+    /* Ключ склейки: строки принадлежат opts лидера. */
+    const char *bucket;
+    const char *key;
+    const char *range;
+    const char *if_match;
+    size_t max_size;
+
+    /* Куда лидер пишет тело ответа. */
+    int fd;
+    off_t offset;
+
+    struct fiber_cond *cond;
+    bool done;
+    int followers; /* сколько последователей ещё не закончили копирование */
+
+    /* Результат лидера. */
+    s3_error_code_t code;
+    s3_error_t err;
+    size_t bytes;
+};
+
+static bool
+s3_sf_str_eq(const char *a, const char *b)
+{
+    if (a == NULL || b == NULL)
+        return a == b;
+    return strcmp(a, b) == 0;
+}
+
+static bool
+s3_sf_call_matches(const struct s3_sf_call *call, const char *bucket,
+                   const s3_get_opts_t *opts, size_t max_size)
+{
+    return call->max_size == max_size &&
+           s3_sf_str_eq(call->key, opts->key) &&
+           s3_sf_str_eq(call->bucket, bucket) &&
+           s3_sf_str_eq(call->range, opts->range) &&
+           s3_sf_str_eq(call->if_match, opts->if_match);
+}
+
+/* ----------------- копирование результата лидера ----------------- */
+
+struct s3_sf_copy_task {
+    int src_fd;
+    off_t src_offset;
+    int dst_fd;
+    off_t dst_offset;
+    size_t len;
+
+    int os_error;
+};
+
+/*
+ * Fallback для ФС/ядер без copy_file_range между этими fd.
+ */
+static int
+s3_sf_copy_rw(struct s3_sf_copy_task *t, size_t done)
+{
+    char buf[64 * 1024];
+
+    while (done < t->len) {
+        size_t chunk = t->len - done;
+        if (chunk > sizeof(buf))
+            chunk = sizeof(buf);
+
+        ssize_t n;
+        do {
+            n = pread(t->src_fd, buf, chunk, t->src_offset + (off_t)done);
+        } while (n < 0 && errno == EINTR);
+        if (n < 0)
+            return errno;
+        if (n == 0)
+            return EIO; /* файл лидера оказался короче, чем он записал */
+
+        size_t written = 0;
+        while (written < (size_t)n) {
+            ssize_t w;
+            do {
+                w = pwrite(t->dst_fd, buf + written, (size_t)n - written,
+                           t->dst_offset + (off_t)(done + written));
+            } while (w < 0 && errno == EINTR);
+            if (w < 0)
+                return errno;
+            written += (size_t)w;
+        }
+        done += (size_t)n;
+    }
+    return 0;
+}
+
+static ssize_t
+s3_sf_copy_worker(va_list ap)
+{
+    struct s3_sf_copy_task *t = va_arg(ap, struct s3_sf_copy_task *);
+    size_t done = 0;
+
+    /*
+     * copy_file_range копирует внутри ядра, а на XFS/btrfs делает reflink,
+     * то есть N последователей не умножают дисковый I/O.
+     */
+    while (done < t->len) {
+        loff_t src_off = (loff_t)(t->src_offset + (off_t)done);
+        loff_t dst_off = (loff_t)(t->dst_offset + (off_t)done);
+
+        ssize_t n = copy_file_range(t->src_fd, &src_off,
+                                    t->dst_fd, &dst_off,
+                                    t->len - done, 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EXDEV || errno == EINVAL || errno == ENOSYS ||
+                errno == EOPNOTSUPP || errno == EBADF)
+            {
+                t->os_error = s3_sf_copy_rw(t, done);
+                return 0;
+            }
+            t->os_error = errno;
+            return 0;
+        }
+        if (n == 0) {
+            t->os_error = EIO;
+            return 0;
+        }
+        done += (size_t)n;
+    }
+
+    t->os_error = 0;
+    return 0;
+}
+
+/* ----------------- лидер / последователь ----------------- */
+
+/* Последователи копируют из fd лидера — он должен читаться. */
+static bool
+s3_sf_fd_readable(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+    return flags >= 0 && (flags & O_ACCMODE) != O_WRONLY;
+}
+
+static void
+s3_sf_follower_leave(struct s3_sf_call *call)
+{
+    if (--call->followers == 0 && call->done)
+        fiber_cond_broadcast(call->cond);
+}
+
+static s3_error_code_t
+s3_sf_follow(s3_client_t *client, struct s3_sf_call *call,
+             const s3_get_opts_t *opts,
+             int fd, off_t offset, size_t max_size,
+             size_t *bytes_written, s3_error_t *err)
+{
+    call->followers++;
+
+    while (!call->done) {
+        if (fiber_cond_wait(call->cond) != 0 && fiber_is_cancelled()) {
+            s3_sf_follower_leave(call);
+            s3_error_set(err, S3_E_CANCELLED,
+                         "fiber is cancelled while waiting for coalesced GET",
+                         0, 0, 0);
+            return err->code;
+        }
+    }
+
+    if (call->code != S3_E_OK) {
+        *err = call->err;
+        s3_sf_follower_leave(call);
+        return err->code;
+    }
+
+    struct s3_sf_copy_task task;
+    memset(&task, 0, sizeof(task));
+    task.src_fd = call->fd;
+    task.src_offset = call->offset;
+    task.dst_fd = fd;
+    task.dst_offset = offset;
+    task.len = call->bytes;
+
+    if (task.len > 0)
+        coio_call(s3_sf_copy_worker, &task);
+
+    /* fd лидера всё же не читается (dup с другим режимом и т.п.). */
+    if (task.os_error == EBADF) {
+        s3_sf_follower_leave(call);
+        return s3_client_get_fd_direct(client, opts, fd, offset, max_size,
+                                       bytes_written, err);
+    }
+
+    if (task.os_error != 0) {
+        s3_error_set(err, S3_E_IO,
+                     "failed to copy coalesced GET result",
+                     task.os_error, 0, 0);
+        s3_sf_follower_leave(call);
+        return err->code;
+    }
+
+    *err = call->err;
+    if (bytes_written != NULL)
+        *bytes_written = call->bytes;
+
+    s3_sf_follower_leave(call);
+    return S3_E_OK;
+}
+
+static s3_error_code_t
+s3_sf_lead(s3_client_t *client, const char *bucket,
+           const s3_get_opts_t *opts,
+           int fd, off_t offset, size_t max_size,
+           size_t *bytes_written, s3_error_t *err)
+{
+    struct s3_sf_call call;
+    memset(&call, 0, sizeof(call));
+
+    call.cond = fiber_cond_new();
+    if (call.cond == NULL) {
+        /* Без cond склеивать не можем — просто выполняем запрос. */
+        return s3_client_get_fd_direct(client, opts, fd, offset, max_size,
+                                       bytes_written, err);
+    }
+
+    call.bucket = bucket;
+    call.key = opts->key;
+    call.range = opts->range;
+    call.if_match = opts->if_match;
+    call.max_size = max_size;
+    call.fd = fd;
+    call.offset = offset;
+    s3_error_clear(&call.err);
+
+    rlist_add_tail(&client->sf_calls, &call.link);
+
+    call.code = s3_client_get_fd_direct(client, opts, fd, offset, max_size,
+                                        &call.bytes, &call.err);
+
+    /* Новые вызовы с этим ключом пойдут уже отдельным запросом. */
+    rlist_del(&call.link);
+    call.done = true;
+    fiber_cond_broadcast(call.cond);
+
+    /* Последователи читают из нашего fd — ждём, пока все скопируют. */
+    while (call.followers > 0)
+        fiber_cond_wait(call.cond);
+
+    fiber_cond_delete(call.cond);
+
+    *err = call.err;
+    if (bytes_written != NULL)
+        *bytes_written = call.bytes;
+    return call.code;
+}
+
+s3_error_code_t
+s3_singleflight_get_fd(s3_client_t *client,
+                       const s3_get_opts_t *opts,
+                       int fd, off_t offset, size_t max_size,
+                       size_t *bytes_written,
+                       s3_error_t *err)
+{
+    const char *bucket = opts->bucket ? opts->bucket : client->default_bucket;
+
+    if (opts->key == NULL || fd < 0) {
+        /* Ошибку аргументов вернёт сам backend. */
+        return s3_client_get_fd_direct(client, opts, fd, offset, max_size,
+                                       bytes_written, err);
+    }
+
+    struct s3_sf_call *call;
+    rlist_foreach_entry(call, &client->sf_calls, link) {
+        if (s3_sf_call_matches(call, bucket, opts, max_size))
+            return s3_sf_follow(client, call, opts, fd, offset, max_size,
+                                bytes_written, err);
+    }
+
+    /* Из O_WRONLY лидера копировать нечем — такой GET не склеиваем. */
+    if (!s3_sf_fd_readable(fd))
+        return s3_client_get_fd_direct(client, opts, fd, offset, max_size,
+                                       bytes_written, err);
+
+    return s3_sf_lead(client, bucket, opts, fd, offset, max_size,
+                      bytes_written, err);
+}
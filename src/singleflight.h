@@ -0,0 +1,26 @@
+#ifndef TARANTOOL_S3_SINGLEFLIGHT_H_INCLUDED
+#define TARANTOOL_S3_SINGLEFLIGHT_H_INCLUDED 1
+
+#include "s3_internal.h"
+
+/*
+ * Singleflight для GET (S3_CLIENT_F_COALESCE_GETS).
+ *
+ * Одновременные GET с одинаковым ключом (bucket, key, range, if_match,
+ * max_size) склеиваются: первый файбер ("лидер") выполняет запрос в свой
+ * fd, остальные ждут его на fiber_cond и затем копируют полученные байты
+ * из fd лидера в свой fd (copy_file_range, fallback — pread/pwrite).
+ *
+ * Лидер не возвращает управление, пока все последователи не скопируют
+ * данные: его fd должен оставаться открытым.
+ *
+ * Вызывается только из файберов tx-треда.
+ */
+s3_error_code_t
+s3_singleflight_get_fd(s3_client_t *client,
+                       const s3_get_opts_t *opts,
+                       int fd, off_t offset, size_t max_size,
+                       size_t *bytes_written,
+                       s3_error_t *err);
+
+#endif /* TARANTOOL_S3_SINGLEFLIGHT_H_INCLUDED */
@@ -0,0 +1,989 @@
+#define _GNU_SOURCE /* timegm */
+#include "s3_internal.h"
+#include "multipart.h"
+#include "s3/curl_easy_factory.h"
+#include "error.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <tarantool/module.h>
+
+#define S3_SYNC_DEFAULT_PART_SIZE   (16u * 1024 * 1024)
+#define S3_SYNC_DEFAULT_CONCURRENCY 8
+#define S3_SYNC_MAX_CONCURRENCY     64
+#define S3_SYNC_RETRIES             2
+#define S3_SYNC_DELETE_BATCH        1000 /* предел DeleteObjects */
+#define S3_SYNC_TMP_SUFFIX          ".s3tmp"
+
+struct s3_sync_entry {
+    char *name;
+    size_t len;
+    bool dir;
+    uint64_t size;
+    int64_t mtime;
+};
+
+/* Открытый уровень обхода local_dir. */
+struct s3_sync_level {
+    char *rel;          /* путь от local_dir с '/' в конце, "" у корня */
+    struct s3_sync_entry *ents;
+    size_t count;
+    size_t pos;
+};
+
+/* Файл больше part_size: multipart, части идут в общих пачках. */
+struct s3_sync_big {
+    struct s3_sync_big *next;
+    char *key;
+    char *path;
+    int fd;
+    uint64_t size;
+    uint32_t nparts;
+    uint32_t done;      /* частей загружено */
+    struct s3_mpu mpu;
+};
+
+/* Передача, ждущая своей пачки. */
+struct s3_sync_xfer {
+    char *key;
+    char *path;
+    char *tmp_path;     /* только download */
+    int fd;
+    uint64_t size;
+    int64_t mtime;      /* download: LastModified объекта */
+    char etag[S3_ETAG_MAX];
+
+    /* Часть part файла big; key/path/fd тогда у big. */
+    struct s3_sync_big *big;
+    uint32_t part;
+    s3_put_seg_t seg;
+};
+
+struct s3_sync_task {
+    s3_client_t *client;
+    s3_sync_opts_t opts;
+    const char *prefix;
+    size_t prefix_len;
+    bool upload;
+
+    /* локальная сторона: стек каталогов и текущий файл */
+    struct s3_sync_level *levels;
+    size_t depth;
+    size_t levels_cap;
+    char *rel;
+    size_t rel_cap;
+    struct s3_sync_entry *local;
+
+    /* удалённая сторона: текущая страница листинга */
+    s3_list_objects_result_t page;
+    size_t page_pos;
+    bool list_done;
+    s3_object_info_t *remote;
+
+    struct s3_sync_xfer *xfers;
+    s3_easy_handle_t **handles;
+    s3_error_code_t *codes;
+    s3_error_t *errs;
+    size_t nxfers;
+
+    s3_delete_object_t *dels;
+    size_t ndels;
+
+    struct s3_sync_big *bigs; /* начатые multipart'ы */
+
+    s3_sync_result_t result;
+    s3_error_t err;
+    s3_error_code_t code;
+};
+
+static s3_error_code_t
+s3_sync_nomem(struct s3_sync_task *t)
+{
+    s3_error_set(&t->err, S3_E_NOMEM, "Out of memory in sync", ENOMEM, 0, 0);
+    return t->err.code;
+}
+
+static s3_error_code_t
+s3_sync_io_error(struct s3_sync_task *t, const char *what, const char *path)
+{
+    char msg[256];
+    snprintf(msg, sizeof(msg), "%s %s", what, path);
+    s3_error_set(&t->err, S3_E_IO, msg, errno, 0, 0);
+    return t->err.code;
+}
+
+static char *
+s3_sync_join(struct s3_sync_task *t, const char *a, const char *b,
+             const char *c)
+{
+    size_t len = strlen(a) + strlen(b) + strlen(c) + 1;
+    char *s = s3_alloc(&t->client->alloc, len);
+    if (s != NULL)
+        snprintf(s, len, "%s%s%s", a, b, c);
+    return s;
+}
+
+static void
+s3_sync_free(struct s3_sync_task *t, void *p)
+{
+    if (p != NULL)
+        s3_free(&t->client->alloc, p);
+}
+
+/* mkdir -p для каталогов path, начиная с позиции from. */
+static int
+s3_sync_mkdirs(char *path, size_t from)
+{
+    for (char *p = path + from; (p = strchr(p, '/')) != NULL; p++) {
+        *p = '\0';
+        int rc = mkdir(path, 0755);
+        *p = '/';
+        if (rc != 0 && errno != EEXIST)
+            return -1;
+    }
+    return 0;
+}
+
+/* "2024-05-01T12:00:00.000Z" -> unix time, -1 если не разобрали. */
+static int64_t
+s3_sync_parse_time(const char *s)
+{
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    if (s == NULL || sscanf(s, "%d-%d-%dT%d:%d:%d", &tm.tm_year, &tm.tm_mon,
+                            &tm.tm_mday, &tm.tm_hour, &tm.tm_min,
+                            &tm.tm_sec) != 6)
+        return -1;
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    return (int64_t)timegm(&tm);
+}
+
+/* Ключ из листинга не должен выводить за пределы local_dir. */
+static bool
+s3_sync_name_ok(const char *name)
+{
+    if (name[0] == '\0' || name[0] == '/')
+        return false;
+    for (const char *p = name; *p != '\0'; ) {
+        size_t n = strcspn(p, "/");
+        if (n == 0 || (n == 1 && p[0] == '.') ||
+            (n == 2 && p[0] == '.' && p[1] == '.'))
+            return false;
+        p += n;
+        if (*p == '/')
+            p++;
+    }
+    return true;
+}
+
+/* ----------------- обход local_dir ----------------- */
+
+/* Символ i имени; каталог сравнивается как "name/". */
+static int
+s3_sync_entry_at(const struct s3_sync_entry *e, size_t i)
+{
+    if (i < e->len)
+        return (unsigned char)e->name[i];
+    return i == e->len && e->dir ? '/' : 0;
+}
+
+/* Порядок ключей S3: полный путь побайтно. */
+static int
+s3_sync_entry_cmp(const void *a, const void *b)
+{
+    const struct s3_sync_entry *x = a;
+    const struct s3_sync_entry *y = b;
+    for (size_t i = 0; ; i++) {
+        int cx = s3_sync_entry_at(x, i);
+        int cy = s3_sync_entry_at(y, i);
+        if (cx != cy || cx == 0)
+            return cx - cy;
+    }
+}
+
+static void
+s3_sync_level_free(struct s3_sync_task *t, struct s3_sync_level *l)
+{
+    for (size_t i = 0; i < l->count; i++)
+        s3_sync_free(t, l->ents[i].name);
+    s3_sync_free(t, l->ents);
+    s3_sync_free(t, l->rel);
+}
+
+/* Прочитать каталог rel целиком и положить на стек обхода. */
+static s3_error_code_t
+s3_sync_push_dir(struct s3_sync_task *t, const char *rel)
+{
+    s3_client_t *c = t->client;
+    struct s3_sync_level l;
+    memset(&l, 0, sizeof(l));
+    size_t cap = 0;
+
+    char *path = s3_sync_join(t, t->opts.local_dir, "/", rel);
+    l.rel = s3_sync_join(t, rel, "", "");
+    if (path == NULL || l.rel == NULL)
+        goto nomem;
+
+    DIR *d = opendir(path);
+    if (d == NULL) {
+        s3_sync_io_error(t, "cannot open directory", path);
+        goto fail;
+    }
+
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        const char *name = de->d_name;
+        size_t len = strlen(name);
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+            continue;
+        /* Недокачанные download'ом файлы. */
+        if (len > sizeof(S3_SYNC_TMP_SUFFIX) - 1 &&
+            strcmp(name + len - (sizeof(S3_SYNC_TMP_SUFFIX) - 1),
+                   S3_SYNC_TMP_SUFFIX) == 0)
+            continue;
+
+        struct stat st;
+        if (fstatat(dirfd(d), name, &st, 0) != 0)
+            continue;
+        if (!S_ISDIR(st.st_mode) && !S_ISREG(st.st_mode))
+            continue;
+
+        if (l.count == cap) {
+            size_t ncap = cap != 0 ? cap * 2 : 64;
+            void *p = s3_realloc(&c->alloc, l.ents, ncap * sizeof(*l.ents));
+            if (p == NULL) {
+                closedir(d);
+                goto nomem;
+            }
+            l.ents = p;
+            cap = ncap;
+        }
+        struct s3_sync_entry *e = &l.ents[l.count];
+        e->name = s3_sync_join(t, name, "", "");
+        if (e->name == NULL) {
+            closedir(d);
+            goto nomem;
+        }
+        e->len = len;
+        e->dir = S_ISDIR(st.st_mode);
+        e->size = (uint64_t)st.st_size;
+        e->mtime = (int64_t)st.st_mtim.tv_sec;
+        l.count++;
+    }
+    closedir(d);
+
+    if (l.count > 1)
+        qsort(l.ents, l.count, sizeof(*l.ents), s3_sync_entry_cmp);
+
+    if (t->depth == t->levels_cap) {
+        size_t ncap = t->levels_cap != 0 ? t->levels_cap * 2 : 8;
+        void *p = s3_realloc(&c->alloc, t->levels, ncap * sizeof(*t->levels));
+        if (p == NULL)
+            goto nomem;
+        t->levels = p;
+        t->levels_cap = ncap;
+    }
+    t->levels[t->depth++] = l;
+    s3_free(&c->alloc, path);
+    return S3_E_OK;
+
+nomem:
+    s3_sync_nomem(t);
+fail:
+    s3_sync_free(t, path);
+    s3_sync_level_free(t, &l);
+    return t->err.code;
+}
+
+/* Следующий файл обхода в t->local / t->rel, NULL в конце. */
+static s3_error_code_t
+s3_sync_local_next(struct s3_sync_task *t)
+{
+    t->local = NULL;
+    while (t->depth > 0) {
+        struct s3_sync_level *l = &t->levels[t->depth - 1];
+        if (l->pos == l->count) {
+            s3_sync_level_free(t, l);
+            t->depth--;
+            continue;
+        }
+        struct s3_sync_entry *e = &l->ents[l->pos++];
+
+        size_t rlen = strlen(l->rel);
+        size_t need = rlen + e->len + 2;
+        if (need > t->rel_cap) {
+            char *p = s3_realloc(&t->client->alloc, t->rel, need);
+            if (p == NULL)
+                return s3_sync_nomem(t);
+            t->rel = p;
+            t->rel_cap = need;
+        }
+        snprintf(t->rel, t->rel_cap, "%s%s%s", l->rel, e->name,
+                 e->dir ? "/" : "");
+
+        if (e->dir) {
+            s3_error_code_t code = s3_sync_push_dir(t, t->rel);
+            if (code != S3_E_OK)
+                return code;
+            continue;
+        }
+        t->local = e;
+        return S3_E_OK;
+    }
+    return S3_E_OK;
+}
+
+/* ----------------- листинг prefix'а ----------------- */
+
+/* Следующий объект листинга в t->remote, NULL в конце. */
+static s3_error_code_t
+s3_sync_remote_next(struct s3_sync_task *t)
+{
+    struct s3_http_backend_impl *b = t->client->backend;
+
+    t->remote = NULL;
+    for (;;) {
+        while (t->page_pos < t->page.count) {
+            s3_object_info_t *o = &t->page.objects[t->page_pos++];
+            if (o->key == NULL ||
+                strncmp(o->key, t->prefix, t->prefix_len) != 0)
+                continue;
+            const char *rel = o->key + t->prefix_len;
+            size_t len = strlen(rel);
+            if (len == 0 || rel[len - 1] == '/')
+                continue;
+            if (!t->upload && !s3_sync_name_ok(rel))
+                continue;
+            t->remote = o;
+            return S3_E_OK;
+        }
+        if (t->list_done)
+            return S3_E_OK;
+
+        /* Следующая страница — только когда слияние дошло до конца этой. */
+        char *token = t->page.next_continuation_token;
+        t->page.next_continuation_token = NULL;
+        s3_list_objects_result_destroy(t->client, &t->page);
+
+        s3_list_objects_opts_t lopts;
+        memset(&lopts, 0, sizeof(lopts));
+        lopts.bucket = t->opts.bucket;
+        lopts.prefix = t->prefix_len > 0 ? t->prefix : NULL;
+        lopts.continuation_token = token;
+
+        s3_error_code_t code = b->vtbl->list_objects(b, &lopts, &t->page,
+                                                     &t->err);
+        s3_sync_free(t, token);
+        if (code != S3_E_OK)
+            return code;
+        t->page_pos = 0;
+        t->list_done = !t->page.is_truncated ||
+                       t->page.next_continuation_token == NULL;
+    }
+}
+
+/* ----------------- передачи ----------------- */
+
+static void
+s3_sync_xfer_drop(struct s3_sync_task *t, size_t i)
+{
+    struct s3_sync_xfer *x = &t->xfers[i];
+    if (t->handles[i] != NULL)
+        s3_easy_handle_destroy(t->handles[i]);
+    t->handles[i] = NULL;
+    if (x->fd >= 0)
+        close(x->fd);
+    if (x->tmp_path != NULL)
+        unlink(x->tmp_path);
+    s3_sync_free(t, x->tmp_path);
+    s3_sync_free(t, x->path);
+    s3_sync_free(t, x->key);
+    memset(x, 0, sizeof(*x));
+    x->fd = -1;
+}
+
+static void
+s3_sync_big_free(struct s3_sync_task *t, struct s3_sync_big *big, bool abort)
+{
+    struct s3_sync_big **pp = &t->bigs;
+    while (*pp != big)
+        pp = &(*pp)->next;
+    *pp = big->next;
+
+    if (abort)
+        s3_mpu_abort(&big->mpu);
+    s3_mpu_destroy(&big->mpu);
+    if (big->fd >= 0)
+        close(big->fd);
+    s3_sync_free(t, big->path);
+    s3_sync_free(t, big->key);
+    s3_free(&t->client->alloc, big);
+}
+
+/* Часть загружена; последняя — CompleteMultipartUpload. */
+static s3_error_code_t
+s3_sync_big_part_done(struct s3_sync_task *t, struct s3_sync_xfer *x,
+                      s3_easy_handle_t *h)
+{
+    struct s3_sync_big *big = x->big;
+    s3_error_code_t code = s3_mpu_part_done(&big->mpu, x->part, h, &t->err);
+    if (code != S3_E_OK || ++big->done < big->nparts)
+        return code;
+
+    if ((code = s3_mpu_complete(&big->mpu, &t->err)) != S3_E_OK)
+        return code;
+    t->result.transferred++;
+    t->result.bytes += big->size;
+    s3_sync_big_free(t, big, false);
+    return S3_E_OK;
+}
+
+/* Скачанный файл: mtime объекта, fsync, rename на место. */
+static s3_error_code_t
+s3_sync_download_done(struct s3_sync_task *t, struct s3_sync_xfer *x)
+{
+    struct timespec ts[2] = {
+        { (time_t)x->mtime, 0 },
+        { (time_t)x->mtime, 0 },
+    };
+    if (x->mtime >= 0 && futimens(x->fd, ts) != 0)
+        return s3_sync_io_error(t, "cannot set mtime of", x->tmp_path);
+    if (fsync(x->fd) != 0)
+        return s3_sync_io_error(t, "fsync failed for", x->tmp_path);
+    close(x->fd);
+    x->fd = -1;
+    if (rename(x->tmp_path, x->path) != 0)
+        return s3_sync_io_error(t, "cannot rename", x->tmp_path);
+    s3_free(&t->client->alloc, x->tmp_path);
+    x->tmp_path = NULL;
+    return S3_E_OK;
+}
+
+/*
+ * Выполнить накопленную пачку, упавшие повторить по одной.
+ * Пачка очищается в любом случае.
+ */
+static s3_error_code_t
+s3_sync_flush(struct s3_sync_task *t)
+{
+    struct s3_http_backend_impl *b = t->client->backend;
+    size_t n = t->nxfers;
+    if (n == 0)
+        return S3_E_OK;
+
+    s3_error_t batch_err = S3_ERROR_INIT;
+    s3_error_code_t rc = b->vtbl->perform_many(b, t->handles, n, t->codes,
+                                               t->errs, &batch_err);
+    s3_error_code_t code = S3_E_OK;
+
+    for (size_t i = 0; i < n; i++) {
+        struct s3_sync_xfer *x = &t->xfers[i];
+        if (rc != S3_E_OK && t->codes[i] == S3_E_INTERNAL) {
+            t->codes[i] = rc;
+            t->errs[i] = batch_err;
+        }
+        for (int a = 0; a < S3_SYNC_RETRIES && t->codes[i] != S3_E_OK &&
+             t->codes[i] != S3_E_ACCESS_DENIED && t->codes[i] != S3_E_AUTH &&
+             t->codes[i] != S3_E_NOT_FOUND &&
+             t->codes[i] != S3_E_INVALID_ARG; a++)
+        {
+            if (s3_easy_handle_rewind(t->handles[i]) != 0)
+                break;
+            t->codes[i] = b->vtbl->perform(b, t->handles[i], &t->errs[i]);
+        }
+
+        if (code != S3_E_OK)
+            continue;
+        if (t->codes[i] != S3_E_OK) {
+            code = t->codes[i];
+            t->err = t->errs[i];
+            continue;
+        }
+        if (x->big != NULL) {
+            code = s3_sync_big_part_done(t, x, t->handles[i]);
+            continue;
+        }
+        if (!t->upload) {
+            if (t->handles[i]->write_bytes_total != x->size) {
+                s3_error_set(&t->err, S3_E_IO, "short download in sync",
+                             0, 0, 0);
+                code = t->err.code;
+                continue;
+            }
+            if ((code = s3_sync_download_done(t, x)) != S3_E_OK)
+                continue;
+        }
+        t->result.transferred++;
+        t->result.bytes += x->size;
+    }
+
+    for (size_t i = 0; i < n; i++)
+        s3_sync_xfer_drop(t, i);
+    t->nxfers = 0;
+    return code;
+}
+
+/*
+ * Большой файл: начать multipart и поставить его части в пачки наравне
+ * с мелкими файлами — слияние не ждёт, пока он загрузится целиком.
+ */
+static s3_error_code_t
+s3_sync_queue_big(struct s3_sync_task *t)
+{
+    const struct s3_sync_entry *e = t->local;
+    size_t part_size = t->opts.part_size;
+    uint64_t nparts = (e->size + part_size - 1) / part_size;
+    if (nparts > S3_MPU_MAX_PARTS) {
+        s3_error_set(&t->err, S3_E_INVALID_ARG,
+                     "file exceeds 10000 parts, increase part_size",
+                     0, 0, 0);
+        return t->err.code;
+    }
+
+    struct s3_sync_big *big = s3_alloc(&t->client->alloc, sizeof(*big));
+    if (big == NULL)
+        return s3_sync_nomem(t);
+    memset(big, 0, sizeof(*big));
+    big->fd = -1;
+    big->next = t->bigs;
+    t->bigs = big;
+
+    big->size = e->size;
+    big->nparts = (uint32_t)nparts;
+    big->key = s3_sync_join(t, t->prefix, t->rel, "");
+    big->path = s3_sync_join(t, t->opts.local_dir, "/", t->rel);
+    if (big->key == NULL || big->path == NULL)
+        return s3_sync_nomem(t);
+
+    big->fd = open(big->path, O_RDONLY | O_CLOEXEC);
+    if (big->fd < 0)
+        return s3_sync_io_error(t, "cannot open", big->path);
+
+    s3_put_opts_t popts;
+    memset(&popts, 0, sizeof(popts));
+    popts.bucket = t->opts.bucket;
+    popts.key = big->key;
+    s3_error_code_t code = s3_mpu_begin(&big->mpu, t->client, &popts,
+                                        &t->err);
+
+    /* Последняя часть может завершить и освободить big внутри flush. */
+    for (uint32_t p = 1; p <= nparts && code == S3_E_OK; p++) {
+        size_t i = t->nxfers++;
+        struct s3_sync_xfer *x = &t->xfers[i];
+        uint64_t off = (uint64_t)(p - 1) * part_size;
+
+        x->big = big;
+        x->part = p;
+        x->seg.fd = big->fd;
+        x->seg.offset = (off_t)off;
+        x->seg.len = e->size - off < part_size ? (size_t)(e->size - off)
+                                               : part_size;
+        code = s3_mpu_part_handle_iov(&big->mpu, p, &x->seg, 1,
+                                      &t->handles[i], &t->err);
+        if (code == S3_E_OK && t->nxfers == t->opts.concurrency)
+            code = s3_sync_flush(t);
+    }
+    return code;
+}
+
+static s3_error_code_t
+s3_sync_queue_upload(struct s3_sync_task *t)
+{
+    const struct s3_sync_entry *e = t->local;
+    if (e->size > t->opts.part_size)
+        return s3_sync_queue_big(t);
+
+    size_t i = t->nxfers++;
+    struct s3_sync_xfer *x = &t->xfers[i];
+
+    x->size = e->size;
+    x->key = s3_sync_join(t, t->prefix, t->rel, "");
+    x->path = s3_sync_join(t, t->opts.local_dir, "/", t->rel);
+    if (x->key == NULL || x->path == NULL)
+        return s3_sync_nomem(t);
+
+    x->fd = open(x->path, O_RDONLY | O_CLOEXEC);
+    if (x->fd < 0)
+        return s3_sync_io_error(t, "cannot open", x->path);
+
+    s3_put_opts_t popts;
+    memset(&popts, 0, sizeof(popts));
+    popts.bucket = t->opts.bucket;
+    popts.key = x->key;
+
+    /* put_fd не умеет пустое тело. */
+    s3_error_code_t code;
+    if (x->size == 0)
+        code = s3_easy_factory_new_put_buf(t->client, &popts, NULL, 0,
+                                           &t->handles[i], &t->err);
+    else
+        code = s3_easy_factory_new_put_fd(t->client, &popts, x->fd, 0,
+                                          (size_t)x->size, &t->handles[i],
+                                          &t->err);
+    if (code != S3_E_OK)
+        return code;
+
+    return t->nxfers == t->opts.concurrency ? s3_sync_flush(t) : S3_E_OK;
+}
+
+static s3_error_code_t
+s3_sync_queue_download(struct s3_sync_task *t)
+{
+    const s3_object_info_t *o = t->remote;
+    const char *rel = o->key + t->prefix_len;
+    size_t i = t->nxfers++;
+    struct s3_sync_xfer *x = &t->xfers[i];
+
+    x->size = o->size;
+    x->mtime = s3_sync_parse_time(o->last_modified);
+    x->key = s3_sync_join(t, o->key, "", "");
+    x->path = s3_sync_join(t, t->opts.local_dir, "/", rel);
+    if (x->key == NULL || x->path == NULL)
+        return s3_sync_nomem(t);
+    x->tmp_path = s3_sync_join(t, x->path, S3_SYNC_TMP_SUFFIX, "");
+    if (x->tmp_path == NULL)
+        return s3_sync_nomem(t);
+
+    if (s3_sync_mkdirs(x->tmp_path, strlen(t->opts.local_dir) + 1) != 0)
+        return s3_sync_io_error(t, "cannot create directory for", x->path);
+    x->fd = open(x->tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (x->fd < 0)
+        return s3_sync_io_error(t, "cannot create", x->tmp_path);
+
+    /* Пустой объект качать незачем. */
+    if (x->size == 0) {
+        s3_error_code_t code = s3_sync_download_done(t, x);
+        if (code == S3_E_OK)
+            t->result.transferred++;
+        s3_sync_xfer_drop(t, i);
+        t->nxfers--;
+        return code;
+    }
+
+    /* Объект не должен поменяться между листингом и GET'ом. */
+    if (o->etag != NULL)
+        snprintf(x->etag, sizeof(x->etag), "\"%s\"", o->etag);
+
+    s3_get_opts_t gopts;
+    memset(&gopts, 0, sizeof(gopts));
+    gopts.bucket = t->opts.bucket;
+    gopts.key = x->key;
+    gopts.if_match = x->etag[0] != '\0' ? x->etag : NULL;
+
+    s3_error_code_t code = s3_easy_factory_new_get_fd(t->client, &gopts,
+                                                      x->fd, 0,
+                                                      (size_t)x->size,
+                                                      &t->handles[i],
+                                                      &t->err);
+    if (code != S3_E_OK)
+        return code;
+
+    return t->nxfers == t->opts.concurrency ? s3_sync_flush(t) : S3_E_OK;
+}
+
+static s3_error_code_t
+s3_sync_flush_deletes(struct s3_sync_task *t)
+{
+    struct s3_http_backend_impl *b = t->client->backend;
+    if (t->ndels == 0)
+        return S3_E_OK;
+
+    s3_delete_objects_opts_t dopts;
+    memset(&dopts, 0, sizeof(dopts));
+    dopts.bucket = t->opts.bucket;
+    dopts.objects = t->dels;
+    dopts.count = t->ndels;
+
+    s3_error_code_t code = b->vtbl->delete_objects(b, &dopts, &t->err);
+    if (code == S3_E_OK)
+        t->result.deleted += t->ndels;
+
+    for (size_t i = 0; i < t->ndels; i++)
+        s3_sync_free(t, (char *)t->dels[i].key);
+    t->ndels = 0;
+    return code;
+}
+
+static s3_error_code_t
+s3_sync_queue_delete(struct s3_sync_task *t, const char *key)
+{
+    if (t->dels == NULL) {
+        t->dels = s3_alloc(&t->client->alloc,
+                           S3_SYNC_DELETE_BATCH * sizeof(*t->dels));
+        if (t->dels == NULL)
+            return s3_sync_nomem(t);
+    }
+    memset(&t->dels[t->ndels], 0, sizeof(t->dels[t->ndels]));
+    t->dels[t->ndels].key = s3_sync_join(t, key, "", "");
+    if (t->dels[t->ndels].key == NULL)
+        return s3_sync_nomem(t);
+    t->ndels++;
+    return t->ndels == S3_SYNC_DELETE_BATCH ? s3_sync_flush_deletes(t)
+                                            : S3_E_OK;
+}
+
+/* ----------------- слияние ----------------- */
+
+/* Есть с обеих сторон: нужно ли передавать. */
+static s3_error_code_t
+s3_sync_changed(struct s3_sync_task *t, bool *changed)
+{
+    const struct s3_sync_entry *l = t->local;
+    const s3_object_info_t *r = t->remote;
+
+    *changed = true;
+    if (l->size != r->size)
+        return S3_E_OK;
+
+    if (!(t->opts.flags & S3_SYNC_F_CHECKSUM)) {
+        int64_t rt = s3_sync_parse_time(r->last_modified);
+        if (rt >= 0)
+            *changed = t->upload ? l->mtime > rt : l->mtime != rt;
+        return S3_E_OK;
+    }
+
+    if (r->etag == NULL)
+        return S3_E_OK;
+
+    char *path = s3_sync_join(t, t->opts.local_dir, "/", t->rel);
+    if (path == NULL)
+        return s3_sync_nomem(t);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        s3_sync_io_error(t, "cannot open", path);
+        s3_free(&t->client->alloc, path);
+        return t->err.code;
+    }
+
+    /* В листинге ETag без кавычек. */
+    char local[S3_ETAG_MAX];
+    int rc = s3_local_etag(fd, l->size, t->opts.part_size,
+                           strchr(r->etag, '-') != NULL, local,
+                           sizeof(local));
+    close(fd);
+    if (rc != 0) {
+        s3_sync_io_error(t, "cannot read", path);
+        s3_free(&t->client->alloc, path);
+        return t->err.code;
+    }
+    s3_free(&t->client->alloc, path);
+
+    size_t len = strlen(r->etag);
+    *changed = strlen(local) != len + 2 ||
+               strncmp(local + 1, r->etag, len) != 0;
+    return S3_E_OK;
+}
+
+static s3_error_code_t
+s3_sync_local_only(struct s3_sync_task *t)
+{
+    if (t->upload)
+        return s3_sync_queue_upload(t);
+    if (!(t->opts.flags & S3_SYNC_F_DELETE))
+        return S3_E_OK;
+
+    char *path = s3_sync_join(t, t->opts.local_dir, "/", t->rel);
+    if (path == NULL)
+        return s3_sync_nomem(t);
+    s3_error_code_t code = S3_E_OK;
+    if (unlink(path) != 0 && errno != ENOENT)
+        code = s3_sync_io_error(t, "cannot remove", path);
+    else
+        t->result.deleted++;
+    s3_free(&t->client->alloc, path);
+    return code;
+}
+
+static s3_error_code_t
+s3_sync_remote_only(struct s3_sync_task *t)
+{
+    if (!t->upload)
+        return s3_sync_queue_download(t);
+    if (!(t->opts.flags & S3_SYNC_F_DELETE))
+        return S3_E_OK;
+    return s3_sync_queue_delete(t, t->remote->key);
+}
+
+static s3_error_code_t
+s3_sync_merge(struct s3_sync_task *t)
+{
+    s3_error_code_t code;
+
+    if (!t->upload) {
+        /* local_dir может ещё не быть. */
+        char *dir = s3_sync_join(t, t->opts.local_dir, "/", "");
+        if (dir == NULL)
+            return s3_sync_nomem(t);
+        int rc = s3_sync_mkdirs(dir, 1);
+        s3_free(&t->client->alloc, dir);
+        if (rc != 0)
+            return s3_sync_io_error(t, "cannot create", t->opts.local_dir);
+    }
+
+    if ((code = s3_sync_push_dir(t, "")) != S3_E_OK ||
+        (code = s3_sync_local_next(t)) != S3_E_OK ||
+        (code = s3_sync_remote_next(t)) != S3_E_OK)
+        return code;
+
+    while (t->local != NULL || t->remote != NULL) {
+        int cmp;
+        if (t->local == NULL)
+            cmp = 1;
+        else if (t->remote == NULL)
+            cmp = -1;
+        else
+            cmp = strcmp(t->rel, t->remote->key + t->prefix_len);
+
+        t->result.scanned++;
+        if (cmp < 0) {
+            if ((code = s3_sync_local_only(t)) != S3_E_OK ||
+                (code = s3_sync_local_next(t)) != S3_E_OK)
+                return code;
+        } else if (cmp > 0) {
+            if ((code = s3_sync_remote_only(t)) != S3_E_OK ||
+                (code = s3_sync_remote_next(t)) != S3_E_OK)
+                return code;
+        } else {
+            bool changed = false;
+            if ((code = s3_sync_changed(t, &changed)) != S3_E_OK)
+                return code;
+            if (changed) {
+                code = t->upload ? s3_sync_queue_upload(t)
+                                 : s3_sync_queue_download(t);
+                if (code != S3_E_OK)
+                    return code;
+            }
+            if ((code = s3_sync_local_next(t)) != S3_E_OK ||
+                (code = s3_sync_remote_next(t)) != S3_E_OK)
+                return code;
+        }
+    }
+
+    if ((code = s3_sync_flush(t)) != S3_E_OK)
+        return code;
+    return s3_sync_flush_deletes(t);
+}
+
+static double
+s3_sync_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static ssize_t
+s3_client_sync_worker(va_list ap)
+{
+    struct s3_sync_task *t = va_arg(ap, struct s3_sync_task *);
+    s3_client_t *c = t->client;
+    uint32_t conc = t->opts.concurrency;
+    double start = s3_sync_now();
+
+    t->xfers = s3_alloc(&c->alloc, conc * sizeof(*t->xfers));
+    t->handles = s3_alloc(&c->alloc, conc * sizeof(*t->handles));
+    t->codes = s3_alloc(&c->alloc, conc * sizeof(*t->codes));
+    t->errs = s3_alloc(&c->alloc, conc * sizeof(*t->errs));
+    if (t->xfers == NULL || t->handles == NULL || t->codes == NULL ||
+        t->errs == NULL)
+    {
+        t->code = s3_sync_nomem(t);
+        goto out;
+    }
+    memset(t->xfers, 0, conc * sizeof(*t->xfers));
+    memset(t->handles, 0, conc * sizeof(*t->handles));
+    for (uint32_t i = 0; i < conc; i++)
+        t->xfers[i].fd = -1;
+
+    t->code = s3_sync_merge(t);
+
+out:
+    if (t->xfers != NULL) {
+        for (size_t i = 0; i < t->nxfers; i++)
+            s3_sync_xfer_drop(t, i);
+    }
+    for (size_t i = 0; i < t->ndels; i++)
+        s3_sync_free(t, (char *)t->dels[i].key);
+    while (t->bigs != NULL)
+        s3_sync_big_free(t, t->bigs, true);
+    while (t->depth > 0)
+        s3_sync_level_free(t, &t->levels[--t->depth]);
+    s3_list_objects_result_destroy(c, &t->page);
+    s3_sync_free(t, t->dels);
+    s3_sync_free(t, t->levels);
+    s3_sync_free(t, t->rel);
+    s3_sync_free(t, t->errs);
+    s3_sync_free(t, t->codes);
+    s3_sync_free(t, t->handles);
+    s3_sync_free(t, t->xfers);
+
+    t->result.elapsed = s3_sync_now() - start;
+    return 0;
+}
+
+s3_error_code_t
+s3_client_sync(s3_client_t *client,
+               const s3_sync_opts_t *opts,
+               s3_sync_result_t *result,
+               s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (client == NULL || opts == NULL || opts->local_dir == NULL ||
+        opts->local_dir[0] == '\0' ||
+        (opts->direction != S3_SYNC_UPLOAD &&
+         opts->direction != S3_SYNC_DOWNLOAD))
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts, local_dir or direction is invalid "
+                     "in sync", 0, 0, 0);
+        if (client != NULL)
+            s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    struct s3_sync_task task;
+    memset(&task, 0, sizeof(task));
+    task.client = client;
+    task.opts = *opts;
+    task.prefix = opts->prefix != NULL ? opts->prefix : "";
+    task.prefix_len = strlen(task.prefix);
+    task.upload = opts->direction == S3_SYNC_UPLOAD;
+    if (task.opts.part_size == 0)
+        task.opts.part_size = S3_SYNC_DEFAULT_PART_SIZE;
+    if (task.opts.concurrency == 0)
+        task.opts.concurrency = S3_SYNC_DEFAULT_CONCURRENCY;
+
+    if (task.opts.part_size < S3_MPU_MIN_PART_SIZE ||
+        task.opts.concurrency > S3_SYNC_MAX_CONCURRENCY)
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "part_size must be >= 5 MiB and concurrency <= 64 "
+                     "in sync", 0, 0, 0);
+        s3_client_set_error(client, err);
+        return err->code;
+    }
+
+    s3_error_clear(&task.err);
+    task.code = S3_E_OK;
+
+    coio_call(s3_client_sync_worker, &task);
+
+    if (result != NULL)
+        *result = task.result;
+
+    *err = task.err;
+    s3_client_set_error(client, &task.err);
+    return task.code;
+}
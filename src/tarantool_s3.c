@@ -1,4 +1,7 @@
 #include "s3/client.h"
+#include "s3/pack.h"
+#include "s3/reader.h"
+#include "s3/writer.h"
 #include "error.h"
 
 #include <lua.h>
@@ -8,13 +11,63 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
+#include <tarantool/module.h>
+
 /* Имя метатабы для клиента. */
 #define S3_LUA_CLIENT_MT "s3_client_mt"
+/* Имя метатабы для pack reader'а. */
+#define S3_LUA_PACK_MT "s3_pack_mt"
+/* Имя метатабы для reader'а объекта. */
+#define S3_LUA_READER_MT "s3_reader_mt"
+/* Имя метатабы для writer'а объекта. */
+#define S3_LUA_WRITER_MT "s3_writer_mt"
+/* Имя метатабы для очереди загрузок. */
+#define S3_LUA_QUEUE_MT "s3_queue_mt"
 
 struct l_s3_client {
     s3_client_t *client;
 };
 
+struct l_s3_pack {
+    s3_pack_reader_t *reader;
+    int client_ref; /* ссылка на userdata клиента в registry */
+};
+
+struct l_s3_reader {
+    s3_reader_t *reader;
+    int client_ref;
+};
+
+struct l_s3_writer {
+    s3_writer_t *writer;
+    int client_ref;
+};
+
+struct l_s3_queue {
+    struct l_s3_client *lc;
+    int client_ref;
+    int api_ref;        /* функции над спейсом, см. l_s3_queue_lua */
+    int thread_ref;
+    int self_ref;       /* держит userdata, пока работает файбер */
+    lua_State *L;       /* Lua-поток файбера */
+    struct fiber *fiber;
+    struct fiber_cond *cond;
+    uint32_t concurrency;
+    uint32_t max_attempts;
+    bool stopping;
+    uint64_t uploaded;
+    uint64_t failed;    /* неудачных попыток */
+    uint64_t dropped;
+    char *space;
+    struct l_s3_queue *next; /* в l_s3_queues */
+};
+
+/* Открытые очереди: на спейс — одна, client:close() закрывает свои. */
+static struct l_s3_queue *l_s3_queues;
+
+static void
+l_s3_queue_stop(lua_State *L, struct l_s3_queue *q);
+
 /* ---------- утилиты для ошибок ---------- */
 
 static void
@@ -62,9 +115,13 @@ l_s3_parse_backend(lua_State *L, int idx, s3_http_backend_t *out)
     } else if (strcmp(s, "multi") == 0) {
         *out = S3_HTTP_BACKEND_CURL_MULTI;
         return 0;
+    } else if (strcmp(s, "native") == 0) {
+        *out = S3_HTTP_BACKEND_NATIVE;
+        return 0;
     }
 
-    luaL_error(L, "invalid backend '%s', expected 'easy' or 'multi'", s);
+    luaL_error(L, "invalid backend '%s', expected 'easy', 'multi' "
+               "or 'native'", s);
 }
 
 /* ---------- методы клиента ---------- */
@@ -79,25 +136,50 @@ l_s3_check_client(lua_State *L, int idx)
     return c;
 }
 
-/* client:close() */
+static void
+l_s3_client_release(struct l_s3_client *c)
+{
+    if (c->client != NULL) {
+        s3_client_delete(c->client);
+        c->client = NULL;
+    }
+}
+
+/* client:close(): сначала останавливает свои очереди. */
 static int
 l_s3_client_close(lua_State *L)
 {
     struct l_s3_client *c =
         (struct l_s3_client *)luaL_checkudata(L, 1, S3_LUA_CLIENT_MT);
 
-    if (c->client != NULL) {
-        s3_client_delete(c->client);
-        c->client = NULL;
+    struct l_s3_queue *q = l_s3_queues;
+    while (q != NULL) {
+        if (q->lc != c) {
+            q = q->next;
+            continue;
+        }
+        /*
+         * Останов ждёт файбер и убирает q из списка — с начала. Если
+         * её уже останавливает другой файбер, ждём, пока он закончит.
+         */
+        if (q->fiber != NULL)
+            l_s3_queue_stop(L, q);
+        else
+            fiber_sleep(0.01);
+        q = l_s3_queues;
     }
+    l_s3_client_release(c);
     return 0;
 }
 
-/* __gc */
+/* __gc: открытая очередь держит клиента, так что их уже нет. */
 static int
 l_s3_client_gc(lua_State *L)
 {
-    return l_s3_client_close(L);
+    struct l_s3_client *c =
+        (struct l_s3_client *)luaL_checkudata(L, 1, S3_LUA_CLIENT_MT);
+    l_s3_client_release(c);
+    return 0;
 }
 
 /*
@@ -148,9 +230,14 @@ l_s3_client_put_fd(lua_State *L)
 }
 
 /*
- * client:get_fd(fd, bucket, key, offset, max_size) -> bytes_written | nil, err
+ * client:get_fd(fd, bucket, key, offset, max_size[, opts]) -> bytes_written | nil, err
  *
  * max_size может быть nil (или 0) → без ограничения.
+ *
+ * opts (опционально):
+ *   range    — HTTP Range, например "bytes=0-1023";
+ *   if_match — ETag, который должен совпасть (If-Match);
+ *   coalesce — false, чтобы не склеивать этот GET (при coalesce_gets).
  */
 static int
 l_s3_client_get_fd(lua_State *L)
@@ -181,6 +268,25 @@ l_s3_client_get_fd(lua_State *L)
     opts.range = NULL;
     opts.flags = 0;
 
+    if (!lua_isnoneornil(L, 7)) {
+        luaL_checktype(L, 7, LUA_TTABLE);
+
+        lua_getfield(L, 7, "range");
+        if (!lua_isnil(L, -1))
+            opts.range = luaL_checkstring(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 7, "if_match");
+        if (!lua_isnil(L, -1))
+            opts.if_match = luaL_checkstring(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 7, "coalesce");
+        if (lua_isboolean(L, -1) && !lua_toboolean(L, -1))
+            opts.flags |= S3_GET_F_NO_COALESCE;
+        lua_pop(L, 1);
+    }
+
     size_t bytes_written = 0;
     s3_error_t err = S3_ERROR_INIT;
     s3_error_code_t rc =
@@ -198,282 +304,2643 @@ l_s3_client_get_fd(lua_State *L)
 }
 
 /*
- * client:create_bucket(bucket) -> bool, err
+ * client:get_stream(fd, bucket, key[, opts]) -> bytes_written | nil, err
+ *
+ * fd — сокет или pipe (например, sock:fd() соединения HTTP-клиента),
+ * тело пишется последовательно. opts: range, if_match.
  */
 static int
-l_s3_client_create_bucket(lua_State *L)
+l_s3_client_get_stream(lua_State *L)
 {
     struct l_s3_client *lc = l_s3_check_client(L, 1);
     s3_client_t *client = lc->client;
 
+    int fd = luaL_checkinteger(L, 2);
+
     const char *bucket = NULL;
-    if (!lua_isnoneornil(L, 2))
-        bucket = luaL_checkstring(L, 2);
+    if (!lua_isnoneornil(L, 3))
+        bucket = luaL_checkstring(L, 3);
 
-    // TODO: acl, flags, etc.
+    const char *key = luaL_checkstring(L, 4);
 
-    s3_create_bucket_opts_t opts;
+    s3_get_opts_t opts;
     memset(&opts, 0, sizeof(opts));
     opts.bucket = bucket;
+    opts.key = key;
 
+    if (!lua_isnoneornil(L, 5)) {
+        luaL_checktype(L, 5, LUA_TTABLE);
+
+        lua_getfield(L, 5, "range");
+        if (!lua_isnil(L, -1))
+            opts.range = luaL_checkstring(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 5, "if_match");
+        if (!lua_isnil(L, -1))
+            opts.if_match = luaL_checkstring(L, -1);
+        lua_pop(L, 1);
+    }
+
+    size_t bytes_written = 0;
     s3_error_t err = S3_ERROR_INIT;
     s3_error_code_t rc =
-        s3_client_create_bucket(client, &opts, &err);
+        s3_client_get_stream(client, &opts, fd, &bytes_written, &err);
 
     if (rc == S3_E_OK) {
-        lua_pushboolean(L, 1);
+        lua_pushinteger(L, (lua_Integer)bytes_written);
         return 1;
     }
 
-    lua_pushboolean(L, 0);
+    lua_pushnil(L);
     l_s3_push_error(L, &err);
     return 2;
 }
 
 /*
- * client:list_objects(bucket, prefix, max_keys, continuation_token) -> result | nil, err
- *
- * bucket можно передать nil, тогда будет использоваться default_bucket.
- * prefix, max_keys, continuation_token — опциональные:
- *   prefix               — фильтр по префиксу;
- *   max_keys (integer)   — максимум объектов на странице (0 или nil → дефолт сервера);
- *   continuation_token   — токен для продолжения пагинации (nil → первая страница).
- *
- * При успехе возвращает одну таблицу:
- * {
- *   objects = {
- *     { key = "...", size = <int>, etag = "...",
- *       last_modified = "...", storage_class = "STANDARD" },
- *     ...
- *   },
- *   is_truncated = <bool>,
- *   next_continuation_token = <string|nil>,
- * }
+ * client:put_stream(fd, bucket, key[, opts]) -> bytes_read | nil, err
  *
- * При ошибке: nil, err_table.
+ * fd — pipe, сокет или stdin, читается до EOF; размер заранее не нужен.
+ * opts: content_type, part_size (>= 5 MiB), concurrency.
  */
 static int
-l_s3_client_list_objects(lua_State *L)
+l_s3_client_put_stream(lua_State *L)
 {
     struct l_s3_client *lc = l_s3_check_client(L, 1);
     s3_client_t *client = lc->client;
 
-    const char *bucket = NULL;
-    if (!lua_isnoneornil(L, 2))
-        bucket = luaL_checkstring(L, 2);
+    int fd = luaL_checkinteger(L, 2);
 
-    const char *prefix = NULL;
+    const char *bucket = NULL;
     if (!lua_isnoneornil(L, 3))
-        prefix = luaL_checkstring(L, 3);
-
-    uint32_t max_keys = 0;
-    if (!lua_isnoneornil(L, 4)) {
-        lua_Integer mk = luaL_checkinteger(L, 4);
-        if (mk < 0)
-            mk = 0;
-        max_keys = (uint32_t)mk;
-    }
+        bucket = luaL_checkstring(L, 3);
 
-    const char *continuation_token = NULL;
-    if (!lua_isnoneornil(L, 5))
-        continuation_token = luaL_checkstring(L, 5);
+    const char *key = luaL_checkstring(L, 4);
 
-    s3_list_objects_opts_t opts;
+    s3_put_opts_t opts;
     memset(&opts, 0, sizeof(opts));
-    opts.bucket = bucket;                  /* может быть NULL → default_bucket */
-    opts.prefix = prefix;                  /* может быть NULL */
-    opts.max_keys = max_keys;              /* 0 → дефолт сервера */
-    opts.continuation_token = continuation_token; /* NULL → первая страница */
-    opts.flags = 0;
+    opts.bucket = bucket;
+    opts.key = key;
 
-    s3_list_objects_result_t res;
-    memset(&res, 0, sizeof(res));
+    s3_put_stream_opts_t sopts;
+    memset(&sopts, 0, sizeof(sopts));
 
-    s3_error_t err = S3_ERROR_INIT;
-    s3_error_code_t rc = s3_client_list_objects(client, &opts, &res, &err);
+    if (!lua_isnoneornil(L, 5)) {
+        luaL_checktype(L, 5, LUA_TTABLE);
 
-    if (rc != S3_E_OK) {
-        /* На всякий случай подчистим результат, если там что-то успело заполниться. */
-        s3_list_objects_result_destroy(client, &res);
+        lua_getfield(L, 5, "content_type");
+        if (!lua_isnil(L, -1))
+            opts.content_type = luaL_checkstring(L, -1);
+        lua_pop(L, 1);
 
-        lua_pushnil(L);
-        l_s3_push_error(L, &err);
-        return 2;
+        lua_getfield(L, 5, "part_size");
+        if (!lua_isnil(L, -1))
+            sopts.part_size = (size_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 5, "concurrency");
+        if (!lua_isnil(L, -1))
+            sopts.concurrency = (uint32_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
     }
 
-    /*
-     * Строим Lua-таблицу результата:
-     *
-     * {
-     *   objects = {
-     *     { key = "...", size = 123, etag = "...",
-     *       last_modified = "...", storage_class = "STANDARD" },
-     *     ...
-     *   },
-     *   is_truncated = true/false,
-     *   next_continuation_token = "..." or nil
-     * }
-     */
+    uint64_t bytes_read = 0;
+    s3_error_t err = S3_ERROR_INIT;
+    s3_error_code_t rc =
+        s3_client_put_stream(client, &opts, &sopts, fd, &bytes_read, &err);
 
-    lua_newtable(L); /* result */
+    if (rc == S3_E_OK) {
+        lua_pushinteger(L, (lua_Integer)bytes_read);
+        return 1;
+    }
 
-    /* result.objects */
-    lua_createtable(L, (int)res.count, 0); /* objects array */
+    lua_pushnil(L);
+    l_s3_push_error(L, &err);
+    return 2;
+}
 
-    for (size_t i = 0; i < res.count; i++) {
-        s3_object_info_t *o = &res.objects[i];
+/*
+ * client:put_iov(bucket, key, segs[, opts]) -> true | nil, err
+ *
+ * segs — массив { fd, offset, len } или { fd = .., offset = .., len = .. };
+ * объект — куски подряд. opts: content_type, part_size, concurrency.
+ */
+static int
+l_s3_client_put_iov(lua_State *L)
+{
+    struct l_s3_client *lc = l_s3_check_client(L, 1);
+    s3_client_t *client = lc->client;
 
-        lua_createtable(L, 0, 5); /* один объект */
+    const char *bucket = NULL;
+    if (!lua_isnoneornil(L, 2))
+        bucket = luaL_checkstring(L, 2);
 
-        if (o->key != NULL) {
-            lua_pushstring(L, o->key);
-            lua_setfield(L, -2, "key");
-        }
+    const char *key = luaL_checkstring(L, 3);
+    luaL_checktype(L, 4, LUA_TTABLE);
 
-        lua_pushinteger(L, (lua_Integer)o->size);
-        lua_setfield(L, -2, "size");
+    s3_put_opts_t opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.bucket = bucket;
+    opts.key = key;
 
-        if (o->etag != NULL) {
-            lua_pushstring(L, o->etag);
-            lua_setfield(L, -2, "etag");
+    s3_put_stream_opts_t mp_opts;
+    memset(&mp_opts, 0, sizeof(mp_opts));
+
+    if (!lua_isnoneornil(L, 5)) {
+        luaL_checktype(L, 5, LUA_TTABLE);
+
+        lua_getfield(L, 5, "content_type");
+        if (!lua_isnil(L, -1))
+            opts.content_type = luaL_checkstring(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 5, "part_size");
+        if (!lua_isnil(L, -1))
+            mp_opts.part_size = (size_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 5, "concurrency");
+        if (!lua_isnil(L, -1))
+            mp_opts.concurrency = (uint32_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+    }
+
+    size_t count = lua_objlen(L, 4);
+    if (count == 0)
+        return luaL_error(L, "put_iov: segs must not be empty");
+
+    s3_put_seg_t *segs = (s3_put_seg_t *)calloc(count, sizeof(*segs));
+    if (segs == NULL)
+        return luaL_error(L, "put_iov: out of memory");
+
+    for (size_t i = 0; i < count; i++) {
+        lua_rawgeti(L, 4, (int)(i + 1));
+        if (!lua_istable(L, -1)) {
+            free(segs);
+            return luaL_error(L, "put_iov: segment #%d must be a table",
+                              (int)(i + 1));
         }
 
-        if (o->last_modified != NULL) {
-            lua_pushstring(L, o->last_modified);
-            lua_setfield(L, -2, "last_modified");
+        static const char *const fields[] = { "fd", "offset", "len" };
+        lua_Integer v[3];
+        for (int f = 0; f < 3; f++) {
+            lua_getfield(L, -1, fields[f]);
+            if (lua_isnil(L, -1)) {
+                lua_pop(L, 1);
+                lua_rawgeti(L, -1, f + 1);
+            }
+            v[f] = lua_tointeger(L, -1);
+            lua_pop(L, 1);
         }
+        lua_pop(L, 1);
 
-        if (o->storage_class != NULL) {
-            lua_pushstring(L, o->storage_class);
-            lua_setfield(L, -2, "storage_class");
+        if (v[0] < 0 || v[1] < 0 || v[2] < 0) {
+            free(segs);
+            return luaL_error(L, "put_iov: segment #%d is invalid",
+                              (int)(i + 1));
         }
+        segs[i].fd = (int)v[0];
+        segs[i].offset = (off_t)v[1];
+        segs[i].len = (size_t)v[2];
+    }
 
-        /* objects[i+1] = объект */
-        lua_rawseti(L, -2, (int)i + 1);
+    s3_error_t err = S3_ERROR_INIT;
+    s3_error_code_t rc =
+        s3_client_put_iov(client, &opts, &mp_opts, segs, count, &err);
+    free(segs);
+
+    if (rc == S3_E_OK) {
+        lua_pushboolean(L, 1);
+        return 1;
     }
 
-    lua_setfield(L, -2, "objects"); /* result.objects = objects */
+    lua_pushnil(L);
+    l_s3_push_error(L, &err);
+    return 2;
+}
 
-    /* result.is_truncated */
-    lua_pushboolean(L, res.is_truncated);
-    lua_setfield(L, -2, "is_truncated");
+/*
+ * client:append(fd, bucket, key[, opts]) -> result | nil, err
+ *
+ * Дописать в объект хвост растущего файла fd.
+ * opts: content_type, part_size, concurrency.
+ * result: { size, uploaded, copied, etag }.
+ */
+static int
+l_s3_client_append(lua_State *L)
+{
+    struct l_s3_client *lc = l_s3_check_client(L, 1);
+    s3_client_t *client = lc->client;
 
-    /* result.next_continuation_token */
-    if (res.next_continuation_token != NULL) {
-        lua_pushstring(L, res.next_continuation_token);
-    } else {
-        lua_pushnil(L);
+    int fd = (int)luaL_checkinteger(L, 2);
+
+    s3_put_opts_t opts;
+    memset(&opts, 0, sizeof(opts));
+    if (!lua_isnoneornil(L, 3))
+        opts.bucket = luaL_checkstring(L, 3);
+    opts.key = luaL_checkstring(L, 4);
+
+    s3_put_stream_opts_t mp_opts;
+    memset(&mp_opts, 0, sizeof(mp_opts));
+
+    if (!lua_isnoneornil(L, 5)) {
+        luaL_checktype(L, 5, LUA_TTABLE);
+
+        lua_getfield(L, 5, "content_type");
+        if (!lua_isnil(L, -1))
+            opts.content_type = luaL_checkstring(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 5, "part_size");
+        if (!lua_isnil(L, -1))
+            mp_opts.part_size = (size_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 5, "concurrency");
+        if (!lua_isnil(L, -1))
+            mp_opts.concurrency = (uint32_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
     }
-    lua_setfield(L, -2, "next_continuation_token");
 
-    /* Освобождаем все строки/массив, выделенные клиентским аллокатором. */
-    s3_list_objects_result_destroy(client, &res);
+    s3_append_result_t res;
+    memset(&res, 0, sizeof(res));
+    s3_error_t err = S3_ERROR_INIT;
+    if (s3_client_append(client, &opts, &mp_opts, fd, &res, &err) != S3_E_OK) {
+        lua_pushnil(L);
+        l_s3_push_error(L, &err);
+        return 2;
+    }
 
-    /* Возвращаем только result, без err. */
+    lua_createtable(L, 0, 4);
+    lua_pushinteger(L, (lua_Integer)res.size);
+    lua_setfield(L, -2, "size");
+    lua_pushinteger(L, (lua_Integer)res.uploaded);
+    lua_setfield(L, -2, "uploaded");
+    lua_pushboolean(L, res.copied);
+    lua_setfield(L, -2, "copied");
+    lua_pushstring(L, res.etag);
+    lua_setfield(L, -2, "etag");
     return 1;
 }
 
+/* box.backup.<fn>() под pcall; 0 — успех, иначе ошибка на стеке. */
+static int
+l_s3_box_backup_call(lua_State *L, const char *fn, int nresults)
+{
+    lua_getglobal(L, "box");
+    if (!lua_istable(L, -1)) {
+        lua_pop(L, 1);
+        lua_pushstring(L, "box is not configured");
+        return -1;
+    }
+    lua_getfield(L, -1, "backup");
+    lua_remove(L, -2);
+    if (!lua_istable(L, -1)) {
+        lua_pop(L, 1);
+        lua_pushstring(L, "box.backup is not available");
+        return -1;
+    }
+    lua_getfield(L, -1, fn);
+    lua_remove(L, -2);
+    return lua_pcall(L, 0, nresults, 0) == 0 ? 0 : -1;
+}
 
 /*
- * client:delete_objects(bucket, keys[, quiet]) -> bool | nil, err
- *
- * bucket:
- *   - строка с именем бакета
- *   - или nil → будет использован default_bucket клиента
+ * client:backup([opts]) -> result | nil, err
  *
- * keys:
- *   - массив строковых ключей: { "k1", "k2", "k3", ... }
+ * opts: bucket, prefix, manifest_key, part_size, concurrency,
+ *       verify_etag (bool), files (список путей; по умолчанию —
+ *       box.backup.start(), после загрузки вызывается box.backup.stop()).
  *
- * quiet (опционально):
- *   - true  → <Quiet>true</Quiet> в XML (сервер не шлёт список успешно удалённых)
- *   - false / nil → обычный режим
+ * result: { files, uploaded, skipped, bytes, bytes_uploaded, elapsed,
+ *           throughput (байт/с) }.
  */
 static int
-l_s3_client_delete_objects(lua_State *L)
+l_s3_client_backup(lua_State *L)
 {
     struct l_s3_client *lc = l_s3_check_client(L, 1);
     s3_client_t *client = lc->client;
 
-    /* 2-й аргумент: bucket (может быть nil) */
-    const char *bucket = NULL;
-    if (!lua_isnoneornil(L, 2))
-        bucket = luaL_checkstring(L, 2);
+    s3_backup_opts_t opts;
+    memset(&opts, 0, sizeof(opts));
 
-    /* 3-й аргумент: keys (обязательная таблица-массив) */
-    luaL_checktype(L, 3, LUA_TTABLE);
+    bool has_opts = !lua_isnoneornil(L, 2);
+    if (has_opts) {
+        luaL_checktype(L, 2, LUA_TTABLE);
+
+        lua_getfield(L, 2, "bucket");
+        if (!lua_isnil(L, -1))
+            opts.bucket = luaL_checkstring(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 2, "prefix");
+        if (!lua_isnil(L, -1))
+            opts.prefix = luaL_checkstring(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 2, "manifest_key");
+        if (!lua_isnil(L, -1))
+            opts.manifest_key = luaL_checkstring(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 2, "part_size");
+        if (!lua_isnil(L, -1))
+            opts.part_size = (size_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 2, "concurrency");
+        if (!lua_isnil(L, -1))
+            opts.concurrency = (uint32_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 2, "verify_etag");
+        if (lua_toboolean(L, -1))
+            opts.flags |= S3_BACKUP_F_VERIFY_ETAG;
+        lua_pop(L, 1);
+    }
 
-    /* 4-й аргумент: quiet (опционально) */
-    bool quiet = false;
+    /* Список файлов на вершине стека — строки живут, пока он там. */
+    bool own_backup = false;
+    if (has_opts) {
+        lua_getfield(L, 2, "files");
+        if (lua_isnil(L, -1))
+            lua_pop(L, 1);
+        else
+            luaL_checktype(L, -1, LUA_TTABLE);
+    }
+    if (lua_gettop(L) < 3 || !lua_istable(L, 3)) {
+        lua_settop(L, 2);
+        if (l_s3_box_backup_call(L, "start", 1) != 0) {
+            s3_error_t err = S3_ERROR_INIT;
+            s3_error_set(&err, S3_E_INVALID_ARG, lua_tostring(L, -1),
+                         0, 0, 0);
+            lua_pushnil(L);
+            l_s3_push_error(L, &err);
+            return 2;
+        }
+        own_backup = true;
+    }
+    int files_idx = lua_gettop(L);
+
+    size_t count = lua_objlen(L, files_idx);
+    const char **files = NULL;
+    if (count > 0) {
+        files = (const char **)lua_newuserdata(L, count * sizeof(*files));
+        for (size_t i = 0; i < count; i++) {
+            lua_rawgeti(L, files_idx, (int)(i + 1));
+            files[i] = lua_tostring(L, -1);
+            lua_pop(L, 1);
+            if (files[i] == NULL) {
+                if (own_backup)
+                    l_s3_box_backup_call(L, "stop", 0);
+                return luaL_error(L, "backup: file #%d must be a string",
+                                  (int)(i + 1));
+            }
+        }
+    }
+
+    s3_backup_result_t res;
+    memset(&res, 0, sizeof(res));
+    s3_error_t err = S3_ERROR_INIT;
+    s3_error_code_t rc =
+        s3_client_backup(client, &opts, files, count, &res, &err);
+
+    if (own_backup && l_s3_box_backup_call(L, "stop", 0) != 0) {
+        if (rc == S3_E_OK)
+            s3_error_set(&err, S3_E_INTERNAL, lua_tostring(L, -1), 0, 0, 0);
+        rc = err.code;
+        lua_pop(L, 1);
+    }
+
+    if (rc != S3_E_OK) {
+        lua_pushnil(L);
+        l_s3_push_error(L, &err);
+        return 2;
+    }
+
+    lua_createtable(L, 0, 7);
+    lua_pushinteger(L, (lua_Integer)res.files);
+    lua_setfield(L, -2, "files");
+    lua_pushinteger(L, (lua_Integer)res.uploaded);
+    lua_setfield(L, -2, "uploaded");
+    lua_pushinteger(L, (lua_Integer)res.skipped);
+    lua_setfield(L, -2, "skipped");
+    lua_pushinteger(L, (lua_Integer)res.bytes);
+    lua_setfield(L, -2, "bytes");
+    lua_pushinteger(L, (lua_Integer)res.bytes_uploaded);
+    lua_setfield(L, -2, "bytes_uploaded");
+    lua_pushnumber(L, res.elapsed);
+    lua_setfield(L, -2, "elapsed");
+    lua_pushnumber(L, res.elapsed > 0 ?
+                   (double)res.bytes_uploaded / res.elapsed : 0);
+    lua_setfield(L, -2, "throughput");
+    return 1;
+}
+
+/*
+ * client:restore(opts) -> result | nil, err
+ *
+ * opts: manifest_key, dir (обязательные), bucket, concurrency,
+ *       verify (bool, по умолчанию true).
+ *
+ * result: { files, bytes, elapsed, throughput (байт/с) }.
+ */
+static int
+l_s3_client_restore(lua_State *L)
+{
+    struct l_s3_client *lc = l_s3_check_client(L, 1);
+    s3_client_t *client = lc->client;
+    luaL_checktype(L, 2, LUA_TTABLE);
+
+    s3_restore_opts_t opts;
+    memset(&opts, 0, sizeof(opts));
+
+    lua_getfield(L, 2, "manifest_key");
+    opts.manifest_key = luaL_checkstring(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, 2, "dir");
+    opts.dir = luaL_checkstring(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, 2, "bucket");
+    if (!lua_isnil(L, -1))
+        opts.bucket = luaL_checkstring(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, 2, "concurrency");
+    if (!lua_isnil(L, -1))
+        opts.concurrency = (uint32_t)luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, 2, "verify");
+    if (!lua_isnil(L, -1) && !lua_toboolean(L, -1))
+        opts.flags |= S3_RESTORE_F_NO_VERIFY;
+    lua_pop(L, 1);
+
+    s3_restore_result_t res;
+    memset(&res, 0, sizeof(res));
+    s3_error_t err = S3_ERROR_INIT;
+    if (s3_client_restore(client, &opts, &res, &err) != S3_E_OK) {
+        lua_pushnil(L);
+        l_s3_push_error(L, &err);
+        return 2;
+    }
+
+    lua_createtable(L, 0, 4);
+    lua_pushinteger(L, (lua_Integer)res.files);
+    lua_setfield(L, -2, "files");
+    lua_pushinteger(L, (lua_Integer)res.bytes);
+    lua_setfield(L, -2, "bytes");
+    lua_pushnumber(L, res.elapsed);
+    lua_setfield(L, -2, "elapsed");
+    lua_pushnumber(L, res.elapsed > 0 ?
+                   (double)res.bytes / res.elapsed : 0);
+    lua_setfield(L, -2, "throughput");
+    return 1;
+}
+
+/*
+ * client:sync(local_dir, bucket, prefix, direction[, opts])
+ *     -> result | nil, err
+ *
+ * direction: "upload" (local_dir -> bucket) или "download".
+ * bucket может быть nil (default_bucket), prefix — nil или строка.
+ * opts: part_size, concurrency, delete (bool), checksum (bool).
+ *
+ * result: { scanned, transferred, deleted, bytes, elapsed }.
+ */
+static int
+l_s3_client_sync(lua_State *L)
+{
+    struct l_s3_client *lc = l_s3_check_client(L, 1);
+    s3_client_t *client = lc->client;
+
+    s3_sync_opts_t opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.local_dir = luaL_checkstring(L, 2);
+    opts.bucket = luaL_optstring(L, 3, NULL);
+    opts.prefix = luaL_optstring(L, 4, NULL);
+
+    const char *dir = luaL_checkstring(L, 5);
+    if (strcmp(dir, "upload") == 0)
+        opts.direction = S3_SYNC_UPLOAD;
+    else if (strcmp(dir, "download") == 0)
+        opts.direction = S3_SYNC_DOWNLOAD;
+    else
+        return luaL_error(L, "sync: bad direction '%s'", dir);
+
+    if (!lua_isnoneornil(L, 6)) {
+        luaL_checktype(L, 6, LUA_TTABLE);
+
+        lua_getfield(L, 6, "part_size");
+        if (!lua_isnil(L, -1))
+            opts.part_size = (size_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 6, "concurrency");
+        if (!lua_isnil(L, -1))
+            opts.concurrency = (uint32_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 6, "delete");
+        if (lua_toboolean(L, -1))
+            opts.flags |= S3_SYNC_F_DELETE;
+        lua_pop(L, 1);
+
+        lua_getfield(L, 6, "checksum");
+        if (lua_toboolean(L, -1))
+            opts.flags |= S3_SYNC_F_CHECKSUM;
+        lua_pop(L, 1);
+    }
+
+    s3_sync_result_t res;
+    memset(&res, 0, sizeof(res));
+    s3_error_t err = S3_ERROR_INIT;
+    if (s3_client_sync(client, &opts, &res, &err) != S3_E_OK) {
+        lua_pushnil(L);
+        l_s3_push_error(L, &err);
+        return 2;
+    }
+
+    lua_createtable(L, 0, 5);
+    lua_pushinteger(L, (lua_Integer)res.scanned);
+    lua_setfield(L, -2, "scanned");
+    lua_pushinteger(L, (lua_Integer)res.transferred);
+    lua_setfield(L, -2, "transferred");
+    lua_pushinteger(L, (lua_Integer)res.deleted);
+    lua_setfield(L, -2, "deleted");
+    lua_pushinteger(L, (lua_Integer)res.bytes);
+    lua_setfield(L, -2, "bytes");
+    lua_pushnumber(L, res.elapsed);
+    lua_setfield(L, -2, "elapsed");
+    return 1;
+}
+
+/* opts chunk store из таблицы idx (может быть nil). */
+static void
+l_s3_chunk_opts(lua_State *L, int idx, s3_chunk_opts_t *opts)
+{
+    memset(opts, 0, sizeof(*opts));
+    if (lua_isnoneornil(L, idx))
+        return;
+    luaL_checktype(L, idx, LUA_TTABLE);
+
+    lua_getfield(L, idx, "bucket");
+    if (!lua_isnil(L, -1))
+        opts->bucket = luaL_checkstring(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, idx, "chunk_prefix");
+    if (!lua_isnil(L, -1))
+        opts->chunk_prefix = luaL_checkstring(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, idx, "avg_chunk");
+    if (!lua_isnil(L, -1))
+        opts->avg_chunk = (size_t)luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, idx, "concurrency");
+    if (!lua_isnil(L, -1))
+        opts->concurrency = (uint32_t)luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+}
+
+static int
+l_s3_push_chunk_result(lua_State *L, s3_error_code_t rc,
+                       const s3_chunk_result_t *res, const s3_error_t *err)
+{
+    if (rc != S3_E_OK) {
+        lua_pushnil(L);
+        l_s3_push_error(L, err);
+        return 2;
+    }
+
+    lua_createtable(L, 0, 5);
+    lua_pushinteger(L, (lua_Integer)res->chunks);
+    lua_setfield(L, -2, "chunks");
+    lua_pushinteger(L, (lua_Integer)res->transferred);
+    lua_setfield(L, -2, "transferred");
+    lua_pushinteger(L, (lua_Integer)res->bytes);
+    lua_setfield(L, -2, "bytes");
+    lua_pushinteger(L, (lua_Integer)res->bytes_transferred);
+    lua_setfield(L, -2, "bytes_transferred");
+    lua_pushnumber(L, res->elapsed);
+    lua_setfield(L, -2, "elapsed");
+    return 1;
+}
+
+/*
+ * client:chunk_put(fd, manifest_key[, opts]) -> result | nil, err
+ * client:chunk_get(manifest_key, fd[, opts]) -> result | nil, err
+ *
+ * opts: bucket, chunk_prefix, avg_chunk, concurrency.
+ * result: { chunks, transferred, bytes, bytes_transferred, elapsed }.
+ */
+static int
+l_s3_client_chunk_put(lua_State *L)
+{
+    struct l_s3_client *lc = l_s3_check_client(L, 1);
+    int fd = (int)luaL_checkinteger(L, 2);
+    const char *manifest_key = luaL_checkstring(L, 3);
+
+    s3_chunk_opts_t opts;
+    l_s3_chunk_opts(L, 4, &opts);
+
+    s3_chunk_result_t res;
+    memset(&res, 0, sizeof(res));
+    s3_error_t err = S3_ERROR_INIT;
+    s3_error_code_t rc = s3_client_chunk_put(lc->client, &opts, manifest_key,
+                                             fd, &res, &err);
+    return l_s3_push_chunk_result(L, rc, &res, &err);
+}
+
+static int
+l_s3_client_chunk_get(lua_State *L)
+{
+    struct l_s3_client *lc = l_s3_check_client(L, 1);
+    const char *manifest_key = luaL_checkstring(L, 2);
+    int fd = (int)luaL_checkinteger(L, 3);
+
+    s3_chunk_opts_t opts;
+    l_s3_chunk_opts(L, 4, &opts);
+
+    s3_chunk_result_t res;
+    memset(&res, 0, sizeof(res));
+    s3_error_t err = S3_ERROR_INIT;
+    s3_error_code_t rc = s3_client_chunk_get(lc->client, &opts, manifest_key,
+                                             fd, &res, &err);
+    return l_s3_push_chunk_result(L, rc, &res, &err);
+}
+
+/*
+ * client:put_fanout(fd, offset, size, dests[, opts]) -> results | nil, err, results
+ *
+ * dests — массив { bucket = .., key = .., client = <другой s3 клиент> }.
+ * opts: content_type, part_size, concurrency, quorum (0/nil — все).
+ *
+ * results[i] — true, если место получило объект, иначе таблица ошибки.
+ */
+static int
+l_s3_client_put_fanout(lua_State *L)
+{
+    struct l_s3_client *lc = l_s3_check_client(L, 1);
+    s3_client_t *client = lc->client;
+
+    int fd = luaL_checkinteger(L, 2);
+    off_t offset = (off_t)luaL_checkinteger(L, 3);
+    size_t size = (size_t)luaL_checkinteger(L, 4);
+    luaL_checktype(L, 5, LUA_TTABLE);
+
+    s3_put_fanout_opts_t opts;
+    memset(&opts, 0, sizeof(opts));
+
+    if (!lua_isnoneornil(L, 6)) {
+        luaL_checktype(L, 6, LUA_TTABLE);
+
+        lua_getfield(L, 6, "content_type");
+        if (!lua_isnil(L, -1))
+            opts.content_type = luaL_checkstring(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 6, "part_size");
+        if (!lua_isnil(L, -1))
+            opts.part_size = (size_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 6, "concurrency");
+        if (!lua_isnil(L, -1))
+            opts.concurrency = (uint32_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 6, "quorum");
+        if (!lua_isnil(L, -1))
+            opts.quorum = (uint32_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+    }
+
+    size_t count = lua_objlen(L, 5);
+    if (count == 0)
+        return luaL_error(L, "put_fanout: dests must not be empty");
+
+    s3_fanout_dest_t *dests =
+        (s3_fanout_dest_t *)calloc(count, sizeof(*dests));
+    if (dests == NULL)
+        return luaL_error(L, "put_fanout: out of memory");
+
+    /* Строки и клиенты остаются в таблице dests на стеке. */
+    for (size_t i = 0; i < count; i++) {
+        lua_rawgeti(L, 5, (int)(i + 1));
+        if (!lua_istable(L, -1)) {
+            free(dests);
+            return luaL_error(L, "put_fanout: dest #%d must be a table",
+                              (int)(i + 1));
+        }
+
+        lua_getfield(L, -1, "bucket");
+        if (!lua_isnil(L, -1))
+            dests[i].bucket = lua_tostring(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, -1, "key");
+        dests[i].key = lua_tostring(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, -1, "client");
+        if (!lua_isnil(L, -1)) {
+            struct l_s3_client *dc = (struct l_s3_client *)
+                luaL_testudata(L, -1, S3_LUA_CLIENT_MT);
+            if (dc == NULL || dc->client == NULL) {
+                free(dests);
+                return luaL_error(L, "put_fanout: dest #%d has invalid "
+                                  "client", (int)(i + 1));
+            }
+            dests[i].client = dc->client;
+        }
+        lua_pop(L, 1);
+
+        lua_pop(L, 1);
+
+        if (dests[i].key == NULL) {
+            free(dests);
+            return luaL_error(L, "put_fanout: dest #%d has no key",
+                              (int)(i + 1));
+        }
+    }
+
+    s3_error_t err = S3_ERROR_INIT;
+    s3_error_code_t rc = s3_client_put_fanout(client, &opts, fd, offset, size,
+                                              dests, count, &err);
+
+    int nret = 0;
+    if (rc != S3_E_OK) {
+        lua_pushnil(L);
+        l_s3_push_error(L, &err);
+        nret = 2;
+    }
+
+    lua_createtable(L, (int)count, 0);
+    for (size_t i = 0; i < count; i++) {
+        if (dests[i].code == S3_E_OK)
+            lua_pushboolean(L, 1);
+        else
+            l_s3_push_error(L, &dests[i].err);
+        lua_rawseti(L, -2, (int)(i + 1));
+    }
+    free(dests);
+
+    return nret + 1;
+}
+
+/*
+ * client:transfer(src_bucket, src_key, dst, dst_bucket, dst_key[, opts])
+ *     -> bytes | nil, err
+ *
+ * Копирует объект этого клиента в dst (другой s3 клиент; nil — этот же)
+ * без промежуточного файла. dst_key nil — как src_key.
+ * opts: content_type, part_size, concurrency.
+ */
+static int
+l_s3_client_transfer(lua_State *L)
+{
+    struct l_s3_client *lc = l_s3_check_client(L, 1);
+    s3_client_t *src = lc->client;
+
+    s3_transfer_opts_t opts;
+    memset(&opts, 0, sizeof(opts));
+
+    if (!lua_isnoneornil(L, 2))
+        opts.src_bucket = luaL_checkstring(L, 2);
+    opts.src_key = luaL_checkstring(L, 3);
+
+    s3_client_t *dst = NULL;
     if (!lua_isnoneornil(L, 4))
-        quiet = lua_toboolean(L, 4);
+        dst = l_s3_check_client(L, 4)->client;
 
-    /* Кол-во элементов в таблице keys.
-     * В Tarantool/LuaJIT нет lua_rawlen, используем lua_objlen.
-     */
-    size_t count = lua_objlen(L, 3);
-    if (count == 0) {
-        /* Пустой список — считаем no-op и сразу успех. */
+    if (!lua_isnoneornil(L, 5))
+        opts.dst_bucket = luaL_checkstring(L, 5);
+    if (!lua_isnoneornil(L, 6))
+        opts.dst_key = luaL_checkstring(L, 6);
+
+    if (!lua_isnoneornil(L, 7)) {
+        luaL_checktype(L, 7, LUA_TTABLE);
+
+        lua_getfield(L, 7, "content_type");
+        if (!lua_isnil(L, -1))
+            opts.content_type = luaL_checkstring(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 7, "part_size");
+        if (!lua_isnil(L, -1))
+            opts.part_size = (size_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 7, "concurrency");
+        if (!lua_isnil(L, -1))
+            opts.concurrency = (uint32_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+    }
+
+    uint64_t bytes = 0;
+    s3_error_t err = S3_ERROR_INIT;
+    s3_error_code_t rc = s3_client_transfer(src, dst, &opts, &bytes, &err);
+
+    if (rc == S3_E_OK) {
+        lua_pushinteger(L, (lua_Integer)bytes);
+        return 1;
+    }
+
+    lua_pushnil(L);
+    l_s3_push_error(L, &err);
+    return 2;
+}
+
+/*
+ * client:create_bucket(bucket) -> bool, err
+ */
+static int
+l_s3_client_create_bucket(lua_State *L)
+{
+    struct l_s3_client *lc = l_s3_check_client(L, 1);
+    s3_client_t *client = lc->client;
+
+    const char *bucket = NULL;
+    if (!lua_isnoneornil(L, 2))
+        bucket = luaL_checkstring(L, 2);
+
+    // TODO: acl, flags, etc.
+
+    s3_create_bucket_opts_t opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.bucket = bucket;
+
+    s3_error_t err = S3_ERROR_INIT;
+    s3_error_code_t rc =
+        s3_client_create_bucket(client, &opts, &err);
+
+    if (rc == S3_E_OK) {
         lua_pushboolean(L, 1);
         return 1;
     }
 
-    /* Массив описаний объектов храним в обычном malloc/free:
-     * он нужен только на время этого вызова и не используется библиотекой
-     * после возврата s3_client_delete_objects.
-     */
-    s3_delete_object_t *objs =
-        (s3_delete_object_t *)malloc(sizeof(*objs) * count);
-    if (objs == NULL) {
-        s3_error_t err = S3_ERROR_INIT;
-        err.code = S3_E_NOMEM;
-        err.os_error = ENOMEM;
-        snprintf(err.message, sizeof(err.message),
-                 "Out of memory in delete_objects");
+    lua_pushboolean(L, 0);
+    l_s3_push_error(L, &err);
+    return 2;
+}
+
+/*
+ * client:list_objects(bucket, prefix, max_keys, continuation_token) -> result | nil, err
+ *
+ * bucket можно передать nil, тогда будет использоваться default_bucket.
+ * prefix, max_keys, continuation_token — опциональные:
+ *   prefix               — фильтр по префиксу;
+ *   max_keys (integer)   — максимум объектов на странице (0 или nil → дефолт сервера);
+ *   continuation_token   — токен для продолжения пагинации (nil → первая страница).
+ *
+ * При успехе возвращает одну таблицу:
+ * {
+ *   objects = {
+ *     { key = "...", size = <int>, etag = "...",
+ *       last_modified = "...", storage_class = "STANDARD" },
+ *     ...
+ *   },
+ *   is_truncated = <bool>,
+ *   next_continuation_token = <string|nil>,
+ * }
+ *
+ * При ошибке: nil, err_table.
+ */
+static int
+l_s3_client_list_objects(lua_State *L)
+{
+    struct l_s3_client *lc = l_s3_check_client(L, 1);
+    s3_client_t *client = lc->client;
+
+    const char *bucket = NULL;
+    if (!lua_isnoneornil(L, 2))
+        bucket = luaL_checkstring(L, 2);
+
+    const char *prefix = NULL;
+    if (!lua_isnoneornil(L, 3))
+        prefix = luaL_checkstring(L, 3);
+
+    uint32_t max_keys = 0;
+    if (!lua_isnoneornil(L, 4)) {
+        lua_Integer mk = luaL_checkinteger(L, 4);
+        if (mk < 0)
+            mk = 0;
+        max_keys = (uint32_t)mk;
+    }
+
+    const char *continuation_token = NULL;
+    if (!lua_isnoneornil(L, 5))
+        continuation_token = luaL_checkstring(L, 5);
+
+    s3_list_objects_opts_t opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.bucket = bucket;                  /* может быть NULL → default_bucket */
+    opts.prefix = prefix;                  /* может быть NULL */
+    opts.max_keys = max_keys;              /* 0 → дефолт сервера */
+    opts.continuation_token = continuation_token; /* NULL → первая страница */
+    opts.flags = 0;
+
+    s3_list_objects_result_t res;
+    memset(&res, 0, sizeof(res));
+
+    s3_error_t err = S3_ERROR_INIT;
+    s3_error_code_t rc = s3_client_list_objects(client, &opts, &res, &err);
+
+    if (rc != S3_E_OK) {
+        /* На всякий случай подчистим результат, если там что-то успело заполниться. */
+        s3_list_objects_result_destroy(client, &res);
+
+        lua_pushnil(L);
+        l_s3_push_error(L, &err);
+        return 2;
+    }
+
+    /*
+     * Строим Lua-таблицу результата:
+     *
+     * {
+     *   objects = {
+     *     { key = "...", size = 123, etag = "...",
+     *       last_modified = "...", storage_class = "STANDARD" },
+     *     ...
+     *   },
+     *   is_truncated = true/false,
+     *   next_continuation_token = "..." or nil
+     * }
+     */
+
+    lua_newtable(L); /* result */
+
+    /* result.objects */
+    lua_createtable(L, (int)res.count, 0); /* objects array */
+
+    for (size_t i = 0; i < res.count; i++) {
+        s3_object_info_t *o = &res.objects[i];
+
+        lua_createtable(L, 0, 5); /* один объект */
+
+        if (o->key != NULL) {
+            lua_pushstring(L, o->key);
+            lua_setfield(L, -2, "key");
+        }
+
+        lua_pushinteger(L, (lua_Integer)o->size);
+        lua_setfield(L, -2, "size");
+
+        if (o->etag != NULL) {
+            lua_pushstring(L, o->etag);
+            lua_setfield(L, -2, "etag");
+        }
+
+        if (o->last_modified != NULL) {
+            lua_pushstring(L, o->last_modified);
+            lua_setfield(L, -2, "last_modified");
+        }
+
+        if (o->storage_class != NULL) {
+            lua_pushstring(L, o->storage_class);
+            lua_setfield(L, -2, "storage_class");
+        }
+
+        /* objects[i+1] = объект */
+        lua_rawseti(L, -2, (int)i + 1);
+    }
+
+    lua_setfield(L, -2, "objects"); /* result.objects = objects */
+
+    /* result.is_truncated */
+    lua_pushboolean(L, res.is_truncated);
+    lua_setfield(L, -2, "is_truncated");
+
+    /* result.next_continuation_token */
+    if (res.next_continuation_token != NULL) {
+        lua_pushstring(L, res.next_continuation_token);
+    } else {
+        lua_pushnil(L);
+    }
+    lua_setfield(L, -2, "next_continuation_token");
+
+    /* Освобождаем все строки/массив, выделенные клиентским аллокатором. */
+    s3_list_objects_result_destroy(client, &res);
+
+    /* Возвращаем только result, без err. */
+    return 1;
+}
+
+
+/*
+ * client:delete_objects(bucket, keys[, quiet]) -> bool | nil, err
+ *
+ * bucket:
+ *   - строка с именем бакета
+ *   - или nil → будет использован default_bucket клиента
+ *
+ * keys:
+ *   - массив строковых ключей: { "k1", "k2", "k3", ... }
+ *
+ * quiet (опционально):
+ *   - true  → <Quiet>true</Quiet> в XML (сервер не шлёт список успешно удалённых)
+ *   - false / nil → обычный режим
+ */
+static int
+l_s3_client_delete_objects(lua_State *L)
+{
+    struct l_s3_client *lc = l_s3_check_client(L, 1);
+    s3_client_t *client = lc->client;
+
+    /* 2-й аргумент: bucket (может быть nil) */
+    const char *bucket = NULL;
+    if (!lua_isnoneornil(L, 2))
+        bucket = luaL_checkstring(L, 2);
+
+    /* 3-й аргумент: keys (обязательная таблица-массив) */
+    luaL_checktype(L, 3, LUA_TTABLE);
+
+    /* 4-й аргумент: quiet (опционально) */
+    bool quiet = false;
+    if (!lua_isnoneornil(L, 4))
+        quiet = lua_toboolean(L, 4);
+
+    /* Кол-во элементов в таблице keys.
+     * В Tarantool/LuaJIT нет lua_rawlen, используем lua_objlen.
+     */
+    size_t count = lua_objlen(L, 3);
+    if (count == 0) {
+        /* Пустой список — считаем no-op и сразу успех. */
+        lua_pushboolean(L, 1);
+        return 1;
+    }
+
+    /* Массив описаний объектов храним в обычном malloc/free:
+     * он нужен только на время этого вызова и не используется библиотекой
+     * после возврата s3_client_delete_objects.
+     */
+    s3_delete_object_t *objs =
+        (s3_delete_object_t *)malloc(sizeof(*objs) * count);
+    if (objs == NULL) {
+        s3_error_t err = S3_ERROR_INIT;
+        err.code = S3_E_NOMEM;
+        err.os_error = ENOMEM;
+        snprintf(err.message, sizeof(err.message),
+                 "Out of memory in delete_objects");
+
+        lua_pushnil(L);
+        l_s3_push_error(L, &err);
+        return 2;
+    }
+
+    memset(objs, 0, sizeof(*objs) * count);
+
+    /* Заполняем массив из Lua-таблицы:
+     * ключи (строки Lua) живут до конца вызова C-функции, поэтому
+     * можно сохранять указатель (без копирования).
+     */
+    for (size_t i = 0; i < count; i++) {
+        lua_rawgeti(L, 3, (int)(i + 1));  /* keys[i+1] на вершине стека */
+
+        const char *key = luaL_checkstring(L, -1);
+        objs[i].key = key;
+
+        lua_pop(L, 1); /* убираем key со стека */
+    }
+
+    s3_delete_objects_opts_t opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.bucket  = bucket;   /* может быть NULL → default_bucket */
+    opts.objects = objs;
+    opts.count   = count;
+    opts.quiet   = quiet;
+    opts.flags   = 0;
+
+    s3_error_t err = S3_ERROR_INIT;
+    s3_error_code_t rc =
+        s3_client_delete_objects(client, &opts, &err);
+
+    free(objs);
+
+    if (rc == S3_E_OK) {
+        lua_pushboolean(L, 1);
+        return 1;
+    }
+
+    lua_pushnil(L);
+    l_s3_push_error(L, &err);
+    return 2;
+}
+
+
+/*
+ * client:get_ranges(bucket, key, ranges[, opts]) -> results | nil, err
+ *
+ * ranges — массив диапазонов одного объекта:
+ *   { offset, length }                          — вернуть строкой;
+ *   { offset = .., length = .., fd = .., fd_offset = .. } — записать в fd.
+ *
+ * opts (опционально):
+ *   max_gap     — склеивать диапазоны с дыркой до max_gap байт
+ *                 (по умолчанию 64 KiB);
+ *   max_span    — максимальный размер одного GET (0 — без ограничения);
+ *   concurrency — сколько GET выполнять одновременно (по умолчанию 8);
+ *   if_match    — ETag для If-Match.
+ *
+ * results[i] — строка для диапазонов в память, число записанных байт
+ * для диапазонов в fd.
+ */
+static int
+l_s3_client_get_ranges(lua_State *L)
+{
+    struct l_s3_client *lc = l_s3_check_client(L, 1);
+    s3_client_t *client = lc->client;
+
+    const char *bucket = NULL;
+    if (!lua_isnoneornil(L, 2))
+        bucket = luaL_checkstring(L, 2);
+
+    const char *key = luaL_checkstring(L, 3);
+    luaL_checktype(L, 4, LUA_TTABLE);
+
+    s3_get_ranges_opts_t opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.bucket = bucket;
+    opts.key = key;
+    opts.max_gap = S3_GET_RANGES_DEFAULT_GAP;
+
+    if (!lua_isnoneornil(L, 5)) {
+        luaL_checktype(L, 5, LUA_TTABLE);
+
+        lua_getfield(L, 5, "max_gap");
+        if (!lua_isnil(L, -1))
+            opts.max_gap = (uint64_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 5, "max_span");
+        if (!lua_isnil(L, -1))
+            opts.max_span = (uint64_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 5, "concurrency");
+        if (!lua_isnil(L, -1))
+            opts.concurrency = (uint32_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 5, "if_match");
+        if (!lua_isnil(L, -1))
+            opts.if_match = luaL_checkstring(L, -1);
+        lua_pop(L, 1);
+    }
+
+    size_t count = lua_objlen(L, 4);
+    if (count == 0) {
+        lua_newtable(L);
+        return 1;
+    }
+
+    s3_range_t *ranges = (s3_range_t *)calloc(count, sizeof(*ranges));
+    if (ranges == NULL)
+        return luaL_error(L, "get_ranges: out of memory");
+
+    /* Первый проход: разбираем диапазоны и считаем память под строки. */
+    size_t mem_total = 0;
+    for (size_t i = 0; i < count; i++) {
+        lua_rawgeti(L, 4, (int)(i + 1));
+        if (!lua_istable(L, -1)) {
+            free(ranges);
+            return luaL_error(L, "get_ranges: range #%d must be a table",
+                              (int)(i + 1));
+        }
+
+        s3_range_t *r = &ranges[i];
+        r->fd = -1;
+
+        lua_getfield(L, -1, "offset");
+        if (lua_isnil(L, -1)) {
+            lua_pop(L, 1);
+            lua_rawgeti(L, -1, 1);
+        }
+        r->offset = (uint64_t)lua_tointeger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, -1, "length");
+        if (lua_isnil(L, -1)) {
+            lua_pop(L, 1);
+            lua_rawgeti(L, -1, 2);
+        }
+        r->length = (size_t)lua_tointeger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, -1, "fd");
+        if (!lua_isnil(L, -1))
+            r->fd = (int)lua_tointeger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, -1, "fd_offset");
+        if (!lua_isnil(L, -1))
+            r->fd_offset = (off_t)lua_tointeger(L, -1);
+        lua_pop(L, 1);
+
+        lua_pop(L, 1);
+
+        if (r->length == 0) {
+            free(ranges);
+            return luaL_error(L, "get_ranges: range #%d has zero length",
+                              (int)(i + 1));
+        }
+        if (r->fd < 0)
+            mem_total += r->length;
+    }
+
+    char *mem = NULL;
+    if (mem_total > 0) {
+        mem = (char *)malloc(mem_total);
+        if (mem == NULL) {
+            free(ranges);
+            return luaL_error(L, "get_ranges: out of memory");
+        }
+
+        size_t pos = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (ranges[i].fd >= 0)
+                continue;
+            ranges[i].buf = mem + pos;
+            pos += ranges[i].length;
+        }
+    }
+
+    s3_error_t err = S3_ERROR_INIT;
+    s3_error_code_t rc = s3_client_get_ranges(client, &opts, ranges, count,
+                                              &err);
+
+    if (rc == S3_E_OK) {
+        lua_createtable(L, (int)count, 0);
+        for (size_t i = 0; i < count; i++) {
+            if (ranges[i].buf != NULL)
+                lua_pushlstring(L, (const char *)ranges[i].buf,
+                                ranges[i].bytes);
+            else
+                lua_pushinteger(L, (lua_Integer)ranges[i].bytes);
+            lua_rawseti(L, -2, (int)(i + 1));
+        }
+    }
+
+    free(mem);
+    free(ranges);
+
+    if (rc == S3_E_OK)
+        return 1;
+
+    lua_pushnil(L);
+    l_s3_push_error(L, &err);
+    return 2;
+}
+
+/*
+ * client:pread(bucket, key, offset, len[, etag]) -> data | nil, err
+ *
+ * Читает через кэш блоков клиента (block_cache_bytes), если он включён
+ * и передан etag; без etag — напрямую.
+ * Строка короче len — объект кончился.
+ */
+static int
+l_s3_client_pread(lua_State *L)
+{
+    struct l_s3_client *lc = l_s3_check_client(L, 1);
+    s3_client_t *client = lc->client;
+
+    s3_pread_opts_t opts;
+    memset(&opts, 0, sizeof(opts));
+    if (!lua_isnoneornil(L, 2))
+        opts.bucket = luaL_checkstring(L, 2);
+    opts.key = luaL_checkstring(L, 3);
+    uint64_t offset = (uint64_t)luaL_checkinteger(L, 4);
+    size_t len = (size_t)luaL_checkinteger(L, 5);
+    if (!lua_isnoneornil(L, 6))
+        opts.etag = luaL_checkstring(L, 6);
+
+    if (len == 0) {
+        lua_pushliteral(L, "");
+        return 1;
+    }
+
+    char *buf = (char *)malloc(len);
+    if (buf == NULL)
+        return luaL_error(L, "pread: out of memory");
+
+    size_t got = 0;
+    s3_error_t err = S3_ERROR_INIT;
+    s3_error_code_t rc = s3_client_pread(client, &opts, buf, len, offset,
+                                         &got, &err);
+    if (rc == S3_E_OK)
+        lua_pushlstring(L, buf, got);
+    free(buf);
+
+    if (rc == S3_E_OK)
+        return 1;
+
+    lua_pushnil(L);
+    l_s3_push_error(L, &err);
+    return 2;
+}
+
+/*
+ * client:stats() -> { requests, connections, http2_requests,
+ *                     requests_per_connection,
+ *                     block_cache_hits, block_cache_misses }
+ */
+static int
+l_s3_client_stats(lua_State *L)
+{
+    struct l_s3_client *lc = l_s3_check_client(L, 1);
+
+    s3_client_stats_t st;
+    s3_client_stats(lc->client, &st);
+
+    lua_createtable(L, 0, 6);
+
+    lua_pushinteger(L, (lua_Integer)st.requests);
+    lua_setfield(L, -2, "requests");
+
+    lua_pushinteger(L, (lua_Integer)st.connections);
+    lua_setfield(L, -2, "connections");
+
+    lua_pushinteger(L, (lua_Integer)st.http2_requests);
+    lua_setfield(L, -2, "http2_requests");
+
+    lua_pushnumber(L, st.requests_per_connection);
+    lua_setfield(L, -2, "requests_per_connection");
+
+    lua_pushinteger(L, (lua_Integer)st.block_cache_hits);
+    lua_setfield(L, -2, "block_cache_hits");
+
+    lua_pushinteger(L, (lua_Integer)st.block_cache_misses);
+    lua_setfield(L, -2, "block_cache_misses");
+
+    return 1;
+}
+
+/*
+ * client:endpoints() -> { { url, ewma_latency_ms, inflight, requests,
+ *                           errors, ejected }, ... }
+ *
+ * Пустая таблица, если клиент создан с одним endpoint.
+ */
+static int
+l_s3_client_endpoints(lua_State *L)
+{
+    struct l_s3_client *lc = l_s3_check_client(L, 1);
+    s3_client_t *client = lc->client;
+
+    size_t count = s3_client_endpoints(client, NULL, 0);
+    s3_endpoint_info_t *info = NULL;
+    if (count > 0) {
+        info = (s3_endpoint_info_t *)calloc(count, sizeof(*info));
+        if (info == NULL)
+            return luaL_error(L, "endpoints: out of memory");
+        count = s3_client_endpoints(client, info, count);
+    }
+
+    lua_createtable(L, (int)count, 0);
+    for (size_t i = 0; i < count; i++) {
+        lua_createtable(L, 0, 6);
+
+        lua_pushstring(L, info[i].url);
+        lua_setfield(L, -2, "url");
+
+        lua_pushnumber(L, info[i].ewma_latency_ms);
+        lua_setfield(L, -2, "ewma_latency_ms");
+
+        lua_pushinteger(L, (lua_Integer)info[i].inflight);
+        lua_setfield(L, -2, "inflight");
+
+        lua_pushinteger(L, (lua_Integer)info[i].requests);
+        lua_setfield(L, -2, "requests");
+
+        lua_pushinteger(L, (lua_Integer)info[i].errors);
+        lua_setfield(L, -2, "errors");
+
+        lua_pushboolean(L, info[i].ejected);
+        lua_setfield(L, -2, "ejected");
+
+        lua_rawseti(L, -2, (int)(i + 1));
+    }
+
+    free(info);
+    return 1;
+}
+
+/* ---------- pack ---------- */
+
+/*
+ * client:put_pack(bucket, key, members) -> true | nil, err
+ *
+ * members — таблица { [name] = data }, name и data — строки.
+ * Все member'ы загружаются одним PUT.
+ */
+static int
+l_s3_client_put_pack(lua_State *L)
+{
+    struct l_s3_client *lc = l_s3_check_client(L, 1);
+    s3_client_t *client = lc->client;
+
+    const char *bucket = NULL;
+    if (!lua_isnoneornil(L, 2))
+        bucket = luaL_checkstring(L, 2);
+
+    const char *key = luaL_checkstring(L, 3);
+    luaL_checktype(L, 4, LUA_TTABLE);
+
+    s3_error_t err = S3_ERROR_INIT;
+    s3_pack_writer_t *w = NULL;
+    if (s3_pack_writer_new(client, &w, &err) != S3_E_OK)
+        goto error;
+
+    lua_pushnil(L);
+    while (lua_next(L, 4) != 0) {
+        if (lua_type(L, -2) != LUA_TSTRING || lua_type(L, -1) != LUA_TSTRING) {
+            s3_pack_writer_delete(w);
+            return luaL_error(L, "put_pack: members must be {name = data} strings");
+        }
+
+        size_t size = 0;
+        const char *name = lua_tostring(L, -2);
+        const char *data = lua_tolstring(L, -1, &size);
+
+        if (s3_pack_writer_add(w, name, data, size, &err) != S3_E_OK) {
+            lua_pop(L, 2);
+            goto error;
+        }
+        lua_pop(L, 1);
+    }
+
+    s3_put_opts_t opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.bucket = bucket;
+    opts.key = key;
+
+    if (s3_pack_writer_finish(w, &opts, &err) != S3_E_OK)
+        goto error;
+
+    s3_pack_writer_delete(w);
+    lua_pushboolean(L, 1);
+    return 1;
+
+error:
+    s3_pack_writer_delete(w);
+    lua_pushnil(L);
+    l_s3_push_error(L, &err);
+    return 2;
+}
+
+/*
+ * client:open_pack(bucket, key) -> pack | nil, err
+ *
+ * Читает index pack'а (один-два Range GET). Методы pack:
+ *   pack:get(name)        -> data | nil, err
+ *   pack:get_fd(name, fd[, offset]) -> bytes_written | nil, err
+ *   pack:stat(name)       -> size | nil
+ *   pack:names()          -> { name, ... } в порядке index
+ *   pack:count()          -> количество member'ов
+ *   pack:close()
+ */
+static int
+l_s3_client_open_pack(lua_State *L)
+{
+    struct l_s3_client *lc = l_s3_check_client(L, 1);
+    s3_client_t *client = lc->client;
+
+    const char *bucket = NULL;
+    if (!lua_isnoneornil(L, 2))
+        bucket = luaL_checkstring(L, 2);
+
+    const char *key = luaL_checkstring(L, 3);
+
+    s3_pack_reader_t *reader = NULL;
+    s3_error_t err = S3_ERROR_INIT;
+    if (s3_pack_reader_open(client, bucket, key, &reader, &err) != S3_E_OK) {
+        lua_pushnil(L);
+        l_s3_push_error(L, &err);
+        return 2;
+    }
+
+    struct l_s3_pack *ud =
+        (struct l_s3_pack *)lua_newuserdata(L, sizeof(*ud));
+    ud->reader = reader;
+
+    /* reader живёт на allocator'е клиента — держим клиента от GC. */
+    lua_pushvalue(L, 1);
+    ud->client_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    luaL_getmetatable(L, S3_LUA_PACK_MT);
+    lua_setmetatable(L, -2);
+
+    return 1;
+}
+
+static struct l_s3_pack *
+l_s3_check_pack(lua_State *L, int idx)
+{
+    struct l_s3_pack *p =
+        (struct l_s3_pack *)luaL_checkudata(L, idx, S3_LUA_PACK_MT);
+    if (p->reader == NULL)
+        luaL_error(L, "attempt to use closed s3 pack");
+    return p;
+}
+
+/* pack:close() */
+static int
+l_s3_pack_close(lua_State *L)
+{
+    struct l_s3_pack *p =
+        (struct l_s3_pack *)luaL_checkudata(L, 1, S3_LUA_PACK_MT);
+
+    if (p->reader != NULL) {
+        s3_pack_reader_delete(p->reader);
+        p->reader = NULL;
+        luaL_unref(L, LUA_REGISTRYINDEX, p->client_ref);
+        p->client_ref = LUA_NOREF;
+    }
+    return 0;
+}
+
+/* pack:get(name) -> data | nil, err */
+static int
+l_s3_pack_get(lua_State *L)
+{
+    struct l_s3_pack *p = l_s3_check_pack(L, 1);
+    const char *name = luaL_checkstring(L, 2);
+
+    s3_error_t err = S3_ERROR_INIT;
+    uint64_t size = 0;
+    if (s3_pack_reader_stat(p->reader, name, &size) != S3_E_OK) {
+        s3_error_set(&err, S3_E_NOT_FOUND, "pack member not found", 0, 0, 0);
+        lua_pushnil(L);
+        l_s3_push_error(L, &err);
+        return 2;
+    }
+
+    if (size == 0) {
+        lua_pushliteral(L, "");
+        return 1;
+    }
+
+    char *buf = (char *)malloc((size_t)size);
+    if (buf == NULL)
+        return luaL_error(L, "pack:get: out of memory");
+
+    size_t got = 0;
+    s3_error_code_t rc = s3_pack_reader_get_buf(p->reader, name, buf,
+                                                (size_t)size, &got, &err);
+    if (rc == S3_E_OK)
+        lua_pushlstring(L, buf, got);
+    free(buf);
+
+    if (rc == S3_E_OK)
+        return 1;
+
+    lua_pushnil(L);
+    l_s3_push_error(L, &err);
+    return 2;
+}
+
+/* pack:get_fd(name, fd[, offset]) -> bytes_written | nil, err */
+static int
+l_s3_pack_get_fd(lua_State *L)
+{
+    struct l_s3_pack *p = l_s3_check_pack(L, 1);
+    const char *name = luaL_checkstring(L, 2);
+    int fd = luaL_checkinteger(L, 3);
+
+    off_t offset = 0;
+    if (!lua_isnoneornil(L, 4))
+        offset = (off_t)luaL_checkinteger(L, 4);
+
+    size_t bytes_written = 0;
+    s3_error_t err = S3_ERROR_INIT;
+    s3_error_code_t rc = s3_pack_reader_get_fd(p->reader, name, fd, offset,
+                                               &bytes_written, &err);
+    if (rc == S3_E_OK) {
+        lua_pushinteger(L, (lua_Integer)bytes_written);
+        return 1;
+    }
+
+    lua_pushnil(L);
+    l_s3_push_error(L, &err);
+    return 2;
+}
+
+/* pack:stat(name) -> size | nil */
+static int
+l_s3_pack_stat(lua_State *L)
+{
+    struct l_s3_pack *p = l_s3_check_pack(L, 1);
+    const char *name = luaL_checkstring(L, 2);
+
+    uint64_t size = 0;
+    if (s3_pack_reader_stat(p->reader, name, &size) != S3_E_OK) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_pushinteger(L, (lua_Integer)size);
+    return 1;
+}
+
+/* pack:names() -> { name, ... } */
+static int
+l_s3_pack_names(lua_State *L)
+{
+    struct l_s3_pack *p = l_s3_check_pack(L, 1);
+    size_t count = s3_pack_reader_count(p->reader);
+
+    lua_createtable(L, (int)count, 0);
+    for (size_t i = 0; i < count; i++) {
+        const char *name = NULL;
+        size_t name_len = 0;
+        s3_pack_reader_member(p->reader, i, &name, &name_len, NULL);
+        lua_pushlstring(L, name, name_len);
+        lua_rawseti(L, -2, (int)(i + 1));
+    }
+    return 1;
+}
+
+/* pack:count() */
+static int
+l_s3_pack_count(lua_State *L)
+{
+    struct l_s3_pack *p = l_s3_check_pack(L, 1);
+    lua_pushinteger(L, (lua_Integer)s3_pack_reader_count(p->reader));
+    return 1;
+}
+
+/*
+ * client:head(bucket, key) -> { size = .., etag = .. } | nil, err
+ */
+static int
+l_s3_client_head(lua_State *L)
+{
+    struct l_s3_client *lc = l_s3_check_client(L, 1);
+
+    const char *bucket = NULL;
+    if (!lua_isnoneornil(L, 2))
+        bucket = luaL_checkstring(L, 2);
+    const char *key = luaL_checkstring(L, 3);
+
+    s3_head_info_t info;
+    s3_error_t err = S3_ERROR_INIT;
+    if (s3_client_head(lc->client, bucket, key, &info, &err) != S3_E_OK) {
+        lua_pushnil(L);
+        l_s3_push_error(L, &err);
+        return 2;
+    }
+
+    lua_createtable(L, 0, 2);
+    lua_pushinteger(L, (lua_Integer)info.size);
+    lua_setfield(L, -2, "size");
+    lua_pushstring(L, info.etag);
+    lua_setfield(L, -2, "etag");
+    return 1;
+}
+
+/*
+ * client:open_read(bucket, key[, opts]) -> reader | nil, err
+ *
+ * opts: min_window, max_window, prefetch. Методы reader'а:
+ *   reader:read([n])   -> data | nil (конец) | nil, err;
+ *                         без n — следующий кусок окна как есть
+ *   reader:lines()     -> итератор по строкам (без '\n')
+ *   reader:seek(offset[, whence]) -> pos; whence: "set", "cur", "end"
+ *   reader:tell(), reader:size()
+ *   reader:close()
+ */
+/* Reader освобождён (возможно, из фонового файбера) — клиент не нужен. */
+static void
+l_s3_reader_on_free(void *arg)
+{
+    luaL_unref(luaT_state(), LUA_REGISTRYINDEX, (int)(intptr_t)arg);
+}
+
+static int
+l_s3_client_open_read(lua_State *L)
+{
+    struct l_s3_client *lc = l_s3_check_client(L, 1);
+
+    s3_reader_opts_t opts;
+    memset(&opts, 0, sizeof(opts));
+    if (!lua_isnoneornil(L, 2))
+        opts.bucket = luaL_checkstring(L, 2);
+    opts.key = luaL_checkstring(L, 3);
+
+    if (!lua_isnoneornil(L, 4)) {
+        luaL_checktype(L, 4, LUA_TTABLE);
+
+        lua_getfield(L, 4, "min_window");
+        if (!lua_isnil(L, -1))
+            opts.min_window = (size_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 4, "max_window");
+        if (!lua_isnil(L, -1))
+            opts.max_window = (size_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 4, "prefetch");
+        if (!lua_isnil(L, -1))
+            opts.prefetch = (uint32_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+    }
+
+    /* Клиент держится, пока reader не освобождён, а не до close(). */
+    lua_pushvalue(L, 1);
+    int client_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    opts.on_free = l_s3_reader_on_free;
+    opts.on_free_arg = (void *)(intptr_t)client_ref;
+
+    s3_reader_t *reader = NULL;
+    s3_error_t err = S3_ERROR_INIT;
+    if (s3_reader_open(lc->client, &opts, &reader, &err) != S3_E_OK) {
+        luaL_unref(L, LUA_REGISTRYINDEX, client_ref);
+        lua_pushnil(L);
+        l_s3_push_error(L, &err);
+        return 2;
+    }
+
+    struct l_s3_reader *ud =
+        (struct l_s3_reader *)lua_newuserdata(L, sizeof(*ud));
+    ud->reader = reader;
+    ud->client_ref = client_ref;
+
+    luaL_getmetatable(L, S3_LUA_READER_MT);
+    lua_setmetatable(L, -2);
+
+    return 1;
+}
+
+static struct l_s3_reader *
+l_s3_check_reader(lua_State *L, int idx)
+{
+    struct l_s3_reader *r =
+        (struct l_s3_reader *)luaL_checkudata(L, idx, S3_LUA_READER_MT);
+    if (r->reader == NULL)
+        luaL_error(L, "attempt to use closed s3 reader");
+    return r;
+}
+
+/* reader:close() */
+static int
+l_s3_reader_close(lua_State *L)
+{
+    struct l_s3_reader *r =
+        (struct l_s3_reader *)luaL_checkudata(L, 1, S3_LUA_READER_MT);
+
+    /* client_ref отпустит l_s3_reader_on_free. */
+    if (r->reader != NULL) {
+        s3_reader_delete(r->reader);
+        r->reader = NULL;
+        r->client_ref = LUA_NOREF;
+    }
+    return 0;
+}
+
+/* reader:read([n]) -> data | nil | nil, err */
+static int
+l_s3_reader_read(lua_State *L)
+{
+    struct l_s3_reader *r = l_s3_check_reader(L, 1);
+    s3_error_t err = S3_ERROR_INIT;
+
+    const void *data = NULL;
+    size_t len = 0;
+    if (s3_reader_peek(r->reader, &data, &len, &err) != S3_E_OK)
+        goto error;
+    if (len == 0) {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    if (lua_isnoneornil(L, 2)) {
+        lua_pushlstring(L, (const char *)data, len);
+        s3_reader_consume(r->reader, len);
+        return 1;
+    }
+
+    size_t n = (size_t)luaL_checkinteger(L, 2);
+    if (n <= len) {
+        lua_pushlstring(L, (const char *)data, n);
+        s3_reader_consume(r->reader, n);
+        return 1;
+    }
+
+    /* Запрос шире текущего блока — собираем из нескольких. */
+    luaL_Buffer b;
+    luaL_buffinit(L, &b);
+    while (n > 0 && len > 0) {
+        size_t take = len < n ? len : n;
+        luaL_addlstring(&b, (const char *)data, take);
+        s3_reader_consume(r->reader, take);
+        n -= take;
+        if (n > 0 &&
+            s3_reader_peek(r->reader, &data, &len, &err) != S3_E_OK)
+        {
+            luaL_pushresult(&b);
+            lua_pop(L, 1);
+            goto error;
+        }
+    }
+    luaL_pushresult(&b);
+    return 1;
+
+error:
+    lua_pushnil(L);
+    l_s3_push_error(L, &err);
+    return 2;
+}
+
+/* Итератор reader:lines(): upvalue 1 — reader. */
+static int
+l_s3_reader_lines_iter(lua_State *L)
+{
+    struct l_s3_reader *r = l_s3_check_reader(L, lua_upvalueindex(1));
+    s3_error_t err = S3_ERROR_INIT;
+
+    luaL_Buffer b;
+    luaL_buffinit(L, &b);
+    bool any = false;
+
+    for (;;) {
+        const void *data = NULL;
+        size_t len = 0;
+        if (s3_reader_peek(r->reader, &data, &len, &err) != S3_E_OK) {
+            luaL_pushresult(&b);
+            lua_pop(L, 1);
+            l_s3_push_error(L, &err);
+            return lua_error(L);
+        }
+        if (len == 0)
+            break;
+
+        any = true;
+        const char *nl = (const char *)memchr(data, '\n', len);
+        if (nl != NULL) {
+            size_t take = (size_t)(nl - (const char *)data);
+            luaL_addlstring(&b, (const char *)data, take);
+            s3_reader_consume(r->reader, take + 1);
+            luaL_pushresult(&b);
+            return 1;
+        }
+        luaL_addlstring(&b, (const char *)data, len);
+        s3_reader_consume(r->reader, len);
+    }
+
+    luaL_pushresult(&b);
+    if (!any) {
+        lua_pop(L, 1);
+        lua_pushnil(L);
+    }
+    return 1;
+}
+
+/* reader:lines() -> iterator */
+static int
+l_s3_reader_lines(lua_State *L)
+{
+    l_s3_check_reader(L, 1);
+    lua_pushvalue(L, 1);
+    lua_pushcclosure(L, l_s3_reader_lines_iter, 1);
+    return 1;
+}
+
+/* reader:seek(offset[, whence]) -> pos | nil, err */
+static int
+l_s3_reader_seek(lua_State *L)
+{
+    struct l_s3_reader *r = l_s3_check_reader(L, 1);
+    int64_t offset = (int64_t)luaL_checkinteger(L, 2);
+    const char *whence = luaL_optstring(L, 3, "set");
+
+    int64_t base = 0;
+    if (strcmp(whence, "cur") == 0)
+        base = (int64_t)s3_reader_tell(r->reader);
+    else if (strcmp(whence, "end") == 0)
+        base = (int64_t)s3_reader_size(r->reader);
+    else if (strcmp(whence, "set") != 0)
+        return luaL_error(L, "reader:seek: bad whence '%s'", whence);
+
+    s3_error_t err = S3_ERROR_INIT;
+    if (base + offset < 0) {
+        s3_error_set(&err, S3_E_INVALID_ARG,
+                     "seek before start of object", 0, 0, 0);
+    } else if (s3_reader_seek(r->reader, (uint64_t)(base + offset),
+                              &err) == S3_E_OK) {
+        lua_pushinteger(L, (lua_Integer)s3_reader_tell(r->reader));
+        return 1;
+    }
+
+    lua_pushnil(L);
+    l_s3_push_error(L, &err);
+    return 2;
+}
+
+/* reader:tell() */
+static int
+l_s3_reader_tell(lua_State *L)
+{
+    struct l_s3_reader *r = l_s3_check_reader(L, 1);
+    lua_pushinteger(L, (lua_Integer)s3_reader_tell(r->reader));
+    return 1;
+}
+
+/* reader:size() */
+static int
+l_s3_reader_size(lua_State *L)
+{
+    struct l_s3_reader *r = l_s3_check_reader(L, 1);
+    lua_pushinteger(L, (lua_Integer)s3_reader_size(r->reader));
+    return 1;
+}
+
+/*
+ * client:open_write(bucket, key[, opts]) -> writer | nil, err
+ *
+ * opts: content_type, part_size, concurrency. Методы writer'а:
+ *   writer:write(data) -> true | nil, err
+ *   writer:close()     -> etag | nil, err
+ *   writer:abort()
+ *   writer:bytes()     -> сколько записано
+ *
+ * Незакрытый writer при сборке мусора отменяет загрузку, ожидая части
+ * в полёте прямо в tx-треде, — закрывайте его явно.
+ */
+static int
+l_s3_client_open_write(lua_State *L)
+{
+    struct l_s3_client *lc = l_s3_check_client(L, 1);
+
+    s3_writer_opts_t opts;
+    memset(&opts, 0, sizeof(opts));
+    if (!lua_isnoneornil(L, 2))
+        opts.bucket = luaL_checkstring(L, 2);
+    opts.key = luaL_checkstring(L, 3);
+
+    if (!lua_isnoneornil(L, 4)) {
+        luaL_checktype(L, 4, LUA_TTABLE);
+
+        lua_getfield(L, 4, "content_type");
+        if (!lua_isnil(L, -1))
+            opts.content_type = luaL_checkstring(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 4, "part_size");
+        if (!lua_isnil(L, -1))
+            opts.part_size = (size_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 4, "concurrency");
+        if (!lua_isnil(L, -1))
+            opts.concurrency = (uint32_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+    }
+
+    s3_writer_t *writer = NULL;
+    s3_error_t err = S3_ERROR_INIT;
+    if (s3_writer_open(lc->client, &opts, &writer, &err) != S3_E_OK) {
+        lua_pushnil(L);
+        l_s3_push_error(L, &err);
+        return 2;
+    }
+
+    struct l_s3_writer *ud =
+        (struct l_s3_writer *)lua_newuserdata(L, sizeof(*ud));
+    ud->writer = writer;
+
+    lua_pushvalue(L, 1);
+    ud->client_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    luaL_getmetatable(L, S3_LUA_WRITER_MT);
+    lua_setmetatable(L, -2);
+
+    return 1;
+}
+
+static struct l_s3_writer *
+l_s3_check_writer(lua_State *L, int idx)
+{
+    struct l_s3_writer *w =
+        (struct l_s3_writer *)luaL_checkudata(L, idx, S3_LUA_WRITER_MT);
+    if (w->writer == NULL)
+        luaL_error(L, "attempt to use closed s3 writer");
+    return w;
+}
+
+static void
+l_s3_writer_release(lua_State *L, struct l_s3_writer *w)
+{
+    s3_writer_delete(w->writer);
+    w->writer = NULL;
+    luaL_unref(L, LUA_REGISTRYINDEX, w->client_ref);
+    w->client_ref = LUA_NOREF;
+}
+
+/* writer:write(data) -> true | nil, err */
+static int
+l_s3_writer_write(lua_State *L)
+{
+    struct l_s3_writer *w = l_s3_check_writer(L, 1);
+    size_t len = 0;
+    const char *data = luaL_checklstring(L, 2, &len);
+
+    s3_error_t err = S3_ERROR_INIT;
+    if (s3_writer_write(w->writer, data, len, &err) != S3_E_OK) {
+        lua_pushnil(L);
+        l_s3_push_error(L, &err);
+        return 2;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+/* writer:close() -> etag | nil, err */
+static int
+l_s3_writer_close(lua_State *L)
+{
+    struct l_s3_writer *w = l_s3_check_writer(L, 1);
+
+    char etag[S3_ETAG_MAX];
+    s3_error_t err = S3_ERROR_INIT;
+    s3_error_code_t rc = s3_writer_close(w->writer, etag, &err);
+    l_s3_writer_release(L, w);
+
+    if (rc == S3_E_OK) {
+        lua_pushstring(L, etag);
+        return 1;
+    }
+
+    lua_pushnil(L);
+    l_s3_push_error(L, &err);
+    return 2;
+}
+
+/* writer:abort() */
+static int
+l_s3_writer_abort(lua_State *L)
+{
+    struct l_s3_writer *w =
+        (struct l_s3_writer *)luaL_checkudata(L, 1, S3_LUA_WRITER_MT);
+    if (w->writer != NULL) {
+        s3_writer_abort(w->writer);
+        l_s3_writer_release(L, w);
+    }
+    return 0;
+}
+
+/*
+ * Брошенные writer'ы: в __gc ни уступать, ни ждать поток нельзя, поэтому
+ * отмену делает отдельный файбер (abort через coio_call), а ссылка на
+ * клиента держится, пока фоновый поток writer'а не закончил.
+ */
+struct l_s3_reap {
+    struct l_s3_reap *next;
+    s3_writer_t *writer;
+    int client_ref;
+};
+
+static struct {
+    struct l_s3_reap *head;
+    struct fiber *fiber;
+    struct fiber_cond *cond;
+} l_s3_reaper;
+
+static int
+l_s3_reaper_main(va_list ap)
+{
+    (void)ap;
+    for (;;) {
+        while (l_s3_reaper.head == NULL) {
+            if (fiber_cond_wait(l_s3_reaper.cond) != 0 &&
+                fiber_is_cancelled())
+            {
+                l_s3_reaper.fiber = NULL;
+                return 0;
+            }
+        }
+        struct l_s3_reap *r = l_s3_reaper.head;
+        l_s3_reaper.head = r->next;
+
+        s3_writer_abort(r->writer);
+        s3_writer_delete(r->writer);
+        luaL_unref(luaT_state(), LUA_REGISTRYINDEX, r->client_ref);
+        free(r);
+    }
+}
+
+static void
+l_s3_reaper_start(void)
+{
+    if (l_s3_reaper.fiber != NULL)
+        return;
+    if (l_s3_reaper.cond == NULL)
+        l_s3_reaper.cond = fiber_cond_new();
+    if (l_s3_reaper.cond == NULL)
+        return;
+    l_s3_reaper.fiber = fiber_new("s3_reaper", l_s3_reaper_main);
+    if (l_s3_reaper.fiber != NULL)
+        fiber_start(l_s3_reaper.fiber);
+}
+
+/* __gc: без coio_call и без ожидания потока — только в очередь. */
+static int
+l_s3_writer_gc(lua_State *L)
+{
+    struct l_s3_writer *w =
+        (struct l_s3_writer *)luaL_checkudata(L, 1, S3_LUA_WRITER_MT);
+    if (w->writer == NULL)
+        return 0;
+
+    struct l_s3_reap *r = NULL;
+    if (l_s3_reaper.fiber != NULL)
+        r = (struct l_s3_reap *)malloc(sizeof(*r));
+    if (r == NULL) {
+        /* Без файбера — delete отпустит поток, тот доделает сам. */
+        l_s3_writer_release(L, w);
+        return 0;
+    }
+    r->writer = w->writer;
+    r->client_ref = w->client_ref;
+    r->next = l_s3_reaper.head;
+    l_s3_reaper.head = r;
+    w->writer = NULL;
+    w->client_ref = LUA_NOREF;
+    fiber_cond_signal(l_s3_reaper.cond);
+    return 0;
+}
+
+/* writer:bytes() */
+static int
+l_s3_writer_bytes(lua_State *L)
+{
+    struct l_s3_writer *w = l_s3_check_writer(L, 1);
+    lua_pushinteger(L, (lua_Integer)s3_writer_bytes(w->writer));
+    return 1;
+}
 
-        lua_pushnil(L);
-        l_s3_push_error(L, &err);
-        return 2;
-    }
+/* ---------- очередь отложенных загрузок ---------- */
 
-    memset(objs, 0, sizeof(*objs) * count);
+#define S3_LUA_QUEUE_DEFAULT_SPACE        "s3_queue"
+#define S3_LUA_QUEUE_DEFAULT_CONCURRENCY  8
+#define S3_LUA_QUEUE_MAX_CONCURRENCY      64
+#define S3_LUA_QUEUE_DEFAULT_MAX_ATTEMPTS 10
+#define S3_LUA_QUEUE_IDLE                 1.0  /* опрос пустой очереди, с */
+#define S3_LUA_QUEUE_BACKOFF_MIN          0.5
+#define S3_LUA_QUEUE_BACKOFF_MAX          30.0
 
-    /* Заполняем массив из Lua-таблицы:
-     * ключи (строки Lua) живут до конца вызова C-функции, поэтому
-     * можно сохранять указатель (без копирования).
-     */
-    for (size_t i = 0; i < count; i++) {
-        lua_rawgeti(L, 3, (int)(i + 1));  /* keys[i+1] на вершине стека */
+/*
+ * Работа со спейсом очереди. Первичный ключ {bucket, key}: новая запись
+ * объекта заменяет ещё не загруженную. seq — порядок выдачи; упавшая
+ * запись получает новый seq и уходит в конец. done/fail не трогают
+ * запись, если её успели заменить (seq другой).
+ */
+static const char l_s3_queue_lua[] =
+"local name = ...\n"
+"local s = box.space[name]\n"
+"if s == nil then\n"
+"    s = box.schema.space.create(name, {format = {\n"
+"        {name = 'bucket', type = 'string'},\n"
+"        {name = 'key', type = 'string'},\n"
+"        {name = 'seq', type = 'unsigned'},\n"
+"        {name = 'path', type = 'string'},\n"
+"        {name = 'data', type = 'string'},\n"
+"        {name = 'content_type', type = 'string'},\n"
+"        {name = 'attempts', type = 'unsigned'},\n"
+"    }})\n"
+"    s:create_index('primary', {parts = {'bucket', 'key'}})\n"
+"    s:create_index('seq', {parts = {'seq'}})\n"
+"end\n"
+"local last = s.index.seq:max()\n"
+"local seq = last ~= nil and last[3] or 0\n"
+"local function next_seq() seq = seq + 1 return seq end\n"
+"return {\n"
+"    put = function(bucket, key, path, data, ctype)\n"
+"        s:replace({bucket, key, next_seq(), path, data, ctype, 0})\n"
+"    end,\n"
+"    take = function(n)\n"
+"        local out = {}\n"
+"        for _, t in s.index.seq:pairs() do\n"
+"            if #out == n then break end\n"
+"            out[#out + 1] = t:totable()\n"
+"        end\n"
+"        return out\n"
+"    end,\n"
+"    done = function(bucket, key, sq)\n"
+"        local t = s:get({bucket, key})\n"
+"        if t ~= nil and t[3] == sq then s:delete({bucket, key}) end\n"
+"    end,\n"
+"    fail = function(bucket, key, sq, max)\n"
+"        local t = s:get({bucket, key})\n"
+"        if t == nil or t[3] ~= sq then return false end\n"
+"        if t[7] + 1 >= max then\n"
+"            s:delete({bucket, key})\n"
+"            return true\n"
+"        end\n"
+"        s:update({bucket, key}, {{'=', 3, next_seq()}, {'+', 7, 1}})\n"
+"        return false\n"
+"    end,\n"
+"    len = function() return s:len() end,\n"
+"}\n";
+
+/* api.<fn>: nargs аргументов уже на вершине стека L. */
+static int
+l_s3_queue_call(lua_State *L, struct l_s3_queue *q, const char *fn,
+                int nargs, int nresults)
+{
+    lua_rawgeti(L, LUA_REGISTRYINDEX, q->api_ref);
+    lua_getfield(L, -1, fn);
+    lua_remove(L, -2);
+    lua_insert(L, -(nargs + 1));
+    return lua_pcall(L, nargs, nresults, 0) == 0 ? 0 : -1;
+}
 
-        const char *key = luaL_checkstring(L, -1);
-        objs[i].key = key;
+/* Пауза, которую прерывает только close(). */
+static void
+l_s3_queue_sleep(struct l_s3_queue *q, double timeout)
+{
+    double deadline = fiber_clock() + timeout;
+    double now;
+    while (!q->stopping && !fiber_is_cancelled() &&
+           (now = fiber_clock()) < deadline)
+        fiber_cond_wait_timeout(q->cond, deadline - now);
+}
 
-        lua_pop(L, 1); /* убираем key со стека */
+/* Строка поля записи очереди; "" — NULL. */
+static const char *
+l_s3_queue_field(lua_State *L, int tuple, int field)
+{
+    lua_rawgeti(L, tuple, field);
+    const char *s = lua_tostring(L, -1);
+    lua_pop(L, 1); /* строка остаётся жить в таблице записи */
+    return s != NULL && s[0] != '\0' ? s : NULL;
+}
+
+/*
+ * Файбер очереди: берёт из спейса до concurrency записей, грузит их
+ * одной пачкой s3_client_put_many и отмечает результат. Пачка целиком
+ * не прошла — пауза с экспоненциальным ростом.
+ */
+static int
+l_s3_queue_main(va_list ap)
+{
+    struct l_s3_queue *q = va_arg(ap, struct l_s3_queue *);
+    lua_State *L = q->L;
+    s3_put_item_t items[S3_LUA_QUEUE_MAX_CONCURRENCY];
+    double backoff = 0;
+
+    while (!q->stopping && !fiber_is_cancelled()) {
+        if (q->lc->client == NULL) {
+            say_warn("s3 queue: client is closed, stopping");
+            break;
+        }
+
+        lua_settop(L, 0);
+        lua_pushinteger(L, q->concurrency);
+        if (l_s3_queue_call(L, q, "take", 1, 1) != 0) {
+            say_error("s3 queue: %s", lua_tostring(L, -1));
+            l_s3_queue_sleep(q, S3_LUA_QUEUE_IDLE);
+            continue;
+        }
+
+        size_t n = lua_objlen(L, 1);
+        if (n == 0) {
+            fiber_cond_wait_timeout(q->cond, S3_LUA_QUEUE_IDLE);
+            continue;
+        }
+
+        memset(items, 0, n * sizeof(items[0]));
+        for (size_t i = 0; i < n; i++) {
+            lua_rawgeti(L, 1, (int)(i + 1));
+            int t = lua_gettop(L);
+            items[i].bucket = l_s3_queue_field(L, t, 1);
+            lua_rawgeti(L, t, 2);
+            items[i].key = lua_tostring(L, -1);
+            lua_pop(L, 1);
+            items[i].path = l_s3_queue_field(L, t, 4);
+            lua_rawgeti(L, t, 5);
+            items[i].data = lua_tolstring(L, -1, &items[i].size);
+            lua_pop(L, 1);
+            items[i].content_type = l_s3_queue_field(L, t, 6);
+            lua_pop(L, 1);
+        }
+
+        s3_client_put_many(q->lc->client, items, n, q->concurrency, NULL);
+
+        size_t ok = 0;
+        for (size_t i = 0; i < n; i++) {
+            lua_rawgeti(L, 1, (int)(i + 1));
+            int t = lua_gettop(L);
+            lua_rawgeti(L, t, 1);
+            lua_rawgeti(L, t, 2);
+            lua_rawgeti(L, t, 3);
+
+            int rc;
+            if (items[i].code == S3_E_OK) {
+                ok++;
+                q->uploaded++;
+                rc = l_s3_queue_call(L, q, "done", 3, 0);
+            } else {
+                q->failed++;
+                lua_pushinteger(L, q->max_attempts);
+                rc = l_s3_queue_call(L, q, "fail", 4, 1);
+                if (rc == 0 && lua_toboolean(L, -1)) {
+                    q->dropped++;
+                    say_error("s3 queue: dropped %s after %u attempts: %s",
+                              items[i].key, (unsigned)q->max_attempts,
+                              s3_error_message(&items[i].err));
+                } else if (rc == 0) {
+                    say_warn("s3 queue: upload of %s failed: %s",
+                             items[i].key, s3_error_message(&items[i].err));
+                }
+            }
+            if (rc != 0)
+                say_error("s3 queue: %s", lua_tostring(L, -1));
+            lua_settop(L, 1);
+        }
+
+        if (ok > 0) {
+            backoff = 0;
+            continue;
+        }
+        backoff = backoff == 0 ? S3_LUA_QUEUE_BACKOFF_MIN : backoff * 2;
+        if (backoff > S3_LUA_QUEUE_BACKOFF_MAX)
+            backoff = S3_LUA_QUEUE_BACKOFF_MAX;
+        l_s3_queue_sleep(q, backoff);
     }
 
-    s3_delete_objects_opts_t opts;
-    memset(&opts, 0, sizeof(opts));
-    opts.bucket  = bucket;   /* может быть NULL → default_bucket */
-    opts.objects = objs;
-    opts.count   = count;
-    opts.quiet   = quiet;
-    opts.flags   = 0;
+    lua_settop(L, 0);
+    return 0;
+}
+
+static void
+l_s3_queue_release(lua_State *L, struct l_s3_queue *q)
+{
+    for (struct l_s3_queue **p = &l_s3_queues; *p != NULL; p = &(*p)->next) {
+        if (*p == q) {
+            *p = q->next;
+            break;
+        }
+    }
+    q->next = NULL;
+    free(q->space);
+    q->space = NULL;
+    luaL_unref(L, LUA_REGISTRYINDEX, q->api_ref);
+    luaL_unref(L, LUA_REGISTRYINDEX, q->thread_ref);
+    luaL_unref(L, LUA_REGISTRYINDEX, q->client_ref);
+    luaL_unref(L, LUA_REGISTRYINDEX, q->self_ref);
+    q->api_ref = q->thread_ref = q->client_ref = q->self_ref = LUA_NOREF;
+    q->L = NULL;
+    if (q->cond != NULL) {
+        fiber_cond_delete(q->cond);
+        q->cond = NULL;
+    }
+}
+
+/*
+ * client:queue([opts]) -> queue | nil, err
+ *
+ * Очередь отложенных загрузок в спейсе box (создаётся, если его нет):
+ * queue:put() только пишет запись и сразу возвращает управление, файбер
+ * очереди грузит записи в фоне. Незагруженное переживает рестарт —
+ * после box.cfg{} достаточно снова вызвать client:queue() с тем же
+ * спейсом. На один спейс — одна очередь: пока она открыта, второй
+ * client:queue() с ним возвращает ошибку.
+ *
+ * opts: space (по умолчанию "s3_queue"), concurrency (по умолчанию 8,
+ *       не больше 64), max_attempts (по умолчанию 10; после стольких
+ *       неудач запись удаляется с ошибкой в логе).
+ *
+ * Очередь работает до queue:close() или client:close() её клиента,
+ * сборщик мусора её не закрывает.
+ */
+static int
+l_s3_client_queue(lua_State *L)
+{
+    struct l_s3_client *lc = l_s3_check_client(L, 1);
+    const char *space = S3_LUA_QUEUE_DEFAULT_SPACE;
+    uint32_t concurrency = S3_LUA_QUEUE_DEFAULT_CONCURRENCY;
+    uint32_t max_attempts = S3_LUA_QUEUE_DEFAULT_MAX_ATTEMPTS;
+
+    if (!lua_isnoneornil(L, 2)) {
+        luaL_checktype(L, 2, LUA_TTABLE);
+
+        lua_getfield(L, 2, "space");
+        if (!lua_isnil(L, -1))
+            space = luaL_checkstring(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 2, "concurrency");
+        if (!lua_isnil(L, -1))
+            concurrency = (uint32_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 2, "max_attempts");
+        if (!lua_isnil(L, -1))
+            max_attempts = (uint32_t)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+    }
+    if (concurrency == 0 || concurrency > S3_LUA_QUEUE_MAX_CONCURRENCY)
+        return luaL_error(L, "queue: concurrency must be in 1..%d",
+                          S3_LUA_QUEUE_MAX_CONCURRENCY);
+    if (max_attempts == 0)
+        return luaL_error(L, "queue: max_attempts must be positive");
 
     s3_error_t err = S3_ERROR_INIT;
-    s3_error_code_t rc =
-        s3_client_delete_objects(client, &opts, &err);
+    for (struct l_s3_queue *o = l_s3_queues; o != NULL; o = o->next) {
+        if (strcmp(o->space, space) == 0) {
+            s3_error_set(&err, S3_E_INVALID_ARG,
+                         "queue on this space is already open", 0, 0, 0);
+            lua_pushnil(L);
+            l_s3_push_error(L, &err);
+            return 2;
+        }
+    }
 
-    free(objs);
+    if (luaL_loadbuffer(L, l_s3_queue_lua, sizeof(l_s3_queue_lua) - 1,
+                        "=s3_queue") != 0)
+        goto lua_fail;
+    lua_pushstring(L, space);
+    if (lua_pcall(L, 1, 1, 0) != 0)
+        goto lua_fail;
+    int api = lua_gettop(L);
+
+    struct l_s3_queue *q =
+        (struct l_s3_queue *)lua_newuserdata(L, sizeof(*q));
+    memset(q, 0, sizeof(*q));
+    q->api_ref = q->thread_ref = q->client_ref = q->self_ref = LUA_NOREF;
+    luaL_getmetatable(L, S3_LUA_QUEUE_MT);
+    lua_setmetatable(L, -2);
 
-    if (rc == S3_E_OK) {
-        lua_pushboolean(L, 1);
-        return 1;
+    q->lc = lc;
+    q->concurrency = concurrency;
+    q->max_attempts = max_attempts;
+
+    lua_pushvalue(L, 1);
+    q->client_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    lua_pushvalue(L, api);
+    q->api_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    q->L = lua_newthread(L);
+    q->thread_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    q->space = strdup(space);
+    q->cond = q->space != NULL ? fiber_cond_new() : NULL;
+    q->fiber = q->cond != NULL ? fiber_new("s3_queue", l_s3_queue_main) :
+                                 NULL;
+    if (q->fiber == NULL) {
+        l_s3_queue_release(L, q);
+        s3_error_set(&err, S3_E_NOMEM, "cannot start queue fiber",
+                     ENOMEM, 0, 0);
+        lua_pushnil(L);
+        l_s3_push_error(L, &err);
+        return 2;
     }
 
+    /* Пока файбер жив, userdata не должна собираться. */
+    lua_pushvalue(L, -1);
+    q->self_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    q->next = l_s3_queues;
+    l_s3_queues = q;
+
+    fiber_set_joinable(q->fiber, true);
+    fiber_start(q->fiber, q);
+    return 1;
+
+lua_fail:
+    s3_error_set(&err, S3_E_INVALID_ARG, lua_tostring(L, -1), 0, 0, 0);
     lua_pushnil(L);
     l_s3_push_error(L, &err);
     return 2;
 }
 
+static struct l_s3_queue *
+l_s3_check_queue(lua_State *L, int idx)
+{
+    struct l_s3_queue *q =
+        (struct l_s3_queue *)luaL_checkudata(L, idx, S3_LUA_QUEUE_MT);
+    if (q->fiber == NULL)
+        luaL_error(L, "attempt to use closed s3 queue");
+    return q;
+}
+
+static int
+l_s3_queue_push(lua_State *L, bool file)
+{
+    struct l_s3_queue *q = l_s3_check_queue(L, 1);
+    const char *bucket = luaL_optstring(L, 2, "");
+    luaL_checkstring(L, 3);
+    luaL_checkstring(L, 4);
+    const char *content_type = luaL_optstring(L, 5, "");
+
+    lua_pushstring(L, bucket);
+    lua_pushvalue(L, 3);
+    if (file) {
+        lua_pushvalue(L, 4);
+        lua_pushliteral(L, "");
+    } else {
+        lua_pushliteral(L, "");
+        lua_pushvalue(L, 4);
+    }
+    lua_pushstring(L, content_type);
+
+    if (l_s3_queue_call(L, q, "put", 5, 0) != 0) {
+        s3_error_t err = S3_ERROR_INIT;
+        s3_error_set(&err, S3_E_INVALID_ARG, lua_tostring(L, -1), 0, 0, 0);
+        lua_pushnil(L);
+        l_s3_push_error(L, &err);
+        return 2;
+    }
+    fiber_cond_signal(q->cond);
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+/* queue:put(bucket, key, data[, content_type]) -> true | nil, err */
+static int
+l_s3_queue_put(lua_State *L)
+{
+    return l_s3_queue_push(L, false);
+}
+
+/*
+ * queue:put_file(bucket, key, path[, content_type]) -> true | nil, err
+ *
+ * Файл читается при загрузке, а не при вызове; путь лучше абсолютный.
+ */
+static int
+l_s3_queue_put_file(lua_State *L)
+{
+    return l_s3_queue_push(L, true);
+}
+
+/* queue:stats() -> { pending, uploaded, failed, dropped } */
+static int
+l_s3_queue_stats(lua_State *L)
+{
+    struct l_s3_queue *q = l_s3_check_queue(L, 1);
+
+    if (l_s3_queue_call(L, q, "len", 0, 1) != 0)
+        return lua_error(L);
+    lua_Integer pending = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+
+    lua_createtable(L, 0, 4);
+    lua_pushinteger(L, pending);
+    lua_setfield(L, -2, "pending");
+    lua_pushinteger(L, (lua_Integer)q->uploaded);
+    lua_setfield(L, -2, "uploaded");
+    lua_pushinteger(L, (lua_Integer)q->failed);
+    lua_setfield(L, -2, "failed");
+    lua_pushinteger(L, (lua_Integer)q->dropped);
+    lua_setfield(L, -2, "dropped");
+    return 1;
+}
+
+/* Дождаться текущей пачки и остановить файбер; уступает управление. */
+static void
+l_s3_queue_stop(lua_State *L, struct l_s3_queue *q)
+{
+    struct fiber *f = q->fiber;
+    if (f == NULL)
+        return;
+
+    q->fiber = NULL;
+    q->stopping = true;
+    fiber_cond_signal(q->cond);
+    fiber_join(f);
+    l_s3_queue_release(L, q);
+}
+
+/*
+ * queue:close(): дождаться текущей пачки и остановить файбер.
+ * Незагруженные записи остаются в спейсе.
+ */
+static int
+l_s3_queue_close(lua_State *L)
+{
+    struct l_s3_queue *q =
+        (struct l_s3_queue *)luaL_checkudata(L, 1, S3_LUA_QUEUE_MT);
+    l_s3_queue_stop(L, q);
+    return 0;
+}
+
+/* __gc: до close() не наступает — файбер держит self_ref. */
+static int
+l_s3_queue_gc(lua_State *L)
+{
+    struct l_s3_queue *q =
+        (struct l_s3_queue *)luaL_checkudata(L, 1, S3_LUA_QUEUE_MT);
+    if (q->fiber == NULL)
+        l_s3_queue_release(L, q);
+    return 0;
+}
 
 /* ---------- s3.new{...} ---------- */
 
@@ -485,9 +2952,39 @@ l_s3_new(lua_State *L)
     s3_client_opts_t opts;
     memset(&opts, 0, sizeof(opts));
 
-    /* endpoint (обязательно) */
+    /*
+     * endpoints — список узлов кластера (опционально);
+     * endpoint обязателен, если endpoints не задан.
+     */
+    const char **endpoints = NULL;
+    size_t endpoints_count = 0;
+
+    lua_getfield(L, 1, "endpoints");
+    if (!lua_isnil(L, -1)) {
+        luaL_checktype(L, -1, LUA_TTABLE);
+        endpoints_count = lua_objlen(L, -1);
+    }
+    if (endpoints_count > 0) {
+        /*
+         * Массив указателей — userdata, чтобы не течь при luaL_error.
+         * Остаётся на стеке до конца вызова, строки живут в таблице opts.
+         */
+        endpoints = (const char **)lua_newuserdata(
+            L, endpoints_count * sizeof(*endpoints));
+        for (size_t i = 0; i < endpoints_count; i++) {
+            lua_rawgeti(L, -2, (int)(i + 1));
+            endpoints[i] = luaL_checkstring(L, -1);
+            lua_pop(L, 1);
+        }
+        lua_remove(L, -2); /* таблица endpoints */
+    } else {
+        lua_pop(L, 1);
+    }
+
     lua_getfield(L, 1, "endpoint");
-    const char *endpoint = luaL_checkstring(L, -1);
+    const char *endpoint = NULL;
+    if (endpoints_count == 0 || !lua_isnil(L, -1))
+        endpoint = luaL_checkstring(L, -1);
     lua_pop(L, 1);
 
     /* region (обязательно) */
@@ -526,7 +3023,7 @@ l_s3_new(lua_State *L)
         default_bucket = luaL_checkstring(L, -1);
     lua_pop(L, 1);
 
-    /* backend: "easy" или "multi", по умолчанию "easy" */
+    /* backend: "easy", "multi" или "native", по умолчанию "easy" */
     lua_getfield(L, 1, "backend");
     s3_http_backend_t backend;
     l_s3_parse_backend(L, -1, &backend);
@@ -545,10 +3042,94 @@ l_s3_new(lua_State *L)
         request_timeout_ms = (uint32_t)luaL_checkinteger(L, -1);
     lua_pop(L, 1);
 
+    lua_getfield(L, 1, "endpoint_eject_errors");
+    if (!lua_isnil(L, -1))
+        opts.endpoint_eject_errors = (uint32_t)luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, 1, "endpoint_probe_interval_ms");
+    if (!lua_isnil(L, -1))
+        opts.endpoint_probe_interval_ms = (uint32_t)luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, 1, "endpoint_max_attempts");
+    if (!lua_isnil(L, -1))
+        opts.endpoint_max_attempts = (uint32_t)luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+
+    uint32_t flags = 0;
+
+    /* coalesce_gets: склеивать одновременные одинаковые GET */
+    lua_getfield(L, 1, "coalesce_gets");
+    if (lua_toboolean(L, -1))
+        flags |= S3_CLIENT_F_COALESCE_GETS;
+    lua_pop(L, 1);
+
+    /* pin_dns: резолвить endpoint'ы заранее, обновлять в фоне */
+    lua_getfield(L, 1, "pin_dns");
+    if (lua_toboolean(L, -1))
+        flags |= S3_CLIENT_F_PIN_DNS;
+    lua_pop(L, 1);
+
+    lua_getfield(L, 1, "dns_refresh_ms");
+    if (!lua_isnil(L, -1))
+        opts.dns_refresh_ms = (uint32_t)luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+
+    /* force_path_style: http://host/bucket/key; нужен backend'у "native" */
+    lua_getfield(L, 1, "force_path_style");
+    if (lua_toboolean(L, -1))
+        flags |= S3_CLIENT_F_FORCE_PATH_STYLE;
+    lua_pop(L, 1);
+
+    /* http2: h2 + мультиплексирование (multi backend) */
+    lua_getfield(L, 1, "http2");
+    if (lua_toboolean(L, -1))
+        flags |= S3_CLIENT_F_HTTP2;
+    lua_pop(L, 1);
+
+    lua_getfield(L, 1, "max_concurrent_streams");
+    if (!lua_isnil(L, -1))
+        opts.max_concurrent_streams = (uint32_t)luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, 1, "max_total_connections");
+    if (!lua_isnil(L, -1))
+        opts.max_total_connections = (uint32_t)luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+
+    /* prewarm_connections: держать прогретыми N соединений на endpoint */
+    lua_getfield(L, 1, "prewarm_connections");
+    if (!lua_isnil(L, -1))
+        opts.prewarm_connections = (uint32_t)luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, 1, "keep_warm_interval_ms");
+    if (!lua_isnil(L, -1))
+        opts.keep_warm_interval_ms = (uint32_t)luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, 1, "prewarm_bucket");
+    if (!lua_isnil(L, -1))
+        opts.prewarm_bucket = luaL_checkstring(L, -1);
+    lua_pop(L, 1);
+
+    /* block_cache_bytes: кэш блоков для client:pread */
+    lua_getfield(L, 1, "block_cache_bytes");
+    if (!lua_isnil(L, -1))
+        opts.block_cache_bytes = (size_t)luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, 1, "block_cache_block_size");
+    if (!lua_isnil(L, -1))
+        opts.block_cache_block_size = (uint32_t)luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
 
 
     /* allocator: пока из Lua не прокидываем, используем NULL -> malloc. */
     opts.endpoint = endpoint;
+    opts.endpoints = endpoints;
+    opts.endpoints_count = endpoints_count;
     opts.region = region;
     opts.access_key = access_key;
     opts.secret_key = secret_key;
@@ -559,7 +3140,7 @@ l_s3_new(lua_State *L)
     opts.allocator = NULL;
     opts.connect_timeout_ms = connect_timeout_ms;
     opts.request_timeout_ms = request_timeout_ms;
-    opts.flags = 0;
+    opts.flags = flags;
 
     s3_client_t *client = NULL;
     s3_error_t err = S3_ERROR_INIT;
@@ -585,9 +3166,30 @@ l_s3_new(lua_State *L)
 static const luaL_Reg s3_client_methods[] = {
     { "put_fd",         l_s3_client_put_fd },
     { "get_fd",         l_s3_client_get_fd },
+    { "get_stream",     l_s3_client_get_stream },
+    { "put_stream",     l_s3_client_put_stream },
+    { "put_iov",        l_s3_client_put_iov },
+    { "append",         l_s3_client_append },
+    { "queue",          l_s3_client_queue },
+    { "backup",         l_s3_client_backup },
+    { "restore",        l_s3_client_restore },
+    { "sync",           l_s3_client_sync },
+    { "chunk_put",      l_s3_client_chunk_put },
+    { "chunk_get",      l_s3_client_chunk_get },
+    { "put_fanout",     l_s3_client_put_fanout },
+    { "transfer",       l_s3_client_transfer },
     { "create_bucket",  l_s3_client_create_bucket },
     { "list_objects",   l_s3_client_list_objects },
     { "delete_objects", l_s3_client_delete_objects },
+    { "get_ranges",     l_s3_client_get_ranges },
+    { "pread",          l_s3_client_pread },
+    { "endpoints",      l_s3_client_endpoints },
+    { "stats",          l_s3_client_stats },
+    { "put_pack",       l_s3_client_put_pack },
+    { "open_pack",      l_s3_client_open_pack },
+    { "head",           l_s3_client_head },
+    { "open_read",      l_s3_client_open_read },
+    { "open_write",     l_s3_client_open_write },
     { "close",          l_s3_client_close },
     { "__gc",           l_s3_client_gc },
     { NULL, NULL }
@@ -608,6 +3210,98 @@ l_s3_create_client_mt(lua_State *L)
     lua_pop(L, 1); /* метатаблица остаётся зарегистрированной по имени */
 }
 
+static const luaL_Reg s3_pack_methods[] = {
+    { "get",    l_s3_pack_get },
+    { "get_fd", l_s3_pack_get_fd },
+    { "stat",   l_s3_pack_stat },
+    { "names",  l_s3_pack_names },
+    { "count",  l_s3_pack_count },
+    { "close",  l_s3_pack_close },
+    { "__gc",   l_s3_pack_close },
+    { NULL, NULL }
+};
+
+static void
+l_s3_create_pack_mt(lua_State *L)
+{
+    luaL_newmetatable(L, S3_LUA_PACK_MT);
+
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+
+    luaL_setfuncs(L, s3_pack_methods, 0);
+
+    lua_pop(L, 1);
+}
+
+static const luaL_Reg s3_reader_methods[] = {
+    { "read",  l_s3_reader_read },
+    { "lines", l_s3_reader_lines },
+    { "seek",  l_s3_reader_seek },
+    { "tell",  l_s3_reader_tell },
+    { "size",  l_s3_reader_size },
+    { "close", l_s3_reader_close },
+    { "__gc",  l_s3_reader_close },
+    { NULL, NULL }
+};
+
+static void
+l_s3_create_reader_mt(lua_State *L)
+{
+    luaL_newmetatable(L, S3_LUA_READER_MT);
+
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+
+    luaL_setfuncs(L, s3_reader_methods, 0);
+
+    lua_pop(L, 1);
+}
+
+static const luaL_Reg s3_writer_methods[] = {
+    { "write", l_s3_writer_write },
+    { "close", l_s3_writer_close },
+    { "abort", l_s3_writer_abort },
+    { "bytes", l_s3_writer_bytes },
+    { "__gc",  l_s3_writer_gc },
+    { NULL, NULL }
+};
+
+static void
+l_s3_create_writer_mt(lua_State *L)
+{
+    luaL_newmetatable(L, S3_LUA_WRITER_MT);
+
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+
+    luaL_setfuncs(L, s3_writer_methods, 0);
+
+    lua_pop(L, 1);
+}
+
+static const luaL_Reg s3_queue_methods[] = {
+    { "put",      l_s3_queue_put },
+    { "put_file", l_s3_queue_put_file },
+    { "stats",    l_s3_queue_stats },
+    { "close",    l_s3_queue_close },
+    { "__gc",     l_s3_queue_gc },
+    { NULL, NULL }
+};
+
+static void
+l_s3_create_queue_mt(lua_State *L)
+{
+    luaL_newmetatable(L, S3_LUA_QUEUE_MT);
+
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+
+    luaL_setfuncs(L, s3_queue_methods, 0);
+
+    lua_pop(L, 1);
+}
+
 static const luaL_Reg s3_module_funcs[] = {
     { "new", l_s3_new },
     { NULL, NULL }
@@ -617,6 +3311,11 @@ int
 luaopen_s3(lua_State *L)
 {
     l_s3_create_client_mt(L);
+    l_s3_create_pack_mt(L);
+    l_s3_create_reader_mt(L);
+    l_s3_create_writer_mt(L);
+    l_s3_create_queue_mt(L);
+    l_s3_reaper_start();
 
     lua_newtable(L);
     luaL_setfuncs(L, s3_module_funcs, 0);
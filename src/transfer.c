@@ -0,0 +1,386 @@
+#include "s3_internal.h"
+#include "multipart.h"
+#include "s3/curl_easy_factory.h"
+#include "http/http_util.h"
+#include "error.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <tarantool/module.h>
+
+#define S3_TRANSFER_DEFAULT_PART_SIZE   (8u * 1024 * 1024)
+#define S3_TRANSFER_DEFAULT_CONCURRENCY 4
+#define S3_TRANSFER_MAX_CONCURRENCY     64
+
+/* Сколько раз повторяем упавший Range GET после пачки. */
+#define S3_TRANSFER_GET_RETRIES 2
+
+struct s3_transfer_task {
+    s3_client_t *src;
+    s3_client_t *dst;
+    s3_transfer_opts_t opts;
+    uint64_t bytes;
+
+    uint64_t size;
+    char etag[S3_ETAG_MAX];
+
+    s3_error_t err;
+    s3_error_code_t code;
+};
+
+/* HEAD источника: размер и ETag (для If-Match всех последующих GET). */
+static s3_error_code_t
+s3_transfer_head(struct s3_transfer_task *t)
+{
+    struct s3_http_backend_impl *b = t->src->backend;
+
+    s3_easy_handle_t *h = NULL;
+    if (s3_easy_factory_new_head_object(t->src, t->opts.src_bucket,
+                                        t->opts.src_key, &h,
+                                        &t->err) != S3_E_OK)
+        return t->err.code;
+
+    s3_error_code_t code = b->vtbl->perform(b, h, &t->err);
+    if (code == S3_E_OK) {
+        curl_off_t len = -1;
+        curl_easy_getinfo(h->easy, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &len);
+        if (len < 0) {
+            s3_error_set(&t->err, S3_E_HTTP,
+                         "no Content-Length in HEAD response", 0, 0, 0);
+            code = t->err.code;
+        } else {
+            t->size = (uint64_t)len;
+            memcpy(t->etag, h->etag, sizeof(t->etag));
+        }
+    }
+
+    s3_easy_handle_destroy(h);
+    return code;
+}
+
+/* Range GET [start, start + len) источника в buf. */
+static s3_error_code_t
+s3_transfer_get_handle(struct s3_transfer_task *t, uint64_t start,
+                       size_t len, char *buf, s3_easy_handle_t **out)
+{
+    char range[64];
+    snprintf(range, sizeof(range), "bytes=%" PRIu64 "-%" PRIu64,
+             start, start + len - 1);
+
+    s3_get_opts_t gopts;
+    memset(&gopts, 0, sizeof(gopts));
+    gopts.bucket = t->opts.src_bucket;
+    gopts.key = t->opts.src_key;
+    gopts.range = len > 0 ? range : NULL;
+    gopts.if_match = t->etag[0] != '\0' ? t->etag : NULL;
+
+    return s3_easy_factory_new_get_buf(t->src, &gopts, buf, len, out, &t->err);
+}
+
+/*
+ * Результат GET из пачки: повторить через backend источника, проверить,
+ * что пришло ровно len байт.
+ */
+static s3_error_code_t
+s3_transfer_get_done(struct s3_transfer_task *t, s3_easy_handle_t *h,
+                     size_t len, s3_error_code_t code, s3_error_t *err)
+{
+    struct s3_http_backend_impl *b = t->src->backend;
+
+    for (int attempt = 0; code != S3_E_OK &&
+         attempt < S3_TRANSFER_GET_RETRIES && code != S3_E_NOT_FOUND &&
+         code != S3_E_ACCESS_DENIED && code != S3_E_AUTH &&
+         err->http_status != 412; attempt++)
+    {
+        if (s3_easy_handle_rewind(h) != 0)
+            break;
+        code = b->vtbl->perform(b, h, err);
+    }
+
+    if (code == S3_E_OK && h->write_bytes_total != len) {
+        s3_error_set(err, S3_E_IO, "short read from source in transfer",
+                     0, 0, 0);
+        code = err->code;
+    }
+    return code;
+}
+
+/* Объект не больше одной части: GET в память и обычный PUT. */
+static void
+s3_transfer_single(struct s3_transfer_task *t)
+{
+    struct s3_http_backend_impl *sb = t->src->backend;
+    struct s3_http_backend_impl *db = t->dst->backend;
+    size_t len = (size_t)t->size;
+
+    char *buf = s3_alloc(&t->src->alloc, len > 0 ? len : 1);
+    if (buf == NULL) {
+        s3_error_set(&t->err, S3_E_NOMEM,
+                     "Out of memory in transfer", ENOMEM, 0, 0);
+        t->code = t->err.code;
+        return;
+    }
+
+    s3_easy_handle_t *h = NULL;
+    if (len > 0) {
+        t->code = s3_transfer_get_handle(t, 0, len, buf, &h);
+        if (t->code == S3_E_OK) {
+            t->code = sb->vtbl->perform(sb, h, &t->err);
+            t->code = s3_transfer_get_done(t, h, len, t->code, &t->err);
+        }
+        s3_easy_handle_destroy(h);
+        h = NULL;
+        if (t->code != S3_E_OK)
+            goto out;
+    }
+
+    s3_put_opts_t popts;
+    memset(&popts, 0, sizeof(popts));
+    popts.bucket = t->opts.dst_bucket;
+    popts.key = t->opts.dst_key;
+    popts.content_type = t->opts.content_type;
+
+    t->code = s3_easy_factory_new_put_buf(t->dst, &popts, buf, len, &h,
+                                          &t->err);
+    if (t->code == S3_E_OK)
+        t->code = db->vtbl->perform(db, h, &t->err);
+    s3_easy_handle_destroy(h);
+
+    if (t->code == S3_E_OK)
+        t->bytes = len;
+
+out:
+    s3_free(&t->src->alloc, buf);
+}
+
+/*
+ * Большой объект: Range GET'ы частей источника в одну половину буферов,
+ * пока части из другой половины уходят UploadPart'ами — одной пачкой
+ * curl_multi на оба клиента. Памяти — 2 * part_size * concurrency.
+ */
+static void
+s3_transfer_multipart(struct s3_transfer_task *t)
+{
+    s3_client_t *alloc_client = t->src;
+    size_t psize = t->opts.part_size;
+    uint32_t conc = t->opts.concurrency;
+    uint64_t total_parts = (t->size + psize - 1) / psize;
+
+    if (total_parts > S3_MPU_MAX_PARTS) {
+        s3_error_set(&t->err, S3_E_INVALID_ARG,
+                     "object exceeds 10000 parts, increase part_size",
+                     0, 0, 0);
+        t->code = t->err.code;
+        return;
+    }
+
+    struct s3_mpu mpu;
+    memset(&mpu, 0, sizeof(mpu));
+
+    size_t nslots = 2 * (size_t)conc;
+    char **bufs = s3_alloc(&alloc_client->alloc, nslots * sizeof(*bufs));
+    size_t *sizes = s3_alloc(&alloc_client->alloc, nslots * sizeof(*sizes));
+    s3_easy_handle_t **handles =
+        s3_alloc(&alloc_client->alloc, nslots * sizeof(*handles));
+    s3_error_code_t *codes =
+        s3_alloc(&alloc_client->alloc, nslots * sizeof(*codes));
+    s3_error_t *errs = s3_alloc(&alloc_client->alloc, nslots * sizeof(*errs));
+    size_t nbufs = 0;
+    size_t nh = 0;
+
+    if (bufs == NULL || sizes == NULL || handles == NULL || codes == NULL ||
+        errs == NULL)
+        goto nomem;
+    for (; nbufs < nslots; nbufs++) {
+        bufs[nbufs] = s3_alloc(&alloc_client->alloc, psize);
+        if (bufs[nbufs] == NULL)
+            goto nomem;
+    }
+
+    s3_put_opts_t popts;
+    memset(&popts, 0, sizeof(popts));
+    popts.bucket = t->opts.dst_bucket;
+    popts.key = t->opts.dst_key;
+    popts.content_type = t->opts.content_type;
+
+    t->code = s3_mpu_begin(&mpu, t->dst, &popts, &t->err);
+    if (t->code != S3_E_OK)
+        goto out;
+
+    /*
+     * Шаг i: GET частей волны i (если есть) в половину i % 2 и PUT частей
+     * волны i - 1 (если есть) из другой половины.
+     */
+    uint64_t waves = (total_parts + conc - 1) / conc;
+    for (uint64_t w = 0; w <= waves; w++) {
+        size_t get_base = (size_t)(w % 2) * conc;
+        size_t put_base = (size_t)((w + 1) % 2) * conc;
+        size_t nget = 0, nput = 0;
+        nh = 0;
+
+        if (w > 0) {
+            uint64_t first = (w - 1) * conc;
+            for (; nput < conc && first + nput < total_parts; nput++) {
+                size_t slot = put_base + nput;
+                t->code = s3_mpu_part_handle(&mpu,
+                                             (uint32_t)(first + nput + 1),
+                                             bufs[slot], sizes[slot],
+                                             &handles[nh], &t->err);
+                if (t->code != S3_E_OK)
+                    goto out;
+                nh++;
+            }
+        }
+        if (w < waves) {
+            uint64_t first = w * conc;
+            for (; nget < conc && first + nget < total_parts; nget++) {
+                size_t slot = get_base + nget;
+                uint64_t start = (first + nget) * psize;
+                sizes[slot] = t->size - start < psize ?
+                    (size_t)(t->size - start) : psize;
+                t->code = s3_transfer_get_handle(t, start, sizes[slot],
+                                                 bufs[slot], &handles[nh]);
+                if (t->code != S3_E_OK)
+                    goto out;
+                nh++;
+            }
+        }
+
+        s3_error_t batch_err = S3_ERROR_INIT;
+        s3_error_code_t rc = s3_http_batch_perform(alloc_client, handles, nh,
+                                                   codes, errs, &batch_err);
+
+        for (size_t k = 0; k < nh; k++) {
+            s3_error_code_t c = codes[k];
+            s3_error_t e = errs[k];
+            if (rc != S3_E_OK && c == S3_E_INTERNAL) {
+                c = rc;
+                e = batch_err;
+            }
+
+            if (k < nput) {
+                uint32_t number = (uint32_t)((w - 1) * conc + k + 1);
+                c = s3_mpu_part_retry(&mpu, handles[k], c, &e);
+                if (c == S3_E_OK)
+                    c = s3_mpu_part_done(&mpu, number, handles[k], &e);
+                if (c == S3_E_OK)
+                    t->bytes += sizes[put_base + k];
+            } else {
+                c = s3_transfer_get_done(t, handles[k],
+                                         sizes[get_base + k - nput], c, &e);
+            }
+
+            if (c != S3_E_OK) {
+                t->err = e;
+                t->code = c;
+                goto out;
+            }
+        }
+
+        for (size_t k = 0; k < nh; k++)
+            s3_easy_handle_destroy(handles[k]);
+        nh = 0;
+    }
+
+    t->code = s3_mpu_complete(&mpu, &t->err);
+    goto out;
+
+nomem:
+    s3_error_set(&t->err, S3_E_NOMEM,
+                 "Out of memory for transfer buffers", ENOMEM, 0, 0);
+    t->code = t->err.code;
+
+out:
+    if (t->code != S3_E_OK)
+        s3_mpu_abort(&mpu);
+    s3_mpu_destroy(&mpu);
+
+    for (size_t k = 0; k < nh; k++)
+        s3_easy_handle_destroy(handles[k]);
+    for (size_t i = 0; i < nbufs; i++)
+        s3_free(&alloc_client->alloc, bufs[i]);
+    if (errs != NULL)
+        s3_free(&alloc_client->alloc, errs);
+    if (codes != NULL)
+        s3_free(&alloc_client->alloc, codes);
+    if (handles != NULL)
+        s3_free(&alloc_client->alloc, handles);
+    if (sizes != NULL)
+        s3_free(&alloc_client->alloc, sizes);
+    if (bufs != NULL)
+        s3_free(&alloc_client->alloc, bufs);
+}
+
+static ssize_t
+s3_client_transfer_worker(va_list ap)
+{
+    struct s3_transfer_task *t = va_arg(ap, struct s3_transfer_task *);
+
+    t->code = s3_transfer_head(t);
+    if (t->code != S3_E_OK)
+        return 0;
+
+    if (t->size <= t->opts.part_size)
+        s3_transfer_single(t);
+    else
+        s3_transfer_multipart(t);
+    return 0;
+}
+
+s3_error_code_t
+s3_client_transfer(s3_client_t *src,
+                   s3_client_t *dst,
+                   const s3_transfer_opts_t *opts,
+                   uint64_t *bytes,
+                   s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (src == NULL || opts == NULL || opts->src_key == NULL) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "src client, opts or src_key is NULL in transfer",
+                     0, 0, 0);
+        if (src != NULL)
+            s3_client_set_error(src, err);
+        return err->code;
+    }
+
+    struct s3_transfer_task task;
+    memset(&task, 0, sizeof(task));
+    task.src = src;
+    task.dst = dst != NULL ? dst : src;
+    task.opts = *opts;
+    if (task.opts.dst_key == NULL)
+        task.opts.dst_key = task.opts.src_key;
+    if (task.opts.part_size == 0)
+        task.opts.part_size = S3_TRANSFER_DEFAULT_PART_SIZE;
+    if (task.opts.concurrency == 0)
+        task.opts.concurrency = S3_TRANSFER_DEFAULT_CONCURRENCY;
+
+    if (task.opts.part_size < S3_MPU_MIN_PART_SIZE ||
+        task.opts.concurrency > S3_TRANSFER_MAX_CONCURRENCY)
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "part_size must be >= 5 MiB and concurrency <= 64 "
+                     "in transfer", 0, 0, 0);
+        s3_client_set_error(src, err);
+        return err->code;
+    }
+
+    s3_error_clear(&task.err);
+    task.code = S3_E_OK;
+
+    coio_call(s3_client_transfer_worker, &task);
+
+    if (bytes != NULL)
+        *bytes = task.bytes;
+
+    *err = task.err;
+    s3_client_set_error(src, &task.err);
+    return task.code;
+}
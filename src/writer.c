@@ -0,0 +1,551 @@
+#include "s3/writer.h"
+#include "s3/alloc.h"
+
+#include "s3_internal.h"
+#include "multipart.h"
+#include "s3/curl_easy_factory.h"
+#include "error.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <tarantool/module.h>
+
+#define S3_WRITER_DEFAULT_PART_SIZE   (8u * 1024 * 1024)
+#define S3_WRITER_DEFAULT_CONCURRENCY 4
+#define S3_WRITER_MAX_CONCURRENCY     64
+
+/* Заполненный буфер в очереди на загрузку. */
+struct s3_writer_part {
+    size_t slot;
+    uint32_t number;
+    size_t size;
+};
+
+struct s3_writer {
+    s3_client_t *client;
+
+    char *bucket;
+    char *key;
+    char *content_type;
+    s3_put_opts_t opts;
+
+    size_t part_size;
+    uint32_t concurrency;
+
+    /* concurrency + 1 буферов по part_size. */
+    char **bufs;
+    size_t nslots;
+
+    /* Только tx: буфер, который сейчас заполняется. */
+    size_t cur;
+    size_t cur_len;
+    uint32_t next_number;
+    uint64_t bytes;
+
+    /* Фоновый поток; mpu трогает только он, пока жив. */
+    struct s3_mpu mpu;
+    bool mpu_started;
+    pthread_t thread;
+    bool thread_started;
+
+    /* Под mutex. */
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;       /* есть работа для потока */
+    pthread_cond_t done_cond;  /* освободился буфер / очередь пуста */
+    size_t *free_slots;
+    size_t nfree;
+    struct s3_writer_part *queue;
+    size_t qhead;
+    size_t qlen;
+    size_t inflight;
+    bool stop;
+    bool cancel;
+    bool exited;               /* поток дошёл до конца */
+    bool detached;             /* delete не ждал: writer освободит поток */
+    s3_error_t err;            /* первая ошибка фоновой загрузки */
+
+    bool finished;             /* close или abort уже были */
+};
+
+static void
+s3_writer_free(s3_writer_t *w);
+
+static void
+s3_writer_set_error(s3_writer_t *w, const s3_error_t *err)
+{
+    if (w->err.code == S3_E_OK)
+        w->err = *err;
+}
+
+static void *
+s3_writer_thread_main(void *arg)
+{
+    s3_writer_t *w = (s3_writer_t *)arg;
+
+    char *bufs[S3_WRITER_MAX_CONCURRENCY];
+    size_t sizes[S3_WRITER_MAX_CONCURRENCY];
+    size_t slots[S3_WRITER_MAX_CONCURRENCY];
+
+    pthread_mutex_lock(&w->mutex);
+    for (;;) {
+        while (!w->stop && w->qlen == 0)
+            pthread_cond_wait(&w->cond, &w->mutex);
+        if (w->qlen == 0 || w->cancel)
+            break;
+
+        size_t n = w->qlen < w->concurrency ? w->qlen : w->concurrency;
+        uint32_t first = w->queue[w->qhead].number;
+        for (size_t i = 0; i < n; i++) {
+            struct s3_writer_part *p =
+                &w->queue[(w->qhead + i) % w->nslots];
+            slots[i] = p->slot;
+            bufs[i] = w->bufs[p->slot];
+            sizes[i] = p->size;
+        }
+        w->qhead = (w->qhead + n) % w->nslots;
+        w->qlen -= n;
+        w->inflight = n;
+        bool failed = w->err.code != S3_E_OK;
+        pthread_mutex_unlock(&w->mutex);
+
+        /* После ошибки части только возвращаются в пул. */
+        s3_error_t err = S3_ERROR_INIT;
+        if (!failed && !w->mpu_started) {
+            w->mpu_started = true;
+            s3_mpu_begin(&w->mpu, w->client, &w->opts, &err);
+        }
+        if (!failed && err.code == S3_E_OK)
+            s3_mpu_upload_parts(&w->mpu, first, bufs, sizes, n, &err);
+
+        pthread_mutex_lock(&w->mutex);
+        if (err.code != S3_E_OK)
+            s3_writer_set_error(w, &err);
+        for (size_t i = 0; i < n; i++)
+            w->free_slots[w->nfree++] = slots[i];
+        w->inflight = 0;
+        pthread_cond_broadcast(&w->done_cond);
+    }
+    bool cancel = w->cancel;
+    pthread_mutex_unlock(&w->mutex);
+
+    if (cancel)
+        s3_mpu_abort(&w->mpu);
+
+    pthread_mutex_lock(&w->mutex);
+    w->exited = true;
+    bool detached = w->detached;
+    pthread_mutex_unlock(&w->mutex);
+
+    if (detached)
+        s3_writer_free(w);
+    return NULL;
+}
+
+s3_error_code_t
+s3_writer_open(s3_client_t *client,
+               const s3_writer_opts_t *opts,
+               s3_writer_t **out_writer,
+               s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (client == NULL || opts == NULL || opts->key == NULL ||
+        out_writer == NULL)
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "client, opts, key or out_writer is NULL", 0, 0, 0);
+        return err->code;
+    }
+
+    size_t part_size = opts->part_size > 0 ?
+        opts->part_size : S3_WRITER_DEFAULT_PART_SIZE;
+    uint32_t concurrency = opts->concurrency > 0 ?
+        opts->concurrency : S3_WRITER_DEFAULT_CONCURRENCY;
+    if (part_size < S3_MPU_MIN_PART_SIZE ||
+        concurrency > S3_WRITER_MAX_CONCURRENCY)
+    {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "part_size must be >= 5 MiB and concurrency <= 64 "
+                     "in writer", 0, 0, 0);
+        return err->code;
+    }
+
+    s3_writer_t *w = (s3_writer_t *)s3_alloc(&client->alloc, sizeof(*w));
+    if (w == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Failed to allocate s3 writer", ENOMEM, 0, 0);
+        return err->code;
+    }
+    memset(w, 0, sizeof(*w));
+    w->client = client;
+    w->part_size = part_size;
+    w->concurrency = concurrency;
+    w->nslots = (size_t)concurrency + 1;
+    w->next_number = 1;
+    pthread_mutex_init(&w->mutex, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    pthread_cond_init(&w->done_cond, NULL);
+
+    if (opts->bucket != NULL &&
+        (w->bucket = s3_strdup_a(&client->alloc, opts->bucket, err)) == NULL)
+        goto fail;
+    if ((w->key = s3_strdup_a(&client->alloc, opts->key, err)) == NULL)
+        goto fail;
+    if (opts->content_type != NULL &&
+        (w->content_type = s3_strdup_a(&client->alloc, opts->content_type,
+                                       err)) == NULL)
+        goto fail;
+    w->opts.bucket = w->bucket;
+    w->opts.key = w->key;
+    w->opts.content_type = w->content_type;
+
+    w->bufs = (char **)s3_alloc(&client->alloc, w->nslots * sizeof(*w->bufs));
+    w->free_slots = (size_t *)s3_alloc(&client->alloc,
+                                       w->nslots * sizeof(*w->free_slots));
+    w->queue = (struct s3_writer_part *)s3_alloc(&client->alloc,
+                                                 w->nslots * sizeof(*w->queue));
+    if (w->bufs == NULL || w->free_slots == NULL || w->queue == NULL)
+        goto nomem;
+    memset(w->bufs, 0, w->nslots * sizeof(*w->bufs));
+
+    /* Первый буфер сразу; остальные понадобятся только объекту > part_size. */
+    w->bufs[0] = (char *)s3_alloc(&client->alloc, part_size);
+    if (w->bufs[0] == NULL)
+        goto nomem;
+    for (size_t i = 1; i < w->nslots; i++)
+        w->free_slots[w->nfree++] = i;
+    w->cur = 0;
+
+    int rc = pthread_create(&w->thread, NULL, s3_writer_thread_main, w);
+    if (rc != 0) {
+        s3_error_set(err, S3_E_INIT,
+                     "pthread_create failed for s3 writer", rc, 0, 0);
+        goto fail;
+    }
+    w->thread_started = true;
+
+    *out_writer = w;
+    return S3_E_OK;
+
+nomem:
+    s3_error_set(err, S3_E_NOMEM,
+                 "Out of memory for s3 writer buffers", ENOMEM, 0, 0);
+fail:
+    s3_writer_delete(w);
+    return err->code;
+}
+
+uint64_t
+s3_writer_bytes(const s3_writer_t *w)
+{
+    return w->bytes;
+}
+
+static ssize_t
+s3_writer_wait_free_worker(va_list ap)
+{
+    s3_writer_t *w = va_arg(ap, s3_writer_t *);
+
+    pthread_mutex_lock(&w->mutex);
+    while (w->nfree == 0 && w->err.code == S3_E_OK)
+        pthread_cond_wait(&w->done_cond, &w->mutex);
+    pthread_mutex_unlock(&w->mutex);
+    return 0;
+}
+
+/*
+ * Отдать текущий буфер потоку и, если take_next, взять свободный
+ * (ждёт, если таких нет).
+ */
+static s3_error_code_t
+s3_writer_submit(s3_writer_t *w, bool take_next, s3_error_t *err)
+{
+    if (w->next_number > S3_MPU_MAX_PARTS) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "object exceeds 10000 parts, increase part_size",
+                     0, 0, 0);
+        return err->code;
+    }
+
+    pthread_mutex_lock(&w->mutex);
+    struct s3_writer_part *p = &w->queue[(w->qhead + w->qlen) % w->nslots];
+    p->slot = w->cur;
+    p->number = w->next_number++;
+    p->size = w->cur_len;
+    w->qlen++;
+    pthread_cond_signal(&w->cond);
+
+    if (!take_next) {
+        pthread_mutex_unlock(&w->mutex);
+        return S3_E_OK;
+    }
+
+    if (w->nfree == 0 && w->err.code == S3_E_OK) {
+        pthread_mutex_unlock(&w->mutex);
+        coio_call(s3_writer_wait_free_worker, w);
+        pthread_mutex_lock(&w->mutex);
+    }
+
+    if (w->err.code != S3_E_OK) {
+        *err = w->err;
+        pthread_mutex_unlock(&w->mutex);
+        return err->code;
+    }
+
+    w->cur = w->free_slots[--w->nfree];
+    w->cur_len = 0;
+    pthread_mutex_unlock(&w->mutex);
+
+    /* Слот теперь наш, поток его не трогает. */
+    if (w->bufs[w->cur] == NULL) {
+        w->bufs[w->cur] = (char *)s3_alloc(&w->client->alloc, w->part_size);
+        if (w->bufs[w->cur] == NULL) {
+            s3_error_set(err, S3_E_NOMEM,
+                         "Out of memory for s3 writer buffers", ENOMEM, 0, 0);
+            return err->code;
+        }
+    }
+    return S3_E_OK;
+}
+
+s3_error_code_t
+s3_writer_write(s3_writer_t *w, const void *data, size_t size,
+                s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (w->finished) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "write to closed s3 writer", 0, 0, 0);
+        return err->code;
+    }
+
+    /* Предыдущий submit не смог выделить буфер. */
+    if (w->bufs[w->cur] == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Out of memory for s3 writer buffers", ENOMEM, 0, 0);
+        return err->code;
+    }
+
+    const char *src = (const char *)data;
+    while (size > 0) {
+        if (w->cur_len == w->part_size &&
+            s3_writer_submit(w, true, err) != S3_E_OK)
+        {
+            s3_client_set_error(w->client, err);
+            return err->code;
+        }
+
+        size_t n = w->part_size - w->cur_len;
+        if (n > size)
+            n = size;
+        memcpy(w->bufs[w->cur] + w->cur_len, src, n);
+        w->cur_len += n;
+        w->bytes += n;
+        src += n;
+        size -= n;
+    }
+    return S3_E_OK;
+}
+
+struct s3_writer_close_task {
+    s3_writer_t *w;
+    s3_error_t err;
+    s3_error_code_t code;
+    char etag[S3_ETAG_MAX];
+};
+
+/* Остановить поток и дождаться его (из coio-воркера). */
+static void
+s3_writer_join(s3_writer_t *w, bool cancel)
+{
+    if (!w->thread_started)
+        return;
+
+    pthread_mutex_lock(&w->mutex);
+    w->stop = true;
+    w->cancel = cancel;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->mutex);
+
+    pthread_join(w->thread, NULL);
+    w->thread_started = false;
+}
+
+static ssize_t
+s3_writer_close_worker(va_list ap)
+{
+    struct s3_writer_close_task *t = va_arg(ap, struct s3_writer_close_task *);
+    s3_writer_t *w = t->w;
+
+    /* Ничего не отдано потоку — весь объект в одном буфере. */
+    if (w->next_number == 1) {
+        s3_writer_join(w, false);
+
+        struct s3_http_backend_impl *b = w->client->backend;
+        s3_easy_handle_t *h = NULL;
+        t->code = s3_easy_factory_new_put_buf(w->client, &w->opts,
+                                              w->bufs[w->cur], w->cur_len,
+                                              &h, &t->err);
+        if (t->code == S3_E_OK) {
+            t->code = b->vtbl->perform(b, h, &t->err);
+            memcpy(t->etag, h->etag, sizeof(t->etag));
+        }
+        s3_easy_handle_destroy(h);
+        return 0;
+    }
+
+    pthread_mutex_lock(&w->mutex);
+    while ((w->qlen > 0 || w->inflight > 0) && w->err.code == S3_E_OK)
+        pthread_cond_wait(&w->done_cond, &w->mutex);
+    s3_error_t err = w->err;
+    pthread_mutex_unlock(&w->mutex);
+
+    /* При ошибке поток сам отменит upload. */
+    s3_writer_join(w, err.code != S3_E_OK);
+    if (err.code != S3_E_OK) {
+        t->err = err;
+        t->code = err.code;
+        return 0;
+    }
+
+    t->code = s3_mpu_complete(&w->mpu, &t->err);
+    if (t->code != S3_E_OK) {
+        s3_mpu_abort(&w->mpu);
+        return 0;
+    }
+    memcpy(t->etag, w->mpu.etag, sizeof(t->etag));
+    return 0;
+}
+
+s3_error_code_t
+s3_writer_close(s3_writer_t *w, char *etag, s3_error_t *error)
+{
+    s3_error_t local_err = S3_ERROR_INIT;
+    s3_error_t *err = error ? error : &local_err;
+    s3_error_clear(err);
+
+    if (w->finished) {
+        s3_error_set(err, S3_E_INVALID_ARG,
+                     "s3 writer is already closed", 0, 0, 0);
+        return err->code;
+    }
+    w->finished = true;
+
+    if (w->bufs[w->cur] == NULL) {
+        s3_error_set(err, S3_E_NOMEM,
+                     "Out of memory for s3 writer buffers", ENOMEM, 0, 0);
+        s3_writer_abort(w);
+        s3_client_set_error(w->client, err);
+        return err->code;
+    }
+
+    /* Хвост — последняя (неполная) часть. */
+    if (w->next_number > 1 && w->cur_len > 0 &&
+        s3_writer_submit(w, false, err) != S3_E_OK)
+    {
+        s3_writer_abort(w);
+        s3_client_set_error(w->client, err);
+        return err->code;
+    }
+
+    struct s3_writer_close_task task;
+    memset(&task, 0, sizeof(task));
+    task.w = w;
+    s3_error_clear(&task.err);
+    task.code = S3_E_OK;
+
+    coio_call(s3_writer_close_worker, &task);
+
+    if (etag != NULL && task.code == S3_E_OK)
+        memcpy(etag, task.etag, S3_ETAG_MAX);
+
+    *err = task.err;
+    s3_client_set_error(w->client, &task.err);
+    return task.code;
+}
+
+static ssize_t
+s3_writer_abort_worker(va_list ap)
+{
+    s3_writer_t *w = va_arg(ap, s3_writer_t *);
+    s3_writer_join(w, true);
+    return 0;
+}
+
+void
+s3_writer_abort(s3_writer_t *w)
+{
+    w->finished = true;
+    if (w->thread_started)
+        coio_call(s3_writer_abort_worker, w);
+}
+
+static void
+s3_writer_free(s3_writer_t *w)
+{
+    s3_client_t *c = w->client;
+
+    s3_mpu_destroy(&w->mpu);
+
+    pthread_cond_destroy(&w->done_cond);
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->mutex);
+
+    if (w->bufs != NULL) {
+        for (size_t i = 0; i < w->nslots; i++) {
+            if (w->bufs[i] != NULL)
+                s3_free(&c->alloc, w->bufs[i]);
+        }
+        s3_free(&c->alloc, w->bufs);
+    }
+    if (w->queue != NULL)
+        s3_free(&c->alloc, w->queue);
+    if (w->free_slots != NULL)
+        s3_free(&c->alloc, w->free_slots);
+    if (w->content_type != NULL)
+        s3_free(&c->alloc, w->content_type);
+    if (w->key != NULL)
+        s3_free(&c->alloc, w->key);
+    if (w->bucket != NULL)
+        s3_free(&c->alloc, w->bucket);
+    s3_free(&c->alloc, w);
+}
+
+void
+s3_writer_delete(s3_writer_t *w)
+{
+    if (w == NULL)
+        return;
+
+    /*
+     * Поток ещё жив (writer не закрыт и не отменён): не ждём его на
+     * tx-треде, а отпускаем — он отменит upload и освободит writer сам.
+     */
+    if (w->thread_started) {
+        pthread_mutex_lock(&w->mutex);
+        bool exited = w->exited;
+        if (!exited) {
+            w->detached = true;
+            w->stop = true;
+            w->cancel = true;
+            pthread_cond_signal(&w->cond);
+        }
+        pthread_mutex_unlock(&w->mutex);
+
+        if (!exited) {
+            pthread_detach(w->thread);
+            return;
+        }
+        pthread_join(w->thread, NULL);
+        w->thread_started = false;
+    }
+    s3_writer_free(w);
+}